@@ -166,6 +166,7 @@ enum rig_debug_level_e {
 
 struct rig;
 struct rig_state;
+struct rig_batch_op;
 
 /**
  * \brief Rig structure definition (see rig for details).
@@ -176,6 +177,7 @@ typedef struct s_rig RIG;
 #define RIGNAMSIZ 30
 #define RIGVERSIZ 8
 #define FILPATHLEN 512
+#define PORTRXBUFSIZ 1024   /* per-port receive buffer size */
 #define FRQRANGESIZ 30
 #define MAXCHANDESC 30      /* describe channel eg: "WWV 5Mhz" */
 #define TSLSTSIZ 20         /* max tuning step list size, zero ended */
@@ -217,6 +219,7 @@ typedef enum rig_port_e {
     RIG_PORT_CM108,         /*!< CM108 GPIO */
     RIG_PORT_GPIO,          /*!< GPIO */
     RIG_PORT_GPION,         /*!< GPIO inverted */
+    RIG_PORT_REPLAY,        /*!< Replay of a trace file, no hardware */
 } rig_port_t;
 
 
@@ -1837,6 +1840,9 @@ struct rig_caps {
     const char *clone_combo_set;    /*!< String describing key combination to enter load cloning mode */
     const char *clone_combo_get;    /*!< String describing key combination to enter save cloning mode */
     const char *macro_name;     /*!< Rig model macro name */
+
+    int (*batch_prefetch)(RIG *rig, const struct rig_batch_op *ops, int count); // see rig_batch_exec()
+    int (*batch_verify)(RIG *rig, int defer); // see rig_batch_exec()
 };
 //! @endcond
 
@@ -1847,6 +1853,10 @@ struct rig_caps {
  * Of course, looks like OO painstakingly programmed in C, sigh.
  */
 //! @cond Doxygen_Suppress
+struct port_trace;
+struct port_replay;
+struct port_adaptive;
+
 typedef struct hamlib_port {
     union {
         rig_port_t rig;     /*!< Communication port type */
@@ -1903,6 +1913,27 @@ typedef struct hamlib_port {
             int value;      /*!< Toggle PTT ON or OFF */
         } gpio;             /*!< GPIO attributes */
     } parm;                 /*!< Port parameter union */
+
+    struct {
+        int head;           /*!< Index of the next unread byte */
+        int tail;           /*!< Index one past the last received byte */
+        unsigned char buf[PORTRXBUFSIZ]; /*!< Bytes read but not consumed yet */
+    } rxbuf;                /*!< Receive buffer, hamlib internal use */
+
+    struct port_trace *trace;   /*!< Wire tracer, hamlib internal use */
+
+    struct {
+        struct port_replay *state;  /*!< Replay thread, hamlib internal use */
+        int timing;         /*!< Reply at the recorded pace, not at once */
+    } replay;               /*!< Trace file replay */
+
+    struct {
+        struct port_adaptive *state;    /*!< Learned timeouts, NULL when off */
+        int min;            /*!< Lowest adaptive timeout, in mS */
+        int max;            /*!< Highest adaptive timeout in mS, 0 for timeout */
+    } adaptive;             /*!< Adaptive timeout */
+
+    uint64_t write_deadline;    /*!< Earliest next write, monotonic uS, hamlib internal use */
 } hamlib_port_t;
 //! @endcond
 
@@ -1915,14 +1946,41 @@ typedef hamlib_port_t port_t;
 #define HAMLIB_ELAPSED_INVALIDATE 2
 
 typedef enum {
-    HAMLIB_CACHE_ALL, // to set all cache timeouts at once
+    HAMLIB_CACHE_ALL, // to set the VFO, freq, mode, PTT and split timeouts at once
     HAMLIB_CACHE_VFO,
     HAMLIB_CACHE_FREQ,
     HAMLIB_CACHE_MODE,
     HAMLIB_CACHE_PTT,
-    HAMLIB_CACHE_SPLIT
+    HAMLIB_CACHE_SPLIT,
+    HAMLIB_CACHE_LEVEL, // this one and the next ones are off until set one by one
+    HAMLIB_CACHE_FUNC,
+    HAMLIB_CACHE_RIT,
+    HAMLIB_CACHE_XIT,
+    HAMLIB_CACHE_TS,
+    HAMLIB_CACHE_CTCSS,
+    HAMLIB_CACHE_ANT,
+    HAMLIB_CACHE_MAX // keep last, number of cache kinds
 } hamlib_cache_t;
 
+#define HAMLIB_CACHE_SETTINGS 32    /* max number of cached settings */
+
+/**
+ * \brief Cached setting
+ *
+ * One cached value of the generic settings cache, keyed by
+ * (vfo, kind, id) where id is the level, func, antenna... concerned.
+ */
+struct rig_cache_setting {
+    hamlib_cache_t kind;    // HAMLIB_CACHE_ALL marks an unused slot
+    vfo_t vfo;
+    setting_t id;
+    value_t val;
+    ant_t ant_curr;         // HAMLIB_CACHE_ANT only
+    ant_t ant_tx;
+    ant_t ant_rx;
+    struct timespec time;
+};
+
 /**
  * \brief Rig cache data
  * 
@@ -1964,6 +2022,84 @@ struct rig_cache {
     vfo_t vfo_freq; // last vfo cached
     vfo_t vfo_mode; // last vfo cached
     int satmode; // if rig is in satellite mode
+    int timeout_kind_ms[HAMLIB_CACHE_MAX]; // per kind timeouts, see rig_set_cache_timeout_ms()
+    struct rig_cache_setting settings[HAMLIB_CACHE_SETTINGS]; // levels, funcs, RIT/XIT, ts, CTCSS, antennas
+};
+
+
+/**
+ * \brief Rig state snapshot
+ *
+ * Consistent copy of the main cached items, see rig_get_state_snapshot().
+ */
+struct rig_state_snapshot {
+    unsigned long version;  /*!< Bumped on every update, 0 until the first one */
+    struct timespec time;   /*!< When this version was published */
+    vfo_t vfo;              /*!< Current VFO */
+    freq_t freq;            /*!< Last frequency read or set */
+    vfo_t vfo_freq;         /*!< VFO of freq */
+    freq_t freqMainA;       /*!< VFOA/Main frequency */
+    freq_t freqMainB;       /*!< VFOB/Sub frequency */
+    rmode_t mode;           /*!< Last mode read or set */
+    pbwidth_t width;        /*!< Passband width of mode */
+    vfo_t vfo_mode;         /*!< VFO of mode */
+    ptt_t ptt;              /*!< PTT status */
+    split_t split;          /*!< Split status */
+    vfo_t split_vfo;        /*!< TX VFO when in split */
+    int satmode;            /*!< Satellite mode status */
+};
+
+
+/**
+ * \brief Batch operations
+ *
+ * \sa rig_batch_add(), rig_batch_exec()
+ */
+typedef enum {
+    /* gets are even, sets odd, see RIG_BATCH_IS_GET() */
+    RIG_BATCH_GET_FREQ,         /*!< rig_get_freq(), result in freq */
+    RIG_BATCH_SET_FREQ,         /*!< rig_set_freq() of freq */
+    RIG_BATCH_GET_MODE,         /*!< rig_get_mode(), result in mode and width */
+    RIG_BATCH_SET_MODE,         /*!< rig_set_mode() of mode and width */
+    RIG_BATCH_GET_VFO,          /*!< rig_get_vfo(), result in tx_vfo */
+    RIG_BATCH_SET_VFO,          /*!< rig_set_vfo() of vfo */
+    RIG_BATCH_GET_PTT,          /*!< rig_get_ptt(), result in ptt */
+    RIG_BATCH_SET_PTT,          /*!< rig_set_ptt() of ptt */
+    RIG_BATCH_GET_SPLIT_VFO,    /*!< rig_get_split_vfo(), result in split and tx_vfo */
+    RIG_BATCH_SET_SPLIT_VFO,    /*!< rig_set_split_vfo() of split and tx_vfo */
+    RIG_BATCH_GET_LEVEL,        /*!< rig_get_level() of level, result in val */
+    RIG_BATCH_SET_LEVEL,        /*!< rig_set_level() of level to val */
+} rig_batch_op_t;
+
+#define RIG_BATCH_IS_GET(op) (((op) & 1) == 0)
+
+/**
+ * \brief One operation of a batch, arguments and results
+ */
+struct rig_batch_op {
+    rig_batch_op_t op;  /*!< Operation */
+    vfo_t vfo;          /*!< Target VFO */
+    freq_t freq;        /*!< Frequency */
+    rmode_t mode;       /*!< Mode */
+    pbwidth_t width;    /*!< Passband width */
+    ptt_t ptt;          /*!< PTT status */
+    split_t split;      /*!< Split status */
+    vfo_t tx_vfo;       /*!< TX VFO, or current VFO for RIG_BATCH_GET_VFO */
+    setting_t level;    /*!< Level */
+    value_t val;        /*!< Level value */
+    int retcode;        /*!< Result of the operation, RIG_OK or a negative error code */
+};
+
+#define RIG_BATCH_MAX 16   /* max number of operations in a batch */
+
+/**
+ * \brief A batch of operations
+ *
+ * \sa rig_batch_init()
+ */
+struct rig_batch {
+    int count;                              /*!< Number of queued operations */
+    struct rig_batch_op ops[RIG_BATCH_MAX]; /*!< Queued operations */
 };
 
 
@@ -2055,6 +2191,9 @@ struct rig_state {
     int power_now;              /*!< Current RF power level in rig units */
     int power_min;              /*!< Minimum RF power level in rig units */
     int power_max;              /*!< Maximum RF power level in rig units */
+    unsigned long snapshot_seq; /*!< Snapshot sequence lock, odd while updating */
+    struct rig_state_snapshot snapshot; /*!< Last published snapshot, see rig_get_state_snapshot() */
+    rig_ptr_t trn_engine;       /*!< Transceive event thread, hamlib internal use */
 };
 
 //! @cond Doxygen_Suppress
@@ -2619,6 +2758,11 @@ rig_set_trn HAMLIB_PARAMS((RIG *rig,
 extern HAMLIB_EXPORT(int)
 rig_get_trn HAMLIB_PARAMS((RIG *rig,
                            int *trn));
+extern HAMLIB_EXPORT(int)
+rig_get_event_fd HAMLIB_PARAMS((RIG *rig,
+                                int *fd));
+extern HAMLIB_EXPORT(int)
+rig_process_events HAMLIB_PARAMS((RIG *rig));
 
 extern HAMLIB_EXPORT(int)
 rig_set_freq_callback HAMLIB_PARAMS((RIG *,
@@ -2701,6 +2845,9 @@ rig_set_debug HAMLIB_PARAMS((enum rig_debug_level_e debug_level));
 extern HAMLIB_EXPORT(void)
 rig_set_debug_time_stamp HAMLIB_PARAMS((int flag));
 
+extern HAMLIB_EXPORT(int)
+rig_set_debug_async HAMLIB_PARAMS((int flag));
+
 #define rig_set_debug_level(level) rig_set_debug(level)
 
 extern HAMLIB_EXPORT(int)
@@ -2710,8 +2857,12 @@ rig_need_debug HAMLIB_PARAMS((enum rig_debug_level_e debug_level));
 
 #ifndef __cplusplus
 #ifdef __GNUC__
-// doing the debug macro with a dummy sprintf allows gcc to check the format string
-#define rig_debug(debug_level,fmt,...) { char xxxbuf[16384]="";snprintf(xxxbuf,sizeof(xxxbuf),fmt,__VA_ARGS__);rig_debug(debug_level,fmt,##__VA_ARGS__); }
+// the format attribute has gcc check the format string, and the macro
+// keeps the arguments from being evaluated when the message is not wanted
+extern HAMLIB_EXPORT(void)
+rig_debug(enum rig_debug_level_e debug_level, const char *fmt, ...)
+__attribute__((format(printf, 2, 3)));
+#define rig_debug(debug_level,fmt,...) { if (rig_need_debug(debug_level)) rig_debug(debug_level,fmt,##__VA_ARGS__); }
 #endif
 #endif
 extern HAMLIB_EXPORT(void)
@@ -2787,6 +2938,11 @@ extern HAMLIB_EXPORT(void) rig_no_restore_ai();
 
 extern HAMLIB_EXPORT(int) rig_get_cache_timeout_ms(RIG *rig, hamlib_cache_t selection);
 extern HAMLIB_EXPORT(int) rig_set_cache_timeout_ms(RIG *rig, hamlib_cache_t selection, int ms);
+extern HAMLIB_EXPORT(int) rig_get_state_snapshot(RIG *rig, struct rig_state_snapshot *snapshot);
+
+extern HAMLIB_EXPORT(void) rig_batch_init(struct rig_batch *batch);
+extern HAMLIB_EXPORT(struct rig_batch_op *) rig_batch_add(struct rig_batch *batch, rig_batch_op_t op, vfo_t vfo);
+extern HAMLIB_EXPORT(int) rig_batch_exec(RIG *rig, struct rig_batch *batch);
 
 extern HAMLIB_EXPORT(int) rig_set_vfo_opt(RIG *rig, int status);
 
@@ -31,6 +31,11 @@
 #include <time.h>
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <sys/socket.h>
+#endif
+
 #include "hamlib/rig.h"
 #include "network.h"
 #include "serial.h"
@@ -45,10 +50,63 @@
 
 #define CHKSCN1ARG(a) if ((a) != 1) return -RIG_EPROTO; else do {} while(0)
 
+#define TOK_CFG_PUSH_CACHE  TOKEN_BACKEND(1)
+
+/* items of the state pushed by rigctld */
+#define NETRIGCTL_PUSH_FREQ (1 << 0)
+#define NETRIGCTL_PUSH_MODE (1 << 1)
+#define NETRIGCTL_PUSH_PTT  (1 << 2)
+#define NETRIGCTL_PUSH_VFO  (1 << 3)
+#define NETRIGCTL_PUSH_ALL  0xf
+#define NETRIGCTL_PUSH_ITEMS 4
+
+struct netrigctl_push_state
+{
+    unsigned int valid;         /* NETRIGCTL_PUSH_xxx items known */
+    vfo_t vfo;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+};
+
+/* replies read ahead by netrigctl_batch_prefetch, rigctld answers
+ * some gets with two lines */
+struct netrigctl_batch_reply
+{
+    char cmd[CMD_MAX];
+    char reply[2][BUF_MAX];
+    int lines;
+};
+
 struct netrigctl_priv_data
 {
     vfo_t vfo_curr;
     int rigctld_vfo_mode;
+    struct netrigctl_batch_reply batch[RIG_BATCH_MAX];
+    int batch_count;
+    const char *batch_line;     /* second line of the last reply served */
+    int push_cache;             /* keep the state rigctld pushes */
+#ifdef HAVE_PTHREAD
+    hamlib_port_t push_port;    /* subscribed connection */
+    pthread_t push_thread;
+    pthread_mutex_t push_lock;
+    int push_running;           /* atomic, read by the reader thread */
+    struct netrigctl_push_state push;
+    /* rigctld snapshot version of our last set of each item,
+     * older pushes are ignored */
+    unsigned long push_fence[NETRIGCTL_PUSH_ITEMS];
+#endif
+};
+
+static const struct confparams netrigctl_cfg_params[] =
+{
+    {
+        TOK_CFG_PUSH_CACHE, "push_cache", "Push cache",
+        "Keep a local copy of the freq, mode, PTT and VFO pushed by rigctld",
+        "0", RIG_CONF_CHECKBUTTON, { }
+    },
+    { RIG_CONF_END, NULL, }
 };
 
 int netrigctl_get_vfo_mode(RIG *rig)
@@ -58,6 +116,54 @@ int netrigctl_get_vfo_mode(RIG *rig)
     return priv->rigctld_vfo_mode;
 }
 
+/*
+ * Serves a reply read ahead by netrigctl_batch_prefetch, if any
+ * Returns the length of the first line, 0 when cmd was not sent ahead
+ */
+static int netrigctl_batch_reply(RIG *rig, const char *cmd, int len, char *buf)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    int i;
+
+    priv->batch_line = NULL;
+
+    for (i = 0; i < priv->batch_count; i++)
+    {
+        struct netrigctl_batch_reply *b = &priv->batch[i];
+
+        if (b->cmd[0] && strlen(b->cmd) == len && memcmp(b->cmd, cmd, len) == 0)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: using prefetched reply for %s", __func__,
+                      b->cmd);
+            strcpy(buf, b->reply[0]);
+
+            if (b->lines > 1) { priv->batch_line = b->reply[1]; }
+
+            b->cmd[0] = '\0';  /* each reply is used once */
+            return strlen(buf);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Reads the next line of a multi line reply
+ */
+static int netrigctl_read_line(RIG *rig, char *buf)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    if (priv->batch_line)
+    {
+        strcpy(buf, priv->batch_line);
+        priv->batch_line = NULL;
+        return strlen(buf);
+    }
+
+    return read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+}
+
 /*
  * Helper function with protocol return code parsing
  */
@@ -67,6 +173,18 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s: called len=%d\n", __func__, len);
 
+    ret = netrigctl_batch_reply(rig, cmd, len, buf);
+
+    if (ret > 0)
+    {
+        if (strncmp(buf, NETRIGCTL_RET, strlen(NETRIGCTL_RET)) == 0)
+        {
+            return atoi(buf + strlen(NETRIGCTL_RET));
+        }
+
+        return ret;
+    }
+
     /* flush anything in the read buffer before command is sent */
     rig_flush(&rig->state.rigport);
 
@@ -198,6 +316,369 @@ static int netrigctl_cleanup(RIG *rig)
     return RIG_OK;
 }
 
+#ifdef HAVE_PTHREAD
+
+/*
+ * Push cache
+ *
+ * With the push_cache option a second connection subscribes to the
+ * rigctld change notifications, and a reader thread keeps the pushed
+ * freq, mode, PTT and VFO.  Gets of those are then answered locally
+ * instead of costing a round trip to rigctld.  Our own sets drop the
+ * item until rigctld pushes it again.
+ *
+ * rigctld tags the pushes with its snapshot version.  A set asks for the
+ * version it produced, see netrigctl_set_transaction(), so that a push
+ * sent before the set and read after it cannot bring back the old value.
+ */
+
+/* items of which a push of version is older than our last set */
+static unsigned int netrigctl_push_stale(struct netrigctl_priv_data *priv,
+        unsigned long version)
+{
+    unsigned int stale = 0;
+    int i;
+
+    for (i = 0; i < NETRIGCTL_PUSH_ITEMS; i++)
+    {
+        if (version < priv->push_fence[i])
+        {
+            stale |= 1 << i;
+        }
+    }
+
+    return stale;
+}
+
+
+static void *netrigctl_push_reader(void *arg)
+{
+    RIG *rig = arg;
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char buf[BUF_MAX];
+    unsigned long version = 0;
+    unsigned int stale;
+
+    while (__atomic_load_n(&priv->push_running, __ATOMIC_ACQUIRE))
+    {
+        int ret = read_string(&priv->push_port, buf, BUF_MAX, "\n", 1);
+
+        if (ret == -RIG_ETIMEOUT)
+        {
+            continue;
+        }
+
+        if (ret <= 0)
+        {
+            break;
+        }
+
+        if (buf[ret - 1] == '\n') { buf[ret - 1] = '\0'; } /* chomp */
+
+        if (strncmp(buf, "Version: ", 9) == 0)
+        {
+            /* of the lines that follow */
+            version = strtoul(buf + 9, NULL, 10);
+            continue;
+        }
+
+        pthread_mutex_lock(&priv->push_lock);
+
+        stale = netrigctl_push_stale(priv, version);
+
+        if (strncmp(buf, "Frequency: ", 11) == 0 && !(stale & NETRIGCTL_PUSH_FREQ))
+        {
+            priv->push.freq = atof(buf + 11);
+            priv->push.valid |= NETRIGCTL_PUSH_FREQ;
+        }
+        else if (strncmp(buf, "Mode: ", 6) == 0 && !(stale & NETRIGCTL_PUSH_MODE))
+        {
+            /* valid again with the Passband line */
+            priv->push.mode = rig_parse_mode(buf + 6);
+            priv->push.valid &= ~NETRIGCTL_PUSH_MODE;
+        }
+        else if (strncmp(buf, "Passband: ", 10) == 0
+                 && !(stale & NETRIGCTL_PUSH_MODE))
+        {
+            priv->push.width = atol(buf + 10);
+            priv->push.valid |= NETRIGCTL_PUSH_MODE;
+        }
+        else if (strncmp(buf, "PTT: ", 5) == 0 && !(stale & NETRIGCTL_PUSH_PTT))
+        {
+            priv->push.ptt = atoi(buf + 5);
+            priv->push.valid |= NETRIGCTL_PUSH_PTT;
+        }
+        else if (strncmp(buf, "VFO: ", 5) == 0 && !(stale & NETRIGCTL_PUSH_VFO))
+        {
+            priv->push.vfo = rig_parse_vfo(buf + 5);
+            priv->push.valid |= NETRIGCTL_PUSH_VFO;
+        }
+
+        pthread_mutex_unlock(&priv->push_lock);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: push stream closed\n", __func__);
+
+    pthread_mutex_lock(&priv->push_lock);
+    priv->push.valid = 0;
+    pthread_mutex_unlock(&priv->push_lock);
+
+    return NULL;
+}
+
+
+static void netrigctl_push_start(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char buf[BUF_MAX];
+    int ret;
+
+    /*
+     * Only the address of rigctld is taken from the rig port, whose
+     * receive buffer, tracer, replay and adaptive timeout state are its
+     * own and must not be shared with the push reader.
+     */
+    memset(&priv->push_port, 0, sizeof(priv->push_port));
+    priv->push_port.type.rig = rig->state.rigport.type.rig;
+    memcpy(priv->push_port.pathname, rig->state.rigport.pathname,
+           sizeof(priv->push_port.pathname));
+    priv->push_port.fd = -1;
+    priv->push_port.timeout = 60000;    /* nothing to read while nothing changes */
+    priv->push_port.retry = 0;
+
+    ret = network_open(&priv->push_port, 4532);
+
+    if (ret != RIG_OK)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: cannot open push connection: %s\n", __func__,
+                  rigerror(ret));
+        return;
+    }
+
+    ret = write_block(&priv->push_port, "\\subscribe all\n", 15);
+
+    if (ret == RIG_OK)
+    {
+        ret = read_string(&priv->push_port, buf, BUF_MAX, "\n", 1);
+    }
+
+    if (ret <= 0 || strncmp(buf, NETRIGCTL_RET "0", strlen(NETRIGCTL_RET) + 1) != 0)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: rigctld does not push changes\n", __func__);
+        network_close(&priv->push_port);
+        return;
+    }
+
+    memset(&priv->push, 0, sizeof(priv->push));
+    memset(priv->push_fence, 0, sizeof(priv->push_fence));
+    pthread_mutex_init(&priv->push_lock, NULL);
+    __atomic_store_n(&priv->push_running, 1, __ATOMIC_RELEASE);
+
+    ret = pthread_create(&priv->push_thread, NULL, netrigctl_push_reader, rig);
+
+    if (ret != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__, strerror(ret));
+        __atomic_store_n(&priv->push_running, 0, __ATOMIC_RELEASE);
+        pthread_mutex_destroy(&priv->push_lock);
+        network_close(&priv->push_port);
+    }
+}
+
+
+static void netrigctl_push_stop(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    if (!__atomic_load_n(&priv->push_running, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    __atomic_store_n(&priv->push_running, 0, __ATOMIC_RELEASE);
+
+    /* wakes the reader up */
+    shutdown(priv->push_port.fd, SHUT_RDWR);
+    pthread_join(priv->push_thread, NULL);
+
+    network_close(&priv->push_port);
+    pthread_mutex_destroy(&priv->push_lock);
+}
+
+
+/*
+ * Copies the pushed state when item is known for vfo
+ */
+static int netrigctl_push_lookup(RIG *rig, vfo_t vfo, unsigned int item,
+                                 struct netrigctl_push_state *state)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    if (!__atomic_load_n(&priv->push_running, __ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&priv->push_lock);
+    *state = priv->push;
+    pthread_mutex_unlock(&priv->push_lock);
+
+    if (!(state->valid & item))
+    {
+        return 0;
+    }
+
+    /* freq and mode are pushed for the current VFO */
+    return vfo == RIG_VFO_CURR
+           || ((state->valid & NETRIGCTL_PUSH_VFO) && vfo == state->vfo)
+           || !(item & (NETRIGCTL_PUSH_FREQ | NETRIGCTL_PUSH_MODE));
+}
+
+
+static void netrigctl_push_invalidate(RIG *rig, unsigned int items)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    if (!__atomic_load_n(&priv->push_running, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&priv->push_lock);
+    priv->push.valid &= ~items;
+    pthread_mutex_unlock(&priv->push_lock);
+}
+
+
+/*
+ * netrigctl_transaction() of a set changing items.  The items are
+ * dropped, and \get_snapshot is sent along with the command, in the same
+ * write, for the version rigctld published with the set.  Pushes of the
+ * items older than that version are then ignored.
+ */
+static int netrigctl_set_transaction(RIG *rig, unsigned int items, char *cmd,
+                                     int len, char *buf)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char setcmd[CMD_MAX + 16];
+    char line[BUF_MAX];
+    unsigned long version;
+    int ret;
+    int i;
+
+    if (!__atomic_load_n(&priv->push_running, __ATOMIC_ACQUIRE))
+    {
+        return netrigctl_transaction(rig, cmd, len, buf);
+    }
+
+    netrigctl_push_invalidate(rig, items);
+
+    memcpy(setcmd, cmd, len);
+    len += sprintf(setcmd + len, "\\get_snapshot\n");
+
+    buf[0] = '\0';
+    ret = netrigctl_transaction(rig, setcmd, len, buf);
+
+    /* rigctld answers the snapshot even when the command failed,
+     * unless the connection itself did */
+    if (buf[0] == '\0'
+            || read_string(&rig->state.rigport, line, BUF_MAX, "\n", 1) <= 0)
+    {
+        return ret;
+    }
+
+    if (strncmp(line, NETRIGCTL_RET, strlen(NETRIGCTL_RET)) == 0)
+    {
+        return ret;     /* no snapshot, the pushes are taken as they come */
+    }
+
+    version = strtoul(line, NULL, 10);
+
+    /* VFO, Frequency, Mode, Passband, PTT, Split, TX VFO, Satmode */
+    for (i = 0; i < 8; i++)
+    {
+        if (read_string(&rig->state.rigport, line, BUF_MAX, "\n", 1) <= 0)
+        {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&priv->push_lock);
+
+    for (i = 0; i < NETRIGCTL_PUSH_ITEMS; i++)
+    {
+        if (items & (1 << i))
+        {
+            priv->push_fence[i] = version;
+        }
+    }
+
+    /* a push read while the set was on its way may be older */
+    priv->push.valid &= ~items;
+
+    pthread_mutex_unlock(&priv->push_lock);
+
+    return ret;
+}
+
+#else
+
+static void netrigctl_push_start(RIG *rig)
+{
+    rig_debug(RIG_DEBUG_WARN, "%s: push cache needs pthread support\n", __func__);
+}
+
+static void netrigctl_push_stop(RIG *rig) {}
+
+static int netrigctl_push_lookup(RIG *rig, vfo_t vfo, unsigned int item,
+                                 struct netrigctl_push_state *state)
+{
+    return 0;
+}
+
+static int netrigctl_set_transaction(RIG *rig, unsigned int items, char *cmd,
+                                     int len, char *buf)
+{
+    return netrigctl_transaction(rig, cmd, len, buf);
+}
+
+#endif
+
+
+static int netrigctl_set_conf(RIG *rig, token_t token, const char *val)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    switch (token)
+    {
+    case TOK_CFG_PUSH_CACHE:
+        priv->push_cache = atoi(val) ? 1 : 0;
+        break;
+
+    default:
+        return -RIG_EINVAL;
+    }
+
+    return RIG_OK;
+}
+
+static int netrigctl_get_conf(RIG *rig, token_t token, char *val)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    switch (token)
+    {
+    case TOK_CFG_PUSH_CACHE:
+        sprintf(val, "%d", priv->push_cache);
+        break;
+
+    default:
+        return -RIG_EINVAL;
+    }
+
+    return RIG_OK;
+}
+
 static int netrigctl_open(RIG *rig)
 {
     int ret, len, i;
@@ -550,7 +1031,12 @@ static int netrigctl_open(RIG *rig)
             return (ret < 0) ? ret : -RIG_EPROTO;
         }
 
-        if (strncmp(buf, "done", 4) == 0) { return RIG_OK; }
+        if (strncmp(buf, "done", 4) == 0)
+        {
+            if (priv->push_cache) { netrigctl_push_start(rig); }
+
+            return RIG_OK;
+        }
 
         if (sscanf(buf, "%31[^=]=%255[^\t\n]", setting, value) == 2)
         {
@@ -607,6 +1093,8 @@ static int netrigctl_close(RIG *rig)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    netrigctl_push_stop(rig);
+
     ret = netrigctl_transaction(rig, "q\n", 2, buf);
 
     if (ret != RIG_OK)
@@ -640,7 +1128,7 @@ static int netrigctl_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     len = sprintf(cmd, "F %"FREQFMT"\n", freq);
 #endif
 
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_FREQ, cmd, len, buf);
     rig_debug(RIG_DEBUG_TRACE, "%s: cmd=%s\n", __func__, strtok(cmd, "\r\n"));
 
     if (ret > 0)
@@ -659,6 +1147,7 @@ static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_push_state push;
 #if 0 // disable until we figure out if we can do this without breaking backwards compatibility
     char vfotmp[16];
 #endif
@@ -666,6 +1155,12 @@ static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     rig_debug(RIG_DEBUG_VERBOSE, "%s called, vfo=%s\n", __func__,
               rig_strvfo(vfo));
 
+    if (netrigctl_push_lookup(rig, vfo, NETRIGCTL_PUSH_FREQ, &push))
+    {
+        *freq = push.freq;
+        return RIG_OK;
+    }
+
     ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), vfo);
 
     if (ret != RIG_OK) { return ret; }
@@ -716,7 +1211,7 @@ static int netrigctl_set_mode(RIG *rig, vfo_t vfo, rmode_t mode,
     len = sprintf(cmd, "M%s %s %li\n",
                   vfostr, rig_strrmode(mode), width);
 
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_MODE, cmd, len, buf);
 
     if (ret > 0)
     {
@@ -736,9 +1231,17 @@ static int netrigctl_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_push_state push;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called, vfo=%s\n", __func__, rig_strvfo(vfo));
 
+    if (netrigctl_push_lookup(rig, vfo, NETRIGCTL_PUSH_MODE, &push))
+    {
+        *mode = push.mode;
+        *width = push.width;
+        return RIG_OK;
+    }
+
     ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), vfo);
 
     if (ret != RIG_OK) { return ret; }
@@ -756,7 +1259,7 @@ static int netrigctl_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
 
     *mode = rig_parse_mode(buf);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -784,7 +1287,8 @@ static int netrigctl_set_vfo(RIG *rig, vfo_t vfo)
 
     len = sprintf(cmd, "V%s %s\n", vfostr, rig_strvfo(vfo));
     rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd='%s'\n", __func__, cmd);
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_FREQ | NETRIGCTL_PUSH_MODE
+                                    | NETRIGCTL_PUSH_VFO, cmd, len, buf);
 
     if (ret > 0)
     {
@@ -804,11 +1308,19 @@ static int netrigctl_get_vfo(RIG *rig, vfo_t *vfo)
     char buf[BUF_MAX];
     char vfostr[16] = "";
     struct netrigctl_priv_data *priv;
+    struct netrigctl_push_state push;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     priv = (struct netrigctl_priv_data *)rig->state.priv;
 
+    if (netrigctl_push_lookup(rig, RIG_VFO_CURR, NETRIGCTL_PUSH_VFO, &push))
+    {
+        *vfo = push.vfo;
+        priv->vfo_curr = *vfo;
+        return RIG_OK;
+    }
+
     ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
 
     if (ret != RIG_OK) { return ret; }
@@ -849,7 +1361,7 @@ static int netrigctl_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
 
     len = sprintf(cmd, "T%s %d\n", vfostr, ptt);
 
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_PTT, cmd, len, buf);
 
     if (ret > 0)
     {
@@ -868,9 +1380,16 @@ static int netrigctl_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_push_state push;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    if (netrigctl_push_lookup(rig, vfo, NETRIGCTL_PUSH_PTT, &push))
+    {
+        *ptt = push.ptt;
+        return RIG_OK;
+    }
+
     ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
 
     if (ret != RIG_OK) { return ret; }
@@ -1433,7 +1952,7 @@ static int netrigctl_get_split_vfo(RIG *rig, vfo_t vfo, split_t *split,
 
     *split = atoi(buf);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -1988,7 +2507,7 @@ static int netrigctl_set_bank(RIG *rig, vfo_t vfo, int bank)
 
     len = sprintf(cmd, "B %d\n", bank);
 
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_ALL, cmd, len, buf);
 
     if (ret > 0)
     {
@@ -2016,7 +2535,7 @@ static int netrigctl_set_mem(RIG *rig, vfo_t vfo, int ch)
 
     len = sprintf(cmd, "E%s %d\n", vfostr, ch);
 
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_ALL, cmd, len, buf);
 
     if (ret > 0)
     {
@@ -2088,7 +2607,7 @@ static int netrigctl_vfo_op(RIG *rig, vfo_t vfo, vfo_op_t op)
 
     len = sprintf(cmd, "J %s\n", rig_strvfop(op));
 
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_set_transaction(rig, NETRIGCTL_PUSH_ALL, cmd, len, buf);
 
     if (ret > 0)
     {
@@ -2245,6 +2764,149 @@ static int netrigctl_set_vfo_opt(RIG *rig, int status)
     return RIG_OK;
 }
 
+/*
+ * netrigctl_batch_prefetch
+ * Sends the commands of a run of batched get operations in one write
+ * and reads the replies in order, so that a run costs a single round
+ * trip to rigctld instead of one per command. Called with NULL ops to
+ * drop the replies left unused.
+ */
+static int netrigctl_batch_prefetch(RIG *rig, const struct rig_batch_op *ops,
+                                    int count)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char cmdbuf[RIG_BATCH_MAX * CMD_MAX];
+    int len = 0;
+    int n = 0;
+    int i;
+    int ret;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called, count=%d\n", __func__, count);
+
+    priv->batch_count = 0;
+    priv->batch_line = NULL;
+
+    if (!ops || count <= 0)
+    {
+        return RIG_OK;
+    }
+
+    for (i = 0; i < count && n < RIG_BATCH_MAX; i++)
+    {
+        struct netrigctl_batch_reply *b = &priv->batch[n];
+        char vfostr[16] = "";
+        int j;
+
+        /* same commands as the get functions send, one or two reply lines */
+        switch (ops[i].op)
+        {
+        case RIG_BATCH_GET_FREQ:
+            ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), ops[i].vfo);
+            sprintf(b->cmd, "f%s\n", vfostr);
+            b->lines = 1;
+            break;
+
+        case RIG_BATCH_GET_MODE:
+            ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), ops[i].vfo);
+            sprintf(b->cmd, "m%s\n", vfostr);
+            b->lines = 2;
+            break;
+
+        case RIG_BATCH_GET_VFO:
+            ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
+            sprintf(b->cmd, "v%s\n", vfostr);
+            b->lines = 1;
+            break;
+
+        case RIG_BATCH_GET_PTT:
+            ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
+            sprintf(b->cmd, "t%s\n", vfostr);
+            b->lines = 1;
+            break;
+
+        case RIG_BATCH_GET_SPLIT_VFO:
+            ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
+            sprintf(b->cmd, "s%s\n", vfostr);
+            b->lines = 2;
+            break;
+
+        case RIG_BATCH_GET_LEVEL:
+            ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), ops[i].vfo);
+            snprintf(b->cmd, CMD_MAX, "l%s %s\n", vfostr, rig_strlevel(ops[i].level));
+            b->lines = 1;
+            break;
+
+        default:
+            continue;
+        }
+
+        if (ret != RIG_OK)
+        {
+            continue;
+        }
+
+        for (j = 0; j < n && strcmp(priv->batch[j].cmd, b->cmd) != 0; j++) {}
+
+        if (j < n)
+        {
+            continue;   /* already asked */
+        }
+
+        len += sprintf(cmdbuf + len, "%s", b->cmd);
+        n++;
+    }
+
+    if (n < 2)
+    {
+        return RIG_OK;  /* nothing to gain */
+    }
+
+    rig_flush(&rig->state.rigport);
+
+    ret = write_block(&rig->state.rigport, cmdbuf, len);
+
+    for (i = 0; ret == RIG_OK && i < n; i++)
+    {
+        struct netrigctl_batch_reply *b = &priv->batch[i];
+        int k;
+
+        for (k = 0; k < b->lines; k++)
+        {
+            ret = read_string(&rig->state.rigport, b->reply[k], BUF_MAX, "\n", 1);
+
+            if (ret <= 0)
+            {
+                ret = ret < 0 ? ret : -RIG_EPROTO;
+                break;
+            }
+
+            ret = RIG_OK;
+
+            /* an error status is the whole reply */
+            if (k == 0
+                    && strncmp(b->reply[0], NETRIGCTL_RET, strlen(NETRIGCTL_RET)) == 0)
+            {
+                b->lines = 1;
+            }
+        }
+
+        if (ret == RIG_OK)
+        {
+            priv->batch_count = i + 1;
+        }
+    }
+
+    if (ret != RIG_OK)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: %d of %d replies read: %s\n", __func__,
+                  priv->batch_count, n, rigerror(ret));
+        /* late replies will be flushed by the next transaction */
+        rig_flush(&rig->state.rigport);
+    }
+
+    return RIG_OK;
+}
+
 /*
  * Netrigctl rig capabilities.
  */
@@ -2289,10 +2951,14 @@ struct rig_caps netrigctl_caps =
     .max_ifshift = 0,
     .priv =  NULL,
 
+    .cfgparams =    netrigctl_cfg_params,
+
     .rig_init =     netrigctl_init,
     .rig_cleanup =  netrigctl_cleanup,
     .rig_open =     netrigctl_open,
     .rig_close =    netrigctl_close,
+    .set_conf =     netrigctl_set_conf,
+    .get_conf =     netrigctl_get_conf,
 
     .set_freq =     netrigctl_set_freq,
     .get_freq =     netrigctl_get_freq,
@@ -2353,4 +3019,5 @@ struct rig_caps netrigctl_caps =
     .set_channel =    netrigctl_set_channel,
     .get_channel =    netrigctl_get_channel,
     .set_vfo_opt = netrigctl_set_vfo_opt,
+    .batch_prefetch = netrigctl_batch_prefetch,
 };
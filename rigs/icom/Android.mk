@@ -12,7 +12,7 @@ LOCAL_SRC_FILES := ic706.c icr8500.c ic735.c ic775.c ic756.c  \
 		id1.c id5100.c ic2730.c \
 		ic707.c ic728.c ic751.c ic761.c \
 		ic78.c ic7800.c ic7000.c ic7100.c ic7200.c ic7600.c ic7700.c \
-		icom.c frame.c optoscan.c
+		icom.c frame.c civbus.c optoscan.c
 LOCAL_MODULE := icom
 
 LOCAL_CFLAGS := -DHAVE_CONFIG_H
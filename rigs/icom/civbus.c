@@ -0,0 +1,382 @@
+/*
+ *  Hamlib CI-V backend - shared bus
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Several Icom rigs may hang on the same CI-V line, and be opened by one
+ * process with a RIG handle each, all on the same port.  The handles of a line
+ * form a bus: the rig opened first owns the port, and all of them do
+ * their I/O through it, one transaction at a time, so that no handle
+ * reads the bytes meant for another one.  The frames seen on the line
+ * are handed to the rig they come from or go to, whichever handle read
+ * them.
+ *
+ * Locking order: the decoder of a rig (Hold_Decode) first, then the bus.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+#include "misc.h"
+#include "icom.h"
+#include "icom_defs.h"
+#include "civbus.h"
+
+/* bytes of the frames in contention, for the backoff slot */
+#define ICOM_BUS_SLOT_BYTES 11
+
+/* the backoff window stops doubling after this many collisions */
+#define ICOM_BUS_MAX_BACKOFF 5
+
+struct icom_bus
+{
+    struct icom_bus *next;
+    char path[FILPATHLEN];
+    RIG *rigs[ICOM_BUS_MAX_RIGS];   /* rigs[0] owns the port */
+    int nrigs;
+    unsigned int seed;              /* of the backoff draws */
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+};
+
+static struct icom_bus *icom_buses;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t icom_buses_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+static void buses_lock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&icom_buses_lock);
+#endif
+}
+
+
+static void buses_unlock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&icom_buses_lock);
+#endif
+}
+
+
+static struct icom_bus *rig_bus(RIG *rig)
+{
+    return ((struct icom_priv_data *) rig->state.priv)->bus;
+}
+
+
+/*
+ * icom_bus_join
+ * Attach an opened rig to the bus of its port, made on the first rig
+ */
+int icom_bus_join(RIG *rig)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+    const char *path = rig->state.rigport.pathname;
+    struct icom_bus *bus;
+    int i;
+
+    if (priv->bus)
+    {
+        return RIG_OK;
+    }
+
+    buses_lock();
+
+    for (bus = icom_buses; bus; bus = bus->next)
+    {
+        if (strcmp(bus->path, path) == 0)
+        {
+            break;
+        }
+    }
+
+    if (!bus)
+    {
+        bus = calloc(1, sizeof(struct icom_bus));
+
+        if (!bus)
+        {
+            buses_unlock();
+            return -RIG_ENOMEM;
+        }
+
+        snprintf(bus->path, sizeof(bus->path), "%s", path);
+        bus->seed = (unsigned int) time(NULL) ^ priv->re_civ_addr;
+#ifdef HAVE_PTHREAD
+        pthread_mutex_init(&bus->lock, NULL);
+#endif
+        bus->next = icom_buses;
+        icom_buses = bus;
+    }
+    else if (bus->nrigs == ICOM_BUS_MAX_RIGS)
+    {
+        buses_unlock();
+        rig_debug(RIG_DEBUG_ERR, "%s: more than %d rigs on %s\n", __func__,
+                  ICOM_BUS_MAX_RIGS, path);
+        return -RIG_EINVAL;
+    }
+
+    for (i = 0; i < bus->nrigs; i++)
+    {
+        struct icom_priv_data *other = bus->rigs[i]->state.priv;
+
+        if (other->re_civ_addr == priv->re_civ_addr)
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: CI-V address %#x already open on %s\n",
+                      __func__, priv->re_civ_addr, path);
+        }
+    }
+
+    if (bus->nrigs > 0)
+    {
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: %#x shares %s with %d rig(s)\n", __func__,
+                  priv->re_civ_addr, path, bus->nrigs);
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&bus->lock);
+#endif
+    bus->rigs[bus->nrigs++] = rig;
+    priv->bus = bus;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&bus->lock);
+#endif
+
+    buses_unlock();
+
+    return RIG_OK;
+}
+
+
+/*
+ * icom_bus_leave
+ * Detach a rig before its port gets closed.  When it owned the port,
+ * the next rig of the bus takes over with its own.
+ */
+void icom_bus_leave(RIG *rig)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+    struct icom_bus *bus = priv->bus;
+    struct icom_bus **pp;
+    int i;
+
+    if (!bus)
+    {
+        return;
+    }
+
+    buses_lock();
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&bus->lock);
+#endif
+
+    for (i = 0; i < bus->nrigs && bus->rigs[i] != rig; i++)
+    {
+    }
+
+    if (i < bus->nrigs)
+    {
+        memmove(&bus->rigs[i], &bus->rigs[i + 1],
+                (bus->nrigs - i - 1) * sizeof(bus->rigs[0]));
+        bus->nrigs--;
+    }
+
+    priv->bus = NULL;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&bus->lock);
+#endif
+
+    if (bus->nrigs == 0)
+    {
+        for (pp = &icom_buses; *pp != bus; pp = &(*pp)->next)
+        {
+        }
+
+        *pp = bus->next;
+#ifdef HAVE_PTHREAD
+        pthread_mutex_destroy(&bus->lock);
+#endif
+        free(bus);
+    }
+
+    buses_unlock();
+}
+
+
+/*
+ * icom_bus_port
+ * The port to talk through, call with the bus locked
+ */
+hamlib_port_t *icom_bus_port(RIG *rig)
+{
+    struct icom_bus *bus = rig_bus(rig);
+
+    return bus ? &bus->rigs[0]->state.rigport : &rig->state.rigport;
+}
+
+
+/*
+ * icom_bus_shared
+ * Whether other rigs of the process are on the bus
+ */
+int icom_bus_shared(RIG *rig)
+{
+    struct icom_bus *bus = rig_bus(rig);
+
+    return bus && bus->nrigs > 1;
+}
+
+
+void icom_bus_lock(RIG *rig)
+{
+#ifdef HAVE_PTHREAD
+    struct icom_bus *bus = rig_bus(rig);
+
+    if (bus)
+    {
+        pthread_mutex_lock(&bus->lock);
+    }
+
+#endif
+}
+
+
+void icom_bus_unlock(RIG *rig)
+{
+#ifdef HAVE_PTHREAD
+    struct icom_bus *bus = rig_bus(rig);
+
+    if (bus)
+    {
+        pthread_mutex_unlock(&bus->lock);
+    }
+
+#endif
+}
+
+
+/*
+ * icom_bus_route
+ * Hand a frame which is not the answer awaited to the rigs it concerns,
+ * each learns in its priv->trn.
+ * Call with the bus locked.
+ */
+void icom_bus_route(RIG *rig, const unsigned char *frame, int frame_len)
+{
+    struct icom_bus *bus = rig_bus(rig);
+    int i;
+
+    if (frame_len < 6)
+    {
+        return;
+    }
+
+    if (!bus)
+    {
+        icom_trn_frame(rig, frame, frame_len);
+        return;
+    }
+
+    for (i = 0; i < bus->nrigs; i++)
+    {
+        RIG *member = bus->rigs[i];
+        unsigned char addr = ((struct icom_priv_data *)
+                              member->state.priv)->re_civ_addr;
+
+        if (frame[2] == addr || frame[3] == addr)
+        {
+            icom_trn_frame(member, frame, frame_len);
+        }
+    }
+}
+
+
+static int bus_rand(unsigned int *seed)
+{
+#ifdef HAVE_RAND_R
+    return rand_r(seed);
+#else
+    /* the example rand() of the C standard */
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed / 65536) % 32768;
+#endif
+}
+
+
+/*
+ * icom_bus_backoff
+ * Wait before sending again after the attempt-th collision, a random
+ * number of frame times within a window doubling with each one, so that
+ * the stations which collided do not collide again.
+ */
+void icom_bus_backoff(RIG *rig, int attempt)
+{
+    struct icom_bus *bus = rig_bus(rig);
+    unsigned int seed = (unsigned int) time(NULL);
+    int rate = rig->state.rigport.parm.serial.rate;
+    int slot_us = 10000;
+    int slots;
+
+    if (rig->state.rigport.type.rig == RIG_PORT_SERIAL && rate > 0)
+    {
+        /* 10 bits per byte */
+        slot_us = ICOM_BUS_SLOT_BYTES * 10 * 1000000 / rate;
+    }
+
+    if (attempt > ICOM_BUS_MAX_BACKOFF)
+    {
+        attempt = ICOM_BUS_MAX_BACKOFF;
+    }
+
+    /* the rigs of the bus draw in turn from its seed */
+    if (bus)
+    {
+        icom_bus_lock(rig);
+        slots = 1 + bus_rand(&bus->seed) % (2 << attempt);
+        icom_bus_unlock(rig);
+    }
+    else
+    {
+        slots = 1 + bus_rand(&seed) % (2 << attempt);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: collision %d, waiting %d us\n", __func__,
+              attempt, slots * slot_us);
+
+    hl_usleep(slots * slot_us);
+}
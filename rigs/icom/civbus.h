@@ -0,0 +1,39 @@
+/*
+ *  Hamlib CI-V backend - shared bus
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CIVBUS_H
+#define _CIVBUS_H 1
+
+#include <hamlib/rig.h>
+
+/* rigs of a process sharing one CI-V interface */
+#define ICOM_BUS_MAX_RIGS 8
+
+int icom_bus_join(RIG *rig);
+void icom_bus_leave(RIG *rig);
+hamlib_port_t *icom_bus_port(RIG *rig);
+int icom_bus_shared(RIG *rig);
+void icom_bus_lock(RIG *rig);
+void icom_bus_unlock(RIG *rig);
+void icom_bus_route(RIG *rig, const unsigned char *frame, int frame_len);
+void icom_bus_backoff(RIG *rig, int attempt);
+
+#endif /* _CIVBUS_H */
@@ -30,9 +30,12 @@
 #include "hamlib/rig.h"
 #include "serial.h"
 #include "misc.h"
+#include "iofunc.h"
+#include "stats.h"
 #include "icom.h"
 #include "icom_defs.h"
 #include "frame.h"
+#include "civbus.h"
 
 /*
  * Build a CI-V frame.
@@ -89,54 +92,103 @@ int make_cmd_frame(char frame[], char re_id, char ctrl_id, char cmd, int subcmd,
     return i;
 }
 
+/* frames icom_trn_drain() reads at most before giving up */
+#define ICOM_TRN_DRAIN_FRAMES 16
+
+/* frames of other stations skipped while waiting for ours */
+#define ICOM_MAX_FOREIGN_FRAMES 8
+
 /*
- * icom_one_transaction
- *
- * We assume that rig!=NULL, rig->state!= NULL, payload!=NULL, data!=NULL, data_len!=NULL
- * Otherwise, you'll get a nice seg fault. You've been warned!
- * payload can be NULL if payload_len == 0
- * subcmd can be equal to -1 (no subcmd wanted)
- * if no answer is to be expected, data_len must be set to NULL to tell so
- *
- * return RIG_OK if transaction completed,
- * or a negative value otherwise indicating the error.
+ * icom_trn_drain
+ * In transceive mode, or with other rigs on the bus, read what was sent
+ * since the last transaction, rather than have the flush drop a change
+ * the rigs reported.
  */
-int icom_one_transaction(RIG *rig, int cmd, int subcmd,
-                         const unsigned char *payload, int payload_len, unsigned char *data,
-                         int *data_len)
+static void icom_trn_drain(RIG *rig, hamlib_port_t *rp)
+{
+    unsigned char buf[MAXFRAMELEN];
+    int i, frm_len;
+
+    for (i = 0; i < ICOM_TRN_DRAIN_FRAMES && port_rx_pending(rp); i++)
+    {
+        frm_len = read_icom_frame(rp, buf, sizeof(buf));
+
+        if (frm_len < 1 || buf[frm_len - 1] != FI)
+        {
+            break;
+        }
+
+        icom_bus_route(rig, buf, frm_len);
+    }
+
+    if (i == ICOM_TRN_DRAIN_FRAMES || port_rx_pending(rp))
+    {
+        /* the flush is going to drop some */
+        icom_trn_invalidate(rig);
+    }
+}
+
+
+/* a whole frame sent by our rig to us */
+static int icom_is_answer(const struct icom_priv_data *priv, int ctrl_id,
+                          const unsigned char *buf, int frm_len)
+{
+    if (frm_len < 6 || buf[frm_len - 1] != FI)
+    {
+        /* not a frame, or jammed: let the caller sort it out */
+        return 1;
+    }
+
+    return buf[2] == ctrl_id
+           && (priv->re_civ_addr == BCASTID || buf[3] == priv->re_civ_addr);
+}
+
+
+/*
+ * icom_bus_transaction
+ * icom_one_transaction() with the decoder held and the bus locked
+ */
+static int icom_bus_transaction(RIG *rig, int cmd, int subcmd,
+                                const unsigned char *payload, int payload_len,
+                                unsigned char *data, int *data_len)
 {
     struct icom_priv_data *priv;
     const struct icom_priv_caps *priv_caps;
-    struct rig_state *rs;
+    hamlib_port_t *rp;
     // this buf needs to be large enough for 0xfe strings for power up
     // at 115,200 this is now at least 150
     unsigned char buf[200];
     unsigned char sendbuf[MAXFRAMELEN];
     int frm_len, retval;
     int ctrl_id;
+    int i;
 
     sendbuf[0] = buf[0] = 0;
-    rs = &rig->state;
-    priv = (struct icom_priv_data *)rs->priv;
+    priv = (struct icom_priv_data *)rig->state.priv;
     priv_caps = (struct icom_priv_caps *)rig->caps->priv;
+    rp = icom_bus_port(rig);
 
     ctrl_id = priv_caps->serial_full_duplex == 0 ? CTRLID : 0x80;
 
     frm_len = make_cmd_frame((char *) sendbuf, priv->re_civ_addr, ctrl_id, cmd,
                              subcmd, payload, payload_len);
 
+    if (icom_trn_enabled(rig) || icom_bus_shared(rig))
+    {
+        icom_trn_drain(rig, rp);
+    }
+
+    rig_flush(rp);
+
+    icom_trn_touched(rig, cmd, subcmd, payload_len);
+
     /*
      * should check return code and that write wrote cmd_len chars!
      */
-    Hold_Decode(rig);
-
-    rig_flush(&rs->rigport);
-
-    retval = write_block(&rs->rigport, (char *) sendbuf, frm_len);
+    retval = write_block(rp, (char *) sendbuf, frm_len);
 
     if (retval != RIG_OK)
     {
-        Unhold_Decode(rig);
         return retval;
     }
 
@@ -150,14 +202,26 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
          *          a collision on the CI-V bus occurred!
          *      - if we get a timeout, then retry to send the frame,
          *          up to rs->retry times.
+         * Another station may have been talking as we sent, its
+         * frames go first.
          */
 
-        retval = read_icom_frame(&rs->rigport, buf, sizeof(buf));
+        for (i = 0; ; i++)
+        {
+            retval = read_icom_frame(rp, buf, sizeof(buf));
+
+            if (retval < 6 || buf[retval - 1] != FI || buf[3] == ctrl_id
+                    || i == ICOM_MAX_FOREIGN_FRAMES)
+            {
+                break;
+            }
+
+            icom_bus_route(rig, buf, retval);
+        }
 
         if (retval == -RIG_ETIMEOUT || retval == 0)
         {
             /* Nothing received, CI-V interface is not echoing */
-            Unhold_Decode(rig);
             return -RIG_BUSERROR;
         }
 
@@ -167,16 +231,10 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
             return retval;
         }
 
-        if (retval < 1)
-        {
-            return -RIG_EPROTO;
-        }
-
         switch (buf[retval - 1])
         {
         case COL:
             /* Collision */
-            Unhold_Decode(rig);
             return -RIG_BUSBUSY;
 
         case FI:
@@ -186,7 +244,6 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
         default:
             /* Timeout after reading at least one character */
             /* Problem on ci-v bus? */
-            Unhold_Decode(rig);
             return -RIG_BUSERROR;
         }
 
@@ -195,7 +252,6 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
             /* Not the same length??? */
             /* Problem on ci-v bus? */
             /* Someone else got a packet in? */
-            Unhold_Decode(rig);
             return -RIG_EPROTO;
         }
 
@@ -204,7 +260,6 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
             /* Frames are different? */
             /* Problem on ci-v bus? */
             /* Someone else got a packet in? */
-            Unhold_Decode(rig);
             return -RIG_EPROTO;
         }
     }
@@ -214,7 +269,6 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
      */
     if (data_len == NULL)
     {
-        Unhold_Decode(rig);
         return RIG_OK;
     }
 
@@ -222,19 +276,41 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
      * wait for ACK ...
      * FIXME: handle padding/collisions
      * ACKFRMLEN is the smallest frame we can expect from the rig
+     * The frames of other stations on the bus, or our rig telling about
+     * a change, may come first.
      */
-    buf[0] = 0;
-    frm_len = read_icom_frame(&rs->rigport, buf, sizeof(buf));
-
-    if (memcmp(buf, sendbuf, frm_len) == 0 && priv->serial_USB_echo_off)
+    for (i = 0; ; i++)
     {
-        // Hmmm -- got an echo back when not expected so let's change
-        priv->serial_USB_echo_off = 0;
-        // And try again
-        frm_len = read_icom_frame(&rs->rigport, buf, sizeof(buf));
+        buf[0] = 0;
+        retval = read_icom_frame(rp, buf, sizeof(buf));
+
+        if (retval == frm_len && memcmp(buf, sendbuf, frm_len) == 0
+                && priv->serial_USB_echo_off)
+        {
+            // Hmmm -- got an echo back when not expected so let's change
+            priv->serial_USB_echo_off = 0;
+            // And try again
+            continue;
+        }
+
+        if (icom_is_answer(priv, ctrl_id, buf, retval))
+        {
+            break;
+        }
+
+        if (i == ICOM_MAX_FOREIGN_FRAMES)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: no answer from %#x among the frames\n",
+                      __func__, priv->re_civ_addr);
+            return -RIG_EPROTO;
+        }
+
+        rig_debug(RIG_DEBUG_TRACE, "%s: frame from %#x to %#x is not ours\n",
+                  __func__, buf[3], buf[2]);
+        icom_bus_route(rig, buf, retval);
     }
 
-    Unhold_Decode(rig);
+    frm_len = retval;
 
     if (frm_len < 0)
     {
@@ -271,13 +347,42 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
     *data_len = frm_len - (ACKFRMLEN - 1);
     memcpy(data, buf + 4, *data_len);
 
-    /*
-     * TODO: check addresses in reply frame
-     */
+    icom_trn_frame(rig, buf, frm_len);
 
     return RIG_OK;
 }
 
+
+/*
+ * icom_one_transaction
+ *
+ * We assume that rig!=NULL, rig->state!= NULL, payload!=NULL, data!=NULL, data_len!=NULL
+ * Otherwise, you'll get a nice seg fault. You've been warned!
+ * payload can be NULL if payload_len == 0
+ * subcmd can be equal to -1 (no subcmd wanted)
+ * if no answer is to be expected, data_len must be set to NULL to tell so
+ *
+ * return RIG_OK if transaction completed,
+ * or a negative value otherwise indicating the error.
+ */
+int icom_one_transaction(RIG *rig, int cmd, int subcmd,
+                         const unsigned char *payload, int payload_len, unsigned char *data,
+                         int *data_len)
+{
+    int retval;
+
+    Hold_Decode(rig);
+    icom_bus_lock(rig);
+
+    retval = icom_bus_transaction(rig, cmd, subcmd, payload, payload_len, data,
+                                  data_len);
+
+    icom_bus_unlock(rig);
+    Unhold_Decode(rig);
+
+    return retval;
+}
+
 /*
  * icom_transaction
  *
@@ -296,20 +401,37 @@ int icom_transaction(RIG *rig, int cmd, int subcmd,
                      int *data_len)
 {
     int retval, retry;
+    int collisions = 0;
+    int attempts = 0;
 
     retry = rig->state.rigport.retry;
 
     do
     {
+        /* a retry is an attempt actually made after the first one */
+        if (attempts++ > 0)
+        {
+            STATS_COUNT(STATS_RETRIES);
+        }
+
         retval = icom_one_transaction(rig, cmd, subcmd, payload, payload_len, data,
                                       data_len);
 
-        if (retval == RIG_OK || retval == -RIG_ERJCTED)
+        /* no point waiting after the last attempt */
+        if (retval == RIG_OK || retval == -RIG_ERJCTED || retry <= 0)
         {
             break;
         }
 
-        hl_usleep(500 * 1000); // pause a half second
+        if (retval == -RIG_BUSBUSY)
+        {
+            /* another station was sending, try again shortly */
+            icom_bus_backoff(rig, collisions++);
+        }
+        else
+        {
+            hl_usleep(500 * 1000); // pause a half second
+        }
     }
     while (retry-- > 0);
 
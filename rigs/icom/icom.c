@@ -36,6 +36,7 @@
 #include <hamlib/rig.h>
 #include <serial.h>
 #include <misc.h>
+#include <iofunc.h>
 #include <cal.h>
 #include <token.h>
 #include <register.h>
@@ -43,8 +44,14 @@
 #include "icom.h"
 #include "icom_defs.h"
 #include "frame.h"
+#include "civbus.h"
 
 static int set_vfo_curr(RIG *rig, vfo_t vfo, vfo_t curr_vfo);
+static int icom_trn_get_freq(RIG *rig, vfo_t vfo, freq_t *freq);
+static int icom_trn_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
+                             pbwidth_t *width);
+static void icom_trn_set_mode(RIG *rig, unsigned char md, int pd,
+                              rmode_t mode, pbwidth_t width);
 
 const cal_table_float_t icom_default_swr_cal =
 {
@@ -677,6 +684,7 @@ icom_cleanup(RIG *rig)
 
     if (rig->state.priv)
     {
+        icom_bus_leave(rig);
         free(rig->state.priv);
     }
 
@@ -758,6 +766,14 @@ icom_rig_open(RIG *rig)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s: %s v%s\n", __func__, rig->caps->model_name,
               rig->caps->version);
+
+    retval = icom_bus_join(rig);
+
+    if (retval != RIG_OK)
+    {
+        return retval;
+    }
+
     retval = icom_get_usb_echo_off(rig);
 
     if (retval != RIG_OK && priv->poweron == 0 && rs->auto_power_on)
@@ -775,6 +791,7 @@ icom_rig_open(RIG *rig)
 
             rig_debug(RIG_DEBUG_WARN, "%s: rig_set_powerstat failed: =%s\n", __func__,
                       rigerror(retval));
+            icom_bus_leave(rig);
             return retval;
         }
 
@@ -784,6 +801,7 @@ icom_rig_open(RIG *rig)
         if (retval < 0)
         {
             rig_debug(RIG_DEBUG_ERR, "%s: Unable to determine USB echo status\n", __func__);
+            icom_bus_leave(rig);
             return retval;
         }
     }
@@ -824,8 +842,11 @@ icom_rig_open(RIG *rig)
 int
 icom_rig_close(RIG *rig)
 {
-    // Nothing to do yet
     rig_debug(RIG_DEBUG_TRACE, "%s: called\n", __func__);
+
+    /* the port is about to be closed, others on the bus stop using it */
+    icom_bus_leave(rig);
+
     return RIG_OK;
 }
 
@@ -1103,6 +1124,11 @@ int icom_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     rs = &rig->state;
     priv = (struct icom_priv_data *) rs->priv;
 
+    if (icom_trn_get_freq(rig, vfo, freq) == RIG_OK)
+    {
+        return RIG_OK;
+    }
+
     cmd = C_RD_FREQ;
     subcmd = -1;
 
@@ -1854,6 +1880,11 @@ int icom_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
     rig_debug(RIG_DEBUG_VERBOSE, "%s called vfo=%s\n", __func__, rig_strvfo(vfo));
     priv_caps = (const struct icom_priv_caps *) rig->caps->priv;
 
+    if (icom_trn_get_mode(rig, vfo, mode, width) == RIG_OK)
+    {
+        return RIG_OK;
+    }
+
     retval = icom_transaction(rig, C_RD_MODE, -1, NULL, 0, modebuf, &mode_len);
 
     rig_debug(RIG_DEBUG_TRACE,
@@ -1896,6 +1927,12 @@ int icom_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
             (rig->caps->rig_model == RIG_MODEL_OMNIVIP) ||
             (rig->caps->rig_model == RIG_MODEL_ICR30))
     {
+        if (width)
+        {
+            icom_trn_set_mode(rig, modebuf[1], mode_len == 2 ? modebuf[2] : -1,
+                              *mode, *width);
+        }
+
         return RIG_OK;
     }
 
@@ -1917,6 +1954,12 @@ int icom_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
                   rig_strvfo(vfo), rig_strrmode(*mode));
     }
 
+    if (width)
+    {
+        icom_trn_set_mode(rig, modebuf[1], mode_len == 2 ? modebuf[2] : -1,
+                          *mode, *width);
+    }
+
     return RIG_OK;
 }
 
@@ -6884,6 +6927,241 @@ int icom_mW2power(RIG *rig, float *power, unsigned int mwpower, freq_t freq,
 
 
 
+/*
+ * icom_trn_enabled
+ * Whether the rig is expected to push its changes, transceive events
+ * being on with the frequency cache not turned off
+ */
+int icom_trn_enabled(RIG *rig)
+{
+    return rig->state.transceive == RIG_TRN_RIG
+           && rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_FREQ] > 0;
+}
+
+
+/* the rig was heard recently enough for its silence to mean no change */
+static int icom_trn_live(RIG *rig)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+
+    return icom_trn_enabled(rig)
+           && elapsed_ms(&priv->trn.heard, HAMLIB_ELAPSED_GET) < ICOM_TRN_LIVE_MS;
+}
+
+
+/*
+ * icom_trn_invalidate
+ * Forget the frequency and mode learned from the rig
+ */
+void icom_trn_invalidate(RIG *rig)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+
+    priv->trn.freq_valid = 0;
+    priv->trn.raw_valid = 0;
+    priv->trn.mode_valid = 0;
+}
+
+
+/*
+ * icom_trn_touched
+ * Called for each command sent to the rig, by us or by another controller
+ * on the bus.  Anything which may change the operating frequency or mode
+ * without the rig telling, like a VFO or memory switch, drops them.
+ */
+void icom_trn_touched(RIG *rig, int cmd, int subcmd, int payload_len)
+{
+    switch (cmd)
+    {
+    case C_RD_FREQ:
+    case C_RD_MODE:
+    case C_CTL_ATT:
+    case C_CTL_LVL:
+    case C_RD_SQSM:
+    case C_CTL_FUNC:
+    case C_RD_TRXID:
+    case C_CTL_RIT:
+        return;
+
+    case C_CTL_SPLT:
+        if (subcmd == -1) { return; }
+
+        break;
+
+    case C_CTL_MEM:
+    case C_CTL_PTT:
+    case C_SEND_SEL_FREQ:
+    case 0x26:  /* sel/unsel VFO mode */
+        if (payload_len == 0) { return; }
+
+        break;
+
+    default:
+        break;
+    }
+
+    icom_trn_invalidate(rig);
+}
+
+
+/*
+ * icom_trn_frame
+ * Learn from a whole CI-V frame seen on the bus which was not the answer
+ * to a command of ours: the transceive frames of the rig, its answers to
+ * another controller, and the commands of the latter.
+ * The rig_state cache is left to the frontend, its only writer: what is
+ * learned here reaches it through the get_freq/get_mode it calls.
+ */
+void icom_trn_frame(RIG *rig, const unsigned char *frame, int frame_len)
+{
+    struct rig_state *rs = &rig->state;
+    struct icom_priv_data *priv = (struct icom_priv_data *) rs->priv;
+    const unsigned char *data = frame + 5;
+    int data_len = frame_len - 6;
+
+    /* FE FE to from cmd ... FD */
+    if (frame_len < 6 || frame[frame_len - 1] != FI)
+    {
+        return;
+    }
+
+    if (frame[2] == priv->re_civ_addr)
+    {
+        icom_trn_touched(rig, frame[4], data_len > 0 ? frame[5] : -1,
+                         data_len > 0 ? data_len - 1 : 0);
+        return;
+    }
+
+    if (frame[3] != priv->re_civ_addr)
+    {
+        return;
+    }
+
+    elapsed_ms(&priv->trn.heard, HAMLIB_ELAPSED_SET);
+
+    switch (frame[4])
+    {
+    case C_SND_FREQ:
+    case C_RD_FREQ:
+        if (data_len != (priv->civ_731_mode ? 4 : 5) || data[0] == 0xff)
+        {
+            break;
+        }
+
+        priv->trn.freq = from_bcd(data, data_len * 2);
+        priv->trn.freq_valid = 1;
+        break;
+
+    case C_SND_MODE:
+    case C_RD_MODE:
+        if (data_len != 1 && data_len != 2)
+        {
+            break;
+        }
+
+        if (!priv->trn.raw_valid || priv->trn.mode_raw != data[0]
+                || priv->trn.filter_raw != (data_len == 2 ? data[1] : -1))
+        {
+            priv->trn.mode_raw = data[0];
+            priv->trn.filter_raw = data_len == 2 ? data[1] : -1;
+            priv->trn.raw_valid = 1;
+            priv->trn.mode_valid = 0;
+        }
+
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/*
+ * Serve a get_freq/get_mode of the current VFO from what the rig told.
+ * Hold the decoder and the bus so no event thread is halfway in an update.
+ */
+static int icom_trn_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+    int retval = -RIG_ENAVAIL;
+
+    if (vfo != RIG_VFO_CURR && vfo != rig->state.current_vfo)
+    {
+        return retval;
+    }
+
+    Hold_Decode(rig);
+    icom_bus_lock(rig);
+
+    if (icom_trn_live(rig) && priv->trn.freq_valid)
+    {
+        *freq = priv->trn.freq;
+        retval = RIG_OK;
+    }
+
+    icom_bus_unlock(rig);
+    Unhold_Decode(rig);
+
+    if (retval == RIG_OK)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: freq=%.0f from transceive\n", __func__,
+                  *freq);
+    }
+
+    return retval;
+}
+
+
+static int icom_trn_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
+                             pbwidth_t *width)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+    int retval = -RIG_ENAVAIL;
+
+    if ((vfo != RIG_VFO_CURR && vfo != rig->state.current_vfo)
+            || rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_MODE] == 0)
+    {
+        return retval;
+    }
+
+    Hold_Decode(rig);
+    icom_bus_lock(rig);
+
+    if (icom_trn_live(rig) && priv->trn.mode_valid)
+    {
+        *mode = priv->trn.mode;
+
+        if (width) { *width = priv->trn.width; }
+
+        retval = RIG_OK;
+    }
+
+    icom_bus_unlock(rig);
+    Unhold_Decode(rig);
+
+    return retval;
+}
+
+
+/* remember the mode decoded from the mode and filter bytes md and pd */
+static void icom_trn_set_mode(RIG *rig, unsigned char md, int pd,
+                              rmode_t mode, pbwidth_t width)
+{
+    struct icom_priv_data *priv = (struct icom_priv_data *) rig->state.priv;
+
+    /* the rig may have told about another mode meanwhile */
+    if (!priv->trn.raw_valid || priv->trn.mode_raw != md
+            || priv->trn.filter_raw != pd)
+    {
+        return;
+    }
+
+    priv->trn.mode = mode;
+    priv->trn.width = width;
+    priv->trn.mode_valid = 1;
+}
+
+
 /*
  * icom_decode is called by sa_sigio, when some asynchronous
  * data has been received from the rig
@@ -6902,7 +7180,27 @@ int icom_decode_event(RIG *rig)
     rs = &rig->state;
     priv = (struct icom_priv_data *) rs->priv;
 
-    frm_len = read_icom_frame(&rs->rigport, buf, sizeof(buf));
+    icom_bus_lock(rig);
+
+    /* another rig of the bus may have read it already */
+    if (icom_bus_shared(rig) && !port_rx_pending(icom_bus_port(rig)))
+    {
+        icom_bus_unlock(rig);
+        return 0;
+    }
+
+    frm_len = read_icom_frame(icom_bus_port(rig), buf, sizeof(buf));
+
+    if (frm_len >= 6 && buf[frm_len - 1] == FI)
+    {
+        icom_bus_route(rig, buf, frm_len);
+    }
+    else if (frm_len > 0)
+    {
+        icom_trn_invalidate(rig);
+    }
+
+    icom_bus_unlock(rig);
 
     if (frm_len == -RIG_ETIMEOUT)
     {
@@ -6932,10 +7230,12 @@ int icom_decode_event(RIG *rig)
         return -RIG_EPROTO;
     }
 
-    if (buf[3] != BCASTID && buf[3] != priv->re_civ_addr)
+    if (buf[3] != priv->re_civ_addr)
     {
-        rig_debug(RIG_DEBUG_WARN, "%s: CI-V %#x called for %#x!\n", __func__,
+        /* another station, its frame went to the rig it concerns */
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: CI-V %#x got a frame of %#x\n", __func__,
                   priv->re_civ_addr, buf[3]);
+        return RIG_OK;
     }
 
     /*
@@ -181,6 +181,28 @@ struct icom_priv_caps
     struct cmdparams *extcmds;  /* Pointer to extended operations array */
 };
 
+/*
+ * Operating frequency and mode as pushed by the rig in CI-V transceive
+ * mode, or seen in its answers.  They are served without asking the rig
+ * while it was heard within ICOM_TRN_LIVE_MS, since it would have told
+ * about any change made on its front panel.
+ */
+#define ICOM_TRN_LIVE_MS 1000
+
+struct icom_trn_cache
+{
+    struct timespec heard;  /* last frame from the rig */
+    int freq_valid;
+    freq_t freq;
+    int raw_valid;          /* mode and filter bytes of the last 01/04 frame */
+    unsigned char mode_raw;
+    int filter_raw;         /* -1 when the frame had no filter byte */
+    int mode_valid;         /* mode and width decoded from the bytes above */
+    rmode_t mode;
+    pbwidth_t width;
+};
+
+struct icom_bus;
 
 struct icom_priv_data
 {
@@ -203,6 +225,8 @@ struct icom_priv_data
     int x25cmdfails;  // This will get set if the 0x25 command fails so we try just once
     int x1cx03cmdfails;  // This will get set if the 0x1c 0x03 command fails so we try just once
     int poweron;  // to prevent powering on more than once
+    struct icom_trn_cache trn; // state pushed by the rig, see icom_trn_frame()
+    struct icom_bus *bus; // rigs sharing the CI-V line, see civbus.c
 };
 
 extern const struct ts_sc_list r8500_ts_sc_list[];
@@ -302,6 +326,10 @@ int icom_set_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t option);
 int icom_get_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t *option,
                  ant_t *ant_curr, ant_t *ant_tx, ant_t *ant_rx);
 int icom_decode_event(RIG *rig);
+int icom_trn_enabled(RIG *rig);
+void icom_trn_frame(RIG *rig, const unsigned char *frame, int frame_len);
+void icom_trn_touched(RIG *rig, int cmd, int subcmd, int payload_len);
+void icom_trn_invalidate(RIG *rig);
 int icom_power2mW(RIG *rig, unsigned int *mwpower, float power, freq_t freq,
                   rmode_t mode);
 int icom_mW2power(RIG *rig, float *power, unsigned int mwpower, freq_t freq,
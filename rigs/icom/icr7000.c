@@ -269,8 +269,8 @@ const struct rig_caps icr7100_caps =
     .priv = (void *)& icr7100_priv_caps,
     .rig_init =   icom_init,
     .rig_cleanup =   icom_cleanup,
-    .rig_open =  NULL,
-    .rig_close =  NULL,
+    .rig_open =  icom_rig_open,
+    .rig_close =  icom_rig_close,
 
     .set_freq =  r7000_set_freq,    /* TBC for R7100 */
     .get_freq =  icom_get_freq,
@@ -37,6 +37,7 @@
 #include "icom.h"
 #include "icom_defs.h"
 #include "frame.h"
+#include "civbus.h"
 #include "optoscan.h"
 
 
@@ -84,12 +85,21 @@ int optoscan_open(RIG *rig)
     memset(pltstate, 0, sizeof(pltstate_t));
     priv->pltstate = pltstate;
 
+    retval = icom_bus_join(rig);
+
+    if (retval != RIG_OK)
+    {
+        free(pltstate);
+        return retval;
+    }
+
     /* select REMOTE control */
     retval = icom_transaction(rig, C_CTL_MISC, S_OPTO_REMOTE,
                               NULL, 0, ackbuf, &ack_len);
 
     if (retval != RIG_OK)
     {
+        icom_bus_leave(rig);
         free(pltstate);
         return retval;
     }
@@ -98,6 +108,7 @@ int optoscan_open(RIG *rig)
     {
         rig_debug(RIG_DEBUG_ERR, "optoscan_open: ack NG (%#.2x), "
                   "len=%d\n", ackbuf[0], ack_len);
+        icom_bus_leave(rig);
         free(pltstate);
         return -RIG_ERJCTED;
     }
@@ -123,6 +134,9 @@ int optoscan_close(RIG *rig)
     retval = icom_transaction(rig, C_CTL_MISC, S_OPTO_LOCAL,
                               NULL, 0, ackbuf, &ack_len);
 
+    /* the port is about to be closed, others on the bus stop using it */
+    icom_bus_leave(rig);
+
     if (retval != RIG_OK)
     {
         return retval;
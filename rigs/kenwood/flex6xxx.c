@@ -1130,6 +1130,7 @@ const struct rig_caps f6k_caps =
     .get_level =        kenwood_get_level,
     //.set_ant =       kenwood_set_ant_no_ack,
     //.get_ant =       kenwood_get_ant,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 /*
@@ -1263,5 +1264,6 @@ const struct rig_caps powersdr_caps =
     .set_func =         powersdr_set_func,
     //.set_ant =       kenwood_set_ant_no_ack,
     //.get_ant =       kenwood_get_ant,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
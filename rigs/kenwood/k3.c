@@ -323,8 +323,9 @@ const struct rig_caps k3_caps =
     .set_ant =      kenwood_set_ant_no_ack,
     .get_ant =      kenwood_get_ant,
     .send_morse =       kenwood_send_morse,
-    .wait_morse =       rig_wait_morse
+    .wait_morse =       rig_wait_morse,
 
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 const struct rig_caps k3s_caps =
@@ -473,7 +474,8 @@ const struct rig_caps k3s_caps =
     .set_ant =      kenwood_set_ant_no_ack,
     .get_ant =      kenwood_get_ant,
     .send_morse =       kenwood_send_morse,
-    .wait_morse =       rig_wait_morse
+    .wait_morse =       rig_wait_morse,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 // How similar is this to the K3S?
@@ -623,7 +625,8 @@ const struct rig_caps k4_caps =
     .set_ant =      kenwood_set_ant_no_ack,
     .get_ant =      kenwood_get_ant,
     .send_morse =       kenwood_send_morse,
-    .wait_morse =       rig_wait_morse
+    .wait_morse =       rig_wait_morse,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 const struct rig_caps kx3_caps =
@@ -772,7 +775,8 @@ const struct rig_caps kx3_caps =
     .set_ant =      kenwood_set_ant_no_ack,
     .get_ant =      kenwood_get_ant,
     .send_morse =       kenwood_send_morse,
-    .wait_morse =       rig_wait_morse
+    .wait_morse =       rig_wait_morse,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 const struct rig_caps kx2_caps =
@@ -921,7 +925,8 @@ const struct rig_caps kx2_caps =
     .set_ant =      kenwood_set_ant_no_ack,
     .get_ant =      kenwood_get_ant,
     .send_morse =       kenwood_send_morse,
-    .wait_morse =       rig_wait_morse
+    .wait_morse =       rig_wait_morse,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 /*
@@ -37,6 +37,7 @@
 #include "misc.h"
 #include "register.h"
 #include "cal.h"
+#include "stats.h"
 
 #include "kenwood.h"
 #include "ts990s.h"
@@ -207,6 +208,226 @@ const struct confparams kenwood_cfg_params[] =
 };
 
 
+/*
+ * What kenwood_transaction() needs to know about a command, looked up by
+ * its first two letters instead of comparing it with every name known.
+ * if_fields are the IF fields a set command may change, only meaningful
+ * with KENWOOD_CMD_LISTED: commands not listed invalidate the whole IF
+ * answer.
+ */
+struct kenwood_cmd_traits
+{
+    unsigned char if_fields;
+    unsigned char flags;
+};
+
+#define KENWOOD_CMD_LISTED  (1 << 0)    /* if_fields are known */
+#define KENWOOD_CMD_SET     (1 << 1)    /* sets even without argument */
+#define KENWOOD_CMD_IF      (1 << 2)    /* the IF read */
+#define KENWOOD_CMD_PTT     (1 << 3)    /* RX or TX */
+#define KENWOOD_CMD_RX      (1 << 4)    /* RX, never verified */
+
+#define KENWOOD_CMD_KEY(a, b) (((a) - 'A') * 26 + ((b) - 'A'))
+
+#define KENWOOD_CMD(a, b, fields, flags) \
+    [KENWOOD_CMD_KEY(a, b)] = { (fields), KENWOOD_CMD_LISTED | (flags) }
+
+/* levels and switches not shown by IF */
+#define KENWOOD_CMD_NO_IF(a, b) KENWOOD_CMD(a, b, 0, 0)
+
+static const struct kenwood_cmd_traits kenwood_cmd_traits[26 * 26] =
+{
+    KENWOOD_CMD('I', 'F', 0, KENWOOD_CMD_IF),
+    KENWOOD_CMD('F', 'A', KENWOOD_IF_FREQ, 0),
+    KENWOOD_CMD('F', 'B', KENWOOD_IF_FREQ, 0),
+    KENWOOD_CMD('F', 'C', KENWOOD_IF_FREQ, 0),
+    KENWOOD_CMD('U', 'P', KENWOOD_IF_FREQ | KENWOOD_IF_MEM, KENWOOD_CMD_SET),
+    KENWOOD_CMD('D', 'N', KENWOOD_IF_FREQ | KENWOOD_IF_MEM, KENWOOD_CMD_SET),
+    KENWOOD_CMD('M', 'D', KENWOOD_IF_MODE, 0),
+    KENWOOD_CMD('D', 'A', KENWOOD_IF_MODE, 0),
+    KENWOOD_CMD('R', 'T', KENWOOD_IF_RIT, 0),
+    KENWOOD_CMD('X', 'T', KENWOOD_IF_RIT, 0),
+    KENWOOD_CMD('R', 'C', KENWOOD_IF_RIT, KENWOOD_CMD_SET),
+    KENWOOD_CMD('R', 'U', KENWOOD_IF_RIT, KENWOOD_CMD_SET),
+    KENWOOD_CMD('R', 'D', KENWOOD_IF_RIT, KENWOOD_CMD_SET),
+    KENWOOD_CMD('T', 'X', KENWOOD_IF_PTT | KENWOOD_IF_VFO | KENWOOD_IF_FREQ,
+                KENWOOD_CMD_SET | KENWOOD_CMD_PTT),
+    KENWOOD_CMD('R', 'X', KENWOOD_IF_PTT | KENWOOD_IF_VFO | KENWOOD_IF_FREQ,
+                KENWOOD_CMD_SET | KENWOOD_CMD_PTT | KENWOOD_CMD_RX),
+    KENWOOD_CMD('K', 'Y', KENWOOD_IF_PTT, 0),
+    KENWOOD_CMD('S', 'C', KENWOOD_IF_MISC, 0),
+    KENWOOD_CMD('T', 'O', KENWOOD_IF_MISC, 0),
+    KENWOOD_CMD('C', 'T', KENWOOD_IF_MISC, 0),
+    KENWOOD_CMD('T', 'N', KENWOOD_IF_MISC, 0),
+    KENWOOD_CMD('C', 'N', KENWOOD_IF_MISC, 0),
+    KENWOOD_CMD_NO_IF('A', 'G'), KENWOOD_CMD_NO_IF('R', 'G'),
+    KENWOOD_CMD_NO_IF('S', 'Q'), KENWOOD_CMD_NO_IF('P', 'C'),
+    KENWOOD_CMD_NO_IF('M', 'G'), KENWOOD_CMD_NO_IF('K', 'S'),
+    KENWOOD_CMD_NO_IF('C', 'G'), KENWOOD_CMD_NO_IF('V', 'G'),
+    KENWOOD_CMD_NO_IF('V', 'D'), KENWOOD_CMD_NO_IF('N', 'B'),
+    KENWOOD_CMD_NO_IF('N', 'R'), KENWOOD_CMD_NO_IF('N', 'L'),
+    KENWOOD_CMD_NO_IF('R', 'A'), KENWOOD_CMD_NO_IF('P', 'A'),
+    KENWOOD_CMD_NO_IF('S', 'M'), KENWOOD_CMD_NO_IF('B', 'C'),
+    KENWOOD_CMD_NO_IF('N', 'T'), KENWOOD_CMD_NO_IF('A', 'N'),
+    KENWOOD_CMD_NO_IF('G', 'T'), KENWOOD_CMD_NO_IF('S', 'H'),
+    KENWOOD_CMD_NO_IF('S', 'L'), KENWOOD_CMD_NO_IF('I', 'S'),
+    KENWOOD_CMD_NO_IF('P', 'R'), KENWOOD_CMD_NO_IF('M', 'L'),
+    KENWOOD_CMD_NO_IF('L', 'K'), KENWOOD_CMD_NO_IF('A', 'C'),
+    KENWOOD_CMD_NO_IF('B', 'P'), KENWOOD_CMD_NO_IF('M', 'O'),
+    KENWOOD_CMD_NO_IF('V', 'X'), KENWOOD_CMD_NO_IF('P', 'L'),
+};
+
+
+static const struct kenwood_cmd_traits *kenwood_cmd_lookup(const char *cmd)
+{
+    /* the PowerSDR transmit, the only ZZ command known */
+    static const struct kenwood_cmd_traits zztx =
+    {
+        KENWOOD_IF_PTT | KENWOOD_IF_VFO | KENWOOD_IF_FREQ,
+        KENWOOD_CMD_LISTED | KENWOOD_CMD_SET
+    };
+    static const struct kenwood_cmd_traits unlisted = { 0, 0 };
+
+    if (!cmd || cmd[0] < 'A' || cmd[0] > 'Z' || cmd[1] < 'A' || cmd[1] > 'Z')
+    {
+        return &unlisted;
+    }
+
+    if (cmd[0] == 'Z' && cmd[1] == 'Z')
+    {
+        return cmd[2] == 'T' && cmd[3] == 'X' ? &zztx : &unlisted;
+    }
+
+    return &kenwood_cmd_traits[KENWOOD_CMD_KEY(cmd[0], cmd[1])];
+}
+
+
+static void kenwood_if_invalidate(struct kenwood_priv_data *priv,
+                                  const char *cmdstr,
+                                  const struct kenwood_cmd_traits *traits)
+{
+    unsigned int fields = KENWOOD_IF_ALL;
+
+    if (traits->flags & KENWOOD_CMD_LISTED)
+    {
+        fields = traits->if_fields;
+    }
+
+    if (fields & priv->if_state.valid)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: %s invalidates IF fields 0x%02x\n",
+                  __func__, cmdstr, fields & priv->if_state.valid);
+    }
+
+    priv->if_state.valid &= ~fields;
+}
+
+
+/* store an IF answer, its fields parsed when long enough */
+static void kenwood_if_update(RIG *rig, const char *buf)
+{
+    struct kenwood_priv_data *priv = rig->state.priv;
+    struct kenwood_if *ifs = &priv->if_state;
+    size_t len = strlen(buf);
+    char num[16];
+
+    /* without the terminator, as kenwood_transaction() returns it */
+    if (len > 0 && buf[len - 1] == kenwood_caps(rig)->cmdtrm)
+    {
+        len--;
+    }
+
+    if (len >= sizeof(ifs->raw))
+    {
+        len = sizeof(ifs->raw) - 1;
+    }
+
+    memcpy(ifs->raw, buf, len);
+    ifs->raw[len] = '\0';
+    elapsed_ms(&ifs->date, HAMLIB_ELAPSED_SET);
+    ifs->valid = 0;
+
+    if (len < 33 || buf[0] != 'I' || buf[1] != 'F')
+    {
+        return;
+    }
+
+    memcpy(num, buf + 2, 11);
+    num[11] = '\0';
+    sscanf(num, "%"SCNfreq, &ifs->freq);
+
+    memcpy(num, buf + 17, 6);
+    num[6] = '\0';
+    ifs->rit = atoi(num);
+    ifs->rit_on = buf[23];
+    ifs->xit_on = buf[24];
+
+    memcpy(num, buf + 26, 2);
+    num[2] = '\0';
+    ifs->mem_ch = atoi(num);
+
+    ifs->ptt = buf[28];
+    ifs->mode = buf[29];
+    ifs->vfo = buf[30];
+    ifs->split = buf[32];
+
+    ifs->valid = KENWOOD_IF_ALL & ~KENWOOD_IF_MISC;
+
+    if (len >= 36)
+    {
+        ifs->valid |= KENWOOD_IF_MISC;
+    }
+}
+
+
+/*
+ * Whether the given IF fields are valid and younger than the rig cache
+ * timeout of their kind.  RIT and tones come with the IF answer and age
+ * with it, under the general cache timeout rather than the settings
+ * kinds, which are off unless asked for.
+ */
+static int kenwood_if_fresh(RIG *rig, unsigned int fields)
+{
+    static const struct
+    {
+        unsigned int field;
+        hamlib_cache_t kind;
+    } kinds[] =
+    {
+        { KENWOOD_IF_FREQ, HAMLIB_CACHE_FREQ },
+        { KENWOOD_IF_RIT, HAMLIB_CACHE_ALL },
+        { KENWOOD_IF_MEM, HAMLIB_CACHE_VFO },
+        { KENWOOD_IF_PTT, HAMLIB_CACHE_PTT },
+        { KENWOOD_IF_MODE, HAMLIB_CACHE_MODE },
+        { KENWOOD_IF_VFO, HAMLIB_CACHE_VFO },
+        { KENWOOD_IF_SPLIT, HAMLIB_CACHE_SPLIT },
+        { KENWOOD_IF_MISC, HAMLIB_CACHE_ALL },
+    };
+    struct kenwood_priv_data *priv = rig->state.priv;
+    struct kenwood_if *ifs = &priv->if_state;
+    double age;
+    int i;
+
+    if (ifs->date.tv_sec == 0 || (ifs->valid & fields) != fields)
+    {
+        return 0;
+    }
+
+    age = elapsed_ms(&ifs->date, HAMLIB_ELAPSED_GET);
+
+    for (i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+        if ((fields & kinds[i].field)
+                && age >= rig_get_cache_timeout_ms(rig, kinds[i].kind))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
 /**
  * kenwood_transaction
  * Assumes rig!=NULL rig->state!=NULL rig->caps!=NULL
@@ -233,12 +454,15 @@ int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
                                        verification may need a longer
                                        buffer than the user supplied one */
     char cmdtrm_str[2];   /* Default Command/Reply termination char */
-    int retval;
-    char *cmd;
+    int retval = RIG_OK;
     int len;
+    int cmdlen = 0;
+    int sendlen = 0;
+    int verify_sent = 0;
     int retry_read = 0;
     struct kenwood_priv_data *priv = rig->state.priv;
     struct kenwood_priv_caps *caps = kenwood_caps(rig);
+    const struct kenwood_cmd_traits *traits = kenwood_cmd_lookup(cmdstr);
     struct rig_state *rs;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -250,72 +474,105 @@ int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
 
     rs = &rig->state;
 
-    rs->hold_decode = 1;
+    if (cmdstr)
+    {
+        cmdlen = strlen(cmdstr);
+
+        if ((size_t) cmdlen + 1 > sizeof(priv->cmdbuf))
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: command too long, %d chars\n", __func__,
+                      cmdlen);
+            return -RIG_EINVAL;
+        }
+    }
+
+    Hold_Decode(rig);
 
     /* Emulators don't need any post_write_delay */
     if (priv->is_emulation) { rs->rigport.post_write_delay = 0; }
 
-    // if this is an IF cmdstr and not the first time through check cache
-    if (strcmp(cmdstr, "IF") == 0 && priv->cache_start.tv_sec != 0)
+    // if this is an IF cmdstr and no field changed since the last one
+    if (cmdlen == 2 && (traits->flags & KENWOOD_CMD_IF)
+            && kenwood_if_fresh(rig, KENWOOD_IF_ALL))
     {
-        int cache_age_ms;
+        rig_debug(RIG_DEBUG_TRACE, "%s: cache hit\n", __func__);
+
+        if (data) { strncpy(data, priv->if_state.raw, datasize); }
 
-        cache_age_ms = elapsed_ms(&priv->cache_start, 0);
+        Unhold_Decode(rig);
+        return RIG_OK;
+    }
+
+    if (cmdstr && datasize && priv->batch_count > 0)
+    {
+        int i;
 
-        if (cache_age_ms < 500) // 500ms cache time
+        for (i = 0; i < priv->batch_count; i++)
         {
-            rig_debug(RIG_DEBUG_TRACE, "%s: cache hit, age=%dms\n", __func__, cache_age_ms);
+            if (priv->batch[i].cmd[0] && strcmp(priv->batch[i].cmd, cmdstr) == 0)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: prefetched reply for %s\n", __func__,
+                          cmdstr);
+                strncpy(data, priv->batch[i].reply, datasize - 1);
+                data[datasize - 1] = '\0';
+                priv->batch[i].cmd[0] = '\0';  /* each reply is used once */
 
-            if (data) { strncpy(data, priv->last_if_response, datasize); }
+                if (traits->flags & KENWOOD_CMD_IF)
+                {
+                    kenwood_if_update(rig, priv->batch[i].reply);
+                }
 
-            return RIG_OK;
+                Unhold_Decode(rig);
+                return RIG_OK;
+            }
         }
-
-        // else we drop through and do the real IF command
     }
 
-    if (strlen(cmdstr) > 2 || strcmp(cmdstr, "RX") == 0
-            || strncmp(cmdstr, "TX", 2) == 0 || strncmp(cmdstr, "ZZTX", 4) == 0)
+    if (cmdlen > 2 || (traits->flags & KENWOOD_CMD_SET))
     {
         // then we must be setting something so we'll invalidate the cache
-        rig_debug(RIG_DEBUG_TRACE, "%s: cache invalidated\n", __func__);
-        priv->cache_start.tv_sec = 0;
+        kenwood_if_invalidate(priv, cmdstr, traits);
     }
 
     cmdtrm_str[0] = caps->cmdtrm;
     cmdtrm_str[1] = '\0';
 
-transaction_write:
-
     if (cmdstr)
     {
-        rig_debug(RIG_DEBUG_TRACE, "%s: cmdstr = %s\n", __func__, cmdstr);
-
-        len = strlen(cmdstr);
-
-        cmd = malloc(len + 2);
+        memcpy(priv->cmdbuf, cmdstr, cmdlen);
+        sendlen = cmdlen;
 
-        if (cmd == NULL)
+        /* XXX the if is temporary, until all invocations are fixed */
+        if (cmdlen > 0 && cmdstr[cmdlen - 1] != ';' && cmdstr[cmdlen - 1] != '\r')
         {
-            retval = -RIG_ENOMEM;
-            goto transaction_quit;
+            priv->cmdbuf[sendlen++] = caps->cmdtrm;
         }
 
-        memcpy(cmd, cmdstr, len);
-
-        /* XXX the if is temporary, until all invocations are fixed */
-        if (cmdstr[len - 1] != ';' && cmdstr[len - 1] != '\r')
+        /* a set command goes out with its verification in one write,
+           on the rigs known to take it, unless the rig wants a pause
+           after each command */
+        if (!datasize && !(traits->flags & KENWOOD_CMD_RX)
+                && caps->verify_in_write
+                && rs->rigport.post_write_delay == 0
+                && sendlen + strlen(priv->verify_cmd) <= sizeof(priv->cmdbuf))
         {
-            cmd[len] = caps->cmdtrm;
-            len++;
+            memcpy(priv->cmdbuf + sendlen, priv->verify_cmd,
+                   strlen(priv->verify_cmd));
+            sendlen += strlen(priv->verify_cmd);
+            verify_sent = 1;
         }
+    }
+
+transaction_write:
+
+    if (cmdstr)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: cmdstr = %s\n", __func__, cmdstr);
 
         /* flush anything in the read buffer before command is sent */
         rig_flush(&rs->rigport);
 
-        retval = write_block(&rs->rigport, cmd, len);
-
-        free(cmd);
+        retval = write_block(&rs->rigport, priv->cmdbuf, sendlen);
 
         if (retval != RIG_OK)
         {
@@ -328,16 +585,16 @@ transaction_write:
     // So we'll skip the checks just on this one command for now
     // The TS-480 PC Control says RX; should return RX0; but it doesn't
     // We may eventually want to verify PTT with rig_get_ptt instead
-    if (retval == RIG_OK && strncmp(cmdstr, "RX", 2) == 0) { goto transaction_quit; }
+    if (retval == RIG_OK && (traits->flags & KENWOOD_CMD_RX)) { goto transaction_quit; }
 
     if (!datasize)
     {
-        rig->state.hold_decode = 0;
+        Unhold_Decode(rig);
 
         /* no reply expected so we need to write a command that always
            gives a reply so we can read any error replies from the actual
            command being sent without blocking */
-        if (RIG_OK != (retval = write_block(&rs->rigport, priv->verify_cmd
+        if (!verify_sent && RIG_OK != (retval = write_block(&rs->rigport, priv->verify_cmd
                                             , strlen(priv->verify_cmd))))
         {
             goto transaction_quit;
@@ -348,9 +605,9 @@ transaction_read:
     /* allow room for most any response */
     len = min(datasize ? datasize + 1 : strlen(priv->verify_cmd) + 32,
               KENWOOD_MAX_BUF_LEN);
-    retval = read_string(&rs->rigport, buffer, len, cmdtrm_str, strlen(cmdtrm_str));
+    retval = read_string(&rs->rigport, buffer, len, cmdtrm_str, 1);
     rig_debug(RIG_DEBUG_TRACE, "%s: read_string(len=%d)='%s'\n", __func__,
-              (int)strlen(buffer), buffer);
+              retval, buffer);
 
     if (retval < 0)
     {
@@ -362,6 +619,8 @@ transaction_read:
         // only retry if we expect a response from the command
         if (retry_read++ < rs->rigport.retry)
         {
+            STATS_COUNT(STATS_RETRIES);
+
             if (datasize)
             {
                 goto transaction_write;
@@ -376,13 +635,15 @@ transaction_read:
     }
 
     /* Check that command termination is correct */
-    if (strchr(cmdtrm_str, buffer[strlen(buffer) - 1]) == NULL)
+    if (retval == 0 || buffer[retval - 1] != caps->cmdtrm)
     {
         rig_debug(RIG_DEBUG_ERR, "%s: Command is not correctly terminated '%s'\n",
                   __func__, buffer);
 
         if (retry_read++ < rs->rigport.retry)
         {
+            STATS_COUNT(STATS_RETRIES);
+
             goto transaction_write;
         }
 
@@ -390,7 +651,7 @@ transaction_read:
         goto transaction_quit;
     }
 
-    if (strlen(buffer) == 2)
+    if (retval == 2)
     {
         switch (buffer[0])
         {
@@ -415,6 +676,8 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                STATS_COUNT(STATS_RETRIES);
+
                 goto transaction_write;
             }
 
@@ -432,6 +695,8 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                STATS_COUNT(STATS_RETRIES);
+
                 goto transaction_write;
             }
 
@@ -449,6 +714,8 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                STATS_COUNT(STATS_RETRIES);
+
                 rig_debug(RIG_DEBUG_ERR, "%s: Retrying shortly\n", __func__);
                 hl_usleep(rig->caps->timeout * 1000);
                 goto transaction_read;
@@ -482,6 +749,8 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                STATS_COUNT(STATS_RETRIES);
+
                 goto transaction_write;
             }
 
@@ -494,7 +763,7 @@ transaction_read:
             /* move the result excluding the command terminator into the
                caller buffer */
             len = min(datasize, retval) - 1;
-            strncpy(data, buffer, len);
+            memcpy(data, buffer, len);
             data[len] = '\0';
         }
     }
@@ -507,7 +776,7 @@ transaction_read:
         // seems some rigs will send back an IF response to RX/TX when it changes the status
         // normally RX/TX returns nothing when it's a null effect
         // TS-950SDX is known to behave this way
-        if (strncmp(cmdstr, "RX", 2) == 0 || strncmp(cmdstr, "TX", 2) == 0)
+        if (traits->flags & KENWOOD_CMD_PTT)
         {
             if (strncmp(priv->verify_cmd, "IF", 2) == 0)
             {
@@ -531,6 +800,8 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                STATS_COUNT(STATS_RETRIES);
+
                 goto transaction_write;
             }
 
@@ -546,18 +817,157 @@ transaction_read:
 transaction_quit:
 
     // update the cache
-    if (retval == RIG_OK && strcmp(cmdstr, "IF") == 0)
+    if (retval == RIG_OK && cmdlen == 2 && (traits->flags & KENWOOD_CMD_IF))
     {
-        elapsed_ms(&priv->cache_start, 1);
-        strncpy(priv->last_if_response, buffer, caps->if_len);
+        kenwood_if_update(rig, buffer);
     }
 
-    rs->hold_decode = 0;
+    Unhold_Decode(rig);
     rig_debug(RIG_DEBUG_TRACE, "%s: returning retval=%d\n", __func__, retval);
     return retval;
 }
 
 
+/*
+ * kenwood_batch_prefetch
+ * Sends the commands of a run of batched get operations in one write
+ * and reads their replies in order, for kenwood_transaction() to serve
+ * them without a round trip each. Called with NULL ops to drop the
+ * replies left unused.
+ *
+ * Only the commands all the Kenwood like rigs answer the same way are
+ * sent ahead, the other operations will just go to the rig as usual.
+ */
+int kenwood_batch_prefetch(RIG *rig, const struct rig_batch_op *ops, int count)
+{
+    struct kenwood_priv_data *priv = rig->state.priv;
+    struct kenwood_priv_caps *caps = kenwood_caps(rig);
+    struct rig_state *rs = &rig->state;
+    char cmdtrm_str[2];
+    char cmdbuf[RIG_BATCH_MAX * 8];
+    int len = 0;
+    int n = 0;
+    int i;
+    int retval;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called, count=%d\n", __func__, count);
+
+    priv->batch_count = 0;
+
+    if (!ops || count <= 0)
+    {
+        return RIG_OK;
+    }
+
+    for (i = 0; i < count && n < RIG_BATCH_MAX; i++)
+    {
+        const char *cmd = NULL;
+        vfo_t tvfo;
+        int j;
+
+        switch (ops[i].op)
+        {
+        case RIG_BATCH_GET_FREQ:
+            tvfo = (ops[i].vfo == RIG_VFO_CURR || ops[i].vfo == RIG_VFO_VFO) ?
+                   rs->current_vfo : ops[i].vfo;
+
+            switch (tvfo)
+            {
+            case RIG_VFO_A:
+            case RIG_VFO_MAIN:
+                cmd = "FA";
+                break;
+
+            case RIG_VFO_B:
+            case RIG_VFO_SUB:
+                cmd = "FB";
+                break;
+
+            default:
+                break;
+            }
+
+            break;
+
+        case RIG_BATCH_GET_MODE:
+            if (!RIG_IS_TS990S) { cmd = "MD"; }
+
+            break;
+
+        case RIG_BATCH_GET_VFO:
+        case RIG_BATCH_GET_PTT:
+        case RIG_BATCH_GET_SPLIT_VFO:
+            cmd = "IF";
+            break;
+
+        default:
+            break;
+        }
+
+        if (!cmd)
+        {
+            continue;
+        }
+
+        for (j = 0; j < n && strcmp(priv->batch[j].cmd, cmd) != 0; j++) {}
+
+        if (j < n)
+        {
+            continue;   /* already asked */
+        }
+
+        strcpy(priv->batch[n++].cmd, cmd);
+        len += sprintf(cmdbuf + len, "%s%c", cmd, caps->cmdtrm);
+    }
+
+    if (n < 2)
+    {
+        return RIG_OK;  /* nothing to gain */
+    }
+
+    cmdtrm_str[0] = caps->cmdtrm;
+    cmdtrm_str[1] = '\0';
+
+    Hold_Decode(rig);
+
+    rig_flush(&rs->rigport);
+
+    retval = write_block(&rs->rigport, cmdbuf, len);
+
+    for (i = 0; retval == RIG_OK && i < n; i++)
+    {
+        char *reply = priv->batch[i].reply;
+
+        retval = read_string(&rs->rigport, reply, KENWOOD_MAX_BUF_LEN,
+                             cmdtrm_str, strlen(cmdtrm_str));
+
+        if (retval < 3 || reply[retval - 1] != caps->cmdtrm
+                || reply[0] != priv->batch[i].cmd[0]
+                || reply[1] != priv->batch[i].cmd[1])
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: unexpected reply '%s' for %s\n", __func__,
+                      retval > 0 ? reply : "", priv->batch[i].cmd);
+            retval = retval < 0 ? retval : -RIG_EPROTO;
+            break;
+        }
+
+        reply[retval - 1] = '\0';  /* as kenwood_transaction returns it */
+        priv->batch_count = i + 1;
+        retval = RIG_OK;
+    }
+
+    if (retval != RIG_OK)
+    {
+        /* late replies will be flushed by the next transaction */
+        rig_flush(&rs->rigport);
+    }
+
+    Unhold_Decode(rig);
+
+    return retval;
+}
+
+
 /**
  * kenwood_safe_transaction
  * A wrapper for kenwood_transaction to check returned data against
@@ -989,6 +1399,39 @@ static int kenwood_get_if(RIG *rig)
 }
 
 
+/*
+ * Makes sure the given fields of priv->if_state are fresh, sending IF
+ * only when one of them is not
+ */
+static int kenwood_get_if_fields(RIG *rig, unsigned int fields)
+{
+    struct kenwood_priv_data *priv = rig->state.priv;
+    int retval;
+
+    if (kenwood_if_fresh(rig, fields))
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: IF fields 0x%02x cached\n", __func__, fields);
+        return RIG_OK;
+    }
+
+    retval = kenwood_get_if(rig);
+
+    if (retval != RIG_OK)
+    {
+        return retval;
+    }
+
+    if ((priv->if_state.valid & fields) != fields)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: IF answer too short '%s'\n", __func__,
+                  priv->info);
+        return -RIG_EPROTO;
+    }
+
+    return RIG_OK;
+}
+
+
 /* FN FR FT
  *  Sets the RX/TX VFO or M.CH mode of the transceiver, does not set split
  *  VFO, but leaves it unchanged if in split VFO mode.
@@ -1300,6 +1743,7 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
     int transmitting;
     int retval;
     struct kenwood_priv_data *priv = rig->state.priv;
+    const struct kenwood_if *ifs = &priv->if_state;
 
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -1333,14 +1777,15 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
         return retval;
     }
 
-    retval = kenwood_get_if(rig);
+    retval = kenwood_get_if_fields(rig, KENWOOD_IF_SPLIT | KENWOOD_IF_VFO
+                                   | KENWOOD_IF_PTT);
 
     if (retval != RIG_OK)
     {
         return retval;
     }
 
-    switch (priv->info[32])
+    switch (ifs->split)
     {
     case '0':
         *split = RIG_SPLIT_OFF;
@@ -1352,7 +1797,7 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
 
     default:
         rig_debug(RIG_DEBUG_ERR, "%s: unsupported split %c\n",
-                  __func__, priv->info[32]);
+                  __func__, ifs->split);
         return -RIG_EPROTO;
     }
 
@@ -1361,9 +1806,9 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
 
     /* find where is the txvfo.. */
     /* Elecraft info[30] does not track split VFO when transmitting */
-    transmitting = '1' == priv->info[28] && !RIG_IS_K2 && !RIG_IS_K3;
+    transmitting = '1' == ifs->ptt && !RIG_IS_K2 && !RIG_IS_K3;
 
-    switch (priv->info[30])
+    switch (ifs->vfo)
     {
     case '0':
         *txvfo = priv->tx_vfo = (*split && !transmitting) ? RIG_VFO_B : RIG_VFO_A;
@@ -1380,7 +1825,7 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
 
     default:
         rig_debug(RIG_DEBUG_ERR, "%s: unsupported VFO %c\n",
-                  __func__, priv->info[30]);
+                  __func__, ifs->vfo);
         return -RIG_EPROTO;
     }
 
@@ -1403,6 +1848,7 @@ int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
     int retval;
     int split_and_transmitting;
     struct kenwood_priv_data *priv = rig->state.priv;
+    const struct kenwood_if *ifs = &priv->if_state;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -1411,7 +1857,8 @@ int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
         return -RIG_EINVAL;
     }
 
-    retval = kenwood_get_if(rig);
+    retval = kenwood_get_if_fields(rig, KENWOOD_IF_VFO | KENWOOD_IF_PTT
+                                   | KENWOOD_IF_SPLIT);
 
     if (retval != RIG_OK)
     {
@@ -1420,17 +1867,17 @@ int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
 
     /* Elecraft info[30] does not track split VFO when transmitting */
     split_and_transmitting =
-        '1' == priv->info[28] /* transmitting */
-        && '1' == priv->info[32]               /* split */
+        '1' == ifs->ptt       /* transmitting */
+        && '1' == ifs->split
         && !RIG_IS_K2
         && !RIG_IS_K3;
 
-    switch (priv->info[30])
+    switch (ifs->vfo)
     {
     case '0':
         *vfo = priv->tx_vfo = split_and_transmitting ? RIG_VFO_B : RIG_VFO_A;
 
-        if (priv->info[32] == '1') { priv->tx_vfo = RIG_VFO_B; }
+        if (ifs->split == '1') { priv->tx_vfo = RIG_VFO_B; }
 
         break;
 
@@ -1445,7 +1892,7 @@ int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
 
     default:
         rig_debug(RIG_DEBUG_ERR, "%s: unsupported VFO %c\n",
-                  __func__, priv->info[30]);
+                  __func__, ifs->vfo);
         return -RIG_EPROTO;
     }
 
@@ -1565,7 +2012,6 @@ int kenwood_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
 int kenwood_get_freq_if(RIG *rig, vfo_t vfo, freq_t *freq)
 {
     struct kenwood_priv_data *priv = rig->state.priv;
-    char freqbuf[50];
     int retval;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -1575,16 +2021,14 @@ int kenwood_get_freq_if(RIG *rig, vfo_t vfo, freq_t *freq)
         return -RIG_EINVAL;
     }
 
-    retval = kenwood_get_if(rig);
+    retval = kenwood_get_if_fields(rig, KENWOOD_IF_FREQ);
 
     if (retval != RIG_OK)
     {
         return retval;
     }
 
-    memcpy(freqbuf, priv->info, 15);
-    freqbuf[14] = '\0';
-    sscanf(freqbuf + 2, "%"SCNfreq, freq);
+    *freq = priv->if_state.freq;
 
     return RIG_OK;
 }
@@ -1653,6 +2097,18 @@ int kenwood_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
         return -RIG_EINVAL;
     }
 
+    /* the IF frequency is that of the RX VFO, unless transmitting split */
+    if ((vfo_letter == 'A' || vfo_letter == 'B')
+            && kenwood_if_fresh(rig, KENWOOD_IF_FREQ | KENWOOD_IF_VFO
+                                | KENWOOD_IF_PTT | KENWOOD_IF_SPLIT)
+            && priv->if_state.vfo == (vfo_letter == 'A' ? '0' : '1')
+            && !(priv->if_state.ptt == '1' && priv->if_state.split == '1'))
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: VFO %c from IF\n", __func__, vfo_letter);
+        *freq = priv->if_state.freq;
+        return RIG_OK;
+    }
+
     snprintf(cmdbuf, sizeof(cmdbuf), "F%c", vfo_letter);
 
     retval = kenwood_safe_transaction(rig, cmdbuf, freqbuf, 50, 13);
@@ -1670,7 +2126,6 @@ int kenwood_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 int kenwood_get_rit(RIG *rig, vfo_t vfo, shortfreq_t *rit)
 {
     int retval;
-    char buf[7];
     struct kenwood_priv_data *priv = rig->state.priv;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -1680,17 +2135,14 @@ int kenwood_get_rit(RIG *rig, vfo_t vfo, shortfreq_t *rit)
         return -RIG_EINVAL;
     }
 
-    retval = kenwood_get_if(rig);
+    retval = kenwood_get_if_fields(rig, KENWOOD_IF_RIT);
 
     if (retval != RIG_OK)
     {
         return retval;
     }
 
-    memcpy(buf, &priv->info[17], 6);
-
-    buf[6] = '\0';
-    *rit = atoi(buf);
+    *rit = priv->if_state.rit;
 
     return RIG_OK;
 }
@@ -1736,7 +2188,7 @@ int kenwood_set_rit(RIG *rig, vfo_t vfo, shortfreq_t rit)
 
         snprintf(buf, sizeof(buf), "R%c", (rit > 0) ? 'U' : 'D');
 
-        diff = labs((rit + rit >= 0 ? 5 : -5) / 10); // round to nearest
+        diff = labs((rit + (rit >= 0 ? 5 : -5)) / 10); // round to nearest
         rig_debug(RIG_DEBUG_TRACE, "%s: rit change loop=%d\n", __func__, diff);
 
         for (i = 0; i < diff; i++)
@@ -2160,14 +2612,14 @@ int kenwood_get_mode_if(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
         return -RIG_EINVAL;
     }
 
-    err = kenwood_get_if(rig);
+    err = kenwood_get_if_fields(rig, KENWOOD_IF_MODE);
 
     if (err != RIG_OK)
     {
         return err;
     }
 
-    *mode = kenwood2rmode(priv->info[29] - '0', caps->mode_table);
+    *mode = kenwood2rmode(priv->if_state.mode - '0', caps->mode_table);
 
     *width = rig_passband_normal(rig, *mode);
 
@@ -3690,14 +4142,14 @@ int kenwood_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         return -RIG_EINVAL;
     }
 
-    retval = kenwood_get_if(rig);
+    retval = kenwood_get_if_fields(rig, KENWOOD_IF_PTT);
 
     if (retval != RIG_OK)
     {
         return retval;
     }
 
-    *ptt = priv->info[28] == '0' ? RIG_PTT_OFF : RIG_PTT_ON;
+    *ptt = priv->if_state.ptt == '0' ? RIG_PTT_OFF : RIG_PTT_ON;
 
     return RIG_OK;
 }
@@ -4213,7 +4665,6 @@ int kenwood_get_mem(RIG *rig, vfo_t vfo, int *ch)
 int kenwood_get_mem_if(RIG *rig, vfo_t vfo, int *ch)
 {
     int err;
-    char buf[4];
     struct kenwood_priv_data *priv = rig->state.priv;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -4223,17 +4674,14 @@ int kenwood_get_mem_if(RIG *rig, vfo_t vfo, int *ch)
         return -RIG_EINVAL;
     }
 
-    err = kenwood_get_if(rig);
+    err = kenwood_get_if_fields(rig, KENWOOD_IF_MEM);
 
     if (err != RIG_OK)
     {
         return err;
     }
 
-    memcpy(buf, &priv->info[26], 2);
-    buf[2] = '\0';
-
-    *ch = atoi(buf);
+    *ch = priv->if_state.mem_ch;
 
     return RIG_OK;
 }
@@ -4496,25 +4944,25 @@ int kenwood_get_ext_parm(RIG *rig, token_t token, value_t *val)
         return get_kenwood_func(rig, "FS", &val->i);
 
     case TOK_XIT:
-        err = kenwood_get_if(rig);
+        err = kenwood_get_if_fields(rig, KENWOOD_IF_RIT);
 
         if (err != RIG_OK)
         {
             return err;
         }
 
-        val->i = (priv->info[24] == '1') ? 1 : 0;
+        val->i = (priv->if_state.xit_on == '1') ? 1 : 0;
         return RIG_OK;
 
     case TOK_RIT:
-        err = kenwood_get_if(rig);
+        err = kenwood_get_if_fields(rig, KENWOOD_IF_RIT);
 
         if (err != RIG_OK)
         {
             return err;
         }
 
-        val->i = (priv->info[23] == '1') ? 1 : 0;
+        val->i = (priv->if_state.rit_on == '1') ? 1 : 0;
         return RIG_OK;
     }
 
@@ -34,6 +34,7 @@
 
 #define KENWOOD_MODE_TABLE_MAX  24
 #define KENWOOD_MAX_BUF_LEN   128 /* max answer len, arbitrary */
+#define KENWOOD_MAX_CMD_LEN   256 /* max command len with its terminator */
 
 
 /* Tokens for Parameters common to multiple rigs.
@@ -108,6 +109,41 @@ struct kenwood_priv_caps
     char cmdtrm;    /* Command termination chars (ken=';' or th='\r') */
     int if_len;     /* length of IF; answer excluding ';' terminator */
     rmode_t *mode_table;
+    int verify_in_write;    /* the rig takes a set and its verify command
+                               in one write, see kenwood_transaction() */
+};
+
+/* fields of the IF answer, see struct kenwood_if */
+#define KENWOOD_IF_FREQ     (1 << 0)    /* frequency */
+#define KENWOOD_IF_RIT      (1 << 1)    /* RIT/XIT offset and switches */
+#define KENWOOD_IF_MEM      (1 << 2)    /* memory channel */
+#define KENWOOD_IF_PTT      (1 << 3)
+#define KENWOOD_IF_MODE     (1 << 4)
+#define KENWOOD_IF_VFO      (1 << 5)
+#define KENWOOD_IF_SPLIT    (1 << 6)
+#define KENWOOD_IF_MISC     (1 << 7)    /* scan and tone */
+#define KENWOOD_IF_ALL      0xff
+
+/*
+ * The last IF answer, parsed.  A set command only invalidates the fields
+ * it may change, and each field is good for the rig cache timeout of its
+ * kind, see rig_set_cache_timeout_ms().  The single digit status fields
+ * are kept as sent by the rig.
+ */
+struct kenwood_if
+{
+    struct timespec date;   /* of the answer, tv_sec 0 when none */
+    unsigned int valid;     /* KENWOOD_IF_* fields not invalidated since */
+    freq_t freq;
+    shortfreq_t rit;        /* RIT/XIT offset */
+    char rit_on;
+    char xit_on;
+    int mem_ch;
+    char ptt;
+    char mode;              /* see kenwood2rmode() */
+    char vfo;               /* 0 VFO A, 1 VFO B, 2 memory */
+    char split;
+    char raw[KENWOOD_MAX_BUF_LEN];
 };
 
 struct kenwood_priv_data
@@ -127,12 +163,18 @@ struct kenwood_priv_data
     int is_emulation;     /* flag for TS-2000 emulations */
     void *data;           /* model specific data */
     rmode_t curr_mode;    /* used for is_emulation to avoid get_mode on VFOB */
-    struct timespec cache_start;
-    char last_if_response[KENWOOD_MAX_BUF_LEN];
+    struct kenwood_if if_state;   /* cached IF answer */
     int poweron;   /* to avoid powering on more than once */
     int has_rit2;  /* rig has set 2 rit command */
     int ag_format; /* which AG command is being used...see LEVEL_AF in kenwood.c*/
     int micgain_min, micgain_max; /* varies by rig so we figure it out automagically */
+    struct
+    {
+        char cmd[8];
+        char reply[KENWOOD_MAX_BUF_LEN];
+    } batch[RIG_BATCH_MAX];  /* replies read ahead by kenwood_batch_prefetch */
+    int batch_count;
+    char cmdbuf[KENWOOD_MAX_CMD_LEN];   /* command being sent, terminated */
 };
 
 
@@ -145,6 +187,7 @@ extern const tone_t kenwood38_ctcss_list[];
 extern const tone_t kenwood42_ctcss_list[];
 
 int kenwood_transaction(RIG *rig, const char *cmdstr, char *data, size_t datasize);
+int kenwood_batch_prefetch(RIG *rig, const struct rig_batch_op *ops, int count);
 int kenwood_safe_transaction(RIG *rig, const char *cmd, char *buf,
                              size_t buf_size, size_t expected);
 
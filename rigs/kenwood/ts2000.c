@@ -324,6 +324,7 @@ const struct rig_caps ts2000_caps =
     .get_info =  kenwood_get_info,
     .reset =  kenwood_reset,
 
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 /*
@@ -589,6 +589,7 @@ const struct rig_caps ts480_caps =
     .has_set_func = TS480_FUNC_ALL,
     .set_func = kenwood_set_func,
     .get_func = kenwood_get_func,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 /*
@@ -750,6 +751,7 @@ const struct rig_caps pt8000a_caps =
     .has_set_func = TS480_FUNC_ALL,
     .set_func = kenwood_set_func,
     .get_func = kenwood_get_func,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 /*
@@ -906,5 +908,6 @@ const struct rig_caps ts890s_caps =
     .has_set_func = TS890_FUNC_ALL,
     .set_func = kenwood_set_func,
     .get_func = kenwood_get_func,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
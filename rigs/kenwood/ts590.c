@@ -79,6 +79,7 @@ int ts590_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val);
 static struct kenwood_priv_caps ts590_priv_caps =
 {
     .cmdtrm = EOM_KEN,
+    .verify_in_write = 1,
 };
 
 
@@ -255,6 +256,7 @@ const struct rig_caps ts590_caps =
     .get_channel =  kenwood_get_channel,
     .vfo_ops = TS590_VFO_OPS,
     .vfo_op =  kenwood_vfo_op,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 const struct rig_caps ts590sg_caps =
@@ -425,6 +427,7 @@ const struct rig_caps ts590sg_caps =
     .get_channel =  kenwood_get_channel,
     .vfo_ops = TS590_VFO_OPS,
     .vfo_op =  kenwood_vfo_op,
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 
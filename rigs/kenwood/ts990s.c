@@ -351,6 +351,7 @@ const struct rig_caps ts990s_caps =
     .get_powerstat =  kenwood_get_powerstat,
     .reset =  kenwood_reset,
 
+    .batch_prefetch = kenwood_batch_prefetch,
 };
 
 /*
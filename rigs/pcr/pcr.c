@@ -361,11 +361,11 @@ pcr_send(RIG *rig, const char *cmd)
     /* XXX not required in auto update mode? (should not harm) */
     priv->cmd_buf[len + 0] = 0x0a;
 
-    rs->hold_decode = 1;
+    Hold_Decode(rig);
 
     err = write_block(&rs->rigport, priv->cmd_buf, len + 1);
 
-    rs->hold_decode = 0;
+    Unhold_Decode(rig);
 
     return err;
 }
@@ -110,7 +110,7 @@ uniden_digital_transaction(RIG *rig, const char *cmdstr, int cmd_len,
     size_t reply_len = BUFSZ;
 
     rs = &rig->state;
-    rs->hold_decode = 1;
+    Hold_Decode(rig);
 
 transaction_write:
 
@@ -262,7 +262,7 @@ transaction_write:
 
     retval = RIG_OK;
 transaction_quit:
-    rs->hold_decode = 0;
+    Unhold_Decode(rig);
     return retval;
 }
 
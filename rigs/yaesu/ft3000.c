@@ -251,4 +251,6 @@ const struct rig_caps ftdx3000_caps =
     .set_ext_level =      newcat_set_ext_level,
     .get_ext_level =      newcat_get_ext_level,
 
+    .batch_prefetch =     newcat_batch_prefetch,
+    .batch_verify =       newcat_batch_verify,
 };
@@ -203,4 +203,6 @@ const struct rig_caps ft450_caps =
     .set_channel =        newcat_set_channel,
     .get_channel =        newcat_get_channel,
 
+    .batch_prefetch =     newcat_batch_prefetch,
+    .batch_verify =       newcat_batch_verify,
 };
@@ -40,6 +40,7 @@
 #include "iofunc.h"
 #include "misc.h"
 #include "cal.h"
+#include "stats.h"
 #include "newcat.h"
 
 /* global variables */
@@ -384,6 +385,7 @@ static int set_roofing_filter_for_width(RIG *rig, vfo_t vfo, int width);
 static int get_roofing_filter(RIG *rig, vfo_t vfo,
                               struct newcat_roofing_filter **roofing_filter);
 static ncboolean newcat_valid_command(RIG *rig, char const *const command);
+static int newcat_check_deferred(RIG *rig);
 
 /*
  * The BS command needs to know what band we're on so we can restore band info
@@ -7293,6 +7295,35 @@ int newcat_vfomem_toggle(RIG *rig)
     return newcat_set_cmd(rig);
 }
 
+/*
+ * timeout in ms of the cached IF answer, see rig_set_cache_timeout_ms().
+ * Its RIT/XIT fields age under the general cache timeout, as the
+ * settings kinds are off unless asked for.
+ */
+static int newcat_if_cache_timeout(RIG *rig)
+{
+    static const hamlib_cache_t kinds[] =
+    {
+        HAMLIB_CACHE_FREQ, HAMLIB_CACHE_MODE, HAMLIB_CACHE_VFO,
+        HAMLIB_CACHE_PTT, HAMLIB_CACHE_ALL
+    };
+    int timeout = rig_get_cache_timeout_ms(rig, kinds[0]);
+    int i;
+
+    for (i = 1; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+        int ms = rig_get_cache_timeout_ms(rig, kinds[i]);
+
+        if (ms < timeout)
+        {
+            timeout = ms;
+        }
+    }
+
+    return timeout;
+}
+
+
 /*
  * Writes a null  terminated command string from  priv->cmd_str to the
  * CAT  port and  returns a  response from  the rig  in priv->ret_data
@@ -7322,7 +7353,8 @@ int newcat_get_cmd(RIG *rig)
 
         cache_age_ms = elapsed_ms(&priv->cache_start, 0);
 
-        if (cache_age_ms < 500) // 500ms cache time
+        // good as long as the shortest rig cache timeout of what IF shows
+        if (cache_age_ms < newcat_if_cache_timeout(rig))
         {
             rig_debug(RIG_DEBUG_TRACE, "%s: cache hit, age=%dms\n", __func__, cache_age_ms);
             strcpy(priv->ret_data, priv->last_if_response);
@@ -7332,6 +7364,29 @@ int newcat_get_cmd(RIG *rig)
         // we drop through and do the real IF command
     }
 
+    if (priv->batch_count > 0)
+    {
+        int i;
+
+        for (i = 0; i < priv->batch_count; i++)
+        {
+            if (priv->batch[i].cmd[0] && strcmp(priv->batch[i].cmd, priv->cmd_str) == 0)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: prefetched reply for %s\n", __func__,
+                          priv->cmd_str);
+                strcpy(priv->ret_data, priv->batch[i].reply);
+                priv->batch[i].cmd[0] = '\0';  /* each reply is used once */
+                return RIG_OK;
+            }
+        }
+    }
+
+    /* a set answering "?;" would be taken for the reply */
+    if (priv->deferred > 0)
+    {
+        newcat_check_deferred(rig);
+    }
+
     // any command that is read only should not expire cache
     is_read_cmd =
         strcmp(priv->cmd_str, "AG0;") == 0
@@ -7397,6 +7452,11 @@ int newcat_get_cmd(RIG *rig)
 
     while (rc != RIG_OK && retry_count++ <= state->rigport.retry)
     {
+        if (retry_count > 1)
+        {
+            STATS_COUNT(STATS_RETRIES);
+        }
+
         if (rc != -RIG_BUSBUSY)
         {
             /* send the command */
@@ -7506,6 +7566,282 @@ int newcat_get_cmd(RIG *rig)
     return rc;
 }
 
+/*
+ * Sends the commands of a run of batched get operations in one write
+ * and reads their replies in order, for newcat_get_cmd() to serve them
+ * without a round trip each. Called with NULL ops to drop the replies
+ * left unused.
+ */
+int newcat_batch_prefetch(RIG *rig, const struct rig_batch_op *ops, int count)
+{
+    struct rig_state *state = &rig->state;
+    struct newcat_priv_data *priv = (struct newcat_priv_data *)rig->state.priv;
+    char cmdbuf[RIG_BATCH_MAX * 8];
+    int len = 0;
+    int n = 0;
+    int i;
+    int rc;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called, count=%d\n", __func__, count);
+
+    priv->batch_count = 0;
+
+    if (!ops || count <= 0)
+    {
+        return RIG_OK;
+    }
+
+    for (i = 0; i < count && n < RIG_BATCH_MAX; i++)
+    {
+        char cmd[8] = "";
+        vfo_t vfo = ops[i].vfo;
+        int j;
+
+        if (vfo == RIG_VFO_CURR || vfo == RIG_VFO_VFO)
+        {
+            vfo = state->current_vfo;
+        }
+
+        switch (ops[i].op)
+        {
+        case RIG_BATCH_GET_FREQ:
+            if ((vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN)
+                    && newcat_valid_command(rig, "FA"))
+            {
+                snprintf(cmd, sizeof(cmd), "FA%c", cat_term);
+            }
+            else if ((vfo == RIG_VFO_B || vfo == RIG_VFO_SUB)
+                     && newcat_valid_command(rig, "FB"))
+            {
+                snprintf(cmd, sizeof(cmd), "FB%c", cat_term);
+            }
+
+            break;
+
+        case RIG_BATCH_GET_MODE:
+            if (newcat_valid_command(rig, "MD"))
+            {
+                char main_sub_vfo = '0';
+
+                if (rig->caps->targetable_vfo & RIG_TARGETABLE_MODE)
+                {
+                    main_sub_vfo = (RIG_VFO_B == vfo || RIG_VFO_SUB == vfo)  ? '1' : '0';
+                }
+
+                snprintf(cmd, sizeof(cmd), "MD%c%c", main_sub_vfo, cat_term);
+            }
+
+            break;
+
+        case RIG_BATCH_GET_PTT:
+            if (newcat_valid_command(rig, "TX"))
+            {
+                snprintf(cmd, sizeof(cmd), "TX%c", cat_term);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+
+        if (!cmd[0])
+        {
+            continue;
+        }
+
+        for (j = 0; j < n && strcmp(priv->batch[j].cmd, cmd) != 0; j++) {}
+
+        if (j < n)
+        {
+            continue;   /* already asked */
+        }
+
+        strcpy(priv->batch[n++].cmd, cmd);
+        len += sprintf(cmdbuf + len, "%s", cmd);
+    }
+
+    if (n < 2)
+    {
+        return RIG_OK;  /* nothing to gain */
+    }
+
+    rig_flush(&state->rigport);
+
+    rc = write_block(&state->rigport, cmdbuf, len);
+
+    for (i = 0; rc == RIG_OK && i < n; i++)
+    {
+        char *reply = priv->batch[i].reply;
+
+        rc = read_string(&state->rigport, reply, sizeof(priv->batch[i].reply),
+                         &cat_term, sizeof(cat_term));
+
+        if (rc < 3 || reply[rc - 1] != cat_term
+                || reply[0] != priv->batch[i].cmd[0]
+                || reply[1] != priv->batch[i].cmd[1])
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: unexpected reply '%s' for %s\n", __func__,
+                      rc > 0 ? reply : "", priv->batch[i].cmd);
+            rc = rc < 0 ? rc : -RIG_EPROTO;
+            break;
+        }
+
+        priv->batch_count = i + 1;
+        rc = RIG_OK;
+    }
+
+    if (rc != RIG_OK)
+    {
+        rig_flush(&state->rigport);
+    }
+
+    return rc;
+}
+
+
+/* a basic quick query command for verification */
+static const char *newcat_verify_cmd(RIG *rig)
+{
+    return RIG_MODEL_FT9000 == rig->caps->rig_model ? "AI;" : "ID;";
+}
+
+
+/*
+ * Checks the set commands sent since verification was deferred with a
+ * single verification command: the rig answers nothing to a set it
+ * accepted, so what comes before the verification reply are the error
+ * codes of the others, taken as newcat_set_cmd() takes them.  The first
+ * failure is kept in priv->deferred_rc.
+ */
+static int newcat_check_deferred(RIG *rig)
+{
+    struct rig_state *state = &rig->state;
+    struct newcat_priv_data *priv = (struct newcat_priv_data *)rig->state.priv;
+    char const *const verify_cmd = newcat_verify_cmd(rig);
+    int count = priv->deferred;
+    int error = RIG_OK;
+    int rc;
+    int i;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: checking %d set commands\n", __func__, count);
+
+    priv->deferred = 0;
+
+    if (RIG_OK != (rc = write_block(&state->rigport, verify_cmd,
+                                    strlen(verify_cmd))))
+    {
+        return priv->deferred_rc = rc;
+    }
+
+    /* at most one error reply per command, then the verification reply */
+    for (i = 0; i <= count; i++)
+    {
+        rc = read_string(&state->rigport, priv->ret_data, sizeof(priv->ret_data),
+                         &cat_term, sizeof(cat_term));
+
+        if (rc <= 0)
+        {
+            rc = rc < 0 ? rc : -RIG_EPROTO;
+            break;
+        }
+
+        if (!strncmp(verify_cmd, priv->ret_data, strlen(verify_cmd) - 1))
+        {
+            rc = error;
+            break;
+        }
+
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: set command answered '%s'\n", __func__,
+                  priv->ret_data);
+
+        switch (priv->ret_data[0])
+        {
+        case 'N':
+            rc = -RIG_ENAVAIL;
+            break;
+
+        case 'O':
+            rc = -RIG_EPROTO;
+            break;
+
+        case 'E':
+            rc = -RIG_EIO;
+            break;
+
+        case '?':
+            /* rig busy, unless rejecting a command */
+            rc = priv->question_mark_response_means_rejected ? -RIG_ERJCTED : RIG_OK;
+            break;
+
+        default:
+            rc = -RIG_EPROTO;
+            break;
+        }
+
+        if (error == RIG_OK)
+        {
+            error = rc;
+        }
+
+        rc = -RIG_EPROTO;   /* no verification reply */
+    }
+
+    if (rc != RIG_OK)
+    {
+        rig_flush(&state->rigport);
+
+        if (priv->deferred_rc == RIG_OK)
+        {
+            priv->deferred_rc = rc;
+        }
+    }
+
+    return rc;
+}
+
+
+/*
+ * Brackets a run of batched set operations: with defer set, the set
+ * commands are streamed without waiting for their verification, then
+ * with defer clear a single verification command checks them all.
+ * Returns an error when any of them failed, rig_batch_exec() then
+ * replays the run one operation at a time to find out which.
+ */
+int newcat_batch_verify(RIG *rig, int defer)
+{
+    struct newcat_priv_data *priv = (struct newcat_priv_data *)rig->state.priv;
+    int rc;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called, defer=%d\n", __func__, defer);
+
+    if (defer)
+    {
+        if (priv->fast_set_commands == TRUE)
+        {
+            return -RIG_ENAVAIL;  /* nothing is verified anyway */
+        }
+
+        priv->defer_verify = TRUE;
+        priv->deferred = 0;
+        priv->deferred_rc = RIG_OK;
+        return RIG_OK;
+    }
+
+    priv->defer_verify = FALSE;
+
+    if (priv->deferred > 0)
+    {
+        newcat_check_deferred(rig);
+    }
+
+    rc = priv->deferred_rc;
+    priv->deferred_rc = RIG_OK;
+
+    return rc;
+}
+
+
 /*
  * Writes a null  terminated command string from  priv->cmd_str to the
  * CAT  port that is not expected to have a response.
@@ -7524,12 +7860,22 @@ int newcat_set_cmd(RIG *rig)
     int rc = -RIG_EPROTO;
 
     /* pick a basic quick query command for verification */
-    char const *const verify_cmd = RIG_MODEL_FT9000 == rig->caps->rig_model ?
-                                   "AI;" : "ID;";
+    char const *const verify_cmd = newcat_verify_cmd(rig);
 
     while (rc != RIG_OK && retry_count++ <= state->rigport.retry)
     {
-        rig_flush(&state->rigport);  /* discard any unsolicited data */
+        if (retry_count > 1)
+        {
+            STATS_COUNT(STATS_RETRIES);
+        }
+
+        /* discard any unsolicited data, but not the answers of the
+           deferred set commands */
+        if (priv->deferred == 0)
+        {
+            rig_flush(&state->rigport);
+        }
+
         /* send the command */
         rig_debug(RIG_DEBUG_TRACE, "cmd_str = %s\n", priv->cmd_str);
 
@@ -7545,6 +7891,13 @@ int newcat_set_cmd(RIG *rig)
             return RIG_OK;
         }
 
+        /* validated along with the next ones, see newcat_batch_verify() */
+        if (priv->defer_verify)
+        {
+            priv->deferred++;
+            return RIG_OK;
+        }
+
         /* send the verification command */
         rig_debug(RIG_DEBUG_TRACE, "cmd_str = %s\n", verify_cmd);
 
@@ -119,6 +119,15 @@ struct newcat_priv_data
     char last_if_response[NEWCAT_DATA_LEN];
     int poweron; /* to prevent powering on more than once */
     int question_mark_response_means_rejected; /* the question mark response has multiple meanings */
+    struct
+    {
+        char cmd[8];
+        char reply[NEWCAT_DATA_LEN];
+    } batch[RIG_BATCH_MAX];  /* replies read ahead by newcat_batch_prefetch */
+    int batch_count;
+    int defer_verify;   /* set commands checked at once, see newcat_batch_verify */
+    int deferred;       /* set commands sent and not checked yet */
+    int deferred_rc;    /* first failure of a deferred check */
 };
 
 /*
@@ -155,6 +164,8 @@ struct newcat_priv_data
 
 int newcat_get_cmd(RIG *rig);
 int newcat_set_cmd(RIG *rig);
+int newcat_batch_prefetch(RIG *rig, const struct rig_batch_op *ops, int count);
+int newcat_batch_verify(RIG *rig, int defer);
 
 int newcat_init(RIG *rig);
 int newcat_cleanup(RIG *rig);
@@ -0,0 +1,377 @@
+/*
+ *  Hamlib rig simulators - common pty and pacing code
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <termios.h>
+
+#include "sim.h"
+
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void sleep_until(uint64_t deadline_us)
+{
+    uint64_t now = now_us();
+
+    if (deadline_us > now)
+    {
+        usleep(deadline_us - now);
+    }
+}
+
+
+/*
+ * Handle one of the SIM_OPTIONS, returns 0 if c is not one of them
+ */
+int sim_option(struct sim *s, int c, const char *arg)
+{
+    switch (c)
+    {
+    case 'b':
+    {
+        int baud = atoi(arg);
+
+        /* start bit, 8 data bits and stop bit */
+        s->byte_us = baud > 0 ? 10000000 / baud : 0;
+        return 1;
+    }
+
+    case 'l':
+        s->latency_ms = atoi(arg);
+        return 1;
+
+    case 'L':
+        s->link = arg;
+        return 1;
+
+    case 'e':
+        s->error_pct = atoi(arg);
+        return 1;
+
+    case 's':
+        srand(atoi(arg));
+        return 1;
+
+    case 'v':
+        s->verbose++;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+
+void sim_usage(const struct sim *s, const char *extra)
+{
+    printf("Usage: %s [OPTION]...\n"
+           "Simulate a rig on a pseudo terminal, whose name is printed first.\n\n",
+           s->name);
+
+    printf("  -b BAUD       pace the bytes as on a serial line at BAUD\n"
+           "  -l MS         wait MS milliseconds before each reply\n"
+           "  -L LINK       make LINK a symlink to the pseudo terminal\n"
+           "  -e PCT        answer PCT percent of the commands with an error\n"
+           "  -s SEED       seed of the random errors, default 1\n"
+           "  -v            print the commands and replies, twice for hex\n"
+           "%s"
+           "  -h            display this help and exit\n",
+           extra);
+}
+
+
+/*
+ * Open the pty, in raw mode, and tell its name on stdout
+ */
+int sim_open(struct sim *s)
+{
+    struct termios tio;
+    const char *name;
+
+    s->fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (s->fd < 0 || grantpt(s->fd) < 0 || unlockpt(s->fd) < 0)
+    {
+        perror("posix_openpt");
+        return -1;
+    }
+
+    name = ptsname(s->fd);
+    s->slave_fd = open(name, O_RDWR | O_NOCTTY);
+
+    if (s->slave_fd < 0)
+    {
+        perror(name);
+        return -1;
+    }
+
+    tcgetattr(s->slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(s->slave_fd, TCSANOW, &tio);
+
+    if (s->link)
+    {
+        unlink(s->link);
+
+        if (symlink(name, s->link) < 0)
+        {
+            perror(s->link);
+            return -1;
+        }
+    }
+
+    printf("%s\n", name);
+    fflush(stdout);
+
+    return 0;
+}
+
+
+void sim_dump(const struct sim *s, const char *dir, const unsigned char *data,
+              size_t len)
+{
+    size_t i;
+
+    if (!s->verbose)
+    {
+        return;
+    }
+
+    fprintf(stderr, "%s %s ", s->name, dir);
+
+    for (i = 0; i < len; i++)
+    {
+        if (s->hex || s->verbose > 1)
+        {
+            fprintf(stderr, "%02x ", data[i]);
+        }
+        else
+        {
+            fputc(data[i] >= ' ' && data[i] < 0x7f ? data[i] : '.', stderr);
+        }
+    }
+
+    fputc('\n', stderr);
+}
+
+
+/*
+ * Read the next command, up to and including the terminator byte.  The
+ * command is only handed out once it would have been received at the
+ * simulated baud rate.  Returns its length, or -1 on error.
+ */
+int sim_read(struct sim *s, unsigned char *buf, size_t size, int terminator)
+{
+    for (;;)
+    {
+        unsigned char *end = memchr(s->in, terminator, s->in_len);
+        ssize_t ret;
+
+        if (end)
+        {
+            size_t len = end - s->in + 1;
+
+            if (len > size)
+            {
+                len = size;
+            }
+
+            memcpy(buf, s->in, len);
+            memmove(s->in, s->in + len, s->in_len - len);
+            s->in_len -= len;
+
+            if (s->byte_us)
+            {
+                sleep_until(s->cmd_start_us + (uint64_t)len * s->byte_us);
+            }
+
+            s->cmd_start_us = now_us();
+            sim_dump(s, "<", buf, len);
+
+            return len;
+        }
+
+        if (s->in_len == sizeof(s->in))
+        {
+            /* garbage without a terminator */
+            s->in_len = 0;
+        }
+
+        ret = read(s->fd, s->in + s->in_len, sizeof(s->in) - s->in_len);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("read");
+            return -1;
+        }
+
+        if (s->in_len == 0)
+        {
+            s->cmd_start_us = now_us();
+        }
+
+        s->in_len += ret;
+    }
+}
+
+
+/*
+ * Send bytes as the rig would, after the reply latency if asked, then one
+ * byte every byte_us.
+ */
+void sim_write(struct sim *s, const void *data, size_t len, int latency)
+{
+    const unsigned char *p = data;
+    uint64_t start = now_us();
+    size_t sent = 0;
+
+    sim_dump(s, ">", data, len);
+
+    if (latency && s->latency_ms)
+    {
+        start += (uint64_t)s->latency_ms * 1000;
+        sleep_until(start);
+    }
+
+    while (sent < len)
+    {
+        size_t due = len;
+        ssize_t ret;
+
+        if (s->byte_us)
+        {
+            /* bytes whose last bit is on the wire by now, at least one */
+            due = (now_us() - start) / s->byte_us;
+
+            if (due <= sent)
+            {
+                sleep_until(start + (uint64_t)(sent + 1) * s->byte_us);
+                due = sent + 1;
+            }
+
+            if (due > len)
+            {
+                due = len;
+            }
+        }
+
+        ret = write(s->fd, p + sent, due - sent);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("write");
+            return;
+        }
+
+        sent += ret;
+    }
+}
+
+
+void sim_reply(struct sim *s, const char *str)
+{
+    sim_write(s, str, strlen(str), 1);
+}
+
+
+/*
+ * Whether to fail this command, error_pct percent of the time
+ */
+int sim_error(const struct sim *s)
+{
+    return s->error_pct > 0 && rand() % 100 < s->error_pct;
+}
+
+
+struct sim_cat *sim_cat_find(struct sim_cat *table, const char *cmd)
+{
+    for (; table->cmd; table++)
+    {
+        if (strncmp(cmd, table->cmd, 2) == 0)
+        {
+            return table;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Read or set a command of the table, cmd being without its terminator.
+ * Returns 0 if the command was answered, -1 if it is unknown or does not
+ * fit, for the caller to send the error reply of the protocol.
+ */
+int sim_cat_command(struct sim *s, struct sim_cat *table, const char *cmd)
+{
+    struct sim_cat *c = sim_cat_find(table, cmd);
+    char reply[sizeof(c->value) + 1];
+
+    if (!c)
+    {
+        return -1;
+    }
+
+    if (strcmp(cmd + 2, c->getarg) == 0)
+    {
+        snprintf(reply, sizeof(reply), "%s;", c->value);
+        sim_reply(s, reply);
+        return 0;
+    }
+
+    if (strlen(cmd) != strlen(c->value)
+            || strncmp(cmd + 2, c->getarg, strlen(c->getarg)) != 0)
+    {
+        return -1;
+    }
+
+    strcpy(c->value, cmd);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ *  Hamlib rig simulators - common pty and pacing code
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _SIM_H
+#define _SIM_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_BUF_SIZE 512
+
+struct sim
+{
+    const char *name;
+    int fd;                 /* master side of the pty */
+    int slave_fd;           /* kept open so that clients may come and go */
+    const char *link;       /* symlink to the slave side, if any */
+    int byte_us;            /* time of one byte on the wire, 0 for none */
+    int latency_ms;         /* delay before each reply */
+    int error_pct;          /* share of commands answered by an error */
+    int verbose;
+    int hex;                /* binary protocol, always dump in hex */
+    uint64_t cmd_start_us;  /* when the first byte of the command came */
+    size_t in_len;
+    unsigned char in[SIM_BUF_SIZE];
+};
+
+/*
+ * One command of a Kenwood style CAT protocol.  The command followed by
+ * getarg reads value, anything longer of the same length as value sets it.
+ */
+struct sim_cat
+{
+    const char *cmd;
+    const char *getarg;
+    char value[40];
+};
+
+/* options understood by every simulator */
+#define SIM_OPTIONS "b:l:L:e:s:vh"
+
+extern int sim_option(struct sim *s, int c, const char *arg);
+extern void sim_usage(const struct sim *s, const char *extra);
+extern int sim_open(struct sim *s);
+extern int sim_read(struct sim *s, unsigned char *buf, size_t size,
+                    int terminator);
+extern void sim_write(struct sim *s, const void *data, size_t len,
+                      int latency);
+extern void sim_reply(struct sim *s, const char *str);
+extern int sim_error(const struct sim *s);
+extern struct sim_cat *sim_cat_find(struct sim_cat *table, const char *cmd);
+extern int sim_cat_command(struct sim *s, struct sim_cat *table,
+                           const char *cmd);
+extern void sim_dump(const struct sim *s, const char *dir,
+                     const unsigned char *data, size_t len);
+
+#endif /* _SIM_H */
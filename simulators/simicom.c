@@ -0,0 +1,569 @@
+/*
+ *  Hamlib rig simulators - Icom IC-7300
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Speaks CI-V as an IC-7300 (rig model 3073) on a single wire bus: every
+ * frame sent to the rig comes back as an echo before the answer.  With
+ * several -a, as many radios share the bus, each answering its address.
+ * With -c some echoes are hit by a collision and end with the jammer
+ * code, as when two stations talk at once.  With -t the dial is turned
+ * while the controller is quiet, and the rig tells it with transceive
+ * frames.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+
+#include "sim.h"
+
+#define PR      0xfe    /* preamble */
+#define FI      0xfd    /* end of frame */
+#define COL     0xfc    /* collision jammer */
+#define ACK     0xfb
+#define NAK     0xfa
+
+static int echo = 1;
+static int collision_pct;
+static int dial_ms;
+
+#define MAX_RADIOS 4
+
+/* the radios on the line, each with its CI-V address */
+static struct radio
+{
+    int addr;
+    unsigned long long freq[2];
+    unsigned char mode[2];
+    unsigned char filter[2];
+    unsigned char data[2];
+    int vfo;                        /* 0 for A, 1 for B */
+    int split;
+    int ptt;
+    int tuner;
+    unsigned short level[256];      /* 0x14 levels, 0..255 */
+    unsigned char func[256];        /* 0x16 switches */
+} radios[MAX_RADIOS] =
+{
+    {
+        0x94,
+        { 14074000, 7074000 },
+        { 0x01, 0x01 },             /* USB */
+        { 1, 1 },
+    }
+};
+
+static int nradios = 1;
+static struct radio *rig = &radios[0];   /* the one addressed */
+
+
+static void to_bcd(unsigned char *bcd, unsigned long long val, int bytes)
+{
+    int i;
+
+    /* least significant byte first */
+    for (i = 0; i < bytes; i++)
+    {
+        bcd[i] = (val % 10) | ((val / 10 % 10) << 4);
+        val /= 100;
+    }
+}
+
+
+static unsigned long long from_bcd(const unsigned char *bcd, int bytes)
+{
+    unsigned long long val = 0;
+    int i;
+
+    for (i = bytes - 1; i >= 0; i--)
+    {
+        val = val * 100 + (bcd[i] >> 4) * 10 + (bcd[i] & 0x0f);
+    }
+
+    return val;
+}
+
+
+/* levels go most significant byte first, 0000 to 0255 */
+static void level_to_bcd(unsigned char *bcd, int val)
+{
+    bcd[0] = val / 100;
+    bcd[1] = ((val / 10 % 10) << 4) | (val % 10);
+}
+
+
+static int level_from_bcd(const unsigned char *bcd)
+{
+    return (bcd[0] & 0x0f) * 100 + (bcd[1] >> 4) * 10 + (bcd[1] & 0x0f);
+}
+
+
+/*
+ * Answer to the controller: cmd, then len bytes of data
+ */
+static void reply(struct sim *s, int ctrl, const unsigned char *data, int len)
+{
+    unsigned char frame[64];
+
+    frame[0] = PR;
+    frame[1] = PR;
+    frame[2] = ctrl;
+    frame[3] = rig->addr;
+    memcpy(frame + 4, data, len);
+    frame[4 + len] = FI;
+
+    sim_write(s, frame, len + 5, 1);
+}
+
+
+/*
+ * Turn the dial of the first radio one 10 Hz step up, it sends its new
+ * frequency to everybody on the bus
+ */
+static void turn_dial(struct sim *s)
+{
+    unsigned char frame[11] = { PR, PR, 0x00, 0, 0x00 };
+
+    rig = &radios[0];
+    rig->freq[rig->vfo] += 10;
+
+    frame[3] = rig->addr;
+    to_bcd(frame + 5, rig->freq[rig->vfo], 5);
+    frame[10] = FI;
+
+    sim_write(s, frame, sizeof(frame), 0);
+}
+
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/*
+ * Wait for the controller until the next turn of the dial, returns 0 when
+ * it is time to turn it
+ */
+static int wait_input(struct sim *s, long long *next_turn)
+{
+    struct pollfd pfd = { s->fd, POLLIN, 0 };
+    long long left = *next_turn - now_ms();
+
+    if (s->in_len > 0)
+    {
+        return 1;
+    }
+
+    if (left > 0 && poll(&pfd, 1, (int)left) != 0)
+    {
+        return 1;
+    }
+
+    *next_turn = now_ms() + dial_ms;
+
+    return 0;
+}
+
+
+static void reply_code(struct sim *s, int ctrl, int code)
+{
+    unsigned char c = code;
+
+    reply(s, ctrl, &c, 1);
+}
+
+
+/*
+ * Execute the command of a frame without its preamble and addresses.
+ * p[0] is the command, len counts it, returns the answer length in ans
+ * or -1 for NG, 0 for OK.
+ */
+static int command(const unsigned char *p, int len, unsigned char *ans)
+{
+    int other = !rig->vfo;
+    int v;
+
+    switch (p[0])
+    {
+    case 0x03:  /* read operating frequency */
+        ans[0] = 0x03;
+        to_bcd(ans + 1, rig->freq[rig->vfo], 5);
+        return 6;
+
+    case 0x04:  /* read operating mode */
+        ans[0] = 0x04;
+        ans[1] = rig->mode[rig->vfo];
+        ans[2] = rig->filter[rig->vfo];
+        return 3;
+
+    case 0x05:  /* set operating frequency */
+        if (len != 6) { return -1; }
+
+        rig->freq[rig->vfo] = from_bcd(p + 1, 5);
+        return 0;
+
+    case 0x06:  /* set operating mode */
+        if (len < 2) { return -1; }
+
+        rig->mode[rig->vfo] = p[1];
+
+        if (len > 2) { rig->filter[rig->vfo] = p[2]; }
+
+        return 0;
+
+    case 0x07:  /* VFO selection */
+        if (len == 1) { return 0; }
+
+        switch (p[1])
+        {
+        case 0x00: case 0xd0: rig->vfo = 0; break;
+
+        case 0x01: case 0xd1: rig->vfo = 1; break;
+
+        case 0xa0:
+            rig->freq[other] = rig->freq[rig->vfo];
+            rig->mode[other] = rig->mode[rig->vfo];
+            rig->filter[other] = rig->filter[rig->vfo];
+            break;
+
+        case 0xb0: rig->vfo = other; break;
+
+        default: return -1;
+        }
+
+        return 0;
+
+    case 0x0f:  /* split */
+        if (len == 1)
+        {
+            ans[0] = 0x0f;
+            ans[1] = rig->split;
+            return 2;
+        }
+
+        if (p[1] > 0x01) { return -1; }
+
+        rig->split = p[1];
+        return 0;
+
+    case 0x14:  /* levels */
+        if (len == 2)
+        {
+            ans[0] = 0x14;
+            ans[1] = p[1];
+            level_to_bcd(ans + 2, rig->level[p[1]]);
+            return 4;
+        }
+
+        if (len != 4) { return -1; }
+
+        rig->level[p[1]] = level_from_bcd(p + 2);
+        return 0;
+
+    case 0x15:  /* meters, S meter at S9 and the others at 0 */
+        if (len != 2) { return -1; }
+
+        ans[0] = 0x15;
+        ans[1] = p[1];
+
+        if (p[1] == 0x01)
+        {
+            ans[2] = 0;     /* squelch closed */
+            return 3;
+        }
+
+        level_to_bcd(ans + 2, p[1] == 0x02 ? 120 : 0);
+        return 4;
+
+    case 0x16:  /* function switches */
+        if (len == 2)
+        {
+            ans[0] = 0x16;
+            ans[1] = p[1];
+            ans[2] = rig->func[p[1]];
+            return 3;
+        }
+
+        if (len != 3) { return -1; }
+
+        rig->func[p[1]] = p[2];
+        return 0;
+
+    case 0x19:  /* transceiver ID */
+        if (len != 2 || p[1] != 0x00) { return -1; }
+
+        ans[0] = 0x19;
+        ans[1] = 0x00;
+        ans[2] = rig->addr;
+        return 3;
+
+    case 0x1a:
+        if (len >= 2 && p[1] == 0x06)   /* data mode */
+        {
+            if (len == 2)
+            {
+                ans[0] = 0x1a;
+                ans[1] = 0x06;
+                ans[2] = rig->data[rig->vfo];
+                ans[3] = rig->data[rig->vfo] ? rig->filter[rig->vfo] : 0;
+                return 4;
+            }
+
+            rig->data[rig->vfo] = p[2];
+            return 0;
+        }
+
+        return -1;
+
+    case 0x1c:  /* PTT and tuner */
+        if (len < 2 || p[1] > 0x01) { return -1; }
+
+        if (len == 2)
+        {
+            ans[0] = 0x1c;
+            ans[1] = p[1];
+            ans[2] = p[1] == 0x00 ? rig->ptt : rig->tuner;
+            return 3;
+        }
+
+        *(p[1] == 0x00 ? &rig->ptt : &rig->tuner) = p[2];
+        return 0;
+
+    case 0x25:  /* frequency of the selected or unselected VFO */
+        if (len < 2 || p[1] > 0x01) { return -1; }
+
+        v = p[1] ? other : rig->vfo;
+
+        if (len == 2)
+        {
+            ans[0] = 0x25;
+            ans[1] = p[1];
+            to_bcd(ans + 2, rig->freq[v], 5);
+            return 7;
+        }
+
+        if (len != 7) { return -1; }
+
+        rig->freq[v] = from_bcd(p + 2, 5);
+        return 0;
+
+    case 0x26:  /* mode of the selected or unselected VFO */
+        if (len < 2 || p[1] > 0x01) { return -1; }
+
+        v = p[1] ? other : rig->vfo;
+
+        if (len == 2)
+        {
+            ans[0] = 0x26;
+            ans[1] = p[1];
+            ans[2] = rig->mode[v];
+            ans[3] = rig->data[v];
+            ans[4] = rig->filter[v];
+            return 5;
+        }
+
+        if (len < 3) { return -1; }
+
+        rig->mode[v] = p[2];
+
+        if (len > 3) { rig->data[v] = p[3]; }
+
+        if (len > 4) { rig->filter[v] = p[4]; }
+
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+
+static void frame(struct sim *s, unsigned char *buf, int len)
+{
+    unsigned char ans[32];
+    int start, ret, i;
+
+    /* skip anything before the preamble */
+    for (start = 0; start + 1 < len && !(buf[start] == PR
+                                          && buf[start + 1] == PR); start++)
+    {
+    }
+
+    buf += start;
+    len -= start;
+
+    /* FE FE to from cmd ... FD */
+    if (len < 6)
+    {
+        return;
+    }
+
+    if (echo)
+    {
+        if (collision_pct > 0 && rand() % 100 < collision_pct)
+        {
+            /* the rest of the frame is lost in the jam */
+            buf[len / 2] = COL;
+            sim_write(s, buf, len / 2 + 1, 0);
+            return;
+        }
+
+        sim_write(s, buf, len, 0);
+    }
+
+    /* a broadcast goes to the first radio */
+    for (i = 0; i < nradios && buf[2] != radios[i].addr && buf[2] != 0x00; i++)
+    {
+    }
+
+    if (i == nradios)
+    {
+        return;
+    }
+
+    rig = &radios[i];
+
+    if (sim_error(s))
+    {
+        reply_code(s, buf[3], NAK);
+        return;
+    }
+
+    ret = command(buf + 4, len - 5, ans);
+
+    if (ret < 0)
+    {
+        reply_code(s, buf[3], NAK);
+    }
+    else if (ret == 0)
+    {
+        reply_code(s, buf[3], ACK);
+    }
+    else
+    {
+        reply(s, buf[3], ans, ret);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sim s = { "simicom" };
+    unsigned char buf[SIM_BUF_SIZE];
+    long long next_turn;
+    int naddr = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, SIM_OPTIONS "a:c:nt:")) != -1)
+    {
+        if (sim_option(&s, c, optarg))
+        {
+            continue;
+        }
+
+        switch (c)
+        {
+        case 'a':
+            if (naddr == MAX_RADIOS)
+            {
+                fprintf(stderr, "%s: at most %d radios\n", s.name, MAX_RADIOS);
+                exit(1);
+            }
+
+            if (naddr > 0)
+            {
+                radios[naddr] = radios[0];
+            }
+
+            radios[naddr++].addr = strtol(optarg, NULL, 16);
+            break;
+
+        case 'c':
+            collision_pct = atoi(optarg);
+            break;
+
+        case 'n':
+            echo = 0;
+            break;
+
+        case 't':
+            dial_ms = atoi(optarg);
+            break;
+
+        default:
+            sim_usage(&s,
+                      "  -a ADDR       CI-V address in hex, default 94, once per radio\n"
+                      "  -c PCT        jam PCT percent of the echoes by a collision\n"
+                      "  -n            no echo, as a USB CI-V port with echo off\n"
+                      "  -t MS         turn the dial every MS ms the controller is quiet,\n"
+                      "                telling it with transceive frames\n");
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+
+    if (naddr > 0)
+    {
+        nradios = naddr;
+    }
+
+    s.hex = 1;
+
+    if (sim_open(&s) < 0)
+    {
+        exit(2);
+    }
+
+    next_turn = now_ms() + dial_ms;
+
+    for (;;)
+    {
+        int len;
+
+        if (dial_ms > 0 && !wait_input(&s, &next_turn))
+        {
+            turn_dial(&s);
+            continue;
+        }
+
+        len = sim_read(&s, buf, sizeof(buf), FI);
+
+        if (len < 0)
+        {
+            exit(2);
+        }
+
+        frame(&s, buf, len);
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ *  Hamlib rig simulators - Kenwood TS-590S
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Speaks the Kenwood CAT protocol of a TS-590S (rig model 2031): set
+ * commands get no answer, read commands their value, and anything the
+ * rig would not understand "?;".
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "sim.h"
+
+static struct sim_cat cmds[] =
+{
+    { "ID", "", "ID021" },
+    { "PS", "", "PS1" },
+    { "FV", "", "FV1.04" },
+    { "AI", "", "AI0" },
+    { "FA", "", "FA00014074000" },
+    { "FB", "", "FB00007074000" },
+    { "FR", "", "FR0" },
+    { "FT", "", "FT0" },
+    { "MD", "", "MD2" },
+    { "AG", "0", "AG0100" },
+    { "RG", "", "RG255" },
+    { "SQ", "0", "SQ0000" },
+    { "PC", "", "PC100" },
+    { "MG", "", "MG050" },
+    { "KS", "", "KS020" },
+    { "SM", "0", "SM00005" },
+    { "PA", "", "PA00" },
+    { "RA", "", "RA00" },
+    { "NB", "", "NB0" },
+    { "NR", "", "NR0" },
+    { "BC", "", "BC0" },
+    { "VX", "", "VX0" },
+    { "RT", "", "RT0" },
+    { "XT", "", "XT0" },
+    { "SH", "", "SH00" },
+    { "SL", "", "SL00" },
+    { "DA", "", "DA0" },
+    { NULL }
+};
+
+static int ptt;
+
+
+static const char *value(const char *cmd)
+{
+    return sim_cat_find(cmds, cmd)->value + 2;
+}
+
+
+/*
+ * IF, the answer backends use to read most of the state at once
+ */
+static void reply_if(struct sim *s)
+{
+    char reply[64];
+    int vfo = value("FR")[0];
+
+    snprintf(reply, sizeof(reply), "IF%s    +00000%c%c000%c%c%c0%c0000;",
+             value(vfo == '1' ? "FB" : "FA"),
+             value("RT")[0], value("XT")[0],
+             ptt ? '1' : '0', value("MD")[0], vfo,
+             value("FR")[0] != value("FT")[0] ? '1' : '0');
+
+    sim_reply(s, reply);
+}
+
+
+static void command(struct sim *s, char *cmd)
+{
+    if (sim_error(s))
+    {
+        sim_reply(s, "?;");
+        return;
+    }
+
+    if (strcmp(cmd, "IF") == 0)
+    {
+        reply_if(s);
+        return;
+    }
+
+    /* TX; TX0; TX1; and TX2; all transmit, RX; receives */
+    if (strncmp(cmd, "TX", 2) == 0 && strlen(cmd) <= 3)
+    {
+        ptt = 1;
+        return;
+    }
+
+    if (strcmp(cmd, "RX") == 0)
+    {
+        ptt = 0;
+        return;
+    }
+
+    if (sim_cat_command(s, cmds, cmd) < 0)
+    {
+        sim_reply(s, "?;");
+        return;
+    }
+
+    /* selecting the receive VFO selects the transmit VFO too */
+    if (strncmp(cmd, "FR", 2) == 0 && cmd[2] != '\0')
+    {
+        sim_cat_find(cmds, "FT")->value[2] = cmd[2];
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sim s = { "simkenwood" };
+    unsigned char buf[SIM_BUF_SIZE];
+    int c;
+
+    while ((c = getopt(argc, argv, SIM_OPTIONS)) != -1)
+    {
+        if (!sim_option(&s, c, optarg))
+        {
+            sim_usage(&s, "");
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+
+    if (sim_open(&s) < 0)
+    {
+        exit(2);
+    }
+
+    for (;;)
+    {
+        int len = sim_read(&s, buf, sizeof(buf) - 1, ';');
+
+        if (len < 0)
+        {
+            exit(2);
+        }
+
+        buf[len - 1] = '\0';
+        command(&s, (char *)buf);
+    }
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ *  Hamlib rig simulators - Yaesu FT-991
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Speaks the NewCAT protocol of an FT-991 (rig model 1035).  Like the
+ * Kenwood one, set commands get no answer and anything the rig would not
+ * understand "?;", which the newcat backend notices through the "ID;" it
+ * sends after each set command.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "sim.h"
+
+static struct sim_cat cmds[] =
+{
+    { "ID", "", "ID0570" },
+    { "PS", "", "PS1" },
+    { "AI", "", "AI0" },
+    { "FA", "", "FA014074000" },
+    { "FB", "", "FB007074000" },
+    { "MD", "0", "MD02" },
+    { "VS", "", "VS0" },
+    { "FT", "", "FT0" },
+    { "TX", "", "TX0" },
+    { "AG", "0", "AG0100" },
+    { "RG", "0", "RG0255" },
+    { "SQ", "0", "SQ0000" },
+    { "PC", "", "PC100" },
+    { "MG", "", "MG050" },
+    { "KS", "", "KS020" },
+    { "SM", "0", "SM0005" },
+    { "PA", "0", "PA00" },
+    { "RA", "0", "RA00" },
+    { "NB", "0", "NB00" },
+    { "NR", "0", "NR00" },
+    { "NA", "0", "NA00" },
+    { "SH", "0", "SH000" },
+    { "RT", "", "RT0" },
+    { "XT", "", "XT0" },
+    { NULL }
+};
+
+
+static const char *value(const char *cmd)
+{
+    return sim_cat_find(cmds, cmd)->value + 2;
+}
+
+
+/*
+ * IF of the FT-991, 28 bytes with its 9 digit frequency
+ */
+static void reply_if(struct sim *s)
+{
+    char reply[64];
+
+    snprintf(reply, sizeof(reply), "IF001%s+0000%c%c%c00000;",
+             value(value("VS")[0] == '1' ? "FB" : "FA"),
+             value("RT")[0], value("XT")[0], value("MD")[1]);
+
+    sim_reply(s, reply);
+}
+
+
+static void command(struct sim *s, char *cmd)
+{
+    if (sim_error(s))
+    {
+        sim_reply(s, "?;");
+        return;
+    }
+
+    if (strcmp(cmd, "IF") == 0)
+    {
+        reply_if(s);
+        return;
+    }
+
+    if (sim_cat_command(s, cmds, cmd) < 0)
+    {
+        sim_reply(s, "?;");
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sim s = { "simnewcat" };
+    unsigned char buf[SIM_BUF_SIZE];
+    int c;
+
+    while ((c = getopt(argc, argv, SIM_OPTIONS)) != -1)
+    {
+        if (!sim_option(&s, c, optarg))
+        {
+            sim_usage(&s, "");
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+
+    if (sim_open(&s) < 0)
+    {
+        exit(2);
+    }
+
+    for (;;)
+    {
+        int len = sim_read(&s, buf, sizeof(buf) - 1, ';');
+
+        if (len < 0)
+        {
+            exit(2);
+        }
+
+        buf[len - 1] = '\0';
+        command(&s, (char *)buf);
+    }
+
+    return 0;
+}
@@ -24,7 +24,13 @@ LOCAL_SRC_FILES := \
         usb_port.c \
         debug.c \
         network.c \
-        cm108.c
+        cm108.c \
+        cache.c \
+        batch.c \
+        stats.c \
+        trace.c \
+        replay.c \
+        adaptive.c
 
 
 LOCAL_MODULE := libhamlib
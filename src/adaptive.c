@@ -0,0 +1,420 @@
+/**
+ * \addtogroup rig_internal
+ * @{
+ */
+
+/**
+ * \file src/adaptive.c
+ * \brief Adaptive port timeout
+ *
+ * When enabled on a port, the time every read waits for the rig is
+ * recorded in a histogram of the command class last written, and the
+ * next wait is bounded by the 99th percentile of that class plus a
+ * margin instead of the fixed port timeout.  A rig that stopped talking
+ * then costs a few tens of ms instead of a full second, while a slow
+ * USB-serial bridge is learned and not cut short.
+ *
+ * The command class is the first two bytes of a text command ("FA",
+ * "IF"), or the command and sub command bytes of a CI-V frame.
+ */
+/*
+ *  Hamlib Interface - adaptive port timeout
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <hamlib/rig.h>
+#include "adaptive.h"
+#include "stats.h"
+
+/* classes tracked per port, the least recently used one is recycled */
+#define ADAPTIVE_CLASSES    16
+
+/* samples needed before a class timeout is trusted */
+#define ADAPTIVE_MIN_SAMPLES 16
+
+/* the histograms are halved past this many samples to follow changes */
+#define ADAPTIVE_WINDOW     512
+
+#define ADAPTIVE_PERCENTILE 0.99
+
+/* added to the percentile, besides half of it, in ms */
+#define ADAPTIVE_MARGIN_MS  10
+
+/* a class doubles its timeout after each timeout, up to 2^8 times */
+#define ADAPTIVE_MAX_BACKOFF 8
+
+struct adaptive_class
+{
+    unsigned int key;
+    uint64_t used;              /* clock of the last use */
+    int backoff;                /* timeouts since the last answer */
+    struct stats_hist hist;     /* waits in us */
+};
+
+struct port_adaptive
+{
+    struct adaptive_class all;  /* every wait of the port */
+    struct adaptive_class cls[ADAPTIVE_CLASSES];
+    int nclasses;
+    struct adaptive_class *cur; /* class of the last command written */
+    uint64_t clock;
+};
+
+
+/**
+ * \brief Turn adaptive timeouts of a port on or off
+ * \param p rig port descriptor
+ * \param enable 1 to learn and apply the timeouts, 0 for p->timeout
+ * \return RIG_OK, or -RIG_ENOMEM
+ *
+ * What was learned is kept when already on and dropped when turned off.
+ */
+int HAMLIB_API adaptive_enable(hamlib_port_t *p, int enable)
+{
+    if (!enable)
+    {
+        adaptive_close(p);
+        return RIG_OK;
+    }
+
+    if (p->adaptive.state)
+    {
+        return RIG_OK;
+    }
+
+    p->adaptive.state = calloc(1, sizeof(struct port_adaptive));
+
+    if (!p->adaptive.state)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief Free the adaptive timeout state of a port
+ * \param p rig port descriptor
+ */
+void HAMLIB_API adaptive_close(hamlib_port_t *p)
+{
+    free(p->adaptive.state);
+    p->adaptive.state = NULL;
+}
+
+
+/**
+ * \brief Forget the learned timeouts of a port
+ * \param p rig port descriptor
+ */
+void HAMLIB_API adaptive_reset(hamlib_port_t *p)
+{
+    if (p->adaptive.state)
+    {
+        memset(p->adaptive.state, 0, sizeof(struct port_adaptive));
+    }
+}
+
+
+static unsigned int class_key(const unsigned char *buf, size_t len)
+{
+    /* CI-V: FE FE to from cmd [subcmd] ... FD */
+    if (len >= 6 && buf[0] == 0xfe && buf[1] == 0xfe)
+    {
+        return buf[4] << 8 | buf[5];
+    }
+
+    if (len >= 2)
+    {
+        return buf[0] << 8 | buf[1];
+    }
+
+    return len == 1 ? buf[0] << 8 : 0;
+}
+
+
+/**
+ * \brief Note the class of a command written to the port
+ * \param p rig port descriptor
+ * \param buf bytes written
+ * \param len count of bytes
+ *
+ * The waits until the next command are charged to this class.
+ */
+void HAMLIB_API adaptive_sent(hamlib_port_t *p, const unsigned char *buf,
+                              size_t len)
+{
+    struct port_adaptive *a = p->adaptive.state;
+    struct adaptive_class *c, *lru;
+    unsigned int key;
+    int i;
+
+    if (!a)
+    {
+        return;
+    }
+
+    key = class_key(buf, len);
+    lru = &a->cls[0];
+
+    for (i = 0; i < a->nclasses; i++)
+    {
+        c = &a->cls[i];
+
+        if (c->key == key)
+        {
+            c->used = ++a->clock;
+            a->cur = c;
+            return;
+        }
+
+        if (c->used < lru->used)
+        {
+            lru = c;
+        }
+    }
+
+    if (a->nclasses < ADAPTIVE_CLASSES)
+    {
+        lru = &a->cls[a->nclasses++];
+    }
+
+    memset(lru, 0, sizeof(*lru));
+    lru->key = key;
+    lru->used = ++a->clock;
+    a->cur = lru;
+}
+
+
+/* learned timeout of a class in ms, -1 when it has too few samples */
+static int class_timeout(const struct adaptive_class *c)
+{
+    uint64_t us;
+
+    if (c->hist.count < ADAPTIVE_MIN_SAMPLES)
+    {
+        return -1;
+    }
+
+    us = rig_stats_hist_percentile(&c->hist, ADAPTIVE_PERCENTILE);
+
+    return (int)((us + us / 2 + 999) / 1000) + ADAPTIVE_MARGIN_MS;
+}
+
+
+static void bounds(const hamlib_port_t *p, int *lo, int *hi)
+{
+    *hi = p->adaptive.max > 0 ? p->adaptive.max : p->timeout;
+    *lo = p->adaptive.min < *hi ? p->adaptive.min : *hi;
+}
+
+
+/**
+ * \brief Timeout of the next wait on the port
+ * \param p rig port descriptor
+ * \return timeout in ms
+ *
+ * p->timeout unless adaptive timeouts are on.  A class that has not
+ * been learned yet falls back to the port wide figure, then to the
+ * upper bound.
+ */
+int HAMLIB_API adaptive_timeout(hamlib_port_t *p)
+{
+    struct port_adaptive *a = p->adaptive.state;
+    struct adaptive_class *c;
+    int lo, hi, ms;
+
+    if (!a)
+    {
+        return p->timeout;
+    }
+
+    bounds(p, &lo, &hi);
+
+    c = a->cur ? a->cur : &a->all;
+    ms = class_timeout(c);
+
+    if (ms < 0)
+    {
+        ms = class_timeout(&a->all);
+    }
+
+    if (ms < 0)
+    {
+        return hi;
+    }
+
+    if (ms < lo)
+    {
+        ms = lo;
+    }
+
+    ms <<= c->backoff;
+
+    return ms < hi ? ms : hi;
+}
+
+
+static void class_add(struct adaptive_class *c, uint64_t us)
+{
+    struct stats_hist *h = &c->hist;
+    int i;
+
+    if (h->count >= ADAPTIVE_WINDOW)
+    {
+        h->count = 0;
+        h->sum_us /= 2;
+
+        for (i = 0; i < STATS_HIST_BUCKETS; i++)
+        {
+            h->bucket[i] /= 2;
+            h->count += h->bucket[i];
+        }
+
+        /* let an old peak go, the percentile is capped by it */
+        h->max_us = rig_stats_hist_percentile(h, 1.0);
+    }
+
+    rig_stats_hist_add(h, us);
+}
+
+
+/**
+ * \brief Record a wait of the port for the rig
+ * \param p rig port descriptor
+ * \param us time waited, in us
+ * \param timed_out nonzero if nothing came in time
+ *
+ * A timeout is not a sample, as the rig may answer later or never,
+ * but it doubles the timeout of the class until its next answer.
+ */
+void HAMLIB_API adaptive_waited(hamlib_port_t *p, uint64_t us, int timed_out)
+{
+    struct port_adaptive *a = p->adaptive.state;
+    struct adaptive_class *c;
+
+    if (!a)
+    {
+        return;
+    }
+
+    c = a->cur ? a->cur : &a->all;
+
+    if (timed_out)
+    {
+        if (c->backoff < ADAPTIVE_MAX_BACKOFF)
+        {
+            c->backoff++;
+        }
+
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: timed out, backoff %d\n", __func__,
+                  c->backoff);
+        return;
+    }
+
+    c->backoff = 0;
+
+    if (c != &a->all)
+    {
+        class_add(c, us);
+    }
+
+    class_add(&a->all, us);
+}
+
+
+static void class_name(const struct adaptive_class *c, char *name)
+{
+    unsigned char hi = c->key >> 8, lo = c->key & 0xff;
+
+    if (isalnum(hi) && isalnum(lo))
+    {
+        sprintf(name, "%c%c", hi, lo);
+    }
+    else if (lo == 0xfd || lo == 0)
+    {
+        sprintf(name, "%02x", hi);     /* CI-V command without sub command */
+    }
+    else
+    {
+        sprintf(name, "%02x%02x", hi, lo);
+    }
+}
+
+
+/**
+ * \brief Learned timeouts of a port, for rig_get_conf()
+ * \param p rig port descriptor
+ * \param buf receives "all=T CLASS=T ...", T in ms
+ * \param len size of buf
+ * \return RIG_OK
+ *
+ * Only the classes with enough samples are listed, buf is empty when
+ * adaptive timeouts are off.
+ */
+int HAMLIB_API adaptive_learned(const hamlib_port_t *p, char *buf, size_t len)
+{
+    const struct port_adaptive *a = p->adaptive.state;
+    size_t n = 0;
+    int lo, hi, i;
+
+    buf[0] = '\0';
+
+    if (!a)
+    {
+        return RIG_OK;
+    }
+
+    bounds(p, &lo, &hi);
+
+    for (i = -1; i < a->nclasses && n < len; i++)
+    {
+        const struct adaptive_class *c = i < 0 ? &a->all : &a->cls[i];
+        char name[8] = "all";
+        int ms = class_timeout(c);
+
+        if (ms < 0)
+        {
+            continue;
+        }
+
+        if (i >= 0)
+        {
+            class_name(c, name);
+        }
+
+        ms = ms < lo ? lo : ms > hi ? hi : ms;
+
+        n += snprintf(buf + n, len - n, "%s%s=%d", n ? " " : "", name, ms);
+    }
+
+    return RIG_OK;
+}
+
+/** @} */
@@ -0,0 +1,43 @@
+/*
+ *  Hamlib Interface - adaptive port timeout header
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _ADAPTIVE_H
+#define _ADAPTIVE_H 1
+
+#include <stdint.h>
+#include <hamlib/rig.h>
+
+__BEGIN_DECLS
+
+extern HAMLIB_EXPORT(int) adaptive_enable(hamlib_port_t *p, int enable);
+extern HAMLIB_EXPORT(void) adaptive_close(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) adaptive_reset(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) adaptive_sent(hamlib_port_t *p,
+        const unsigned char *buf, size_t len);
+extern HAMLIB_EXPORT(int) adaptive_timeout(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) adaptive_waited(hamlib_port_t *p, uint64_t us,
+        int timed_out);
+extern HAMLIB_EXPORT(int) adaptive_learned(const hamlib_port_t *p, char *buf,
+        size_t len);
+
+__END_DECLS
+
+#endif /* _ADAPTIVE_H */
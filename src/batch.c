@@ -0,0 +1,266 @@
+/**
+ * \addtogroup rig
+ * @{
+ */
+
+/**
+ * \file src/batch.c
+ * \brief Batched rig operations
+ *
+ * A batch queues several get/set operations so a backend able to
+ * pipeline its commands gets them all at once, see rig_batch_exec().
+ */
+/*
+ *  Hamlib Interface - batched operations
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include <hamlib/rig.h>
+
+
+#ifndef DOC_HIDDEN
+
+#  define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !(r)->state.comm_state)
+
+#endif /* !DOC_HIDDEN */
+
+
+/**
+ * \brief empty a batch
+ * \param batch  The batch to initialize
+ *
+ * \sa rig_batch_add()
+ */
+void HAMLIB_API rig_batch_init(struct rig_batch *batch)
+{
+    memset(batch, 0, sizeof(*batch));
+}
+
+
+/**
+ * \brief queue an operation
+ * \param batch  The batch
+ * \param op     The operation
+ * \param vfo    The target VFO
+ *
+ *  Queues \a op at the end of \a batch. Arguments of set operations
+ *  are to be filled in the returned slot, see struct rig_batch_op.
+ *
+ * \return the operation slot, or NULL when the batch is full.
+ *
+ * \sa rig_batch_exec()
+ */
+struct rig_batch_op *HAMLIB_API rig_batch_add(struct rig_batch *batch,
+        rig_batch_op_t op,
+        vfo_t vfo)
+{
+    struct rig_batch_op *bop;
+
+    if (!batch || batch->count >= RIG_BATCH_MAX)
+    {
+        return NULL;
+    }
+
+    bop = &batch->ops[batch->count++];
+    memset(bop, 0, sizeof(*bop));
+    bop->op = op;
+    bop->vfo = vfo;
+
+    return bop;
+}
+
+
+static int batch_exec_op(RIG *rig, struct rig_batch_op *bop)
+{
+    switch (bop->op)
+    {
+    case RIG_BATCH_GET_FREQ:
+        return rig_get_freq(rig, bop->vfo, &bop->freq);
+
+    case RIG_BATCH_SET_FREQ:
+        return rig_set_freq(rig, bop->vfo, bop->freq);
+
+    case RIG_BATCH_GET_MODE:
+        return rig_get_mode(rig, bop->vfo, &bop->mode, &bop->width);
+
+    case RIG_BATCH_SET_MODE:
+        return rig_set_mode(rig, bop->vfo, bop->mode, bop->width);
+
+    case RIG_BATCH_GET_VFO:
+        return rig_get_vfo(rig, &bop->tx_vfo);
+
+    case RIG_BATCH_SET_VFO:
+        return rig_set_vfo(rig, bop->vfo);
+
+    case RIG_BATCH_GET_PTT:
+        return rig_get_ptt(rig, bop->vfo, &bop->ptt);
+
+    case RIG_BATCH_SET_PTT:
+        return rig_set_ptt(rig, bop->vfo, bop->ptt);
+
+    case RIG_BATCH_GET_SPLIT_VFO:
+        return rig_get_split_vfo(rig, bop->vfo, &bop->split, &bop->tx_vfo);
+
+    case RIG_BATCH_SET_SPLIT_VFO:
+        return rig_set_split_vfo(rig, bop->vfo, bop->split, bop->tx_vfo);
+
+    case RIG_BATCH_GET_LEVEL:
+        return rig_get_level(rig, bop->vfo, bop->level, &bop->val);
+
+    case RIG_BATCH_SET_LEVEL:
+        return rig_set_level(rig, bop->vfo, bop->level, bop->val);
+
+    default:
+        return -RIG_EINVAL;
+    }
+}
+
+
+/**
+ * \brief execute a batch of operations
+ * \param rig    The rig handle
+ * \param batch  The operations to execute
+ *
+ *  Executes the operations of \a batch in order, storing each result
+ *  in the operation retcode field. An error does not stop the batch.
+ *
+ *  Each run of consecutive get operations is first handed to the
+ *  backend batch_prefetch() when it has one, so it can send all the
+ *  commands in one write and read the replies in order, e.g. "FA;MD0;TX;"
+ *  for a Kenwood or Yaesu NewCAT rig. The operations are then executed
+ *  as usual through rig_get_freq() and friends, the backend serving the
+ *  prefetched replies instead of doing a round trip each. Backends
+ *  without batch_prefetch() simply execute the operations one by one.
+ *
+ *  Likewise a run of consecutive set operations is bracketed by the
+ *  backend batch_verify(), when it has one: called with 1 it defers the
+ *  check a backend makes after each set command, called with 0 it checks
+ *  the whole run at once, e.g. with a single "ID;" for a Yaesu NewCAT
+ *  rig. Should that check fail, the run is executed again one operation
+ *  at a time, each checked, to tell which one failed.
+ *
+ * \return RIG_OK if all the operations have been successful, otherwise
+ * the error code of the first one that failed.
+ *
+ * \sa rig_batch_init(), rig_batch_add()
+ */
+int HAMLIB_API rig_batch_exec(RIG *rig, struct rig_batch *batch)
+{
+    const struct rig_caps *caps;
+    int retcode = RIG_OK;
+    int i;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+
+    if (CHECK_RIG_ARG(rig) || !batch || batch->count > RIG_BATCH_MAX)
+    {
+        return -RIG_EINVAL;
+    }
+
+    caps = rig->caps;
+
+    for (i = 0; i < batch->count; i++)
+    {
+        int run = 0;
+
+        if (caps->batch_verify && !RIG_BATCH_IS_GET(batch->ops[i].op))
+        {
+            while (i + run < batch->count
+                    && !RIG_BATCH_IS_GET(batch->ops[i + run].op))
+            {
+                run++;
+            }
+
+            if (run > 1 && caps->batch_verify(rig, 1) == RIG_OK)
+            {
+                int j;
+
+                for (j = i; j < i + run; j++)
+                {
+                    batch->ops[j].retcode = batch_exec_op(rig, &batch->ops[j]);
+                }
+
+                if (caps->batch_verify(rig, 0) != RIG_OK)
+                {
+                    rig_debug(RIG_DEBUG_WARN, "%s: run of %d sets failed, "
+                              "replaying them one by one\n", __func__, run);
+
+                    for (j = i; j < i + run; j++)
+                    {
+                        batch->ops[j].retcode = batch_exec_op(rig, &batch->ops[j]);
+                    }
+                }
+
+                i += run - 1;
+                continue;
+            }
+
+            run = 0;
+        }
+
+        if (caps->batch_prefetch)
+        {
+            while (i + run < batch->count
+                    && RIG_BATCH_IS_GET(batch->ops[i + run].op))
+            {
+                run++;
+            }
+
+            if (run > 1)
+            {
+                int j;
+
+                /* failure is not an error, the replies are read again */
+                caps->batch_prefetch(rig, &batch->ops[i], run);
+
+                for (j = i; j < i + run; j++)
+                {
+                    batch->ops[j].retcode = batch_exec_op(rig, &batch->ops[j]);
+                }
+
+                /* drop any reply left unused */
+                caps->batch_prefetch(rig, NULL, 0);
+
+                i += run - 1;
+                continue;
+            }
+        }
+
+        batch->ops[i].retcode = batch_exec_op(rig, &batch->ops[i]);
+    }
+
+    for (i = 0; i < batch->count; i++)
+    {
+        if (batch->ops[i].retcode != RIG_OK)
+        {
+            retcode = batch->ops[i].retcode;
+            break;
+        }
+    }
+
+    return retcode;
+}
+
+/** @} */
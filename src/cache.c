@@ -0,0 +1,312 @@
+/**
+ * \addtogroup rig
+ * @{
+ */
+
+/**
+ * \file src/cache.c
+ * \brief Generic settings cache
+ *
+ * Levels, funcs, RIT/XIT, tuning step, CTCSS and antenna values read
+ * from the rig are kept in rig->state.cache.settings, keyed by
+ * (vfo, kind, id), and served back until their per kind timeout expires
+ * or a matching rig_set_*() call invalidates them.
+ *
+ * Also home of the lock free snapshot of the main cached items.
+ */
+/*
+ *  Hamlib Interface - settings cache
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+#include <time.h>
+
+#include <hamlib/rig.h>
+#include "misc.h"
+#include "cache.h"
+#include "stats.h"
+
+
+/*
+ * Lookup a cached setting, NULL when not cached or too old
+ */
+struct rig_cache_setting *HAMLIB_API rig_cache_find(RIG *rig,
+        hamlib_cache_t kind,
+        vfo_t vfo,
+        setting_t id)
+{
+    struct rig_cache *cache = &rig->state.cache;
+    int i;
+
+    if (kind <= HAMLIB_CACHE_ALL || kind >= HAMLIB_CACHE_MAX
+            || cache->timeout_kind_ms[kind] <= 0)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < HAMLIB_CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *s = &cache->settings[i];
+        int cache_ms;
+
+        if (s->kind != kind || s->vfo != vfo || s->id != id)
+        {
+            continue;
+        }
+
+        cache_ms = elapsed_ms(&s->time, HAMLIB_ELAPSED_GET);
+
+        if (cache_ms < cache->timeout_kind_ms[kind])
+        {
+            STATS_COUNT(STATS_CACHE_HITS);
+            rig_debug(RIG_DEBUG_TRACE, "%s: kind=%d %s id=0x%llx cache hit age=%dms\n",
+                      __func__, kind, rig_strvfo(vfo), (unsigned long long)id, cache_ms);
+            return s;
+        }
+
+        STATS_COUNT(STATS_CACHE_MISSES);
+        rig_debug(RIG_DEBUG_TRACE, "%s: kind=%d %s id=0x%llx cache miss age=%dms\n",
+                  __func__, kind, rig_strvfo(vfo), (unsigned long long)id, cache_ms);
+        return NULL;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Store a setting freshly read from the rig.
+ * Reuses the slot of the same key, else a free one, else the oldest one.
+ * Returns the slot so callers can fill in kind specific fields.
+ */
+struct rig_cache_setting *HAMLIB_API rig_cache_store(RIG *rig,
+        hamlib_cache_t kind,
+        vfo_t vfo,
+        setting_t id,
+        value_t val)
+{
+    struct rig_cache *cache = &rig->state.cache;
+    struct rig_cache_setting *slot = NULL;
+    int i;
+
+    if (kind <= HAMLIB_CACHE_ALL || kind >= HAMLIB_CACHE_MAX
+            || cache->timeout_kind_ms[kind] <= 0)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < HAMLIB_CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *s = &cache->settings[i];
+
+        if (s->kind == kind && s->vfo == vfo && s->id == id)
+        {
+            slot = s;
+            break;
+        }
+
+        if (s->kind == HAMLIB_CACHE_ALL)
+        {
+            if (!slot || slot->kind != HAMLIB_CACHE_ALL) { slot = s; }
+        }
+        else if (!slot || (slot->kind != HAMLIB_CACHE_ALL
+                           && (s->time.tv_sec < slot->time.tv_sec
+                               || (s->time.tv_sec == slot->time.tv_sec
+                                   && s->time.tv_nsec < slot->time.tv_nsec))))
+        {
+            slot = s;
+        }
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    slot->kind = kind;
+    slot->vfo = vfo;
+    slot->id = id;
+    slot->val = val;
+    elapsed_ms(&slot->time, HAMLIB_ELAPSED_SET);
+
+    return slot;
+}
+
+
+/*
+ * Drop all cached entries of kind/id, whatever the VFO
+ * since a set on RIG_VFO_CURR may well change VFOA.
+ */
+void HAMLIB_API rig_cache_invalidate(RIG *rig, hamlib_cache_t kind,
+                                     setting_t id)
+{
+    int i;
+
+    for (i = 0; i < HAMLIB_CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *s = &rig->state.cache.settings[i];
+
+        if (s->kind == kind && s->id == id)
+        {
+            s->kind = HAMLIB_CACHE_ALL;
+        }
+    }
+}
+
+
+void HAMLIB_API rig_cache_invalidate_kind(RIG *rig, hamlib_cache_t kind)
+{
+    int i;
+
+    for (i = 0; i < HAMLIB_CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *s = &rig->state.cache.settings[i];
+
+        if (s->kind == kind)
+        {
+            s->kind = HAMLIB_CACHE_ALL;
+        }
+    }
+}
+
+
+/*
+ * Drop the entries which do not name a real VFO,
+ * their meaning changes with rig_set_vfo() and rig_set_split_vfo().
+ */
+void HAMLIB_API rig_cache_invalidate_curr(RIG *rig)
+{
+    int i;
+
+    for (i = 0; i < HAMLIB_CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *s = &rig->state.cache.settings[i];
+
+        switch (s->vfo)
+        {
+        case RIG_VFO_NONE:
+        case RIG_VFO_CURR:  /* same as RIG_VFO_RX */
+        case RIG_VFO_TX:
+        case RIG_VFO_MEM:
+        case RIG_VFO_VFO:
+            s->kind = HAMLIB_CACHE_ALL;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+/*
+ * Drop everything, for the calls which may change any setting
+ * like a band change or a memory recall.
+ */
+void HAMLIB_API rig_cache_invalidate_all(RIG *rig)
+{
+    int i;
+
+    for (i = 0; i < HAMLIB_CACHE_SETTINGS; i++)
+    {
+        rig->state.cache.settings[i].kind = HAMLIB_CACHE_ALL;
+    }
+}
+
+/*
+ * Publish the main cached items for rig_get_state_snapshot().
+ * Called by the thread doing the rig I/O each time it updates the cache;
+ * the sequence counter is odd while the copy is in progress so readers
+ * can detect a torn copy and retry, the writer never waits on them.
+ */
+void HAMLIB_API rig_cache_publish(RIG *rig)
+{
+    struct rig_state *rs = &rig->state;
+    struct rig_state_snapshot *snap = &rs->snapshot;
+    unsigned long seq = __atomic_load_n(&rs->snapshot_seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&rs->snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    snap->version = (seq + 2) / 2;
+    clock_gettime(CLOCK_REALTIME, &snap->time);
+    snap->vfo = rs->cache.vfo;
+    snap->freq = rs->cache.freq;
+    snap->vfo_freq = rs->cache.vfo_freq;
+    snap->freqMainA = rs->cache.freqMainA;
+    snap->freqMainB = rs->cache.freqMainB;
+    snap->mode = rs->cache.mode;
+    snap->width = rs->cache.width;
+    snap->vfo_mode = rs->cache.vfo_mode;
+    snap->ptt = rs->cache.ptt;
+    snap->split = rs->cache.split;
+    snap->split_vfo = rs->cache.split_vfo;
+    snap->satmode = rs->cache.satmode;
+
+    __atomic_store_n(&rs->snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * \brief get a consistent copy of the cached rig state
+ * \param rig   The rig handle
+ * \param snapshot  The location where to store the snapshot
+ *
+ *  Copies the last frequency, mode, PTT, split... values Hamlib has read
+ *  from or set to the rig, without any rig I/O and without locking.
+ *  It is safe to call from any thread, even while another one is
+ *  talking to the rig, and will never hold up that thread.
+ *  \a snapshot->version changes each time the cache gets updated, and
+ *  is 0 as long as nothing has been cached yet.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * \sa rig_get_cache_timeout_ms()
+ */
+int HAMLIB_API rig_get_state_snapshot(RIG *rig,
+                                      struct rig_state_snapshot *snapshot)
+{
+    struct rig_state *rs;
+    unsigned long seq1, seq2;
+
+    if (!rig || !snapshot)
+    {
+        return -RIG_EINVAL;
+    }
+
+    rs = &rig->state;
+
+    do
+    {
+        seq1 = __atomic_load_n(&rs->snapshot_seq, __ATOMIC_ACQUIRE);
+
+        memcpy(snapshot, &rs->snapshot, sizeof(*snapshot));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&rs->snapshot_seq, __ATOMIC_RELAXED);
+    }
+    while ((seq1 & 1) || seq1 != seq2);
+
+    return RIG_OK;
+}
+
+/** @} */
@@ -0,0 +1,52 @@
+/*
+ *  Hamlib Interface - settings cache header
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H 1
+
+#include <hamlib/rig.h>
+
+__BEGIN_DECLS
+
+/* Hamlib internal use, see cache.c */
+extern HAMLIB_EXPORT(struct rig_cache_setting *)
+rig_cache_find(RIG *rig, hamlib_cache_t kind, vfo_t vfo, setting_t id);
+
+extern HAMLIB_EXPORT(struct rig_cache_setting *)
+rig_cache_store(RIG *rig, hamlib_cache_t kind, vfo_t vfo, setting_t id,
+                value_t val);
+
+extern HAMLIB_EXPORT(void) rig_cache_invalidate(RIG *rig,
+                                                hamlib_cache_t kind,
+                                                setting_t id);
+
+extern HAMLIB_EXPORT(void) rig_cache_invalidate_kind(RIG *rig,
+                                                     hamlib_cache_t kind);
+
+extern HAMLIB_EXPORT(void) rig_cache_invalidate_curr(RIG *rig);
+
+extern HAMLIB_EXPORT(void) rig_cache_invalidate_all(RIG *rig);
+
+extern HAMLIB_EXPORT(void) rig_cache_publish(RIG *rig);
+
+__END_DECLS
+
+#endif /* _CACHE_H */
@@ -42,6 +42,8 @@
 
 #include <hamlib/rig.h>
 #include "token.h"
+#include "trace.h"
+#include "adaptive.h"
 
 
 /*
@@ -143,6 +145,42 @@ static const struct confparams frontend_cfg_params[] =
         "True enables ptt port to be shared with other apps",
         "0", RIG_CONF_CHECKBUTTON, { }
     },
+    {
+        TOK_TRACE_FILE, "trace_file", "Trace file",
+        "File receiving a binary trace of the rig port I/O, see rigtrace(1)",
+        "", RIG_CONF_STRING,
+    },
+    {
+        TOK_REPLAY_FILE, "replay_file", "Replay file",
+        "Trace file replayed in place of the rig, see trace_file",
+        "", RIG_CONF_STRING,
+    },
+    {
+        TOK_REPLAY_TIMING, "replay_timing", "Replay timing",
+        "True replays the answers at the recorded pace instead of at once",
+        "0", RIG_CONF_CHECKBUTTON, { }
+    },
+    {
+        TOK_ADAPTIVE_TIMEOUT, "adaptive_timeout", "Adaptive timeout",
+        "True learns the timeout of each command from the rig answers, "
+        "within timeout_min and timeout_max",
+        "0", RIG_CONF_CHECKBUTTON, { }
+    },
+    {
+        TOK_TIMEOUT_MIN, "timeout_min", "Min adaptive timeout",
+        "Lowest adaptive timeout in ms",
+        "0", RIG_CONF_NUMERIC, { .n = { 0, 10000, 1 } }
+    },
+    {
+        TOK_TIMEOUT_MAX, "timeout_max", "Max adaptive timeout",
+        "Highest adaptive timeout in ms, 0 for timeout",
+        "0", RIG_CONF_NUMERIC, { .n = { 0, 10000, 1 } }
+    },
+    {
+        TOK_TIMEOUT_LEARNED, "timeout_learned", "Learned timeouts",
+        "Adaptive timeouts in ms by command, setting it starts over",
+        "", RIG_CONF_STRING,
+    },
 
     { RIG_CONF_END, NULL, }
 };
@@ -594,6 +632,53 @@ static int frontend_set_conf(RIG *rig, token_t token, const char *val)
         rs->ptt_share = val_i ? 1 : 0;
         break;
 
+    case TOK_TRACE_FILE:
+        return trace_open(&rs->rigport, val, rig->caps->rig_model);
+
+    case TOK_REPLAY_FILE:
+        rs->rigport.type.rig = RIG_PORT_REPLAY;
+        strncpy(rs->rigport.pathname, val, FILPATHLEN - 1);
+        break;
+
+    case TOK_REPLAY_TIMING:
+        if (1 != sscanf(val, "%d", &val_i))
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        rs->rigport.replay.timing = val_i ? 1 : 0;
+        break;
+
+    case TOK_ADAPTIVE_TIMEOUT:
+        if (1 != sscanf(val, "%d", &val_i))
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        return adaptive_enable(&rs->rigport, val_i);
+
+    case TOK_TIMEOUT_MIN:
+        if (1 != sscanf(val, "%d", &val_i) || val_i < 0)
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        rs->rigport.adaptive.min = val_i;
+        break;
+
+    case TOK_TIMEOUT_MAX:
+        if (1 != sscanf(val, "%d", &val_i) || val_i < 0)
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        rs->rigport.adaptive.max = val_i;
+        break;
+
+    case TOK_TIMEOUT_LEARNED:
+        adaptive_reset(&rs->rigport);
+        break;
+
 
     default:
         return -RIG_EINVAL;
@@ -899,6 +984,35 @@ static int frontend_get_conf(RIG *rig, token_t token, char *val)
         strcpy(val, rs->dcdport.pathname);
         break;
 
+    case TOK_TRACE_FILE:
+        strcpy(val, trace_pathname(&rs->rigport));
+        break;
+
+    case TOK_REPLAY_FILE:
+        strcpy(val, rs->rigport.type.rig == RIG_PORT_REPLAY ?
+               rs->rigport.pathname : "");
+        break;
+
+    case TOK_REPLAY_TIMING:
+        sprintf(val, "%d", rs->rigport.replay.timing);
+        break;
+
+    case TOK_ADAPTIVE_TIMEOUT:
+        sprintf(val, "%d", rs->rigport.adaptive.state != NULL);
+        break;
+
+    case TOK_TIMEOUT_MIN:
+        sprintf(val, "%d", rs->rigport.adaptive.min);
+        break;
+
+    case TOK_TIMEOUT_MAX:
+        sprintf(val, "%d", rs->rigport.adaptive.max);
+        break;
+
+    case TOK_TIMEOUT_LEARNED:
+        adaptive_learned(&rs->rigport, val, 128);
+        break;
+
     case TOK_LO_FREQ:
         sprintf(val, "%g", rs->lo_freq);
         break;
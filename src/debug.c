@@ -44,6 +44,10 @@
 #include <unistd.h>
 #include <time.h>
 
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
 #ifdef ANDROID
 #  include <android/log.h>
 #endif
@@ -63,6 +67,53 @@ static FILE *rig_debug_stream;
 static vprintf_cb_t rig_vprintf_cb;
 static rig_ptr_t rig_vprintf_arg;
 
+#ifdef HAVE_PTHREAD
+/*
+ * Asynchronous output, see rig_set_debug_async().
+ *
+ * Each thread formats its messages into a ring buffer of its own, which
+ * a logger thread empties into the debug stream.  A ring has a single
+ * producer, its thread, and a single consumer, whoever holds
+ * debug_lock, so head and tail are enough to share it.  Messages carry
+ * a global sequence number to be written in the order they were made.
+ * Producers never take debug_lock: new rings are pushed on the list
+ * with a compare and swap, and the logger is woken through wake_lock.
+ */
+#define DEBUG_RING_SIZE (64 * 1024)     /* per thread, a power of 2 */
+#define DEBUG_RING_MASK (DEBUG_RING_SIZE - 1)
+#define DEBUG_MSG_MAX   1024            /* longer messages are truncated */
+#define DEBUG_FLUSH_MS  20              /* logger thread period */
+
+struct debug_ring
+{
+    struct debug_ring *next;
+    uint64_t head;          /* written by the producer */
+    uint64_t tail;          /* written by the consumer */
+    unsigned dropped;       /* messages which did not fit */
+    unsigned dropped_seen;  /* consumer only */
+    int dead;               /* the thread has exited */
+    unsigned char buf[DEBUG_RING_SIZE];
+};
+
+/* record header, followed by the message text */
+struct debug_rec
+{
+    uint64_t seq;
+    uint16_t len;
+};
+
+static int debug_async;
+static uint64_t debug_seq;
+static struct debug_ring *debug_rings;
+static pthread_key_t debug_key;
+static pthread_once_t debug_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t debug_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t debug_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t debug_thread;
+static int debug_thread_stop;
+#endif
+
 extern HAMLIB_EXPORT(void) dump_hex(const unsigned char ptr[], size_t size);
 
 /**
@@ -162,6 +213,334 @@ char *date_strget(char *buf, int buflen)
 }
 //! @endcond
 
+#ifdef HAVE_PTHREAD
+static void debug_ring_get(const struct debug_ring *ring, uint64_t pos,
+                           void *dst, size_t len)
+{
+    size_t off = pos & DEBUG_RING_MASK;
+    size_t first = len < DEBUG_RING_SIZE - off ? len : DEBUG_RING_SIZE - off;
+
+    memcpy(dst, ring->buf + off, first);
+    memcpy((char *)dst + first, ring->buf, len - first);
+}
+
+
+static void debug_ring_put(struct debug_ring *ring, uint64_t pos,
+                           const void *src, size_t len)
+{
+    size_t off = pos & DEBUG_RING_MASK;
+    size_t first = len < DEBUG_RING_SIZE - off ? len : DEBUG_RING_SIZE - off;
+
+    memcpy(ring->buf + off, src, first);
+    memcpy(ring->buf, (const char *)src + first, len - first);
+}
+
+
+/*
+ * Write out the messages of all the rings, oldest first.
+ * Must be called with debug_lock held.
+ */
+static void debug_drain(void)
+{
+    /* stderr is unbuffered, write in large chunks */
+    static char out[16 * DEBUG_MSG_MAX];
+    size_t outlen = 0;
+    FILE *stream = rig_debug_stream ? rig_debug_stream : stderr;
+    struct debug_ring **pring;
+    int written = 0;
+
+    for (;;)
+    {
+        struct debug_ring *ring, *oldest = NULL;
+        struct debug_rec rec, oldest_rec;
+
+        for (ring = debug_rings; ring; ring = ring->next)
+        {
+            if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail)
+            {
+                continue;
+            }
+
+            debug_ring_get(ring, ring->tail, &rec, sizeof(rec));
+
+            if (!oldest || rec.seq < oldest_rec.seq)
+            {
+                oldest = ring;
+                oldest_rec = rec;
+            }
+        }
+
+        if (!oldest)
+        {
+            break;
+        }
+
+        if (outlen + oldest_rec.len > sizeof(out))
+        {
+            fwrite(out, 1, outlen, stream);
+            outlen = 0;
+        }
+
+        debug_ring_get(oldest, oldest->tail + sizeof(rec), out + outlen,
+                       oldest_rec.len);
+        outlen += oldest_rec.len;
+        written = 1;
+
+        __atomic_store_n(&oldest->tail,
+                         oldest->tail + sizeof(rec) + oldest_rec.len,
+                         __ATOMIC_RELEASE);
+    }
+
+    fwrite(out, 1, outlen, stream);
+
+    for (pring = &debug_rings; __atomic_load_n(pring, __ATOMIC_ACQUIRE);)
+    {
+        struct debug_ring *ring = __atomic_load_n(pring, __ATOMIC_ACQUIRE);
+        unsigned dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+
+        if (dropped != ring->dropped_seen)
+        {
+            fprintf(stream, "rig_debug: %u messages dropped\n",
+                    dropped - ring->dropped_seen);
+            ring->dropped_seen = dropped;
+            written = 1;
+        }
+
+        /*
+         * A dead thread cannot add anything after its last message.
+         * New threads push their ring at the list head meanwhile, so
+         * only the head needs a compare and swap, the other links are
+         * ours.  When it fails, look again at what is the head now.
+         */
+        if (__atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE)
+                && __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail)
+        {
+            struct debug_ring *expected = ring;
+
+            if (pring != &debug_rings)
+            {
+                *pring = ring->next;
+                free(ring);
+            }
+            else if (__atomic_compare_exchange_n(&debug_rings, &expected, ring->next,
+                                                 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                free(ring);
+            }
+
+            continue;
+        }
+
+        pring = &ring->next;
+    }
+
+    if (written)
+    {
+        fflush(stream);
+    }
+}
+
+
+static void *debug_logger(void *arg)
+{
+    int stop = 0;
+
+    while (!stop)
+    {
+        struct timeval tv;
+        struct timespec ts;
+
+        gettimeofday(&tv, NULL);
+        ts.tv_sec = tv.tv_sec;
+        ts.tv_nsec = tv.tv_usec * 1000 + DEBUG_FLUSH_MS * 1000000L;
+
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&wake_lock);
+
+        if (!debug_thread_stop)
+        {
+            pthread_cond_timedwait(&debug_cond, &wake_lock, &ts);
+        }
+
+        stop = debug_thread_stop;
+        pthread_mutex_unlock(&wake_lock);
+
+        pthread_mutex_lock(&debug_lock);
+        debug_drain();
+        pthread_mutex_unlock(&debug_lock);
+    }
+
+    return NULL;
+}
+
+
+/* thread exit: the logger frees the ring once it is empty */
+static void debug_ring_release(void *arg)
+{
+    struct debug_ring *ring = arg;
+
+    __atomic_store_n(&ring->dead, 1, __ATOMIC_RELEASE);
+}
+
+
+static void debug_atexit(void)
+{
+    pthread_mutex_lock(&debug_lock);
+    debug_drain();
+    pthread_mutex_unlock(&debug_lock);
+}
+
+
+static void debug_init(void)
+{
+    pthread_key_create(&debug_key, debug_ring_release);
+    atexit(debug_atexit);
+}
+
+
+/*
+ * Format a message into the ring of the calling thread,
+ * dropping it if the ring is full.
+ */
+static void debug_async_vprintf(const char *fmt, va_list ap)
+{
+    struct debug_ring *ring = pthread_getspecific(debug_key);
+    struct debug_rec rec;
+    char text[DEBUG_MSG_MAX];
+    uint64_t head, tail;
+    int len = 0;
+
+    if (!ring)
+    {
+        ring = calloc(1, sizeof(struct debug_ring));
+
+        if (!ring)
+        {
+            return;
+        }
+
+        pthread_setspecific(debug_key, ring);
+
+        ring->next = __atomic_load_n(&debug_rings, __ATOMIC_ACQUIRE);
+
+        while (!__atomic_compare_exchange_n(&debug_rings, &ring->next, ring, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+        }
+    }
+
+    if (rig_debug_time_stamp)
+    {
+        char buf[256];
+
+        len = snprintf(text, sizeof(text), "%s: ", date_strget(buf, sizeof(buf)));
+    }
+
+    len += vsnprintf(text + len, sizeof(text) - len, fmt, ap);
+
+    if (len >= sizeof(text))
+    {
+        len = sizeof(text) - 1;
+    }
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (DEBUG_RING_SIZE - (head - tail) < sizeof(rec) + len)
+    {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    rec.seq = __atomic_fetch_add(&debug_seq, 1, __ATOMIC_RELAXED);
+    rec.len = len;
+
+    debug_ring_put(ring, head, &rec, sizeof(rec));
+    debug_ring_put(ring, head + sizeof(rec), text, len);
+    head += sizeof(rec) + len;
+
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+    /* the logger wakes up on its own, unless the ring fills up fast */
+    if (head - tail > DEBUG_RING_SIZE / 4)
+    {
+        pthread_mutex_lock(&wake_lock);
+        pthread_cond_signal(&debug_cond);
+        pthread_mutex_unlock(&wake_lock);
+    }
+}
+#endif
+
+
+/**
+ * \param flag
+ * \brief Enable/disable asynchronous debug output
+ *
+ * When enabled, rig_debug() only formats the message into a buffer of
+ * the calling thread and returns, the messages being written to the
+ * debug stream by a logger thread in the order they were made.  Threads
+ * logging heavily thus neither wait on the stream nor on each other.
+ * A message which finds its thread's buffer full is dropped, the number
+ * of dropped messages being reported in the output.
+ *
+ * Messages handled by a rig_set_debug_callback() callback are not
+ * affected, the callback is still called by the thread of rig_debug().
+ *
+ * \return RIG_OK, or -RIG_ENIMPL without thread support
+ */
+int HAMLIB_API rig_set_debug_async(int flag)
+{
+#ifdef HAVE_PTHREAD
+    int retval = RIG_OK;
+
+    pthread_once(&debug_once, debug_init);
+
+    pthread_mutex_lock(&debug_lock);
+
+    if (flag && !debug_async)
+    {
+        debug_thread_stop = 0;
+
+        if (pthread_create(&debug_thread, NULL, debug_logger, NULL) == 0)
+        {
+            __atomic_store_n(&debug_async, 1, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            retval = -RIG_EINTERNAL;
+        }
+
+        pthread_mutex_unlock(&debug_lock);
+    }
+    else if (!flag && debug_async)
+    {
+        __atomic_store_n(&debug_async, 0, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&debug_lock);
+
+        pthread_mutex_lock(&wake_lock);
+        debug_thread_stop = 1;
+        pthread_cond_signal(&debug_cond);
+        pthread_mutex_unlock(&wake_lock);
+
+        pthread_join(debug_thread, NULL);
+    }
+    else
+    {
+        pthread_mutex_unlock(&debug_lock);
+    }
+
+    return retval;
+#else
+    return flag ? -RIG_ENIMPL : RIG_OK;
+#endif
+}
+
+
 /**
  * \param debug_level
  * \param fmt
@@ -185,6 +564,14 @@ void HAMLIB_API rig_debug(enum rig_debug_level_e debug_level,
     {
         rig_vprintf_cb(debug_level, rig_vprintf_arg, fmt, ap);
     }
+
+#ifdef HAVE_PTHREAD
+    else if (__atomic_load_n(&debug_async, __ATOMIC_ACQUIRE))
+    {
+        debug_async_vprintf(fmt, ap);
+    }
+
+#endif
     else
     {
         if (!rig_debug_stream)
@@ -294,10 +681,21 @@ vprintf_cb_t HAMLIB_API rig_set_debug_callback(vprintf_cb_t cb, rig_ptr_t arg)
  */
 FILE *HAMLIB_API rig_set_debug_file(FILE *stream)
 {
-    FILE *prev_stream = rig_debug_stream;
+    FILE *prev_stream;
+
+#ifdef HAVE_PTHREAD
+    /* pending messages go to the stream in use when they were made */
+    pthread_mutex_lock(&debug_lock);
+    debug_drain();
+#endif
 
+    prev_stream = rig_debug_stream;
     rig_debug_stream = stream;
 
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&debug_lock);
+#endif
+
     return prev_stream;
 }
 
@@ -59,16 +59,580 @@
 
 #include <hamlib/rig.h>
 #include "event.h"
+#include "misc.h"
+#include "iofunc.h"
+
+#if defined(HAVE_PTHREAD) && !defined(_WIN32)
+#  define HAVE_TRN_THREAD 1
+#  include <pthread.h>
+#  ifdef HAVE_SYS_EVENTFD_H
+#    include <sys/eventfd.h>
+#  endif
+#endif
+
+#if defined(WIN32) && !defined(HAVE_TERMIOS_H)
+#  include "win32termios.h"
+#  define select win32_serial_select
+#endif
+
+#ifndef DOC_HIDDEN
+
+#define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !(r)->state.comm_state)
+
+
+#if defined(HAVE_TRN_THREAD) || defined(HAVE_SIGACTION)
+/*
+ * Read the state of a rig in RIG_TRN_POLL mode and call the event
+ * callbacks for what changed.  The caller holds the decoder.
+ */
+static int poll_rig_state(RIG *rig)
+{
+    struct rig_state *rs = &rig->state;
+    int retval;
+
+    if (rig->caps->get_vfo && rig->callbacks.vfo_event)
+    {
+        vfo_t vfo = RIG_VFO_CURR;
+
+        retval = rig->caps->get_vfo(rig, &vfo);
+
+        if (retval == RIG_OK)
+        {
+            if (vfo != rs->current_vfo)
+            {
+                rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
+            }
+
+            rs->current_vfo = vfo;
+        }
+    }
+
+    if (rig->caps->get_freq && rig->callbacks.freq_event)
+    {
+        freq_t freq;
+
+        retval = rig->caps->get_freq(rig, RIG_VFO_CURR, &freq);
+
+        if (retval == RIG_OK)
+        {
+            if (freq != rs->current_freq)
+            {
+                rig->callbacks.freq_event(rig,
+                                          RIG_VFO_CURR,
+                                          freq,
+                                          rig->callbacks.freq_arg);
+            }
+
+            rs->current_freq = freq;
+        }
+    }
+
+    if (rig->caps->get_mode && rig->callbacks.mode_event)
+    {
+        rmode_t rmode;
+        pbwidth_t width;
+
+        retval = rig->caps->get_mode(rig, RIG_VFO_CURR, &rmode, &width);
+
+        if (retval == RIG_OK)
+        {
+            if (rmode != rs->current_mode || width != rs->current_width)
+            {
+                rig->callbacks.mode_event(rig,
+                                          RIG_VFO_CURR,
+                                          rmode,
+                                          width,
+                                          rig->callbacks.mode_arg);
+            }
+
+            rs->current_mode = rmode;
+            rs->current_width = width;
+        }
+    }
+
+    return RIG_OK;
+}
+#endif
+
+
+#ifdef HAVE_TRN_THREAD
+
+/*
+ * Transceive event thread
+ *
+ * Each rig in RIG_TRN_RIG or RIG_TRN_POLL mode gets its own thread
+ * watching the port, or ticking every poll_interval, instead of the
+ * process wide SIGIO and SIGALRM handlers.  Several rigs can be open at
+ * once, and decode_event() and the callbacks never run in signal context.
+ *
+ * By default the thread does the decoding or polling itself, holding
+ * the decoder while it does.  Once the application asked for the event
+ * fd with rig_get_event_fd(), the thread only makes that fd readable
+ * and the work is done by rig_process_events(), from the application
+ * thread polling the fd.
+ */
+
+#define TRN_MAX_FRAMES 16   /* decode_event() calls per wake up */
+
+struct trn_engine
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* posted, stop and hold_decode changes */
+    int running;
+    int mode;               /* RIG_TRN_RIG or RIG_TRN_POLL */
+    int stop;
+    int wake[2];            /* wakes the thread up to stop */
+    int event_fd[2];        /* read end handed to the application */
+    int app_driven;         /* rig_get_event_fd() was called */
+    int posted;             /* event fd readable, rig_process_events() due */
+};
+
+
+static struct trn_engine *trn_engine_get(RIG *rig)
+{
+    struct trn_engine *trn = rig->state.trn_engine;
+
+    if (trn)
+    {
+        return trn;
+    }
+
+    trn = calloc(1, sizeof(struct trn_engine));
+
+    if (!trn)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_init(&trn->lock, NULL);
+    pthread_cond_init(&trn->cond, NULL);
+    trn->wake[0] = trn->wake[1] = -1;
+    trn->event_fd[0] = trn->event_fd[1] = -1;
+
+    rig->state.trn_engine = trn;
+
+    return trn;
+}
+
+
+static int trn_is_engine_thread(RIG *rig)
+{
+    struct trn_engine *trn = rig->state.trn_engine;
+
+    return trn && trn->running && pthread_equal(pthread_self(), trn->thread);
+}
+
+
+/* returns 1 when the thread got hold of the decoder */
+static int trn_hold(RIG *rig)
+{
+    int expected = 0;
+
+    return __atomic_compare_exchange_n(&rig->state.hold_decode, &expected, 2, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+
+static void trn_unhold(RIG *rig)
+{
+    struct trn_engine *trn = rig->state.trn_engine;
+    int expected = 2;
+
+    __atomic_compare_exchange_n(&rig->state.hold_decode, &expected, 0, 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+    /* a transaction may be waiting in rig_hold_decode() */
+    pthread_mutex_lock(&trn->lock);
+    pthread_cond_broadcast(&trn->cond);
+    pthread_mutex_unlock(&trn->lock);
+}
+
+
+/*
+ * Sleep until hold_decode is no longer held by the given owner, 1 for
+ * a transaction, 2 for the event thread.  Whoever releases it
+ * broadcasts trn->cond.
+ */
+static void trn_wait_unhold(struct trn_engine *trn, RIG *rig, int owner)
+{
+    pthread_mutex_lock(&trn->lock);
+
+    while (__atomic_load_n(&rig->state.hold_decode, __ATOMIC_ACQUIRE) == owner
+            && !trn->stop)
+    {
+        pthread_cond_wait(&trn->cond, &trn->lock);
+    }
+
+    pthread_mutex_unlock(&trn->lock);
+}
+
+
+/* decode the unsolicited frames waiting on the port */
+static void trn_decode(RIG *rig)
+{
+    int i;
+
+    if (!rig->caps->decode_event)
+    {
+        port_rxbuf_flush(&rig->state.rigport);
+        return;
+    }
+
+    for (i = 0; i < TRN_MAX_FRAMES && port_rx_pending(&rig->state.rigport); i++)
+    {
+        rig->caps->decode_event(rig);
+    }
+}
+
+
+/* make the event fd readable, the application will call rig_process_events() */
+static void trn_post(struct trn_engine *trn)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+#else
+    char one = 0;
+#endif
+
+    pthread_mutex_lock(&trn->lock);
+    trn->posted = 1;
+    pthread_mutex_unlock(&trn->lock);
+
+    if (write(trn->event_fd[1], &one, sizeof(one)) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: write: %s\n", __func__, strerror(errno));
+    }
+}
+
+
+static void *trn_thread(void *arg)
+{
+    RIG *rig = (RIG *)arg;
+    struct trn_engine *trn = rig->state.trn_engine;
+    int fd = rig->state.rigport.fd;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: started, mode=%d\n", __func__, trn->mode);
+
+    for (;;)
+    {
+        fd_set rfds;
+        struct timeval tv;
+        int maxfd = trn->wake[0];
+        int retval;
+
+        pthread_mutex_lock(&trn->lock);
+
+        /* one rig_process_events() at a time */
+        while (trn->posted && !trn->stop)
+        {
+            pthread_cond_wait(&trn->cond, &trn->lock);
+        }
+
+        if (trn->stop)
+        {
+            pthread_mutex_unlock(&trn->lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&trn->lock);
+
+        FD_ZERO(&rfds);
+        FD_SET(trn->wake[0], &rfds);
+
+        if (trn->mode == RIG_TRN_RIG)
+        {
+            FD_SET(fd, &rfds);
+            maxfd = fd > maxfd ? fd : maxfd;
+
+            /* bytes left in the port buffer do not wake select() up */
+            tv.tv_sec = 0;
+            tv.tv_usec = 0;
+        }
+        else
+        {
+            tv.tv_sec = rig->state.poll_interval / 1000;
+            tv.tv_usec = (rig->state.poll_interval % 1000) * 1000;
+        }
+
+        retval = select(maxfd + 1, &rfds, NULL, NULL,
+                        (trn->mode != RIG_TRN_RIG
+                         || rig->state.rigport.rxbuf.tail > rig->state.rigport.rxbuf.head)
+                        ? &tv : NULL);
+
+        if (retval < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            rig_debug(RIG_DEBUG_ERR, "%s: select: %s\n", __func__, strerror(errno));
+            break;
+        }
+
+        if (FD_ISSET(trn->wake[0], &rfds))
+        {
+            char buf[16];
+
+            if (read(trn->wake[0], buf, sizeof(buf)) < 0) {}
+
+            continue;
+        }
+
+        if (trn->mode == RIG_TRN_RIG && !port_rx_pending(&rig->state.rigport))
+        {
+            continue;
+        }
+
+        /*
+         * Do not disturb, the backend is currently receiving data,
+         * most likely the reply to its command
+         */
+        if (__atomic_load_n(&rig->state.hold_decode, __ATOMIC_ACQUIRE))
+        {
+            trn_wait_unhold(trn, rig, 1);
+            continue;
+        }
+
+        if (trn->app_driven)
+        {
+            trn_post(trn);
+            continue;
+        }
+
+        if (!trn_hold(rig))
+        {
+            continue;
+        }
+
+        if (trn->mode == RIG_TRN_RIG)
+        {
+            trn_decode(rig);
+        }
+        else
+        {
+            poll_rig_state(rig);
+        }
+
+        trn_unhold(rig);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: stopped\n", __func__);
+
+    return NULL;
+}
+
+
+static int trn_start(RIG *rig, int mode)
+{
+    struct trn_engine *trn;
+    int retval;
+
+    if (rig->state.rigport.fd < 0)
+    {
+        return -RIG_EINVAL;
+    }
+
+    trn = trn_engine_get(rig);
+
+    if (!trn)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    if (trn->running)
+    {
+        return -RIG_EINTERNAL;
+    }
+
+    if (pipe(trn->wake) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pipe: %s\n", __func__, strerror(errno));
+        return -RIG_EINTERNAL;
+    }
+
+    trn->mode = mode;
+    trn->stop = 0;
+    trn->posted = 0;
+
+    retval = pthread_create(&trn->thread, NULL, trn_thread, rig);
+
+    if (retval != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__,
+                  strerror(retval));
+        close(trn->wake[0]);
+        close(trn->wake[1]);
+        return -RIG_EINTERNAL;
+    }
+
+    trn->running = 1;
+
+    return RIG_OK;
+}
+
+
+static int trn_stop(RIG *rig)
+{
+    struct trn_engine *trn = rig->state.trn_engine;
+    char c = 0;
+
+    if (!trn || !trn->running)
+    {
+        return RIG_OK;
+    }
+
+    pthread_mutex_lock(&trn->lock);
+    trn->stop = 1;
+    pthread_cond_broadcast(&trn->cond);
+    pthread_mutex_unlock(&trn->lock);
+
+    if (write(trn->wake[1], &c, 1) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: write: %s\n", __func__, strerror(errno));
+    }
+
+    pthread_join(trn->thread, NULL);
+    trn->running = 0;
+
+    close(trn->wake[0]);
+    close(trn->wake[1]);
+    trn->wake[0] = trn->wake[1] = -1;
+
+    return RIG_OK;
+}
+
+
+/*
+ * add_trn_rig
+ * not exported in Hamlib API.
+ * Assumes rig->caps->transceive == RIG_TRN_RIG
+ */
+int add_trn_rig(RIG *rig)
+{
+    return trn_start(rig, RIG_TRN_RIG);
+}
+
+
+/*
+ * remove_trn_rig
+ * not exported in Hamlib API.
+ * Assumes rig->caps->transceive == RIG_TRN_RIG
+ */
+int remove_trn_rig(RIG *rig)
+{
+    return trn_stop(rig);
+}
+
+
+/*
+ * add_trn_poll_rig
+ * not exported in Hamlib API.
+ */
+static int add_trn_poll_rig(RIG *rig)
+{
+    return trn_start(rig, RIG_TRN_POLL);
+}
+
+
+/*
+ * remove_trn_poll_rig
+ * not exported in Hamlib API.
+ */
+static int remove_trn_poll_rig(RIG *rig)
+{
+    return trn_stop(rig);
+}
+
+
+/*
+ * cleanup_trn_rig
+ * not exported in Hamlib API.
+ * Releases what the event thread used, called by rig_cleanup()
+ */
+void cleanup_trn_rig(RIG *rig)
+{
+    struct trn_engine *trn = rig->state.trn_engine;
 
-#if defined(WIN32) && !defined(HAVE_TERMIOS_H)
-#  include "win32termios.h"
-#  define select win32_serial_select
-#endif
+    if (!trn)
+    {
+        return;
+    }
 
-#ifndef DOC_HIDDEN
+    trn_stop(rig);
 
-#define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !(r)->state.comm_state)
+    if (trn->event_fd[0] >= 0)
+    {
+        close(trn->event_fd[0]);
+
+        if (trn->event_fd[1] != trn->event_fd[0])
+        {
+            close(trn->event_fd[1]);
+        }
+    }
+
+    pthread_mutex_destroy(&trn->lock);
+    pthread_cond_destroy(&trn->cond);
+    free(trn);
+    rig->state.trn_engine = NULL;
+}
+
+
+/*
+ * Hold_Decode()/Unhold_Decode(), keep the event thread off the port
+ * while a transaction is under way.  A transaction started by
+ * decode_event() or the polling, in the event thread, is already held.
+ */
+void HAMLIB_API rig_hold_decode(RIG *rig)
+{
+    int expected = 0;
+
+    if (trn_is_engine_thread(rig))
+    {
+        return;
+    }
+
+    while (!__atomic_compare_exchange_n(&rig->state.hold_decode, &expected, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        if (expected == 1)
+        {
+            return;     /* held already */
+        }
+
+        /* the event thread is decoding */
+        trn_wait_unhold(rig->state.trn_engine, rig, 2);
+        expected = 0;
+    }
+}
+
+
+void HAMLIB_API rig_unhold_decode(RIG *rig)
+{
+    int expected = 1;
+
+    if (trn_is_engine_thread(rig))
+    {
+        return;
+    }
+
+    if (__atomic_compare_exchange_n(&rig->state.hold_decode, &expected, 0, 0,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+        struct trn_engine *trn = rig->state.trn_engine;
+
+        /* the event thread may be waiting for us */
+        if (trn && trn->running)
+        {
+            pthread_mutex_lock(&trn->lock);
+            pthread_cond_broadcast(&trn->cond);
+            pthread_mutex_unlock(&trn->lock);
+        }
+    }
+}
 
+#else   /* !HAVE_TRN_THREAD */
 
 #ifdef HAVE_SIGACTION
 static struct sigaction hamlib_trn_oldact, hamlib_trn_poll_oldact;
@@ -224,8 +788,9 @@ int remove_trn_rig(RIG *rig)
  */
 static int add_trn_poll_rig(RIG *rig)
 {
-#ifdef HAVE_SIGACTION
+#ifdef HAVE_SETITIMER
     struct sigaction act;
+    struct itimerval value;
     int status;
 
     /*
@@ -252,11 +817,27 @@ static int add_trn_poll_rig(RIG *rig)
                   strerror(errno));
     }
 
+    /* install handler here */
+    value.it_value.tv_sec = 0;
+    value.it_value.tv_usec = rig->state.poll_interval * 1000;
+    value.it_interval.tv_sec = 0;
+    value.it_interval.tv_usec = rig->state.poll_interval * 1000;
+
+    if (setitimer(ITIMER_REAL, &value, NULL) == -1)
+    {
+        rig_debug(RIG_DEBUG_ERR,
+                  "%s: setitimer: %s\n",
+                  __func__,
+                  strerror(errno));
+        sigaction(SIGALRM, &hamlib_trn_poll_oldact, NULL);
+        return -RIG_EINTERNAL;
+    }
+
     return RIG_OK;
 
 #else
-    return -RIG_ENIMPL;
-#endif  /* !HAVE_SIGINFO */
+    return -RIG_ENAVAIL;
+#endif  /* !HAVE_SETITIMER */
 }
 
 
@@ -266,24 +847,26 @@ static int add_trn_poll_rig(RIG *rig)
  */
 static int remove_trn_poll_rig(RIG *rig)
 {
-#ifdef HAVE_SIGINFO
-    int status;
+#ifdef HAVE_SETITIMER
+    struct itimerval value;
 
-    status = sigaction(SIGALRM, &hamlib_trn_poll_oldact, NULL);
+    memset(&value, 0, sizeof(value));
 
-    if (status < 0)
+    if (setitimer(ITIMER_REAL, &value, NULL) == -1)
     {
-        rig_debug(RIG_DEBUG_ERR,
-                  "%s sigaction failed: %s\n",
+        rig_debug(RIG_DEBUG_ERR, "%s: setitimer: %s\n",
                   __func__,
                   strerror(errno));
+        return -RIG_EINTERNAL;
     }
 
+    sigaction(SIGALRM, &hamlib_trn_poll_oldact, NULL);
+
     return RIG_OK;
 
 #else
-    return -RIG_ENIMPL;
-#endif  /* !HAVE_SIGINFO */
+    return -RIG_ENAVAIL;
+#endif  /* !HAVE_SETITIMER */
 }
 
 
@@ -367,9 +950,6 @@ static int search_rig_and_decode(RIG *rig, rig_ptr_t data)
  */
 static int search_rig_and_poll(RIG *rig, rig_ptr_t data)
 {
-    struct rig_state *rs = &rig->state;
-    int retval;
-
     if (rig->state.transceive != RIG_TRN_POLL)
     {
         return -1;
@@ -385,65 +965,7 @@ static int search_rig_and_poll(RIG *rig, rig_ptr_t data)
 
     rig->state.hold_decode = 2;
 
-    if (rig->caps->get_vfo && rig->callbacks.vfo_event)
-    {
-        vfo_t vfo = RIG_VFO_CURR;
-
-        retval = rig->caps->get_vfo(rig, &vfo);
-
-        if (retval == RIG_OK)
-        {
-            if (vfo != rs->current_vfo)
-            {
-                rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
-            }
-
-            rs->current_vfo = vfo;
-        }
-    }
-
-    if (rig->caps->get_freq && rig->callbacks.freq_event)
-    {
-        freq_t freq;
-
-        retval = rig->caps->get_freq(rig, RIG_VFO_CURR, &freq);
-
-        if (retval == RIG_OK)
-        {
-            if (freq != rs->current_freq)
-            {
-                rig->callbacks.freq_event(rig,
-                                          RIG_VFO_CURR,
-                                          freq,
-                                          rig->callbacks.freq_arg);
-            }
-
-            rs->current_freq = freq;
-        }
-    }
-
-    if (rig->caps->get_mode && rig->callbacks.mode_event)
-    {
-        rmode_t rmode;
-        pbwidth_t width;
-
-        retval = rig->caps->get_mode(rig, RIG_VFO_CURR, &rmode, &width);
-
-        if (retval == RIG_OK)
-        {
-            if (rmode != rs->current_mode || width != rs->current_width)
-            {
-                rig->callbacks.mode_event(rig,
-                                          RIG_VFO_CURR,
-                                          rmode,
-                                          width,
-                                          rig->callbacks.mode_arg);
-            }
-
-            rs->current_mode = rmode;
-            rs->current_width = width;
-        }
-    }
+    poll_rig_state(rig);
 
     rig->state.hold_decode = 0;
 
@@ -504,7 +1026,43 @@ static void sa_sigalrmhandler(int signum)
 
 #endif /* !HAVE_SIGINFO_T */
 
-#endif /* HAVE_SIGINFO */
+#else   /* !HAVE_SIGACTION */
+
+static int add_trn_poll_rig(RIG *rig)
+{
+    return -RIG_ENAVAIL;
+}
+
+
+static int remove_trn_poll_rig(RIG *rig)
+{
+    return -RIG_ENAVAIL;
+}
+
+#endif  /* !HAVE_SIGACTION */
+
+
+/*
+ * cleanup_trn_rig
+ * not exported in Hamlib API.
+ */
+void cleanup_trn_rig(RIG *rig)
+{
+}
+
+
+void HAMLIB_API rig_hold_decode(RIG *rig)
+{
+    rig->state.hold_decode = 1;
+}
+
+
+void HAMLIB_API rig_unhold_decode(RIG *rig)
+{
+    rig->state.hold_decode = 0;
+}
+
+#endif  /* !HAVE_TRN_THREAD */
 
 #endif  /* !DOC_HIDDEN */
 
@@ -708,9 +1266,6 @@ int HAMLIB_API rig_set_trn(RIG *rig, int trn)
 {
     const struct rig_caps *caps;
     int retcode = RIG_OK;
-#ifdef HAVE_SETITIMER
-    struct itimerval value;
-#endif
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -760,58 +1315,13 @@ int HAMLIB_API rig_set_trn(RIG *rig, int trn)
         break;
 
     case RIG_TRN_POLL:
-#ifdef HAVE_SETITIMER
-
-        add_trn_poll_rig(rig);
-
-        /* install handler here */
-        value.it_value.tv_sec = 0;
-        value.it_value.tv_usec = rig->state.poll_interval * 1000;
-        value.it_interval.tv_sec = 0;
-        value.it_interval.tv_usec = rig->state.poll_interval * 1000;
-        retcode = setitimer(ITIMER_REAL, &value, NULL);
-
-        if (retcode == -1)
-        {
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s: setitimer: %s\n",
-                      __func__,
-                      strerror(errno));
-            remove_trn_poll_rig(rig);
-            return -RIG_EINTERNAL;
-        }
-
-#else
-        return -RIG_ENAVAIL;
-#endif
+        retcode = add_trn_poll_rig(rig);
         break;
 
     case RIG_TRN_OFF:
         if (rig->state.transceive == RIG_TRN_POLL)
         {
-#ifdef HAVE_SETITIMER
-
-            // don't care about the return code here
-            remove_trn_poll_rig(rig);
-
-            value.it_value.tv_sec = 0;
-            value.it_value.tv_usec = 0;
-            value.it_interval.tv_sec = 0;
-            value.it_interval.tv_usec = 0;
-
-            retcode = setitimer(ITIMER_REAL, &value, NULL);
-
-            if (retcode == -1)
-            {
-                rig_debug(RIG_DEBUG_ERR, "%s: setitimer: %s\n",
-                          __func__,
-                          strerror(errno));
-                return -RIG_EINTERNAL;
-            }
-
-#else
-            return -RIG_ENAVAIL;
-#endif
+            retcode = remove_trn_poll_rig(rig);
         }
         else if (rig->state.transceive == RIG_TRN_RIG)
         {
@@ -870,4 +1380,134 @@ int HAMLIB_API rig_get_trn(RIG *rig, int *trn)
     return RIG_OK;
 }
 
+
+/**
+ * \brief get a file descriptor signaling pending events
+ * \param rig   The rig handle
+ * \param fd    The location where to store the file descriptor
+ *
+ *  Hands the events of the transceive (or poll) mode over to the
+ *  application.  The returned descriptor becomes readable when the rig
+ *  sent data, or the poll interval elapsed, and rig_process_events()
+ *  is then due.  The event callbacks are called from rig_process_events(),
+ *  in the thread of the application, instead of from the Hamlib event
+ *  thread.  The descriptor stays valid until rig_cleanup().
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * \sa rig_process_events(), rig_set_trn()
+ */
+int HAMLIB_API rig_get_event_fd(RIG *rig, int *fd)
+{
+#ifdef HAVE_TRN_THREAD
+    struct trn_engine *trn;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+
+    if (!rig || !rig->caps || !fd)
+    {
+        return -RIG_EINVAL;
+    }
+
+    trn = trn_engine_get(rig);
+
+    if (!trn)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    if (trn->event_fd[0] < 0)
+    {
+#ifdef HAVE_SYS_EVENTFD_H
+        trn->event_fd[0] = trn->event_fd[1] = eventfd(0, EFD_NONBLOCK);
+
+        if (trn->event_fd[0] < 0)
+#else
+        if (pipe(trn->event_fd) < 0
+                || fcntl(trn->event_fd[0], F_SETFL, O_NONBLOCK) < 0)
+#endif
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: %s\n", __func__, strerror(errno));
+            trn->event_fd[0] = trn->event_fd[1] = -1;
+            return -RIG_EINTERNAL;
+        }
+    }
+
+    trn->app_driven = 1;
+    *fd = trn->event_fd[0];
+
+    return RIG_OK;
+#else
+    return -RIG_ENAVAIL;
+#endif
+}
+
+
+/**
+ * \brief process the pending events
+ * \param rig   The rig handle
+ *
+ *  Decodes the data sent by the rig in transceive mode, or polls the rig
+ *  in poll mode, calling the event callbacks for the changes.  To be
+ *  called when the descriptor from rig_get_event_fd() is readable, from
+ *  the thread which otherwise uses the rig.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * \sa rig_get_event_fd()
+ */
+int HAMLIB_API rig_process_events(RIG *rig)
+{
+#ifdef HAVE_TRN_THREAD
+    struct trn_engine *trn;
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t count;
+#else
+    char count[16];
+#endif
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+
+    if (CHECK_RIG_ARG(rig))
+    {
+        return -RIG_EINVAL;
+    }
+
+    trn = rig->state.trn_engine;
+
+    if (!trn || trn->event_fd[0] < 0)
+    {
+        return -RIG_EINVAL;
+    }
+
+    if (read(trn->event_fd[0], &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: read: %s\n", __func__, strerror(errno));
+    }
+
+    if (rig->state.transceive == RIG_TRN_RIG)
+    {
+        trn_decode(rig);
+    }
+    else if (rig->state.transceive == RIG_TRN_POLL)
+    {
+        poll_rig_state(rig);
+    }
+
+    /* let the event thread watch again */
+    pthread_mutex_lock(&trn->lock);
+    trn->posted = 0;
+    pthread_cond_broadcast(&trn->cond);
+    pthread_mutex_unlock(&trn->lock);
+
+    return RIG_OK;
+#else
+    return -RIG_ENAVAIL;
+#endif
+}
+
 /** @} */
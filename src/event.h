@@ -27,6 +27,7 @@
 
 int add_trn_rig(RIG *rig);
 int remove_trn_rig(RIG *rig);
+void cleanup_trn_rig(RIG *rig);
 
 #endif /* _EVENT_H */
 
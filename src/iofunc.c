@@ -47,6 +47,10 @@
 #include <hamlib/rig.h>
 #include "iofunc.h"
 #include "misc.h"
+#include "stats.h"
+#include "trace.h"
+#include "replay.h"
+#include "adaptive.h"
 
 #include "serial.h"
 #include "parallel.h"
@@ -68,6 +72,8 @@ int HAMLIB_API port_open(hamlib_port_t *p)
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     p->fd = -1;
+    p->rxbuf.head = 0;
+    p->rxbuf.tail = 0;
 
     switch (p->type.rig)
     {
@@ -172,6 +178,16 @@ int HAMLIB_API port_open(hamlib_port_t *p)
 
         break;
 
+    case RIG_PORT_REPLAY:
+        status = replay_open(p);
+
+        if (status < 0)
+        {
+            return status;
+        }
+
+        break;
+
     default:
         return -RIG_EINVAL;
     }
@@ -209,6 +225,10 @@ int HAMLIB_API port_close(hamlib_port_t *p, rig_port_t port_type)
             ret = network_close(p);
             break;
 
+        case RIG_PORT_REPLAY:
+            ret = replay_close(p);
+            break;
+
         default:
             rig_debug(RIG_DEBUG_ERR, "%s(): Unknown port type %d\n",
                       __func__, port_type);
@@ -221,6 +241,9 @@ int HAMLIB_API port_close(hamlib_port_t *p, rig_port_t port_type)
         p->fd = -1;
     }
 
+    p->rxbuf.head = 0;
+    p->rxbuf.tail = 0;
+
     return ret;
 }
 
@@ -389,66 +412,51 @@ static ssize_t port_read(hamlib_port_t *p, void *buf, size_t count)
 
 #endif
 
+/* sleep until the monotonic date in us, if still ahead */
+static void port_sleep_until(uint64_t date)
+{
+    uint64_t now = rig_stats_now_us();
+
+    if (date > now)
+    {
+        hl_usleep(date - now);
+    }
+}
+
+
 /**
- * \brief Write a block of characters to an fd.
+ * \brief Wait until the port may be written to again
  * \param p rig port descriptor
- * \param txbuffer command sequence to be sent
- * \param count number of bytes to send
- * \return 0 = OK, <0 = NOK
  *
- * Write a block of count characters to port file descriptor,
- * with a pause between each character if write_delay is > 0
- *
- * The write_delay is for Yaesu type rigs..require 5 character
- * sequence to be sent with 50-200msec between each char.
- *
- * Also, post_write_delay is for some Yaesu rigs (eg: FT747) that
- * get confused with sequential fast writes between cmd sequences.
- *
- * input:
- *
- * fd - file descriptor to write to
- * txbuffer - pointer to a command sequence array
- * count - count of byte to send from the txbuffer
- * write_delay - write delay in ms between 2 chars
- * post_write_delay - minimum delay between two writes
- * post_write_date - timeval of last write
- *
- * Actually, this function has nothing specific to serial comm,
- * it could work very well also with any file handle, like a socket.
+ * write_block() leaves the write_delay and post_write_delay owed after a
+ * command as a date in p->write_deadline instead of sleeping them, so
+ * the time spent meanwhile, reading the answer or serving clients from
+ * the cache, counts toward them.  Only what is left is slept here, before
+ * the next write or flush: a flush still discards whatever the rig sent
+ * during the delay.
  */
-
-int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
+void HAMLIB_API port_write_wait(hamlib_port_t *p)
 {
-    int ret;
-
-    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+    if (p->write_deadline == 0)
+    {
+        return;
+    }
 
-#ifdef WANT_NON_ACTIVE_POST_WRITE_DELAY
+    port_sleep_until(p->write_deadline);
 
-    if (p->post_write_date.tv_sec != 0)
-    {
-        signed int date_delay;    /* in us */
-        struct timeval tv;
+    p->write_deadline = 0;
+}
 
-        /* FIXME in Y2038 ... */
-        gettimeofday(&tv, NULL);
-        date_delay = p->post_write_delay * 1000 -
-                     ((tv.tv_sec - p->post_write_date.tv_sec) * 1000000 +
-                      (tv.tv_usec - p->post_write_date.tv_usec));
 
-        if (date_delay > 0)
-        {
-            /*
-             * optional delay after last write
-             */
-            hl_sleep(date_delay);
-        }
+/* write_block() body, timed by the wrapper when statistics are on */
+static int do_write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
+{
+    uint64_t next = 0;      /* earliest date of the next byte */
+    int ret;
 
-        p->post_write_date.tv_sec = 0;
-    }
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
-#endif
+    port_write_wait(p);
 
     if (p->write_delay > 0)
     {
@@ -456,6 +464,9 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
 
         for (i = 0; i < count; i++)
         {
+            port_sleep_until(next);
+            next = rig_stats_now_us() + p->write_delay * 1000;
+
             ret = port_write(p, txbuffer + i, 1);
 
             if (ret != 1)
@@ -469,8 +480,6 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
 
                 return -RIG_EIO;
             }
-
-            hl_usleep(p->write_delay * 1000);
         }
     }
     else
@@ -490,26 +499,38 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
         }
     }
 
+    if (p->trace)
+    {
+        trace_record(p, TRACE_TX, (const unsigned char *)txbuffer, count);
+    }
+
+    if (p->adaptive.state)
+    {
+        adaptive_sent(p, (const unsigned char *)txbuffer, count);
+    }
+
+    /*
+     * The gap owed after the last byte, as long as it has always been:
+     * some yaesu rigs get confused with sequential fast writes
+     */
     if (p->post_write_delay > 0)
     {
-#ifdef WANT_NON_ACTIVE_POST_WRITE_DELAY
-#define POST_WRITE_DELAY_TRSHLD 10
+        struct timeval tv;
 
-        if (p->post_write_delay > POST_WRITE_DELAY_TRSHLD)
+        if (next == 0)
         {
-            struct timeval tv;
-            gettimeofday(&tv, NULL);
-            p->post_write_date.tv_sec = tv.tv_sec;
-            p->post_write_date.tv_usec = tv.tv_usec;
+            next = rig_stats_now_us();
         }
-        else
-#endif
-            hl_usleep(p->post_write_delay * 1000); /* optional delay after last write */
 
-        /* otherwise some yaesu rigs get confused */
-        /* with sequential fast writes*/
+        next += p->post_write_delay * 1000;
+
+        gettimeofday(&tv, NULL);
+        p->post_write_date.tv_sec = tv.tv_sec;
+        p->post_write_date.tv_usec = tv.tv_usec;
     }
 
+    p->write_deadline = next;
+
     rig_debug(RIG_DEBUG_TRACE, "%s(): TX %d bytes\n", __func__, (int)count);
     dump_hex((unsigned char *) txbuffer, count);
 
@@ -518,27 +539,216 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
 
 
 /**
- * \brief Read bytes from an fd
+ * \brief Write a block of characters to an fd.
  * \param p rig port descriptor
- * \param rxbuffer buffer to receive text
- * \param count number of bytes
- * \return count of bytes received
+ * \param txbuffer command sequence to be sent
+ * \param count number of bytes to send
+ * \return 0 = OK, <0 = NOK
  *
- * Read "num" bytes from "fd" and put results into
- * an array of unsigned char pointed to by "rxbuffer"
+ * Write a block of count characters to port file descriptor,
+ * with a pause between each character if write_delay is > 0
  *
- * Blocks on read until timeout hits.
+ * The write_delay is for Yaesu type rigs..require 5 character
+ * sequence to be sent with 50-200msec between each char.
  *
- * It then reads "num" bytes into rxbuffer.
+ * Also, post_write_delay is for some Yaesu rigs (eg: FT747) that
+ * get confused with sequential fast writes between cmd sequences.
+ *
+ * Both are paced against the clock: the delay owed after the last
+ * byte is not slept here but at the next write or flush, see
+ * port_write_wait(), and only for what has not elapsed by then.
+ *
+ * input:
+ *
+ * fd - file descriptor to write to
+ * txbuffer - pointer to a command sequence array
+ * count - count of byte to send from the txbuffer
+ * write_delay - write delay in ms between 2 chars
+ * post_write_delay - minimum delay between two writes
+ * post_write_date - timeval of last write
  *
  * Actually, this function has nothing specific to serial comm,
  * it could work very well also with any file handle, like a socket.
  */
 
-int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
+int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
+{
+    uint64_t start;
+    int ret;
+
+    if (!rig_stats_on)
+    {
+        return do_write_block(p, txbuffer, count);
+    }
+
+    start = rig_stats_now_us();
+    ret = do_write_block(p, txbuffer, count);
+    rig_stats_call(STATS_WRITE_BLOCK, start, ret);
+
+    if (ret == RIG_OK)
+    {
+        rig_stats_add(STATS_TX_BYTES, count);
+    }
+
+    return ret;
+}
+
+
+/*
+ * Number of bytes waiting in the port receive buffer
+ */
+#define port_rxbuf_count(p) ((p)->rxbuf.tail - (p)->rxbuf.head)
+
+
+/**
+ * \brief Discard any bytes held in the port receive buffer
+ * \param p rig port descriptor
+ *
+ * Meant to be called along with any flush of the underlying device,
+ * so stale data buffered by read_block()/read_string() does not
+ * survive the flush.
+ */
+void HAMLIB_API port_rxbuf_flush(hamlib_port_t *p)
+{
+    if (port_rxbuf_count(p) > 0)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: discarding %d buffered bytes\n", __func__,
+                  port_rxbuf_count(p));
+        dump_hex(p->rxbuf.buf + p->rxbuf.head, port_rxbuf_count(p));
+
+        if (p->trace)
+        {
+            trace_record(p, TRACE_FLUSH, NULL, 0);
+        }
+    }
+
+    p->rxbuf.head = 0;
+    p->rxbuf.tail = 0;
+}
+
+
+/**
+ * \brief Tell whether bytes wait to be read, buffered or on the device
+ * \param p rig port descriptor
+ * \return 1 if the next read_block()/read_string() will not wait, else 0
+ *
+ * Lets a backend pick up the unsolicited data of the rig before a flush
+ * would throw it away.
+ */
+int HAMLIB_API port_rx_pending(hamlib_port_t *p)
+{
+    fd_set rfds;
+    struct timeval tv = { 0, 0 };
+
+    if (port_rxbuf_count(p) > 0)
+    {
+        return 1;
+    }
+
+    FD_ZERO(&rfds);
+    FD_SET(p->fd, &rfds);
+
+    return port_select(p, p->fd + 1, &rfds, NULL, NULL, &tv) > 0;
+}
+
+
+/*
+ * port_rxbuf_fill
+ * Wait up to timeout for the port to become readable, then grab
+ * whatever is available with a single read into the receive buffer.
+ * Must only be called when the receive buffer is empty.  With adaptive
+ * timeouts on, the wait is recorded.
+ *
+ * Returns the number of bytes buffered, -RIG_ETIMEOUT when nothing
+ * came in before the timeout, or -RIG_EIO on error.
+ */
+static int port_rxbuf_fill(hamlib_port_t *p, const struct timeval *timeout)
 {
     fd_set rfds, efds;
-    struct timeval tv, tv_timeout, start_time, end_time, elapsed_time;
+    struct timeval tv;
+    uint64_t start = 0;
+    int retval;
+    int rd_count;
+
+    tv = *timeout;    /* select may update it */
+
+    FD_ZERO(&rfds);
+    FD_SET(p->fd, &rfds);
+    efds = rfds;
+
+    if (p->adaptive.state)
+    {
+        start = rig_stats_now_us();
+    }
+
+    retval = port_select(p, p->fd + 1, &rfds, NULL, &efds, &tv);
+
+    if (p->adaptive.state && retval >= 0)
+    {
+        adaptive_waited(p, rig_stats_now_us() - start, retval == 0);
+    }
+
+    if (retval == 0)
+    {
+        if (p->trace)
+        {
+            trace_record(p, TRACE_TIMEOUT, NULL, 0);
+        }
+
+        return -RIG_ETIMEOUT;
+    }
+
+    if (retval < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR,
+                  "%s(): select() error: %s\n",
+                  __func__,
+                  strerror(errno));
+
+        return -RIG_EIO;
+    }
+
+    if (FD_ISSET(p->fd, &efds))
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s(): fd error\n", __func__);
+
+        return -RIG_EIO;
+    }
+
+    /*
+     * grab all available bytes from the rig
+     * The file descriptor must have been set up non blocking.
+     */
+    rd_count = port_read(p, p->rxbuf.buf, sizeof(p->rxbuf.buf));
+
+    /* if we get 0 bytes or an error something is wrong */
+    if (rd_count <= 0)
+    {
+        rig_debug(RIG_DEBUG_ERR,
+                  "%s(): read() failed - %s\n",
+                  __func__,
+                  rd_count == 0 ? "end of file" : strerror(errno));
+
+        return -RIG_EIO;
+    }
+
+    p->rxbuf.head = 0;
+    p->rxbuf.tail = rd_count;
+
+    if (p->trace)
+    {
+        trace_record(p, TRACE_RX, p->rxbuf.buf, rd_count);
+    }
+
+    return rd_count;
+}
+
+
+/* read_block() body, timed by the wrapper when statistics are on */
+static int do_read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
+{
+    struct timeval tv_timeout, start_time, end_time, elapsed_time;
+    int timeout;
     int total_count = 0;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -546,81 +756,62 @@ int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
     /*
      * Wait up to timeout ms.
      */
-    tv_timeout.tv_sec = p->timeout / 1000;
-    tv_timeout.tv_usec = (p->timeout % 1000) * 1000;
+    timeout = adaptive_timeout(p);
+    tv_timeout.tv_sec = timeout / 1000;
+    tv_timeout.tv_usec = (timeout % 1000) * 1000;
 
     /* Store the time of the read loop start */
     gettimeofday(&start_time, NULL);
 
     while (count > 0)
     {
-        int retval;
-        int rd_count;
-        tv = tv_timeout;    /* select may have updated it */
+        int avail;
 
-        FD_ZERO(&rfds);
-        FD_SET(p->fd, &rfds);
-        efds = rfds;
-
-        retval = port_select(p, p->fd + 1, &rfds, NULL, &efds, &tv);
-
-        if (retval == 0)
+        if (port_rxbuf_count(p) == 0)
         {
-            /* Record timeout time and calculate elapsed time */
-            gettimeofday(&end_time, NULL);
-            timersub(&end_time, &start_time, &elapsed_time);
-
-            dump_hex((unsigned char *) rxbuffer, total_count);
-            rig_debug(RIG_DEBUG_WARN,
-                      "%s(): Timed out %d.%d seconds after %d chars\n",
-                      __func__,
-                      (int)elapsed_time.tv_sec,
-                      (int)elapsed_time.tv_usec,
-                      total_count);
+            int retval = port_rxbuf_fill(p, &tv_timeout);
 
-            return -RIG_ETIMEOUT;
-        }
+            if (retval == -RIG_ETIMEOUT)
+            {
+                /* Record timeout time and calculate elapsed time */
+                gettimeofday(&end_time, NULL);
+                timersub(&end_time, &start_time, &elapsed_time);
 
-        if (retval < 0)
-        {
-            dump_hex((unsigned char *) rxbuffer, total_count);
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): select() error after %d chars: %s\n",
-                      __func__,
-                      total_count,
-                      strerror(errno));
+                dump_hex((unsigned char *) rxbuffer, total_count);
+                rig_debug(RIG_DEBUG_WARN,
+                          "%s(): Timed out %d.%d seconds after %d chars\n",
+                          __func__,
+                          (int)elapsed_time.tv_sec,
+                          (int)elapsed_time.tv_usec,
+                          total_count);
 
-            return -RIG_EIO;
-        }
+                return -RIG_ETIMEOUT;
+            }
 
-        if (FD_ISSET(p->fd, &efds))
-        {
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): fd error after %d chars\n",
-                      __func__,
-                      total_count);
+            if (retval < 0)
+            {
+                dump_hex((unsigned char *) rxbuffer, total_count);
+                rig_debug(RIG_DEBUG_ERR,
+                          "%s(): error after %d chars\n",
+                          __func__,
+                          total_count);
 
-            return -RIG_EIO;
+                return retval;
+            }
         }
 
-        /*
-         * grab bytes from the rig
-         * The file descriptor must have been set up non blocking.
-         */
-        rd_count = port_read(p, rxbuffer + total_count, count);
+        avail = port_rxbuf_count(p);
 
-        if (rd_count < 0)
+        if (avail > count)
         {
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): read() failed - %s\n",
-                      __func__,
-                      strerror(errno));
-
-            return -RIG_EIO;
+            avail = count;
         }
 
-        total_count += rd_count;
-        count -= rd_count;
+        memcpy(rxbuffer + total_count, p->rxbuf.buf + p->rxbuf.head, avail);
+        p->rxbuf.head += avail;
+
+        total_count += avail;
+        count -= avail;
     }
 
     rig_debug(RIG_DEBUG_TRACE, "%s(): RX %d bytes\n", __func__, total_count);
@@ -631,39 +822,54 @@ int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
 
 
 /**
- * \brief Read a string from an fd
- * \param p Hamlib port descriptor
- * \param rxbuffer buffer to receive string
- * \param rxmax maximum string size + 1
- * \param stopset string of recognized end of string characters
- * \param stopset_len length of stopset
- * \return number of characters read if the operation has been successful,
- * otherwise a negative value if an error occurred (in which case, cause is
- * set appropriately).
+ * \brief Read bytes from an fd
+ * \param p rig port descriptor
+ * \param rxbuffer buffer to receive text
+ * \param count number of bytes
+ * \return count of bytes received
  *
- * Read a string from "fd" and put result into
+ * Read "num" bytes from "fd" and put results into
  * an array of unsigned char pointed to by "rxbuffer"
  *
  * Blocks on read until timeout hits.
  *
- * It then reads characters until one of the characters in
- * "stopset" is found, or until "rxmax-1" characters was copied
- * into rxbuffer.  String termination character is added at the end.
+ * It then reads "num" bytes into rxbuffer.  Bytes received beyond
+ * "num" are kept in the port receive buffer for the next read_block()
+ * or read_string() call.
  *
  * Actually, this function has nothing specific to serial comm,
  * it could work very well also with any file handle, like a socket.
- *
- * Assumes rxbuffer!=NULL
  */
-int HAMLIB_API read_string(hamlib_port_t *p,
-                           char *rxbuffer,
-                           size_t rxmax,
-                           const char *stopset,
-                           int stopset_len)
+
+int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
 {
-    fd_set rfds, efds;
-    struct timeval tv, tv_timeout, start_time, end_time, elapsed_time;
+    uint64_t start;
+    int ret;
+
+    if (!rig_stats_on)
+    {
+        return do_read_block(p, rxbuffer, count);
+    }
+
+    start = rig_stats_now_us();
+    ret = do_read_block(p, rxbuffer, count);
+    rig_stats_call(STATS_READ_BLOCK, start, ret);
+
+    return ret;
+}
+
+
+/* read_string() body, timed by the wrapper when statistics are on */
+static int do_read_string(hamlib_port_t *p,
+                          char *rxbuffer,
+                          size_t rxmax,
+                          const char *stopset,
+                          int stopset_len)
+{
+    struct timeval tv_timeout, start_time, end_time, elapsed_time;
+    int timeout;
     int total_count = 0;
+    int found = 0;
 
     rig_debug(RIG_DEBUG_TRACE, "%s called, rxmax=%d\n", __func__, (int)rxmax);
 
@@ -683,97 +889,98 @@ int HAMLIB_API read_string(hamlib_port_t *p,
     /*
      * Wait up to timeout ms.
      */
-    tv_timeout.tv_sec = p->timeout / 1000;
-    tv_timeout.tv_usec = (p->timeout % 1000) * 1000;
+    timeout = adaptive_timeout(p);
+    tv_timeout.tv_sec = timeout / 1000;
+    tv_timeout.tv_usec = (timeout % 1000) * 1000;
 
     /* Store the time of the read loop start */
     gettimeofday(&start_time, NULL);
 
     rxbuffer[0] = 0; /* ensure string is terminated */
 
-    while (total_count < rxmax - 1)
+    while (!found && total_count < rxmax - 1)
     {
-        int rd_count;
-        int retval;
-        tv = tv_timeout;    /* select may have updated it */
-
-        FD_ZERO(&rfds);
-        FD_SET(p->fd, &rfds);
-        efds = rfds;
-
-        retval = port_select(p, p->fd + 1, &rfds, NULL, &efds, &tv);
+        const unsigned char *src;
+        int avail;
+        int i;
 
-        if (retval == 0)
+        if (port_rxbuf_count(p) == 0)
         {
-            if (0 == total_count)
+            int retval = port_rxbuf_fill(p, &tv_timeout);
+
+            if (retval == -RIG_ETIMEOUT)
             {
-                /* Record timeout time and calculate elapsed time */
-                gettimeofday(&end_time, NULL);
-                timersub(&end_time, &start_time, &elapsed_time);
+                if (0 == total_count)
+                {
+                    /* Record timeout time and calculate elapsed time */
+                    gettimeofday(&end_time, NULL);
+                    timersub(&end_time, &start_time, &elapsed_time);
+
+                    dump_hex((unsigned char *) rxbuffer, total_count);
+                    rig_debug(RIG_DEBUG_WARN,
+                              "%s(): Timed out %d.%d seconds after %d chars\n",
+                              __func__,
+                              (int)elapsed_time.tv_sec,
+                              (int)elapsed_time.tv_usec,
+                              total_count);
+
+                    return -RIG_ETIMEOUT;
+                }
+
+                break;                      /* return what we have read */
+            }
 
+            if (retval < 0)
+            {
                 dump_hex((unsigned char *) rxbuffer, total_count);
-                rig_debug(RIG_DEBUG_WARN,
-                          "%s(): Timed out %d.%d seconds after %d chars\n",
+                rig_debug(RIG_DEBUG_ERR,
+                          "%s(): error after %d chars\n",
                           __func__,
-                          (int)elapsed_time.tv_sec,
-                          (int)elapsed_time.tv_usec,
                           total_count);
 
-                return -RIG_ETIMEOUT;
+                return retval;
             }
-
-            break;                      /* return what we have read */
         }
 
-        if (retval < 0)
-        {
-            dump_hex((unsigned char *) rxbuffer, total_count);
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): select() error after %d chars: %s\n",
-                      __func__,
-                      total_count,
-                      strerror(errno));
+        src = p->rxbuf.buf + p->rxbuf.head;
 
-            return -RIG_EIO;
-        }
+        // check to see if our string starts with \...if so we need more chars
+        if (total_count == 0 && src[0] == '\\') { rxmax = (rxmax - 1) * 5; }
 
-        if (FD_ISSET(p->fd, &efds))
-        {
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): fd error after %d chars\n",
-                      __func__,
-                      total_count);
+        avail = port_rxbuf_count(p);
 
-            return -RIG_EIO;
+        if (avail > rxmax - 1 - total_count)
+        {
+            avail = rxmax - 1 - total_count;
         }
 
-        /*
-             * read 1 character from the rig, (check if in stop set)
-         * The file descriptor must have been set up non blocking.
-         */
-        rd_count = port_read(p, &rxbuffer[total_count], 1);
-
-        /* if we get 0 bytes or an error something is wrong */
-        if (rd_count <= 0)
+        /* look for the first stopset char in what has been buffered */
+        if (stopset && stopset_len == 1)
         {
-            dump_hex((unsigned char *) rxbuffer, total_count);
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): read() failed - %s\n",
-                      __func__,
-                      strerror(errno));
+            const unsigned char *stop = memchr(src, stopset[0], avail);
 
-            return -RIG_EIO;
+            if (stop)
+            {
+                avail = stop - src + 1;
+                found = 1;
+            }
         }
-
-        // check to see if our string startis with \...if so we need more chars
-        if (total_count == 0 && rxbuffer[total_count] == '\\') { rxmax = (rxmax - 1) * 5; }
-
-        ++total_count;
-
-        if (stopset && memchr(stopset, rxbuffer[total_count - 1], stopset_len))
+        else if (stopset && stopset_len > 1)
         {
-            break;
+            for (i = 0; i < avail; i++)
+            {
+                if (memchr(stopset, src[i], stopset_len))
+                {
+                    avail = i + 1;
+                    found = 1;
+                    break;
+                }
+            }
         }
+
+        memcpy(rxbuffer + total_count, src, avail);
+        p->rxbuf.head += avail;
+        total_count += avail;
     }
 
     /*
@@ -792,4 +999,56 @@ int HAMLIB_API read_string(hamlib_port_t *p,
     return total_count;           /* return bytes count read */
 }
 
+
+/**
+ * \brief Read a string from an fd
+ * \param p Hamlib port descriptor
+ * \param rxbuffer buffer to receive string
+ * \param rxmax maximum string size + 1
+ * \param stopset string of recognized end of string characters
+ * \param stopset_len length of stopset
+ * \return number of characters read if the operation has been successful,
+ * otherwise a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * Read a string from "fd" and put result into
+ * an array of unsigned char pointed to by "rxbuffer"
+ *
+ * Blocks on read until timeout hits.
+ *
+ * It then reads characters until one of the characters in
+ * "stopset" is found, or until "rxmax-1" characters was copied
+ * into rxbuffer.  String termination character is added at the end.
+ *
+ * Whatever the port has available is read in one go into the port
+ * receive buffer and scanned for the stopset there. Characters past
+ * the end of the string are kept for the next read_string() or
+ * read_block() call.
+ *
+ * Actually, this function has nothing specific to serial comm,
+ * it could work very well also with any file handle, like a socket.
+ *
+ * Assumes rxbuffer!=NULL
+ */
+int HAMLIB_API read_string(hamlib_port_t *p,
+                           char *rxbuffer,
+                           size_t rxmax,
+                           const char *stopset,
+                           int stopset_len)
+{
+    uint64_t start;
+    int ret;
+
+    if (!rig_stats_on)
+    {
+        return do_read_string(p, rxbuffer, rxmax, stopset, stopset_len);
+    }
+
+    start = rig_stats_now_us();
+    ret = do_read_string(p, rxbuffer, rxmax, stopset, stopset_len);
+    rig_stats_call(STATS_READ_STRING, start, ret);
+
+    return ret;
+}
+
 /** @} */
@@ -44,4 +44,8 @@ extern HAMLIB_EXPORT(int) read_string(hamlib_port_t *p,
                                       const char *stopset,
                                       int stopset_len);
 
+extern HAMLIB_EXPORT(void) port_rxbuf_flush(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) port_write_wait(hamlib_port_t *p);
+extern HAMLIB_EXPORT(int) port_rx_pending(hamlib_port_t *p);
+
 #endif /* _IOFUNC_H */
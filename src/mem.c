@@ -45,6 +45,7 @@
 #include <fcntl.h>
 
 #include <hamlib/rig.h>
+#include "cache.h"
 
 #ifndef DOC_HIDDEN
 
@@ -82,6 +83,8 @@ int HAMLIB_API rig_set_mem(RIG *rig, vfo_t vfo, int ch)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     caps = rig->caps;
 
     if (caps->set_mem == NULL)
@@ -208,6 +211,8 @@ int HAMLIB_API rig_set_bank(RIG *rig, vfo_t vfo, int bank)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     caps = rig->caps;
 
     if (caps->set_bank == NULL)
@@ -701,6 +706,8 @@ int HAMLIB_API rig_set_channel(RIG *rig, const channel_t *chan)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     /*
      * TODO: check validity of chan->channel_num
      */
@@ -1310,15 +1310,47 @@ double HAMLIB_API elapsed_ms(struct timespec *start, int option)
 int HAMLIB_API rig_get_cache_timeout_ms(RIG *rig, hamlib_cache_t selection)
 {
     rig_debug(RIG_DEBUG_TRACE, "%s: called selection=%d\n", __func__, selection);
-    return rig->state.cache.timeout_ms;
+
+    if (selection <= HAMLIB_CACHE_ALL || selection >= HAMLIB_CACHE_MAX)
+    {
+        return rig->state.cache.timeout_ms;
+    }
+
+    return rig->state.cache.timeout_kind_ms[selection];
 }
 
+/*
+ * HAMLIB_CACHE_ALL sets the timeouts of VFO, freq, mode, PTT and split,
+ * any other selection only the one of that kind.  The settings kinds,
+ * from HAMLIB_CACHE_LEVEL on, are 0 (not cached) unless set by kind, as
+ * a setting changed on the front panel would stay hidden until expiry.
+ */
 int HAMLIB_API rig_set_cache_timeout_ms(RIG *rig, hamlib_cache_t selection,
                                         int ms)
 {
+    int i;
+
     rig_debug(RIG_DEBUG_TRACE, "%s: called selection=%d, ms=%d\n", __func__,
               selection, ms);
+
+    if (selection < HAMLIB_CACHE_ALL || selection >= HAMLIB_CACHE_MAX)
+    {
+        return -RIG_EINVAL;
+    }
+
+    if (selection != HAMLIB_CACHE_ALL)
+    {
+        rig->state.cache.timeout_kind_ms[selection] = ms;
+        return RIG_OK;
+    }
+
     rig->state.cache.timeout_ms = ms;
+
+    for (i = HAMLIB_CACHE_ALL + 1; i < HAMLIB_CACHE_LEVEL; i++)
+    {
+        rig->state.cache.timeout_kind_ms[i] = ms;
+    }
+
     return RIG_OK;
 }
 
@@ -1498,8 +1530,10 @@ int HAMLIB_API rig_flush(hamlib_port_t *port)
     rig_debug(RIG_DEBUG_TRACE, "%s: called for %s device\n", __func__,
               port->type.rig == RIG_PORT_SERIAL ? "serial" : "network");
 
+    /* a replay port is a local socket */
     if (port->type.rig == RIG_PORT_NETWORK
-            || port->type.rig == RIG_PORT_UDP_NETWORK)
+            || port->type.rig == RIG_PORT_UDP_NETWORK
+            || port->type.rig == RIG_PORT_REPLAY)
     {
         network_flush(port);
         return RIG_OK;
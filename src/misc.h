@@ -26,13 +26,11 @@
 
 
 /*
- * Careful!! These macros are NOT reentrant!
- * ie. they may not be executed atomically,
- * thus not ensure mutual exclusion.
- * Fix it when making Hamlib reentrant!  --SF
+ * Keep the transceive event thread off the port during a transaction,
+ * see rig_hold_decode() in event.c
  */
-#define Hold_Decode(rig) {(rig)->state.hold_decode = 1;}
-#define Unhold_Decode(rig) {(rig)->state.hold_decode = 0;}
+#define Hold_Decode(rig) {rig_hold_decode(rig);}
+#define Unhold_Decode(rig) {rig_unhold_decode(rig);}
 
 __BEGIN_DECLS
 
@@ -100,6 +98,9 @@ extern HAMLIB_EXPORT(setting_t) rig_idx2setting(int i);
 
 extern HAMLIB_EXPORT(int) hl_usleep(rig_useconds_t usec);
 
+extern HAMLIB_EXPORT(void) rig_hold_decode(RIG *rig);
+extern HAMLIB_EXPORT(void) rig_unhold_decode(RIG *rig);
+
 extern HAMLIB_EXPORT(double) elapsed_ms(struct timespec *start, int start_flag);
 
 extern HAMLIB_EXPORT(vfo_t) vfo_fixup(RIG *rig, vfo_t vfo);
@@ -77,6 +77,7 @@
 #include <hamlib/rig.h>
 #include "network.h"
 #include "misc.h"
+#include "iofunc.h"
 
 
 #ifdef __MINGW32__
@@ -300,6 +301,9 @@ void network_flush(hamlib_port_t *rp)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    port_write_wait(rp);
+    port_rxbuf_flush(rp);
+
     for (;;)
     {
         int ret;
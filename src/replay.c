@@ -0,0 +1,504 @@
+/**
+ * \addtogroup rig_internal
+ * @{
+ */
+
+/**
+ * \file src/replay.c
+ * \brief Trace file replay port
+ *
+ * A RIG_PORT_REPLAY port talks to a thread playing the rig recorded in a
+ * trace file, see trace.c.  Each command the backend writes is looked up
+ * among the recorded ones and answered with the bytes the rig sent back
+ * then, right away or at the recorded pace.  Backends and applications can
+ * thus be run and timed without any hardware, and always against the same
+ * replies.
+ */
+/*
+ *  Hamlib Interface - trace file replay
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SYS_SOCKET_H
+#  include <sys/socket.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+#include "replay.h"
+#include "trace.h"
+#include "stats.h"
+#include "misc.h"
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_SOCKETPAIR)
+
+/* room for the commands received but not matched yet */
+#define REPLAY_INBUF_SIZE   (2 * 4096)
+
+/* how long an incomplete command may wait for its end, in ms */
+#define REPLAY_PARTIAL_MS   1000
+
+struct replay_rec
+{
+    uint64_t us;
+    int type;
+    size_t len;
+    const unsigned char *data;
+};
+
+struct port_replay
+{
+    unsigned char *file;        /* the whole trace file */
+    struct replay_rec *recs;
+    int nrecs;
+    uint64_t start_us;          /* monotonic time the trace started */
+    int sock;                   /* rig end of the socket pair */
+    int timing;
+    int stop;
+    pthread_t thread;
+    size_t in_len;
+    unsigned char in[REPLAY_INBUF_SIZE];
+};
+
+
+static uint64_t get_le(const unsigned char *p, int len)
+{
+    uint64_t val = 0;
+
+    while (len-- > 0)
+    {
+        val = (val << 8) | p[len];
+    }
+
+    return val;
+}
+
+
+/*
+ * Read the trace file in memory and index its records.  A record cut
+ * short at the end of the file, as left by a program killed while
+ * tracing, ends the trace.
+ */
+static int replay_load(struct port_replay *r, const char *path)
+{
+    FILE *fp;
+    long size;
+    size_t off;
+    int n;
+
+    fp = fopen(path, "rb");
+
+    if (!fp)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot open %s: %s\n", __func__, path,
+                  strerror(errno));
+        return -RIG_EIO;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0)
+    {
+        fclose(fp);
+        return -RIG_EIO;
+    }
+
+    rewind(fp);
+
+    r->file = malloc(size > 0 ? size : 1);
+
+    if (!r->file)
+    {
+        fclose(fp);
+        return -RIG_ENOMEM;
+    }
+
+    if (fread(r->file, 1, size, fp) != (size_t)size)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot read %s\n", __func__, path);
+        fclose(fp);
+        return -RIG_EIO;
+    }
+
+    fclose(fp);
+
+    if (size < TRACE_HEADER_LEN || memcmp(r->file, TRACE_MAGIC, 8) != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: %s is not a trace file\n", __func__, path);
+        return -RIG_EINVAL;
+    }
+
+    r->start_us = get_le(r->file + 24, 8);
+
+    /* count the records, then index them */
+    for (n = 0, off = TRACE_HEADER_LEN; off + TRACE_RECORD_LEN <= (size_t)size;
+            n++)
+    {
+        size_t len = get_le(r->file + off + 10, 2);
+
+        if (off + TRACE_RECORD_LEN + len > (size_t)size)
+        {
+            break;
+        }
+
+        off += TRACE_RECORD_LEN + len;
+    }
+
+    r->recs = calloc(n > 0 ? n : 1, sizeof(struct replay_rec));
+
+    if (!r->recs)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    for (r->nrecs = 0, off = TRACE_HEADER_LEN; r->nrecs < n; r->nrecs++)
+    {
+        struct replay_rec *rec = &r->recs[r->nrecs];
+
+        rec->us = get_le(r->file + off, 8);
+        rec->type = r->file[off + 8];
+        rec->len = get_le(r->file + off + 10, 2);
+        rec->data = r->file + off + TRACE_RECORD_LEN;
+
+        off += TRACE_RECORD_LEN + rec->len;
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: %d records of rig model %u in %s\n",
+              __func__, r->nrecs, (unsigned)get_le(r->file + 8, 4), path);
+
+    return RIG_OK;
+}
+
+
+static void replay_wait_until(struct port_replay *r, uint64_t deadline_us)
+{
+    uint64_t now;
+
+    while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED)
+            && (now = rig_stats_now_us()) < deadline_us)
+    {
+        uint64_t us = deadline_us - now;
+
+        hl_usleep(us < 10000 ? us : 10000);
+    }
+}
+
+
+static void replay_send(struct port_replay *r, const unsigned char *data,
+                        size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t ret = send(r->sock, data, len, 0);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            rig_debug(RIG_DEBUG_ERR, "%s: %s\n", __func__, strerror(errno));
+            return;
+        }
+
+        data += ret;
+        len -= ret;
+    }
+}
+
+
+/*
+ * Send the replies recorded after record i, up to the next command, and
+ * return the index of that command.  matched_us is when record i was
+ * matched, the reference of the recorded delays.
+ */
+static int replay_answer(struct port_replay *r, int i, uint64_t matched_us)
+{
+    uint64_t ref_us = i < 0 ? r->start_us : r->recs[i].us;
+    int j;
+
+    for (j = i + 1; j < r->nrecs && r->recs[j].type != TRACE_TX; j++)
+    {
+        const struct replay_rec *rec = &r->recs[j];
+
+        /* timeouts, flushes and lost records have nothing to replay */
+        if (rec->type != TRACE_RX)
+        {
+            continue;
+        }
+
+        if (r->timing && rec->us > ref_us)
+        {
+            replay_wait_until(r, matched_us + (rec->us - ref_us));
+        }
+
+        replay_send(r, rec->data, rec->len);
+    }
+
+    return j;
+}
+
+
+/*
+ * Find the recorded command at the start of the input, trying the one
+ * following the last match first so that a trace replays in order, then
+ * the next ones, wrapping around.  *partial is set when the input may
+ * still grow into a recorded command.
+ */
+static int replay_match(const struct port_replay *r, int cursor, int *partial)
+{
+    int k;
+
+    *partial = 0;
+
+    for (k = 0; k < r->nrecs; k++)
+    {
+        int i = (cursor + k) % r->nrecs;
+        const struct replay_rec *rec = &r->recs[i];
+
+        if (rec->type != TRACE_TX || rec->len == 0)
+        {
+            continue;
+        }
+
+        if (rec->len <= r->in_len)
+        {
+            if (memcmp(r->in, rec->data, rec->len) == 0)
+            {
+                return i;
+            }
+        }
+        else if (memcmp(r->in, rec->data, r->in_len) == 0)
+        {
+            *partial = 1;
+        }
+    }
+
+    return -1;
+}
+
+
+static void *replay_rig(void *arg)
+{
+    struct port_replay *r = arg;
+    int cursor;
+    int waited_ms = 0;
+
+    /* what the rig sent before the first command */
+    cursor = replay_answer(r, -1, rig_stats_now_us());
+
+    while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED))
+    {
+        fd_set rfds;
+        struct timeval tv = { 0, 100 * 1000 };
+        ssize_t ret;
+        int partial = 0;
+
+        FD_ZERO(&rfds);
+        FD_SET(r->sock, &rfds);
+
+        ret = select(r->sock + 1, &rfds, NULL, NULL, &tv);
+
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (ret == 0)
+        {
+            waited_ms += 100;
+
+            if (r->in_len > 0 && waited_ms >= REPLAY_PARTIAL_MS)
+            {
+                rig_debug(RIG_DEBUG_WARN, "%s: incomplete command dropped\n",
+                          __func__);
+                dump_hex(r->in, r->in_len);
+                r->in_len = 0;
+            }
+
+            continue;
+        }
+
+        ret = recv(r->sock, r->in + r->in_len, sizeof(r->in) - r->in_len, 0);
+
+        if (ret <= 0)
+        {
+            /* port closed */
+            break;
+        }
+
+        r->in_len += ret;
+        waited_ms = 0;
+
+        while (r->in_len > 0)
+        {
+            int i = replay_match(r, cursor, &partial);
+
+            if (i >= 0)
+            {
+                uint64_t now = rig_stats_now_us();
+                size_t len = r->recs[i].len;
+
+                memmove(r->in, r->in + len, r->in_len - len);
+                r->in_len -= len;
+                cursor = replay_answer(r, i, now);
+                continue;
+            }
+
+            if (partial && r->in_len < sizeof(r->in))
+            {
+                break;
+            }
+
+            rig_debug(RIG_DEBUG_WARN, "%s: command not in the trace, dropped\n",
+                      __func__);
+            dump_hex(r->in, r->in_len);
+            r->in_len = 0;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void replay_free(struct port_replay *r)
+{
+    free(r->recs);
+    free(r->file);
+    free(r);
+}
+
+
+/**
+ * \brief Open a replay port
+ * \param p port, whose pathname is the trace file to replay
+ * \return RIG_OK or < 0 if error
+ *
+ * p->fd is connected to a thread answering the commands as the traced
+ * rig did.
+ */
+int HAMLIB_API replay_open(hamlib_port_t *p)
+{
+    struct port_replay *r;
+    int sv[2];
+    int ret;
+
+    r = calloc(1, sizeof(struct port_replay));
+
+    if (!r)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    ret = replay_load(r, p->pathname);
+
+    if (ret != RIG_OK)
+    {
+        replay_free(r);
+        return ret;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: socketpair: %s\n", __func__,
+                  strerror(errno));
+        replay_free(r);
+        return -RIG_EIO;
+    }
+
+    r->sock = sv[1];
+    r->timing = p->replay.timing;
+
+    if (pthread_create(&r->thread, NULL, replay_rig, r) != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot start the replay thread\n", __func__);
+        close(sv[0]);
+        close(sv[1]);
+        replay_free(r);
+        return -RIG_EINTERNAL;
+    }
+
+    p->fd = sv[0];
+    p->replay.state = r;
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief Close a replay port
+ * \param p port opened by replay_open()
+ * \return RIG_OK or < 0 if error
+ */
+int HAMLIB_API replay_close(hamlib_port_t *p)
+{
+    struct port_replay *r = p->replay.state;
+    int ret;
+
+    if (!r)
+    {
+        return close(p->fd);
+    }
+
+    p->replay.state = NULL;
+
+    __atomic_store_n(&r->stop, 1, __ATOMIC_RELAXED);
+    shutdown(p->fd, SHUT_RDWR);
+    pthread_join(r->thread, NULL);
+
+    ret = close(p->fd);
+    close(r->sock);
+    replay_free(r);
+
+    return ret;
+}
+
+#else /* HAVE_PTHREAD && HAVE_SOCKETPAIR */
+
+int HAMLIB_API replay_open(hamlib_port_t *p)
+{
+    rig_debug(RIG_DEBUG_ERR, "%s: replay needs threads and socketpair()\n",
+              __func__);
+
+    return -RIG_ENIMPL;
+}
+
+
+int HAMLIB_API replay_close(hamlib_port_t *p)
+{
+    return close(p->fd);
+}
+
+#endif /* HAVE_PTHREAD && HAVE_SOCKETPAIR */
+
+/** @} */
@@ -0,0 +1,34 @@
+/*
+ *  Hamlib Interface - trace file replay header
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _REPLAY_H
+#define _REPLAY_H 1
+
+#include <hamlib/rig.h>
+
+__BEGIN_DECLS
+
+extern HAMLIB_EXPORT(int) replay_open(hamlib_port_t *p);
+extern HAMLIB_EXPORT(int) replay_close(hamlib_port_t *p);
+
+__END_DECLS
+
+#endif /* _REPLAY_H */
@@ -71,6 +71,10 @@
 #include "cm108.h"
 #include "gpio.h"
 #include "misc.h"
+#include "cache.h"
+#include "stats.h"
+#include "trace.h"
+#include "adaptive.h"
 
 /**
  * \brief Hamlib release number
@@ -411,7 +415,7 @@ RIG *HAMLIB_API rig_init(rig_model_t rig_model)
     rs->transceive = RIG_TRN_OFF;
     rs->poll_interval = 500;
     rs->lo_freq = 0;
-    rs->cache.timeout_ms = 500;  // 500ms cache timeout by default
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, 500);  // 500ms cache timeout by default
 
     // We are using range_list1 as the default
     // Eventually we will have separate model number for different rig variations
@@ -569,7 +573,8 @@ int HAMLIB_API rig_open(RIG *rig)
     caps = rig->caps;
     rs = &rig->state;
 
-    if (strlen(rs->rigport.pathname) > 0)
+    if (strlen(rs->rigport.pathname) > 0
+            && rs->rigport.type.rig != RIG_PORT_REPLAY)
     {
         char hoststr[256], portstr[6];
         status = parse_hoststr(rs->rigport.pathname, hoststr, portstr);
@@ -1147,6 +1152,11 @@ int HAMLIB_API rig_cleanup(RIG *rig)
         rig->caps->rig_cleanup(rig);
     }
 
+    cleanup_trn_rig(rig);
+
+    trace_close(&rig->state.rigport);
+    adaptive_close(&rig->state.rigport);
+
     free(rig);
 
     return RIG_OK;
@@ -1393,6 +1403,8 @@ int HAMLIB_API rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     caps = rig->caps;
 
     vfo = vfo_fixup(rig, vfo);
@@ -1507,6 +1519,7 @@ int HAMLIB_API rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
         //future 4.1 caching
         set_cache_freq(rig, vfo, freq_new);
         rig->state.cache.vfo_freq = vfo;
+        rig_cache_publish(rig);
     }
 
     return retcode;
@@ -1595,15 +1608,18 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     cache_ms = elapsed_ms(&rig->state.cache.time_freq, HAMLIB_ELAPSED_GET);
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms && rig->state.cache.vfo_freq == vfo)
+    if (cache_ms < rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_FREQ]
+            && rig->state.cache.vfo_freq == vfo)
     {
         *freq = rig->state.cache.freq;
+        STATS_COUNT(STATS_CACHE_HITS);
         rig_debug(RIG_DEBUG_TRACE, "%s: %s cache hit age=%dms, freq=%.0f\n", __func__,
                   rig_strvfo(vfo), cache_ms, *freq);
         return RIG_OK;
     }
     else
     {
+        STATS_COUNT(STATS_CACHE_MISSES);
         rig_debug(RIG_DEBUG_TRACE,
                   "%s: cache miss age=%dms, cached_vfo=%s, asked_vfo=%s\n", __func__, cache_ms,
                   rig_strvfo(rig->state.cache.vfo_freq), rig_strvfo(vfo));
@@ -1637,6 +1653,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
             //future 4.1 caching
             set_cache_freq(rig, vfo, *freq);
             rig->state.cache.vfo_freq = vfo;
+            rig_cache_publish(rig);
         }
     }
     else
@@ -1668,6 +1685,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
             //future 4.1 caching
             set_cache_freq(rig, vfo, *freq);
             rig->state.cache.vfo_freq = vfo;
+            rig_cache_publish(rig);
             /* return the first error code */
             retcode = rc2;
         }
@@ -1698,6 +1716,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     //future 4.1 caching
     set_cache_freq(rig, vfo, *freq);
     rig->state.cache.vfo_freq = vfo;
+    if (retcode == RIG_OK) { rig_cache_publish(rig); }
 
     return retcode;
 }
@@ -1734,6 +1753,8 @@ int HAMLIB_API rig_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     caps = rig->caps;
 
     if (caps->set_mode == NULL)
@@ -1787,6 +1808,7 @@ int HAMLIB_API rig_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
 
     rig->state.cache.mode = mode;
     rig->state.cache.vfo_mode = vfo;
+    if (retcode == RIG_OK) { rig_cache_publish(rig); }
     elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_SET);
 
     return retcode;
@@ -1838,8 +1860,10 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     cache_ms = elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_GET);
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms && rig->state.cache.vfo_mode == vfo)
+    if (cache_ms < rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_MODE]
+            && rig->state.cache.vfo_mode == vfo)
     {
+        STATS_COUNT(STATS_CACHE_HITS);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
         *mode = rig->state.cache.mode;
         *width = rig->state.cache.width;
@@ -1847,6 +1871,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     }
     else
     {
+        STATS_COUNT(STATS_CACHE_MISSES);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
     }
 
@@ -1905,6 +1930,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     rig->state.cache.mode = *mode;
     rig->state.cache.width = *width;
     rig->state.cache.vfo_mode = vfo;
+    if (retcode == RIG_OK) { rig_cache_publish(rig); }
     cache_ms = elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_SET);
 
     return retcode;
@@ -2081,6 +2107,8 @@ int HAMLIB_API rig_set_vfo(RIG *rig, vfo_t vfo)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_curr(rig);
+
     if (vfo == RIG_VFO_CURR) { return RIG_OK; }
 
     // make sure we are asking for a VFO that the rig actually has
@@ -2120,6 +2148,7 @@ int HAMLIB_API rig_set_vfo(RIG *rig, vfo_t vfo)
     {
         rig->state.current_vfo = vfo;
         rig->state.cache.vfo = vfo;
+        rig_cache_publish(rig);
         rig_debug(RIG_DEBUG_TRACE, "%s: rig->state.current_vfo=%s\n", __func__,
                   rig_strvfo(vfo));
     }
@@ -2193,14 +2222,16 @@ int HAMLIB_API rig_get_vfo(RIG *rig, vfo_t *vfo)
     cache_ms = elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_GET);
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms)
+    if (cache_ms < rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_VFO])
     {
+        STATS_COUNT(STATS_CACHE_HITS);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
         *vfo = rig->state.cache.vfo;
         return RIG_OK;
     }
     else
     {
+        STATS_COUNT(STATS_CACHE_MISSES);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
     }
 
@@ -2210,6 +2241,7 @@ int HAMLIB_API rig_get_vfo(RIG *rig, vfo_t *vfo)
     {
         rig->state.current_vfo = *vfo;
         rig->state.cache.vfo = *vfo;
+        rig_cache_publish(rig);
         cache_ms = elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_SET);
     }
     else
@@ -2422,6 +2454,7 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     }
 
     rig->state.cache.ptt = ptt;
+    if (retcode == RIG_OK) { rig_cache_publish(rig); }
     elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
 
     if (retcode != RIG_OK) { rig_debug(RIG_DEBUG_ERR, "%s: return code=%d\n", __func__, retcode); }
@@ -2463,14 +2496,16 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     cache_ms = elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_GET);
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms)
+    if (cache_ms < rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_PTT])
     {
+        STATS_COUNT(STATS_CACHE_HITS);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
         *ptt = rig->state.cache.ptt;
         return RIG_OK;
     }
     else
     {
+        STATS_COUNT(STATS_CACHE_MISSES);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
     }
 
@@ -2495,6 +2530,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             if (retcode == RIG_OK)
             {
                 rig->state.cache.ptt = *ptt;
+                rig_cache_publish(rig);
                 elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
             }
 
@@ -2523,6 +2559,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             /* return the first error code */
             retcode = rc2;
             rig->state.cache.ptt = *ptt;
+            rig_cache_publish(rig);
             elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
         }
 
@@ -2537,6 +2574,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             {
                 elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
                 rig->state.cache.ptt = *ptt;
+                rig_cache_publish(rig);
             }
 
             return retcode;
@@ -2556,6 +2594,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         }
 
         rig->state.cache.ptt = *ptt;
+        if (retcode == RIG_OK) { rig_cache_publish(rig); }
         elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
         return retcode;
 
@@ -2568,6 +2607,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             {
                 elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
                 rig->state.cache.ptt = *ptt;
+                rig_cache_publish(rig);
             }
 
             return retcode;
@@ -2587,6 +2627,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         }
 
         rig->state.cache.ptt = *ptt;
+        if (retcode == RIG_OK) { rig_cache_publish(rig); }
         elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
         return retcode;
 
@@ -2599,6 +2640,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             {
                 elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
                 rig->state.cache.ptt = *ptt;
+                rig_cache_publish(rig);
             }
 
             return retcode;
@@ -2610,6 +2652,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         {
             elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
             rig->state.cache.ptt = *ptt;
+            rig_cache_publish(rig);
         }
 
         return retcode;
@@ -2623,6 +2666,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             {
                 elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
                 rig->state.cache.ptt = *ptt;
+                rig_cache_publish(rig);
             }
 
             return retcode;
@@ -2634,6 +2678,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         {
             elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
             rig->state.cache.ptt = *ptt;
+            rig_cache_publish(rig);
         }
 
         return retcode;
@@ -2648,6 +2693,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             {
                 elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
                 rig->state.cache.ptt = *ptt;
+                rig_cache_publish(rig);
             }
 
             return retcode;
@@ -3650,6 +3696,8 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_curr(rig);
+
     caps = rig->caps;
 
     if (caps->set_split_vfo == NULL)
@@ -3672,6 +3720,7 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
 
         rig->state.cache.split = split;
         rig->state.cache.split_vfo = tx_vfo;
+        if (retcode == RIG_OK) { rig_cache_publish(rig); }
         elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
         return retcode;
     }
@@ -3707,6 +3756,7 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
 
     rig->state.cache.split = split;
     rig->state.cache.split_vfo = tx_vfo;
+    if (retcode == RIG_OK) { rig_cache_publish(rig); }
     elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
     return retcode;
 }
@@ -3760,8 +3810,9 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     cache_ms = elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_GET);
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms)
+    if (cache_ms < rig->state.cache.timeout_kind_ms[HAMLIB_CACHE_SPLIT])
     {
+        STATS_COUNT(STATS_CACHE_HITS);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
         *split = rig->state.cache.split;
         *tx_vfo = rig->state.cache.split_vfo;
@@ -3769,6 +3820,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     }
     else
     {
+        STATS_COUNT(STATS_CACHE_MISSES);
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
     }
 
@@ -3782,6 +3834,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
         retcode = caps->get_split_vfo(rig, vfo, split, tx_vfo);
         rig->state.cache.split = *split;
         rig->state.cache.split_vfo = *tx_vfo;
+        if (retcode == RIG_OK) { rig_cache_publish(rig); }
         elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
         return retcode;
     }
@@ -3819,6 +3872,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     {
         rig->state.cache.split = *split;
         rig->state.cache.split_vfo = *tx_vfo;
+        rig_cache_publish(rig);
         elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
     }
 
@@ -3860,6 +3914,9 @@ int HAMLIB_API rig_set_rit(RIG *rig, vfo_t vfo, shortfreq_t rit)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_RIT, 0);
+    rig_cache_invalidate(rig, HAMLIB_CACHE_FUNC, RIG_FUNC_RIT);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_RITXIT)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -3913,6 +3970,8 @@ int HAMLIB_API rig_get_rit(RIG *rig, vfo_t vfo, shortfreq_t *rit)
     const struct rig_caps *caps;
     int retcode, rc2;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    value_t val;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -3928,11 +3987,27 @@ int HAMLIB_API rig_get_rit(RIG *rig, vfo_t vfo, shortfreq_t *rit)
         return -RIG_ENAVAIL;
     }
 
+    cached = rig_cache_find(rig, HAMLIB_CACHE_RIT, vfo, 0);
+
+    if (cached)
+    {
+        *rit = cached->val.i;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_RITXIT)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
-        return caps->get_rit(rig, vfo, rit);
+        retcode = caps->get_rit(rig, vfo, rit);
+
+        if (RIG_OK == retcode)
+        {
+            val.i = *rit;
+            rig_cache_store(rig, HAMLIB_CACHE_RIT, vfo, 0, val);
+        }
+
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -3958,6 +4033,12 @@ int HAMLIB_API rig_get_rit(RIG *rig, vfo_t vfo, shortfreq_t *rit)
         retcode = rc2;
     }
 
+    if (RIG_OK == retcode)
+    {
+        val.i = *rit;
+        rig_cache_store(rig, HAMLIB_CACHE_RIT, vfo, 0, val);
+    }
+
     return retcode;
 }
 
@@ -3996,6 +4077,9 @@ int HAMLIB_API rig_set_xit(RIG *rig, vfo_t vfo, shortfreq_t xit)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_XIT, 0);
+    rig_cache_invalidate(rig, HAMLIB_CACHE_FUNC, RIG_FUNC_XIT);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_RITXIT)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -4049,6 +4133,8 @@ int HAMLIB_API rig_get_xit(RIG *rig, vfo_t vfo, shortfreq_t *xit)
     const struct rig_caps *caps;
     int retcode, rc2;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    value_t val;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -4064,11 +4150,27 @@ int HAMLIB_API rig_get_xit(RIG *rig, vfo_t vfo, shortfreq_t *xit)
         return -RIG_ENAVAIL;
     }
 
+    cached = rig_cache_find(rig, HAMLIB_CACHE_XIT, vfo, 0);
+
+    if (cached)
+    {
+        *xit = cached->val.i;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_RITXIT)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
-        return caps->get_xit(rig, vfo, xit);
+        retcode = caps->get_xit(rig, vfo, xit);
+
+        if (RIG_OK == retcode)
+        {
+            val.i = *xit;
+            rig_cache_store(rig, HAMLIB_CACHE_XIT, vfo, 0, val);
+        }
+
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -4094,6 +4196,12 @@ int HAMLIB_API rig_get_xit(RIG *rig, vfo_t vfo, shortfreq_t *xit)
         retcode = rc2;
     }
 
+    if (RIG_OK == retcode)
+    {
+        val.i = *xit;
+        rig_cache_store(rig, HAMLIB_CACHE_XIT, vfo, 0, val);
+    }
+
     return retcode;
 }
 
@@ -4132,6 +4240,8 @@ int HAMLIB_API rig_set_ts(RIG *rig, vfo_t vfo, shortfreq_t ts)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_TS, 0);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_PURE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -4185,6 +4295,8 @@ int HAMLIB_API rig_get_ts(RIG *rig, vfo_t vfo, shortfreq_t *ts)
     const struct rig_caps *caps;
     int retcode, rc2;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    value_t val;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -4200,11 +4312,27 @@ int HAMLIB_API rig_get_ts(RIG *rig, vfo_t vfo, shortfreq_t *ts)
         return -RIG_ENAVAIL;
     }
 
+    cached = rig_cache_find(rig, HAMLIB_CACHE_TS, vfo, 0);
+
+    if (cached)
+    {
+        *ts = cached->val.i;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_PURE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
-        return caps->get_ts(rig, vfo, ts);
+        retcode = caps->get_ts(rig, vfo, ts);
+
+        if (RIG_OK == retcode)
+        {
+            val.i = *ts;
+            rig_cache_store(rig, HAMLIB_CACHE_TS, vfo, 0, val);
+        }
+
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -4230,6 +4358,12 @@ int HAMLIB_API rig_get_ts(RIG *rig, vfo_t vfo, shortfreq_t *ts)
         retcode = rc2;
     }
 
+    if (RIG_OK == retcode)
+    {
+        val.i = *ts;
+        rig_cache_store(rig, HAMLIB_CACHE_TS, vfo, 0, val);
+    }
+
     return retcode;
 }
 
@@ -4273,6 +4407,8 @@ int HAMLIB_API rig_set_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t option)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate_kind(rig, HAMLIB_CACHE_ANT);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_PURE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -4331,6 +4467,7 @@ int HAMLIB_API rig_get_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t *option,
     const struct rig_caps *caps;
     int retcode, rc2;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -4348,11 +4485,36 @@ int HAMLIB_API rig_get_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t *option,
         return -RIG_ENAVAIL;
     }
 
+    cached = rig_cache_find(rig, HAMLIB_CACHE_ANT, vfo, ant);
+
+    if (cached)
+    {
+        *option = cached->val;
+        *ant_curr = cached->ant_curr;
+        *ant_tx = cached->ant_tx;
+        *ant_rx = cached->ant_rx;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_PURE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
-        return caps->get_ant(rig, vfo, ant, option, ant_curr, ant_tx, ant_rx);
+        retcode = caps->get_ant(rig, vfo, ant, option, ant_curr, ant_tx, ant_rx);
+
+        if (RIG_OK == retcode)
+        {
+            cached = rig_cache_store(rig, HAMLIB_CACHE_ANT, vfo, ant, *option);
+
+            if (cached)
+            {
+                cached->ant_curr = *ant_curr;
+                cached->ant_tx = *ant_tx;
+                cached->ant_rx = *ant_rx;
+            }
+        }
+
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -4378,6 +4540,18 @@ int HAMLIB_API rig_get_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t *option,
         retcode = rc2;
     }
 
+    if (RIG_OK == retcode)
+    {
+        cached = rig_cache_store(rig, HAMLIB_CACHE_ANT, vfo, ant, *option);
+
+        if (cached)
+        {
+            cached->ant_curr = *ant_curr;
+            cached->ant_tx = *ant_tx;
+            cached->ant_rx = *ant_rx;
+        }
+    }
+
     return retcode;
 }
 
@@ -4566,6 +4740,8 @@ int HAMLIB_API rig_set_powerstat(RIG *rig, powerstat_t status)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     if (rig->caps->set_powerstat == NULL)
     {
         rig_debug(RIG_DEBUG_WARN, "%s set_powerstat not implemented\n", __func__);
@@ -4631,6 +4807,8 @@ int HAMLIB_API rig_reset(RIG *rig, reset_t reset)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     if (rig->caps->reset == NULL)
     {
         return -RIG_ENAVAIL;
@@ -4765,6 +4943,8 @@ int HAMLIB_API rig_vfo_op(RIG *rig, vfo_t vfo, vfo_op_t op)
         return -RIG_EINVAL;
     }
 
+    rig_cache_invalidate_all(rig);
+
     caps = rig->caps;
 
     if (caps->vfo_op == NULL || !rig_has_vfo_op(rig, op))
@@ -81,6 +81,7 @@
 #include <hamlib/rig.h>
 #include "serial.h"
 #include "misc.h"
+#include "iofunc.h"
 
 #ifdef HAVE_SYS_IOCCOM_H
 #  include <sys/ioccom.h>
@@ -607,6 +608,9 @@ int HAMLIB_API serial_flush(hamlib_port_t *p)
 {
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    port_write_wait(p);
+    port_rxbuf_flush(p);
+
     if (p->fd == uh_ptt_fd || p->fd == uh_radio_fd)
     {
         unsigned char buf[32];
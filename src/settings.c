@@ -48,6 +48,7 @@
 #include <hamlib/rig.h>
 #include <hamlib/amplifier.h>
 #include "cal.h"
+#include "cache.h"
 
 
 #ifndef DOC_HIDDEN
@@ -94,6 +95,8 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_LEVEL, level);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_LEVEL)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -149,6 +152,9 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
     const struct rig_caps *caps;
     int retcode;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    /* meters change all by themselves, never cache them */
+    int cacheable = !(level & RIG_LEVEL_READONLY_LIST);
 
     // too verbose
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -187,13 +193,26 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
         return RIG_OK;
     }
 
+    cached = cacheable ? rig_cache_find(rig, HAMLIB_CACHE_LEVEL, vfo, level) : NULL;
+
+    if (cached)
+    {
+        *val = cached->val;
+        return RIG_OK;
+    }
 
     if ((caps->targetable_vfo & RIG_TARGETABLE_LEVEL)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
+        retcode = caps->get_level(rig, vfo, level, val);
+
+        if (RIG_OK == retcode && cacheable)
+        {
+            rig_cache_store(rig, HAMLIB_CACHE_LEVEL, vfo, level, *val);
+        }
 
-        return caps->get_level(rig, vfo, level, val);
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -211,6 +230,12 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
 
     retcode = caps->get_level(rig, vfo, level, val);
     caps->set_vfo(rig, curr_vfo);
+
+    if (RIG_OK == retcode && cacheable)
+    {
+        rig_cache_store(rig, HAMLIB_CACHE_LEVEL, vfo, level, *val);
+    }
+
     return retcode;
 }
 
@@ -527,6 +552,18 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_FUNC, func);
+
+    if (func & RIG_FUNC_RIT)
+    {
+        rig_cache_invalidate(rig, HAMLIB_CACHE_RIT, 0);
+    }
+
+    if (func & RIG_FUNC_XIT)
+    {
+        rig_cache_invalidate(rig, HAMLIB_CACHE_XIT, 0);
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_FUNC)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -585,6 +622,8 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
     const struct rig_caps *caps;
     int retcode;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    value_t val;
 
     // too verbose
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -601,12 +640,27 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
         return -RIG_ENAVAIL;
     }
 
+    cached = rig_cache_find(rig, HAMLIB_CACHE_FUNC, vfo, func);
+
+    if (cached)
+    {
+        *status = cached->val.i;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_FUNC)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
+        retcode = caps->get_func(rig, vfo, func, status);
+
+        if (RIG_OK == retcode)
+        {
+            val.i = *status;
+            rig_cache_store(rig, HAMLIB_CACHE_FUNC, vfo, func, val);
+        }
 
-        return caps->get_func(rig, vfo, func, status);
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -625,6 +679,12 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
     retcode = caps->get_func(rig, vfo, func, status);
     caps->set_vfo(rig, curr_vfo);
 
+    if (RIG_OK == retcode)
+    {
+        val.i = *status;
+        rig_cache_store(rig, HAMLIB_CACHE_FUNC, vfo, func, val);
+    }
+
     return retcode;
 }
 
@@ -0,0 +1,259 @@
+/**
+ * \addtogroup rig_internal
+ * @{
+ */
+
+/**
+ * \file src/stats.c
+ * \brief Latency histograms and counters
+ *
+ * Port I/O calls, read timeouts, backend retries and cache hits are
+ * accounted here while statistics are enabled.  When they are not, the
+ * instrumented code only tests rig_stats_on.
+ */
+/*
+ *  Hamlib Interface - latency statistics
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+#include <time.h>
+
+#include <hamlib/rig.h>
+#include "stats.h"
+
+int rig_stats_on;
+
+static struct stats_hist call_hist[STATS_CALLS];
+static uint64_t counters[STATS_COUNTERS];
+
+static const char *call_names[STATS_CALLS] =
+{
+    "write_block", "read_string", "read_block"
+};
+
+static const char *counter_names[STATS_COUNTERS] =
+{
+    "timeouts", "retries", "cache_hits", "cache_misses", "tx_bytes", "rx_bytes"
+};
+
+
+void HAMLIB_API rig_stats_enable(int enable)
+{
+    __atomic_store_n(&rig_stats_on, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+
+int HAMLIB_API rig_stats_enabled(void)
+{
+    return __atomic_load_n(&rig_stats_on, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Clear the library statistics.  Updates racing with it may survive.
+ */
+void HAMLIB_API rig_stats_reset(void)
+{
+    memset(call_hist, 0, sizeof(call_hist));
+    memset(counters, 0, sizeof(counters));
+}
+
+
+uint64_t HAMLIB_API rig_stats_now_us(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static int hist_index(uint64_t us)
+{
+    int e = 0;
+
+    if (us < 4)
+    {
+        return us;
+    }
+
+    while ((us >> e) >= 8)
+    {
+        e++;
+    }
+
+    /* us >> e is 4..7, the top bit and the 2 bits below it */
+    e = e * 4 + (int)(us >> e);
+
+    return e < STATS_HIST_BUCKETS ? e : STATS_HIST_BUCKETS - 1;
+}
+
+
+/* smallest value falling into bucket i */
+static uint64_t hist_value(int i)
+{
+    if (i < 4)
+    {
+        return i;
+    }
+
+    return (uint64_t)(4 + i % 4) << (i / 4 - 1);
+}
+
+
+void HAMLIB_API rig_stats_hist_add(struct stats_hist *h, uint64_t us)
+{
+    uint64_t max = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_us, us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->bucket[hist_index(us)], 1, __ATOMIC_RELAXED);
+
+    while (us > max
+            && !__atomic_compare_exchange_n(&h->max_us, &max, us, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+
+/*
+ * Upper bound of the bucket holding the given fraction of the samples,
+ * no more than the largest sample seen
+ */
+uint64_t HAMLIB_API rig_stats_hist_percentile(const struct stats_hist *h,
+        double fraction)
+{
+    uint64_t count = h->count;
+    uint64_t rank = (uint64_t)(count * fraction + 0.5);
+    uint64_t seen = 0;
+    uint64_t value;
+    int i;
+
+    for (i = 0; i < STATS_HIST_BUCKETS - 1; i++)
+    {
+        seen += h->bucket[i];
+
+        if (seen >= rank && seen > 0)
+        {
+            break;
+        }
+    }
+
+    value = i < STATS_HIST_BUCKETS - 1 ? hist_value(i + 1) - 1 : h->max_us;
+
+    return value < h->max_us ? value : h->max_us;
+}
+
+
+/*
+ * One line: name: count avg p50 p90 p99 max, all times in us
+ */
+void HAMLIB_API rig_stats_hist_print(FILE *fout, const char *name,
+                                     const struct stats_hist *h, char sep)
+{
+    uint64_t count = h->count;
+
+    if (count == 0)
+    {
+        fprintf(fout, "%s: count=0%c", name, sep);
+        return;
+    }
+
+    fprintf(fout,
+            "%s: count=%llu avg=%lluus p50=%lluus p90=%lluus p99=%lluus max=%lluus%c",
+            name,
+            (unsigned long long)count,
+            (unsigned long long)(h->sum_us / count),
+            (unsigned long long)rig_stats_hist_percentile(h, 0.50),
+            (unsigned long long)rig_stats_hist_percentile(h, 0.90),
+            (unsigned long long)rig_stats_hist_percentile(h, 0.99),
+            (unsigned long long)h->max_us,
+            sep);
+}
+
+
+void HAMLIB_API rig_stats_count(enum stats_counter c)
+{
+    __atomic_fetch_add(&counters[c], 1, __ATOMIC_RELAXED);
+}
+
+
+void HAMLIB_API rig_stats_add(enum stats_counter c, uint64_t n)
+{
+    __atomic_fetch_add(&counters[c], n, __ATOMIC_RELAXED);
+}
+
+
+uint64_t HAMLIB_API rig_stats_get_count(enum stats_counter c)
+{
+    return __atomic_load_n(&counters[c], __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Account a port I/O call started at start_us, reads returning the
+ * number of bytes read
+ */
+void HAMLIB_API rig_stats_call(enum stats_call call, uint64_t start_us,
+                               int retval)
+{
+    rig_stats_hist_add(&call_hist[call], rig_stats_now_us() - start_us);
+
+    if (retval == -RIG_ETIMEOUT)
+    {
+        rig_stats_count(STATS_TIMEOUTS);
+    }
+    else if (retval > 0 && call != STATS_WRITE_BLOCK)
+    {
+        rig_stats_add(STATS_RX_BYTES, retval);
+    }
+}
+
+
+/*
+ * Print the library statistics, one item per line
+ */
+void HAMLIB_API rig_stats_print(FILE *fout, char sep)
+{
+    int i;
+
+    for (i = 0; i < STATS_CALLS; i++)
+    {
+        rig_stats_hist_print(fout, call_names[i], &call_hist[i], sep);
+    }
+
+    for (i = 0; i < STATS_COUNTERS; i++)
+    {
+        fprintf(fout, "%s: %llu%c", counter_names[i],
+                (unsigned long long)counters[i], sep);
+    }
+}
+
+/** @} */
@@ -0,0 +1,88 @@
+/*
+ *  Hamlib Interface - latency statistics header
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _STATS_H
+#define _STATS_H 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <hamlib/rig.h>
+
+__BEGIN_DECLS
+
+/*
+ * Latency histogram in microseconds, log-linear buckets: 4 per power
+ * of 2, i.e. within 25% of the value, from 1 us to over half an hour.
+ */
+#define STATS_HIST_BUCKETS 128
+
+struct stats_hist
+{
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint32_t bucket[STATS_HIST_BUCKETS];
+};
+
+/* port I/O calls timed by iofunc.c */
+enum stats_call
+{
+    STATS_WRITE_BLOCK,
+    STATS_READ_STRING,
+    STATS_READ_BLOCK,
+    STATS_CALLS
+};
+
+enum stats_counter
+{
+    STATS_TIMEOUTS,         /* reads that timed out */
+    STATS_RETRIES,          /* backend transaction retries */
+    STATS_CACHE_HITS,
+    STATS_CACHE_MISSES,
+    STATS_TX_BYTES,         /* bytes written to the ports */
+    STATS_RX_BYTES,         /* bytes read from the ports */
+    STATS_COUNTERS
+};
+
+/* Hamlib internal use, exported for rigctld and the tests, see stats.c */
+extern int rig_stats_on;
+
+#define STATS_COUNT(c) do { if (rig_stats_on) { rig_stats_count(c); } } while (0)
+
+extern HAMLIB_EXPORT(void) rig_stats_enable(int enable);
+extern HAMLIB_EXPORT(int) rig_stats_enabled(void);
+extern HAMLIB_EXPORT(void) rig_stats_reset(void);
+extern HAMLIB_EXPORT(uint64_t) rig_stats_now_us(void);
+extern HAMLIB_EXPORT(void) rig_stats_hist_add(struct stats_hist *h, uint64_t us);
+extern HAMLIB_EXPORT(uint64_t) rig_stats_hist_percentile(const struct stats_hist *h,
+        double fraction);
+extern HAMLIB_EXPORT(void) rig_stats_hist_print(FILE *fout, const char *name,
+        const struct stats_hist *h, char sep);
+extern HAMLIB_EXPORT(void) rig_stats_count(enum stats_counter c);
+extern HAMLIB_EXPORT(void) rig_stats_add(enum stats_counter c, uint64_t n);
+extern HAMLIB_EXPORT(uint64_t) rig_stats_get_count(enum stats_counter c);
+extern HAMLIB_EXPORT(void) rig_stats_call(enum stats_call call, uint64_t start_us,
+                                          int retval);
+extern HAMLIB_EXPORT(void) rig_stats_print(FILE *fout, char sep);
+
+__END_DECLS
+
+#endif /* _STATS_H */
@@ -110,6 +110,20 @@
 #define TOK_AUTO_POWER_ON  TOKEN_FRONTEND(124)
 /** \brief rig: Auto disable screensaver */
 #define TOK_AUTO_DISABLE_SCREENSAVER  TOKEN_FRONTEND(125)
+/** \brief rig: Binary trace file of the rig port I/O */
+#define TOK_TRACE_FILE  TOKEN_FRONTEND(126)
+/** \brief rig: Trace file replayed instead of talking to a rig */
+#define TOK_REPLAY_FILE  TOKEN_FRONTEND(127)
+/** \brief rig: Replay at the recorded pace */
+#define TOK_REPLAY_TIMING  TOKEN_FRONTEND(128)
+/** \brief rig: Learn the port timeout from the observed answers */
+#define TOK_ADAPTIVE_TIMEOUT  TOKEN_FRONTEND(129)
+/** \brief rig: Lowest adaptive timeout */
+#define TOK_TIMEOUT_MIN  TOKEN_FRONTEND(130)
+/** \brief rig: Highest adaptive timeout */
+#define TOK_TIMEOUT_MAX  TOKEN_FRONTEND(131)
+/** \brief rig: Learned timeouts, setting it starts over */
+#define TOK_TIMEOUT_LEARNED  TOKEN_FRONTEND(132)
 /*
  * rotator specific tokens
  * (strictly, should be documented as rotator_internal)
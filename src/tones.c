@@ -38,6 +38,7 @@
 
 #include <hamlib/rig.h>
 #include "tones.h"
+#include "cache.h"
 
 #if !defined(_WIN32) && !defined(__CYGWIN__)
 
@@ -117,6 +118,8 @@ int HAMLIB_API rig_set_ctcss_tone(RIG *rig, vfo_t vfo, tone_t tone)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_CTCSS, 0);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_TONE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -169,6 +172,8 @@ int HAMLIB_API rig_get_ctcss_tone(RIG *rig, vfo_t vfo, tone_t *tone)
     const struct rig_caps *caps;
     int retcode;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    value_t val;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -184,12 +189,28 @@ int HAMLIB_API rig_get_ctcss_tone(RIG *rig, vfo_t vfo, tone_t *tone)
         return -RIG_ENAVAIL;
     }
 
+    /* id 0 is the encoder tone, 1 the squelch tone */
+    cached = rig_cache_find(rig, HAMLIB_CACHE_CTCSS, vfo, 0);
+
+    if (cached)
+    {
+        *tone = cached->val.i;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_TONE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
+        retcode = caps->get_ctcss_tone(rig, vfo, tone);
 
-        return caps->get_ctcss_tone(rig, vfo, tone);
+        if (RIG_OK == retcode)
+        {
+            val.i = *tone;
+            rig_cache_store(rig, HAMLIB_CACHE_CTCSS, vfo, 0, val);
+        }
+
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -208,6 +229,12 @@ int HAMLIB_API rig_get_ctcss_tone(RIG *rig, vfo_t vfo, tone_t *tone)
     retcode = caps->get_ctcss_tone(rig, vfo, tone);
     caps->set_vfo(rig, curr_vfo);
 
+    if (RIG_OK == retcode)
+    {
+        val.i = *tone;
+        rig_cache_store(rig, HAMLIB_CACHE_CTCSS, vfo, 0, val);
+    }
+
     return retcode;
 }
 
@@ -379,6 +406,8 @@ int HAMLIB_API rig_set_ctcss_sql(RIG *rig, vfo_t vfo, tone_t tone)
         return -RIG_ENAVAIL;
     }
 
+    rig_cache_invalidate(rig, HAMLIB_CACHE_CTCSS, 1);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_TONE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -431,6 +460,8 @@ int HAMLIB_API rig_get_ctcss_sql(RIG *rig, vfo_t vfo, tone_t *tone)
     const struct rig_caps *caps;
     int retcode;
     vfo_t curr_vfo;
+    struct rig_cache_setting *cached;
+    value_t val;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -446,12 +477,27 @@ int HAMLIB_API rig_get_ctcss_sql(RIG *rig, vfo_t vfo, tone_t *tone)
         return -RIG_ENAVAIL;
     }
 
+    cached = rig_cache_find(rig, HAMLIB_CACHE_CTCSS, vfo, 1);
+
+    if (cached)
+    {
+        *tone = cached->val.i;
+        return RIG_OK;
+    }
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_TONE)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
     {
+        retcode = caps->get_ctcss_sql(rig, vfo, tone);
 
-        return caps->get_ctcss_sql(rig, vfo, tone);
+        if (RIG_OK == retcode)
+        {
+            val.i = *tone;
+            rig_cache_store(rig, HAMLIB_CACHE_CTCSS, vfo, 1, val);
+        }
+
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -470,6 +516,12 @@ int HAMLIB_API rig_get_ctcss_sql(RIG *rig, vfo_t vfo, tone_t *tone)
     retcode = caps->get_ctcss_sql(rig, vfo, tone);
     caps->set_vfo(rig, curr_vfo);
 
+    if (RIG_OK == retcode)
+    {
+        val.i = *tone;
+        rig_cache_store(rig, HAMLIB_CACHE_CTCSS, vfo, 1, val);
+    }
+
     return retcode;
 }
 
@@ -0,0 +1,454 @@
+/**
+ * \addtogroup rig_internal
+ * @{
+ */
+
+/**
+ * \file src/trace.c
+ * \brief Binary wire tracer
+ *
+ * Every byte written to or read from a traced port is stored with a
+ * time stamp in a ring buffer of the port, without any formatting.  A
+ * writer thread moves the records from the ring to the trace file, so
+ * that tracing hardly changes the timing of the rig conversation.  The
+ * rigtrace program decodes trace files.
+ */
+/*
+ *  Hamlib Interface - wire tracer
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+#include "trace.h"
+#include "stats.h"
+
+/* must be a power of 2 */
+#define TRACE_RING_SIZE (64 * 1024)
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+/* largest record, bigger writes are cut in pieces */
+#define TRACE_CHUNK 4096
+
+/* how often the writer thread empties the ring, in ms */
+#define TRACE_FLUSH_MS 50
+
+/*
+ * The port I/O path is the only producer, so head and tail are enough to
+ * share the ring lock free.  Consumers, the writer thread and the exit
+ * handler, take the lock of the trace.
+ */
+struct port_trace
+{
+    struct port_trace *next;    /* list of open traces */
+    char pathname[FILPATHLEN];
+    FILE *fp;
+    uint64_t head;          /* written by the producer */
+    uint64_t tail;          /* written by the consumer */
+    uint32_t lost;          /* records dropped, producer only */
+#ifdef HAVE_PTHREAD
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+#endif
+    unsigned char ring[TRACE_RING_SIZE];
+};
+
+static struct port_trace *traces;
+static int traces_registered;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t traces_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+static void put_le(unsigned char *p, uint64_t val, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        p[i] = val >> (8 * i);
+    }
+}
+
+
+/* consumer side: write out everything the producer has published */
+static void trace_drain(struct port_trace *t)
+{
+    uint64_t head = __atomic_load_n(&t->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = t->tail;
+
+    if (tail == head)
+    {
+        return;
+    }
+
+    while (tail != head)
+    {
+        size_t off = tail & TRACE_RING_MASK;
+        size_t len = head - tail;
+
+        if (len > TRACE_RING_SIZE - off)
+        {
+            len = TRACE_RING_SIZE - off;
+        }
+
+        fwrite(t->ring + off, 1, len, t->fp);
+        tail += len;
+    }
+
+    __atomic_store_n(&t->tail, tail, __ATOMIC_RELEASE);
+
+    fflush(t->fp);
+}
+
+
+#ifdef HAVE_PTHREAD
+static void *trace_writer(void *arg)
+{
+    struct port_trace *t = arg;
+    int stop = 0;
+
+    while (!stop)
+    {
+        struct timeval tv;
+        struct timespec ts;
+
+        gettimeofday(&tv, NULL);
+        ts.tv_sec = tv.tv_sec;
+        ts.tv_nsec = tv.tv_usec * 1000 + TRACE_FLUSH_MS * 1000000L;
+
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&t->lock);
+
+        if (!t->stop)
+        {
+            pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+        }
+
+        stop = t->stop;
+        trace_drain(t);
+        pthread_mutex_unlock(&t->lock);
+    }
+
+    return NULL;
+}
+#endif
+
+
+/*
+ * Programs often exit without closing the rig, write out what the open
+ * traces still hold then.
+ */
+static void trace_atexit(void)
+{
+    struct port_trace *t;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&traces_lock);
+#endif
+
+    for (t = traces; t; t = t->next)
+    {
+#ifdef HAVE_PTHREAD
+        pthread_mutex_lock(&t->lock);
+#endif
+        trace_drain(t);
+#ifdef HAVE_PTHREAD
+        pthread_mutex_unlock(&t->lock);
+#endif
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&traces_lock);
+#endif
+}
+
+
+/* producer side: copy len bytes at *head, wrapping around the ring */
+static void ring_put(struct port_trace *t, uint64_t *head, const void *data,
+                     size_t len)
+{
+    size_t off = *head & TRACE_RING_MASK;
+    size_t first = len < TRACE_RING_SIZE - off ? len : TRACE_RING_SIZE - off;
+
+    memcpy(t->ring + off, data, first);
+    memcpy(t->ring, (const unsigned char *)data + first, len - first);
+    *head += len;
+}
+
+
+/* producer side: store one record, 0 if the ring has no room for it */
+static int ring_record(struct port_trace *t, int type,
+                       const unsigned char *data, size_t len)
+{
+    uint64_t head = t->head;
+    uint64_t tail = __atomic_load_n(&t->tail, __ATOMIC_ACQUIRE);
+    unsigned char hdr[TRACE_RECORD_LEN];
+
+    if (TRACE_RING_SIZE - (head - tail) < TRACE_RECORD_LEN + len)
+    {
+        return 0;
+    }
+
+    put_le(hdr, rig_stats_now_us(), 8);
+    hdr[8] = type;
+    hdr[9] = 0;
+    put_le(hdr + 10, len, 2);
+
+    ring_put(t, &head, hdr, sizeof(hdr));
+
+    if (len > 0)
+    {
+        ring_put(t, &head, data, len);
+    }
+
+    __atomic_store_n(&t->head, head, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+
+/*
+ * Record one I/O event of the port, cut in pieces of TRACE_CHUNK bytes.
+ * When the ring is full the record is dropped and counted, the count
+ * being stored as a TRACE_LOST record as soon as there is room again.
+ */
+void HAMLIB_API trace_record(hamlib_port_t *p, int type,
+                             const unsigned char *data, size_t len)
+{
+    struct port_trace *t = p->trace;
+
+    if (!t)
+    {
+        return;
+    }
+
+    do
+    {
+        size_t chunk = len < TRACE_CHUNK ? len : TRACE_CHUNK;
+
+#ifndef HAVE_PTHREAD
+        /* no writer thread, empty the ring on the spot */
+        if (TRACE_RING_SIZE - (t->head - t->tail)
+                < 2 * TRACE_RECORD_LEN + 4 + chunk)
+        {
+            trace_drain(t);
+        }
+
+#endif
+
+        if (t->lost)
+        {
+            unsigned char count[4];
+
+            put_le(count, t->lost, 4);
+
+            if (!ring_record(t, TRACE_LOST, count, sizeof(count)))
+            {
+                t->lost++;
+                return;
+            }
+
+            t->lost = 0;
+        }
+
+        if (!ring_record(t, type, data, chunk))
+        {
+            t->lost++;
+            return;
+        }
+
+        data += chunk;
+        len -= chunk;
+    }
+    while (len > 0);
+}
+
+
+/**
+ * \brief Start tracing the I/O of a port
+ * \param p port to trace
+ * \param path trace file, an empty string stops tracing
+ * \param model rig model, saved in the file for the decoder
+ * \return RIG_OK or < 0 if error
+ *
+ * Any trace in progress on the port is closed first.
+ */
+int HAMLIB_API trace_open(hamlib_port_t *p, const char *path,
+                          rig_model_t model)
+{
+    struct port_trace *t;
+    unsigned char hdr[TRACE_HEADER_LEN];
+    struct timeval tv;
+
+    trace_close(p);
+
+    if (!path || !*path)
+    {
+        return RIG_OK;
+    }
+
+    t = calloc(1, sizeof(struct port_trace));
+
+    if (!t)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    strncpy(t->pathname, path, FILPATHLEN - 1);
+    t->fp = fopen(path, "wb");
+
+    if (!t->fp)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot open %s: %s\n", __func__, path,
+                  strerror(errno));
+        free(t);
+        return -RIG_EIO;
+    }
+
+    gettimeofday(&tv, NULL);
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, TRACE_MAGIC, 8);
+    put_le(hdr + 8, model, 4);
+    put_le(hdr + 16, (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec, 8);
+    put_le(hdr + 24, rig_stats_now_us(), 8);
+    fwrite(hdr, 1, sizeof(hdr), t->fp);
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+
+    if (pthread_create(&t->thread, NULL, trace_writer, t) != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot start the writer thread\n", __func__);
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->cond);
+        fclose(t->fp);
+        free(t);
+        return -RIG_EINTERNAL;
+    }
+
+#endif
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: tracing to %s\n", __func__, path);
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&traces_lock);
+#endif
+
+    if (!traces_registered)
+    {
+        atexit(trace_atexit);
+        traces_registered = 1;
+    }
+
+    t->next = traces;
+    traces = t;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&traces_lock);
+#endif
+
+    p->trace = t;
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief Stop tracing a port, writing out what is left in the ring
+ * \param p traced port
+ */
+void HAMLIB_API trace_close(hamlib_port_t *p)
+{
+    struct port_trace *t = p->trace;
+    struct port_trace **pt;
+
+    if (!t)
+    {
+        return;
+    }
+
+    p->trace = NULL;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&traces_lock);
+#endif
+
+    for (pt = &traces; *pt != t; pt = &(*pt)->next)
+    {
+    }
+
+    *pt = t->next;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&traces_lock);
+#endif
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&t->lock);
+    t->stop = 1;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+
+    pthread_join(t->thread, NULL);
+
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+#endif
+
+    trace_drain(t);
+    fclose(t->fp);
+    free(t);
+}
+
+
+/**
+ * \brief Name of the trace file of a port
+ * \param p port
+ * \return the path, empty if the port is not traced
+ */
+const char *HAMLIB_API trace_pathname(const hamlib_port_t *p)
+{
+    return p->trace ? p->trace->pathname : "";
+}
+
+/** @} */
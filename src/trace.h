@@ -0,0 +1,57 @@
+/*
+ *  Hamlib Interface - wire tracer header
+ *  Copyright (c) 2020 by the Hamlib Group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H 1
+
+#include <hamlib/rig.h>
+
+__BEGIN_DECLS
+
+/*
+ * Trace file layout, all integers little endian:
+ *
+ * header   "HLTRACE1", u32 rig model, u32 reserved,
+ *          u64 wall clock and u64 monotonic clock at start, in us
+ * records  u64 monotonic time in us, u8 type, u8 reserved, u16 length,
+ *          then length bytes of data
+ */
+#define TRACE_MAGIC         "HLTRACE1"
+#define TRACE_HEADER_LEN    32
+#define TRACE_RECORD_LEN    12
+
+/* record types */
+#define TRACE_TX        'T'     /* bytes written to the rig */
+#define TRACE_RX        'R'     /* bytes read from the rig */
+#define TRACE_TIMEOUT   'O'     /* read timed out, no data */
+#define TRACE_FLUSH     'F'     /* receive buffer discarded, no data */
+#define TRACE_LOST      'L'     /* u32 count of records dropped on overrun */
+
+extern HAMLIB_EXPORT(int) trace_open(hamlib_port_t *p, const char *path,
+                                     rig_model_t model);
+extern HAMLIB_EXPORT(void) trace_close(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) trace_record(hamlib_port_t *p, int type,
+                                        const unsigned char *data, size_t len);
+extern HAMLIB_EXPORT(const char *) trace_pathname(const hamlib_port_t *p);
+
+__END_DECLS
+
+#endif /* _TRACE_H */
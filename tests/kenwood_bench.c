@@ -0,0 +1,167 @@
+/*
+ * Hamlib kenwood_bench program
+ *
+ * Measures the CPU time kenwood_transaction() takes per command, as a
+ * high rate poller would drive it, against a rig simulator on a pty:
+ *
+ *   $ simulators/simkenwood &
+ *   /dev/pts/3
+ *   $ tests/kenwood_bench /dev/pts/3
+ *
+ * Each loop reads FA, MD and IF, then sets FA and MD, with the frontend
+ * cache off.  The wall time is mostly the pty round trips and the system
+ * time the syscalls, the user time is what the transaction code costs.
+ *
+ * Usage: kenwood_bench PTY [loops [model]]
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <hamlib/rig.h>
+#include "testutil.h"
+
+#define LOOP_COUNT 2000
+
+/* from rigs/kenwood/kenwood.h, exported by the library */
+extern int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
+                               size_t datasize);
+
+static const struct
+{
+    const char *cmd;
+    int reply;
+} mix[] =
+{
+    { "FA", 1 },
+    { "MD", 1 },
+    { "IF", 1 },
+    { "FA00014074000", 0 },
+    { "MD2", 0 },
+};
+
+#define MIX_LEN (sizeof(mix) / sizeof(mix[0]))
+
+
+static double seconds(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1000000.0;
+}
+
+
+/* CPU time of the process in user mode, and in the kernel */
+static void cpu_seconds(double *user, double *sys)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    *user = seconds(&ru.ru_utime);
+    *sys = seconds(&ru.ru_stime);
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *rig;
+    rig_model_t model = 2031;   /* TS-590S, as simkenwood */
+    int loops = LOOP_COUNT;
+    int i, n = 0;
+    struct timeval tv1, tv2;
+    double user1, user2, sys1, sys2, elapsed;
+    long syscr1, syscr2, syscw1, syscw2;
+    char buf[64];
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s PTY [loops [model]]\n", argv[0]);
+        exit(1);
+    }
+
+    if (argc > 2)
+    {
+        loops = atoi(argv[2]);
+    }
+
+    if (argc > 3)
+    {
+        model = atoi(argv[3]);
+    }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    rig = rig_init(model);
+
+    if (!rig)
+    {
+        fprintf(stderr, "Unknown rig num %d\n", (int)model);
+        exit(1);
+    }
+
+    strncpy(rig->state.rigport.pathname, argv[1], FILPATHLEN - 1);
+
+    if (rig_open(rig) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        exit(1);
+    }
+
+    rig_set_conf(rig, rig_token_lookup(rig, "cache_timeout"), "0");
+
+    printf("Perform %d transactions on %s...\n", loops * (int)MIX_LEN,
+           argv[1]);
+
+    proc_syscalls(&syscr1, &syscw1);
+    cpu_seconds(&user1, &sys1);
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < loops; i++)
+    {
+        int j;
+
+        for (j = 0; j < MIX_LEN; j++, n++)
+        {
+            int retval = kenwood_transaction(rig, mix[j].cmd,
+                                             mix[j].reply ? buf : NULL,
+                                             mix[j].reply ? sizeof(buf) : 0);
+
+            if (retval != RIG_OK)
+            {
+                fprintf(stderr, "%s: %s\n", mix[j].cmd, rigerror(retval));
+                goto done;
+            }
+        }
+    }
+
+done:
+    gettimeofday(&tv2, NULL);
+    cpu_seconds(&user2, &sys2);
+    proc_syscalls(&syscr2, &syscw2);
+
+    elapsed = seconds(&tv2) - seconds(&tv1);
+
+    if (n > 0)
+    {
+        printf("Elapsed: %.3fs, Avg: %.0f transactions/s, %.1f us/transaction\n",
+               elapsed, n / elapsed, elapsed * 1000000.0 / n);
+        printf("CPU: user %.2f us/transaction, system %.2f us/transaction\n",
+               (user2 - user1) * 1000000.0 / n, (sys2 - sys1) * 1000000.0 / n);
+
+        if (syscr1 >= 0 && syscr2 >= 0)
+        {
+            printf("syscalls: %.2f read, %.2f write per transaction\n",
+                   (double)(syscr2 - syscr1) / n, (double)(syscw2 - syscw1) / n);
+        }
+    }
+
+    rig_close(rig);
+    rig_cleanup(rig);
+
+    return n == loops * MIX_LEN ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/*
+ * Hamlib parse_bench program
+ *
+ * Measures the per command cost of the rigctl parser by feeding a
+ * recorded rigctld session through it against the dummy rig, both
+ * through rigctl_parse() on a stdio stream and through
+ * rigctl_parse_input() on a connection buffer, as rigctld does.
+ *
+ * Usage: parse_bench [loops] [session file]
+ *
+ * A session file holds one rigctld protocol command per line, e.g. the
+ * input side of a client conversation captured from the network.
+ * Reads are served from the frontend cache so that the figures are
+ * dominated by parsing and dispatch; note that the dummy rig sleeps on
+ * every set, so a session with set commands measures mostly that.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <hamlib/rig.h>
+#include "rigctl_parse.h"
+
+#define LOOP_COUNT 2000
+
+/*
+ * Traffic of a typical digital mode program polling rigctld,
+ * with a few extended protocol and long name commands mixed in.
+ */
+static const char *default_session[] =
+{
+    "\\chk_vfo",
+    "\\get_powerstat",
+    "f",
+    "m",
+    "v",
+    "t",
+    "s",
+    "\\get_freq",
+    "\\get_mode",
+    "\\get_vfo",
+    "\\get_ptt",
+    "\\get_split_vfo",
+    "f",
+    "m",
+    "l STRENGTH",
+    "\\get_level RFPOWER",
+    "+f",
+    ";m",
+    "t",
+    "\\get_rit",
+    "\\get_xit",
+    "j",
+    "z",
+    NULL
+};
+
+
+static double elapsed_since(const struct timeval *tv1)
+{
+    struct timeval tv2;
+
+    gettimeofday(&tv2, NULL);
+
+    return tv2.tv_sec - tv1->tv_sec + (tv2.tv_usec - tv1->tv_usec) / 1000000.0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *my_rig;
+    FILE *fin, *fout;
+    static struct rigctl_input in;
+    char *session;
+    long session_len;
+    int loops = LOOP_COUNT;
+    int ncmds = 0;
+    int vfo_mode = 0;
+    int ext_resp = 0;
+    char resp_sep = '\n';
+    int i, n;
+    struct timeval tv1;
+    double elapsed;
+
+    if (argc > 1)
+    {
+        loops = atoi(argv[1]);
+    }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    fin = tmpfile();
+    fout = fopen("/dev/null", "w");
+
+    if (!fin || !fout)
+    {
+        perror("parse_bench");
+        exit(1);
+    }
+
+    if (argc > 2)
+    {
+        char line[256];
+        FILE *fp = fopen(argv[2], "r");
+
+        if (!fp)
+        {
+            perror(argv[2]);
+            exit(1);
+        }
+
+        while (fgets(line, sizeof(line), fp))
+        {
+            if (line[0] != '\n' && line[0] != '\r')
+            {
+                fputs(line, fin);
+                ncmds++;
+            }
+        }
+
+        fclose(fp);
+    }
+    else
+    {
+        for (i = 0; default_session[i]; i++)
+        {
+            fprintf(fin, "%s\n", default_session[i]);
+            ncmds++;
+        }
+    }
+
+    if (ncmds == 0)
+    {
+        fprintf(stderr, "empty session\n");
+        exit(1);
+    }
+
+    session_len = ftell(fin);
+    session = malloc(session_len);
+    rewind(fin);
+
+    if (!session || fread(session, 1, session_len, fin) != session_len)
+    {
+        perror("parse_bench");
+        exit(1);
+    }
+
+    my_rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!my_rig || rig_open(my_rig) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open the dummy rig\n");
+        exit(1);
+    }
+
+    rig_set_cache_timeout_ms(my_rig, HAMLIB_CACHE_ALL, 60000);
+
+    printf("Parse %d x %d session commands...\n", loops, ncmds);
+
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < loops; i++)
+    {
+        rewind(fin);
+
+        for (n = 0; n < ncmds; n++)
+        {
+            if (rigctl_parse(my_rig, fin, fout, NULL, 0, NULL, 1, 0, &vfo_mode,
+                             '\r', &ext_resp, &resp_sep) == 1)
+            {
+                break;
+            }
+        }
+    }
+
+    elapsed = elapsed_since(&tv1);
+    printf("stdio:  Elapsed: %.3fs, Avg: %.0f ns/command\n",
+           elapsed,
+           elapsed * 1e9 / ((double)loops * ncmds));
+
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < loops; i++)
+    {
+        long off = 0;
+
+        /* the input is consumed in place, so feed it again every pass */
+        while (off < session_len)
+        {
+            size_t room;
+            char *p = rigctl_input_space(&in, &room);
+            size_t len = session_len - off < room ? session_len - off : room;
+
+            memcpy(p, session + off, len);
+            in.tail += len;
+            off += len;
+
+            while (rigctl_parse_input(my_rig, &in, fout, NULL, &vfo_mode, '\r',
+                                      &ext_resp, &resp_sep) != RIGCTL_PARSE_MORE)
+            {
+            }
+        }
+    }
+
+    elapsed = elapsed_since(&tv1);
+    printf("buffer: Elapsed: %.3fs, Avg: %.0f ns/command\n",
+           elapsed,
+           elapsed * 1e9 / ((double)loops * ncmds));
+
+    rig_close(my_rig);
+    rig_cleanup(my_rig);
+    fclose(fin);
+    fclose(fout);
+    free(session);
+
+    return 0;
+}
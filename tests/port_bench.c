@@ -0,0 +1,170 @@
+/*
+ * Hamlib port_bench program
+ *
+ * Measures the cost of the read_string() receive path by running
+ * Kenwood style command/response transactions against a responder
+ * sitting on the master side of a pty.
+ *
+ * Usage: port_bench [loops]
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <hamlib/rig.h>
+#include "iofunc.h"
+#include "testutil.h"
+
+#define LOOP_COUNT 10000
+
+/* a typical Kenwood IF; answer */
+#define IF_REPLY "IF00014074000     +00000000002000000;"
+
+#ifndef __MINGW32__
+
+/*
+ * Answer every ';' terminated command with IF_REPLY
+ */
+static void responder(int fd)
+{
+    char buf[256];
+
+    for (;;)
+    {
+        ssize_t i, n = read(fd, buf, sizeof(buf));
+
+        if (n <= 0)
+        {
+            exit(0);
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (buf[i] == ';' && write(fd, IF_REPLY, strlen(IF_REPLY)) < 0)
+            {
+                exit(1);
+            }
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    hamlib_port_t port;
+    int master;
+    int loops = LOOP_COUNT;
+    int i;
+    pid_t pid;
+    long syscr1, syscr2, syscw;
+    struct timeval tv1, tv2;
+    double elapsed;
+    char buf[64];
+
+    if (argc > 1)
+    {
+        loops = atoi(argv[1]);
+    }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("posix_openpt");
+        exit(1);
+    }
+
+    memset(&port, 0, sizeof(port));
+    port.type.rig = RIG_PORT_SERIAL;
+    port.parm.serial.rate = 38400;
+    port.parm.serial.data_bits = 8;
+    port.parm.serial.stop_bits = 1;
+    port.parm.serial.parity = RIG_PARITY_NONE;
+    port.parm.serial.handshake = RIG_HANDSHAKE_NONE;
+    port.parm.serial.rts_state = RIG_SIGNAL_UNSET;
+    port.parm.serial.dtr_state = RIG_SIGNAL_UNSET;
+    port.timeout = 1000;
+    strncpy(port.pathname, ptsname(master), FILPATHLEN - 1);
+
+    if (port_open(&port) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open %s\n", port.pathname);
+        exit(1);
+    }
+
+    pid = fork();
+
+    if (pid == 0)
+    {
+        responder(master);
+    }
+
+    printf("Perform %d IF; transactions on %s...\n", loops, port.pathname);
+
+    proc_syscalls(&syscr1, &syscw);
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < loops; i++)
+    {
+        int retval;
+
+        if (write_block(&port, "IF;", 3) != RIG_OK)
+        {
+            fprintf(stderr, "write_block failed\n");
+            break;
+        }
+
+        retval = read_string(&port, buf, sizeof(buf), ";", 1);
+
+        if (retval != strlen(IF_REPLY))
+        {
+            fprintf(stderr, "read_string: unexpected reply %d\n", retval);
+            break;
+        }
+    }
+
+    gettimeofday(&tv2, NULL);
+    proc_syscalls(&syscr2, &syscw);
+
+    elapsed = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("Elapsed: %.3fs, Avg: %.0f transactions/s, %.1f us/transaction\n",
+           elapsed,
+           i / elapsed,
+           elapsed * 1000000.0 / i);
+
+    if (syscr1 >= 0 && syscr2 >= 0)
+    {
+        printf("read syscalls: %ld, %.2f per transaction\n",
+               syscr2 - syscr1,
+               (double)(syscr2 - syscr1) / i);
+    }
+
+    port_close(&port, RIG_PORT_SERIAL);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(master);
+
+    return i == loops ? 0 : 1;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+    fprintf(stderr, "port_bench needs pty support\n");
+    return 77;
+}
+
+#endif
@@ -1,127 +1,851 @@
 /*
  * Hamlib rig_bench program
+ *
+ * Runs a scenario of rig calls in a loop, from one or more threads,
+ * either on a rig opened directly or through rigctld, and reports the
+ * latency percentiles of every call, the transactions per second and the
+ * bytes exchanged, as text or JSON.
+ *
+ * A scenario file holds one call per line, run in order at each
+ * iteration; '#' starts a comment.  VFO arguments are optional:
+ *
+ *   get_freq [VFO]                 set_freq FREQ [VFO]
+ *   get_mode [VFO]                 set_mode MODE [WIDTH [VFO]]
+ *   get_vfo                        set_vfo VFO
+ *   get_ptt [VFO]                  set_ptt 0|1 [VFO]
+ *   get_split [VFO]                set_split 0|1 [TXVFO]
+ *   get_level LEVEL [VFO]          set_level LEVEL VALUE [VFO]
+ *   think MS                       pause, not counted as a call
+ *
+ * Without a scenario, get_freq and get_mode are run.  Add
+ * -C cache_timeout=0 to time the rig rather than the frontend cache.
+ *
+ * Usage: rig_bench [OPTION]... [SCENARIO]
  */
 
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <getopt.h>
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
 #include <hamlib/rig.h>
-#include <sys/time.h>
 #include "misc.h"
+#include "stats.h"
 
-#define LOOP_COUNT 100
+#define MAX_STEPS 64
+#define MAX_THREADS 64
 
-#define SERIAL_PORT "/dev/ttyS0"
+/*
+ * Reminder: when adding long options,
+ *  keep up to date SHORT_OPTIONS and usage()'s output. thanks.
+ * NB: do NOT use -W since it's reserved by POSIX.
+ */
+#define SHORT_OPTIONS "m:r:s:C:t:n:T:jvhV"
+static struct option long_options[] =
+{
+    {"model",           1, 0, 'm'},
+    {"rig-file",        1, 0, 'r'},
+    {"serial-speed",    1, 0, 's'},
+    {"set-conf",        1, 0, 'C'},
+    {"rigctld",         1, 0, 't'},
+    {"iterations",      1, 0, 'n'},
+    {"threads",         1, 0, 'T'},
+    {"json",            0, 0, 'j'},
+    {"verbose",         0, 0, 'v'},
+    {"help",            0, 0, 'h'},
+    {"version",         0, 0, 'V'},
+    {0, 0, 0, 0}
+};
 
+enum op
+{
+    OP_GET_FREQ,
+    OP_SET_FREQ,
+    OP_GET_MODE,
+    OP_SET_MODE,
+    OP_GET_VFO,
+    OP_SET_VFO,
+    OP_GET_PTT,
+    OP_SET_PTT,
+    OP_GET_SPLIT,
+    OP_SET_SPLIT,
+    OP_GET_LEVEL,
+    OP_SET_LEVEL,
+    OP_THINK
+};
 
-int main(int argc, char *argv[])
+static const struct
+{
+    const char *name;
+    int args;       /* mandatory arguments, before the optional VFO */
+} ops[] =
+{
+    [OP_GET_FREQ]  = { "get_freq", 0 },
+    [OP_SET_FREQ]  = { "set_freq", 1 },
+    [OP_GET_MODE]  = { "get_mode", 0 },
+    [OP_SET_MODE]  = { "set_mode", 1 },
+    [OP_GET_VFO]   = { "get_vfo", 0 },
+    [OP_SET_VFO]   = { "set_vfo", 1 },
+    [OP_GET_PTT]   = { "get_ptt", 0 },
+    [OP_SET_PTT]   = { "set_ptt", 1 },
+    [OP_GET_SPLIT] = { "get_split", 0 },
+    [OP_SET_SPLIT] = { "set_split", 1 },
+    [OP_GET_LEVEL] = { "get_level", 1 },
+    [OP_SET_LEVEL] = { "set_level", 2 },
+    [OP_THINK]     = { "think", 1 },
+};
+
+struct step
+{
+    enum op op;
+    char text[64];          /* the scenario line, to name the results */
+    vfo_t vfo;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int on;                 /* ptt or split */
+    setting_t level;
+    value_t val;
+    int think_ms;
+
+    struct stats_hist hist;
+    uint64_t errors;
+};
+
+/* one spare for the line past the limit */
+static struct step steps[MAX_STEPS + 1];
+static int nsteps;
+
+static rig_model_t model = RIG_MODEL_DUMMY;
+static const char *rig_file;
+static const char *rigctld_addr;
+static int serial_rate;
+static char conf_parms[256];
+static int iterations = 100;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t rig_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void usage(void);
+
+
+static int parse_step(struct step *s, char *line, int lineno)
 {
-    RIG *my_rig;        /* handle to rig (nstance) */
-    int retcode;        /* generic return code from functions */
-    rig_model_t myrig_model;
-    unsigned i;
-    struct timeval tv1, tv2;
-    float elapsed;
+    char *argv[8];
+    int argc = 0;
+    char *p;
+    int i;
 
-    rig_set_debug(RIG_DEBUG_ERR);
+    /* drop the comment and trailing blanks, keep the line as the name */
+    p = strchr(line, '#');
 
-    /*
-     * allocate memory, setup & open port
-     */
+    if (p)
+    {
+        *p = '\0';
+    }
 
-    if (argc < 2)
+    for (p = line + strlen(line); p > line && isspace((unsigned char)p[-1]); p--)
     {
-        hamlib_port_t myport;
-        /* may be overridden by backend probe */
-        myport.type.rig = RIG_PORT_SERIAL;
-        myport.parm.serial.rate = 9600;
-        myport.parm.serial.data_bits = 8;
-        myport.parm.serial.stop_bits = 1;
-        myport.parm.serial.parity = RIG_PARITY_NONE;
-        myport.parm.serial.handshake = RIG_HANDSHAKE_NONE;
-        strncpy(myport.pathname, SERIAL_PORT, FILPATHLEN - 1);
+        *(p - 1) = '\0';
+    }
 
-        rig_load_all_backends();
-        myrig_model = rig_probe(&myport);
+    while (isspace((unsigned char)*line))
+    {
+        line++;
     }
-    else
+
+    if (*line == '\0')
     {
-        myrig_model = atoi(argv[1]);
+        return 0;
     }
 
-    my_rig = rig_init(myrig_model);
+    memset(s, 0, sizeof(*s));
+    snprintf(s->text, sizeof(s->text), "%s", line);
 
-    if (!my_rig)
+    for (p = strtok(line, " \t"); p && argc < 8; p = strtok(NULL, " \t"))
     {
-        fprintf(stderr, "Unknown rig num: %u\n", myrig_model);
-        fprintf(stderr, "Please check riglist.h\n");
-        exit(1);    /* whoops! something went wrong (mem alloc?) */
+        argv[argc++] = p;
     }
 
-    printf("Opened rig model %u, '%s'\n",
-           my_rig->caps->rig_model,
-           my_rig->caps->model_name);
+    for (i = 0; i <= OP_THINK; i++)
+    {
+        if (strcmp(argv[0], ops[i].name) == 0)
+        {
+            break;
+        }
+    }
 
-    printf("Backend version: %s, Status: %s\n",
-           my_rig->caps->version,
-           rig_strstatus(my_rig->caps->status));
+    if (i > OP_THINK || argc - 1 < ops[i].args)
+    {
+        fprintf(stderr, "line %d: bad step '%s'\n", lineno, s->text);
+        return -1;
+    }
 
-    printf("Serial speed: %d bauds\n", my_rig->state.rigport.parm.serial.rate);
+    s->op = i;
+    s->vfo = RIG_VFO_CURR;
 
-    strncpy(my_rig->state.rigport.pathname, SERIAL_PORT, FILPATHLEN - 1);
+    /* the optional VFO comes after the mandatory arguments */
+    if (argc - 1 > ops[i].args && s->op != OP_SET_MODE)
+    {
+        s->vfo = rig_parse_vfo(argv[ops[i].args + 1]);
+    }
 
-    retcode = rig_open(my_rig);
+    switch (s->op)
+    {
+    case OP_SET_FREQ:
+        s->freq = atof(argv[1]);
+        break;
 
-    if (retcode != RIG_OK)
+    case OP_SET_MODE:
+        s->mode = rig_parse_mode(argv[1]);
+        s->width = argc > 2 ? atoi(argv[2]) : RIG_PASSBAND_NOCHANGE;
+
+        if (argc > 3)
+        {
+            s->vfo = rig_parse_vfo(argv[3]);
+        }
+
+        break;
+
+    case OP_SET_VFO:
+        s->vfo = rig_parse_vfo(argv[1]);
+        break;
+
+    case OP_SET_PTT:
+        s->on = atoi(argv[1]) ? 1 : 0;
+        break;
+
+    case OP_SET_SPLIT:
+        s->on = atoi(argv[1]) ? 1 : 0;
+        s->vfo = argc > 2 ? rig_parse_vfo(argv[2]) : RIG_VFO_B;
+        break;
+
+    case OP_GET_LEVEL:
+    case OP_SET_LEVEL:
+        s->level = rig_parse_level(argv[1]);
+
+        if (s->level == RIG_LEVEL_NONE)
+        {
+            fprintf(stderr, "line %d: unknown level '%s'\n", lineno, argv[1]);
+            return -1;
+        }
+
+        if (s->op == OP_SET_LEVEL)
+        {
+            if (RIG_LEVEL_IS_FLOAT(s->level))
+            {
+                s->val.f = atof(argv[2]);
+            }
+            else
+            {
+                s->val.i = atoi(argv[2]);
+            }
+        }
+
+        break;
+
+    case OP_THINK:
+        s->think_ms = atoi(argv[1]);
+        break;
+
+    default:
+        break;
+    }
+
+    return 1;
+}
+
+
+static int load_scenario(const char *path)
+{
+    char line[256];
+    int lineno = 0;
+    FILE *fp;
+
+    fp = fopen(path, "r");
+
+    if (!fp)
     {
-        printf("rig_open: error = %s\n", rigerror(retcode));
-        exit(2);
+        perror(path);
+        return -1;
     }
 
-    printf("Port %s opened ok\n", SERIAL_PORT);
-    printf("Perform %d loops...\n", LOOP_COUNT);
+    while (fgets(line, sizeof(line), fp))
+    {
+        int ret;
+
+        lineno++;
+        ret = parse_step(&steps[nsteps], line, lineno);
+
+        if (ret < 0)
+        {
+            fclose(fp);
+            return -1;
+        }
 
-    /*
-     * we're not using getrusage here because we want effective time
-     */
-    gettimeofday(&tv1, NULL);
+        nsteps += ret;
 
-    for (i = 0; i < LOOP_COUNT; i++)
+        if (nsteps > MAX_STEPS)
+        {
+            fprintf(stderr, "%s: more than %d steps\n", path, MAX_STEPS);
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    fclose(fp);
+
+    return nsteps > 0 ? 0 : -1;
+}
+
+
+static int run_step(RIG *rig, const struct step *s)
+{
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    vfo_t vfo;
+    ptt_t ptt;
+    split_t split;
+    value_t val;
+
+    switch (s->op)
     {
-        freq_t freq;
-        rmode_t rmode;
-        pbwidth_t width;
+    case OP_GET_FREQ: return rig_get_freq(rig, s->vfo, &freq);
+
+    case OP_SET_FREQ: return rig_set_freq(rig, s->vfo, s->freq);
+
+    case OP_GET_MODE: return rig_get_mode(rig, s->vfo, &mode, &width);
+
+    case OP_SET_MODE: return rig_set_mode(rig, s->vfo, s->mode, s->width);
+
+    case OP_GET_VFO: return rig_get_vfo(rig, &vfo);
+
+    case OP_SET_VFO: return rig_set_vfo(rig, s->vfo);
+
+    case OP_GET_PTT: return rig_get_ptt(rig, s->vfo, &ptt);
+
+    case OP_SET_PTT:
+        return rig_set_ptt(rig, s->vfo, s->on ? RIG_PTT_ON : RIG_PTT_OFF);
+
+    case OP_GET_SPLIT: return rig_get_split_vfo(rig, s->vfo, &split, &vfo);
+
+    case OP_SET_SPLIT:
+        return rig_set_split_vfo(rig, RIG_VFO_CURR,
+                                 s->on ? RIG_SPLIT_ON : RIG_SPLIT_OFF, s->vfo);
+
+    case OP_GET_LEVEL: return rig_get_level(rig, s->vfo, s->level, &val);
+
+    case OP_SET_LEVEL: return rig_set_level(rig, s->vfo, s->level, s->val);
+
+    default: return RIG_OK;
+    }
+}
+
+
+static int set_conf(RIG *rig, char *parms)
+{
+    char *p = parms;
+
+    while (p && *p != '\0')
+    {
+        char *q = strchr(p, '=');
+        char *n;
+        int ret;
+
+        if (!q)
+        {
+            return -RIG_EINVAL;
+        }
+
+        *q++ = '\0';
+        n = strchr(q, ',');
+
+        if (n)
+        {
+            *n++ = '\0';
+        }
 
-        retcode = rig_get_freq(my_rig, RIG_VFO_CURR, &freq);
+        ret = rig_set_conf(rig, rig_token_lookup(rig, p), q);
 
-        if (retcode != RIG_OK)
+        if (ret != RIG_OK)
         {
-            printf("rig_get_freq: error =  %s \n", rigerror(retcode));
+            return ret;
+        }
+
+        p = n;
+    }
+
+    return RIG_OK;
+}
+
+
+static RIG *open_rig(void)
+{
+    char parms[sizeof(conf_parms)];
+    RIG *rig;
+    int ret;
+
+    rig = rig_init(rigctld_addr ? RIG_MODEL_NETRIGCTL : model);
+
+    if (!rig)
+    {
+        fprintf(stderr, "Unknown rig num: %u\n", model);
+        return NULL;
+    }
+
+    /* set_conf cuts the string */
+    strcpy(parms, conf_parms);
+    ret = set_conf(rig, parms);
+
+    if (ret != RIG_OK)
+    {
+        fprintf(stderr, "Config parameter error: %s\n", rigerror(ret));
+        rig_cleanup(rig);
+        return NULL;
+    }
+
+    if (rigctld_addr)
+    {
+        strncpy(rig->state.rigport.pathname, rigctld_addr, FILPATHLEN - 1);
+    }
+    else if (rig_file)
+    {
+        strncpy(rig->state.rigport.pathname, rig_file, FILPATHLEN - 1);
+    }
+
+    if (serial_rate)
+    {
+        rig->state.rigport.parm.serial.rate = serial_rate;
+    }
+
+    ret = rig_open(rig);
+
+    if (ret != RIG_OK)
+    {
+        fprintf(stderr, "rig_open: error = %s\n", rigerror(ret));
+        rig_cleanup(rig);
+        return NULL;
+    }
+
+    return rig;
+}
+
+
+/*
+ * One client: run the scenario iterations times.  Through rigctld each
+ * client has its own connection, a rig opened directly is shared and
+ * used by one client at a time, as rigctld does.
+ */
+static void *client(void *arg)
+{
+    RIG *rig = arg;
+    int i, j;
+
+    for (i = 0; i < iterations; i++)
+    {
+        for (j = 0; j < nsteps; j++)
+        {
+            struct step *s = &steps[j];
+            uint64_t start;
+            int ret;
+
+            if (s->op == OP_THINK)
+            {
+                hl_usleep(s->think_ms * 1000);
+                continue;
+            }
+
+#ifdef HAVE_PTHREAD
+
+            if (!rigctld_addr)
+            {
+                pthread_mutex_lock(&rig_lock);
+            }
+
+#endif
+            start = rig_stats_now_us();
+            ret = run_step(rig, s);
+            rig_stats_hist_add(&s->hist, rig_stats_now_us() - start);
+#ifdef HAVE_PTHREAD
+
+            if (!rigctld_addr)
+            {
+                pthread_mutex_unlock(&rig_lock);
+            }
+
+#endif
+
+            if (ret != RIG_OK)
+            {
+                __atomic_fetch_add(&s->errors, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+/* all the calls of the scenario in one histogram */
+static void merge_hist(struct stats_hist *total)
+{
+    int i, j;
+
+    memset(total, 0, sizeof(*total));
+
+    for (i = 0; i < nsteps; i++)
+    {
+        const struct stats_hist *h = &steps[i].hist;
+
+        total->count += h->count;
+        total->sum_us += h->sum_us;
+
+        if (h->max_us > total->max_us)
+        {
+            total->max_us = h->max_us;
+        }
+
+        for (j = 0; j < STATS_HIST_BUCKETS; j++)
+        {
+            total->bucket[j] += h->bucket[j];
+        }
+    }
+}
+
+
+static void print_json_string(const char *str)
+{
+    putchar('"');
+
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            putchar('\\');
+        }
+
+        putchar(*str);
+    }
+
+    putchar('"');
+}
+
+
+static void print_latency(FILE *fout, const struct stats_hist *h, int json)
+{
+    unsigned long long avg = h->count ? h->sum_us / h->count : 0;
+
+    fprintf(fout, json ?
+            "\"avg_us\": %llu, \"p50_us\": %llu, \"p95_us\": %llu, "
+            "\"p99_us\": %llu, \"max_us\": %llu" :
+            "%8llu %8llu %8llu %8llu %8llu",
+            avg,
+            (unsigned long long)rig_stats_hist_percentile(h, 0.50),
+            (unsigned long long)rig_stats_hist_percentile(h, 0.95),
+            (unsigned long long)rig_stats_hist_percentile(h, 0.99),
+            (unsigned long long)h->max_us);
+}
+
+
+static void report(const RIG *rig, const char *scenario, int threads,
+                   double elapsed, int json)
+{
+    struct stats_hist total;
+    uint64_t errors = 0;
+    unsigned long long tx = rig_stats_get_count(STATS_TX_BYTES);
+    unsigned long long rx = rig_stats_get_count(STATS_RX_BYTES);
+    unsigned long long hits = rig_stats_get_count(STATS_CACHE_HITS);
+    unsigned long long misses = rig_stats_get_count(STATS_CACHE_MISSES);
+    const char *sep;
+    int i;
+
+    merge_hist(&total);
+
+    for (i = 0; i < nsteps; i++)
+    {
+        errors += steps[i].errors;
+    }
+
+    if (json)
+    {
+        printf("{\n"
+               "  \"hamlib\": \"%s\",\n"
+               "  \"model\": %u,\n"
+               "  \"model_name\": \"%s %s\",\n"
+               "  \"via\": \"%s\",\n"
+               "  \"scenario\": ",
+               hamlib_version, rig->caps->rig_model, rig->caps->mfg_name,
+               rig->caps->model_name, rigctld_addr ? "rigctld" : "direct");
+        print_json_string(scenario);
+        printf(",\n"
+               "  \"threads\": %d,\n"
+               "  \"iterations\": %d,\n"
+               "  \"elapsed_s\": %.6f,\n"
+               "  \"transactions\": %llu,\n"
+               "  \"errors\": %llu,\n"
+               "  \"tps\": %.1f,\n"
+               "  \"bytes_tx\": %llu,\n"
+               "  \"bytes_rx\": %llu,\n"
+               "  \"cache_hits\": %llu,\n"
+               "  \"cache_misses\": %llu,\n"
+               "  \"latency\": { ",
+               threads, iterations, elapsed,
+               (unsigned long long)total.count, (unsigned long long)errors,
+               total.count / elapsed, tx, rx, hits, misses);
+        print_latency(stdout, &total, 1);
+        printf(" },\n  \"steps\": [");
+
+        for (i = 0, sep = ""; i < nsteps; i++)
+        {
+            if (steps[i].op == OP_THINK)
+            {
+                continue;
+            }
+
+            printf("%s\n    { \"step\": ", sep);
+            print_json_string(steps[i].text);
+            printf(", \"count\": %llu, \"errors\": %llu, ",
+                   (unsigned long long)steps[i].hist.count,
+                   (unsigned long long)steps[i].errors);
+            print_latency(stdout, &steps[i].hist, 1);
+            printf(" }");
+            sep = ",";
+        }
+
+        printf("\n  ]\n}\n");
+
+        return;
+    }
+
+    printf("%s %s (model %u) %s, scenario %s\n",
+           rig->caps->mfg_name, rig->caps->model_name, rig->caps->rig_model,
+           rigctld_addr ? "through rigctld" : "direct", scenario);
+    printf("%d thread(s) x %d iterations in %.3fs: %llu transactions, "
+           "%.1f/s, %llu errors\n",
+           threads, iterations, elapsed, (unsigned long long)total.count,
+           total.count / elapsed, (unsigned long long)errors);
+    printf("bytes on the wire: %llu sent, %llu received\n", tx, rx);
+    printf("cache: %llu hits, %llu misses\n\n", hits, misses);
+
+    printf("%-24s %8s %6s %8s %8s %8s %8s %8s\n", "step (us)", "count",
+           "errors", "avg", "p50", "p95", "p99", "max");
+
+    for (i = 0; i < nsteps; i++)
+    {
+        if (steps[i].op == OP_THINK)
+        {
+            continue;
+        }
+
+        printf("%-24s %8llu %6llu ", steps[i].text,
+               (unsigned long long)steps[i].hist.count,
+               (unsigned long long)steps[i].errors);
+        print_latency(stdout, &steps[i].hist, 0);
+        printf("\n");
+    }
+
+    printf("%-24s %8llu %6llu ", "all", (unsigned long long)total.count,
+           (unsigned long long)errors);
+    print_latency(stdout, &total, 0);
+    printf("\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *rigs[MAX_THREADS];
+    const char *scenario = "default";
+    int threads = 1;
+    int json = 0;
+    int verbose = RIG_DEBUG_NONE;
+    uint64_t start;
+    double elapsed;
+    int i;
+
+    while (1)
+    {
+        int c;
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, SHORT_OPTIONS, long_options, &option_index);
+
+        if (c == -1)
+        {
+            break;
+        }
+
+        switch (c)
+        {
+        case 'h':
+            usage();
+            exit(0);
+
+        case 'V':
+            printf("rig_bench, %s\n\n", hamlib_version);
+            exit(0);
+
+        case 'm':
+            model = atoi(optarg);
+            break;
+
+        case 'r':
+            rig_file = optarg;
+            break;
+
+        case 's':
+            serial_rate = atoi(optarg);
+            break;
+
+        case 'C':
+            if (strlen(conf_parms) + strlen(optarg) + 2 > sizeof(conf_parms))
+            {
+                fprintf(stderr, "Too many config parameters\n");
+                exit(1);
+            }
+
+            if (*conf_parms != '\0')
+            {
+                strcat(conf_parms, ",");
+            }
+
+            strcat(conf_parms, optarg);
+            break;
+
+        case 't':
+            rigctld_addr = optarg;
+            break;
+
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+
+        case 'T':
+            threads = atoi(optarg);
+            break;
+
+        case 'j':
+            json = 1;
+            break;
+
+        case 'v':
+            verbose++;
+            break;
+
+        default:
+            usage();    /* unknown option? */
             exit(1);
         }
+    }
 
-        retcode = rig_get_mode(my_rig, RIG_VFO_CURR, &rmode, &width);
+#ifndef HAVE_PTHREAD
+    threads = 1;
+#endif
 
-        if (retcode != RIG_OK)
+    if (threads < 1 || threads > MAX_THREADS || iterations < 1)
+    {
+        fprintf(stderr, "Threads must be 1 to %d, iterations at least 1\n",
+                MAX_THREADS);
+        exit(1);
+    }
+
+    rig_set_debug(verbose);
+
+    if (optind < argc)
+    {
+        scenario = argv[optind];
+
+        if (load_scenario(scenario) < 0)
         {
-            printf("rig_get_mode: error =  %s \n", rigerror(retcode));
             exit(1);
         }
     }
+    else
+    {
+        char line1[] = "get_freq", line2[] = "get_mode";
 
-    gettimeofday(&tv2, NULL);
+        parse_step(&steps[nsteps++], line1, 1);
+        parse_step(&steps[nsteps++], line2, 2);
+    }
 
-    elapsed = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
-    printf("Elapsed: %.3fs, Avg: %f loops/s, %f s/loop\n",
-           elapsed,
-           LOOP_COUNT / elapsed,
-           elapsed / LOOP_COUNT);
+    /* through rigctld every client has its own connection */
+    for (i = 0; i < (rigctld_addr ? threads : 1); i++)
+    {
+        rigs[i] = open_rig();
+
+        if (!rigs[i])
+        {
+            exit(2);
+        }
+    }
 
-    rig_close(my_rig);      /* close port */
-    rig_cleanup(my_rig);    /* if you care about memory */
+    rig_stats_reset();
+    rig_stats_enable(1);
+    start = rig_stats_now_us();
 
-    printf("port %s closed ok \n", SERIAL_PORT);
+#ifdef HAVE_PTHREAD
+    {
+        pthread_t tids[MAX_THREADS];
+
+        for (i = 0; i < threads; i++)
+        {
+            pthread_create(&tids[i], NULL, client,
+                           rigs[rigctld_addr ? i : 0]);
+        }
+
+        for (i = 0; i < threads; i++)
+        {
+            pthread_join(tids[i], NULL);
+        }
+    }
+#else
+    client(rigs[0]);
+#endif
+
+    elapsed = (rig_stats_now_us() - start) / 1e6;
+    rig_stats_enable(0);
+
+    report(rigs[0], scenario, threads, elapsed, json);
+
+    for (i = 0; i < (rigctld_addr ? threads : 1); i++)
+    {
+        rig_close(rigs[i]);
+        rig_cleanup(rigs[i]);
+    }
 
     return 0;
 }
+
+
+static void usage(void)
+{
+    printf("Usage: rig_bench [OPTION]... [SCENARIO]\n"
+           "Time the rig calls of a scenario file, see the head of rig_bench.c.\n\n");
+
+    printf(
+        "  -m, --model=ID                select radio model number, default dummy\n"
+        "  -r, --rig-file=DEVICE         set device of the radio to operate on\n"
+        "  -s, --serial-speed=BAUD       set serial speed of the serial port\n"
+        "  -C, --set-conf=PARM=VAL       set config parameters\n"
+        "  -t, --rigctld=HOST[:PORT]     go through the rigctld at HOST\n"
+        "  -n, --iterations=N            run the scenario N times per thread\n"
+        "  -T, --threads=N               run N clients at once\n"
+        "  -j, --json                    report in JSON\n"
+        "  -v, --verbose                 set verbose mode, cumulative\n"
+        "  -h, --help                    display this help and exit\n"
+        "  -V, --version                 output version information and exit\n\n"
+    );
+
+    printf("\nReport bugs to <hamlib-developer@lists.sourceforge.net>.\n");
+}
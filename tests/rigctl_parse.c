@@ -36,6 +36,14 @@
 #include <ctype.h>
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+#  include <sys/socket.h>
+#endif
+
 #ifdef HAVE_LIBREADLINE
 #  if defined(HAVE_READLINE_READLINE_H)
 #    include <readline/readline.h>
@@ -67,6 +75,7 @@ extern int read_history();
 #include "iofunc.h"
 #include "serial.h"
 #include "sprintflst.h"
+#include "stats.h"
 
 #include "rigctl_parse.h"
 
@@ -88,6 +97,8 @@ extern int read_history();
 #define ARG_OUT3 0x20
 #define ARG_IN4  0x40
 #define ARG_OUT4 0x80
+#define ARG_NOLOCK 0x1000      /* does not talk to the rig, no need to serialize */
+#define ARG_COALESCE 0x2000    /* read only, may share an identical in-flight result */
 #define ARG_IN_LINE 0x4000
 #define ARG_NOVFO 0x8000
 
@@ -234,6 +245,13 @@ declare_proto_rig(set_cache);
 declare_proto_rig(get_cache);
 declare_proto_rig(halt);
 declare_proto_rig(pause);
+declare_proto_rig(get_coalesce);
+declare_proto_rig(get_snapshot);
+declare_proto_rig(batch);
+declare_proto_rig(subscribe);
+declare_proto_rig(binary);
+declare_proto_rig(set_stats);
+declare_proto_rig(get_stats);
 
 
 /*
@@ -253,61 +271,61 @@ static struct test_table test_list[] =
 #else
     { 'F',  "set_freq",         ACTION(set_freq),       ARG_IN1, "Frequency" },
 #endif
-    { 'f',  "get_freq",         ACTION(get_freq),       ARG_OUT, "Frequency" },
+    { 'f',  "get_freq",         ACTION(get_freq),       ARG_OUT | ARG_COALESCE, "Frequency" },
     { 'M',  "set_mode",         ACTION(set_mode),       ARG_IN, "Mode", "Passband" },
-    { 'm',  "get_mode",         ACTION(get_mode),       ARG_OUT, "Mode", "Passband" },
+    { 'm',  "get_mode",         ACTION(get_mode),       ARG_OUT | ARG_COALESCE, "Mode", "Passband" },
     { 'I',  "set_split_freq",   ACTION(set_split_freq), ARG_IN, "TX Frequency" },
-    { 'i',  "get_split_freq",   ACTION(get_split_freq), ARG_OUT, "TX Frequency" },
+    { 'i',  "get_split_freq",   ACTION(get_split_freq), ARG_OUT | ARG_COALESCE, "TX Frequency" },
     { 'X',  "set_split_mode",   ACTION(set_split_mode), ARG_IN, "TX Mode", "TX Passband" },
-    { 'x',  "get_split_mode",   ACTION(get_split_mode), ARG_OUT, "TX Mode", "TX Passband" },
+    { 'x',  "get_split_mode",   ACTION(get_split_mode), ARG_OUT | ARG_COALESCE, "TX Mode", "TX Passband" },
     { 'K',  "set_split_freq_mode",  ACTION(set_split_freq_mode), ARG_IN,    "TX Frequency", "TX Mode", "TX Passband" },
-    { 'k',  "get_split_freq_mode",  ACTION(get_split_freq_mode), ARG_OUT,   "TX Frequency", "TX Mode", "TX Passband" },
+    { 'k',  "get_split_freq_mode",  ACTION(get_split_freq_mode), ARG_OUT | ARG_COALESCE,   "TX Frequency", "TX Mode", "TX Passband" },
     { 'S',  "set_split_vfo",    ACTION(set_split_vfo),  ARG_IN, "Split", "TX VFO" },
-    { 's',  "get_split_vfo",    ACTION(get_split_vfo),  ARG_OUT, "Split", "TX VFO" },
+    { 's',  "get_split_vfo",    ACTION(get_split_vfo),  ARG_OUT | ARG_COALESCE, "Split", "TX VFO" },
     { 'N',  "set_ts",           ACTION(set_ts),         ARG_IN, "Tuning Step" },
-    { 'n',  "get_ts",           ACTION(get_ts),         ARG_OUT, "Tuning Step" },
+    { 'n',  "get_ts",           ACTION(get_ts),         ARG_OUT | ARG_COALESCE, "Tuning Step" },
     { 'L',  "set_level",        ACTION(set_level),      ARG_IN, "Level", "Level Value" },
-    { 'l',  "get_level",        ACTION(get_level),      ARG_IN1 | ARG_OUT2, "Level", "Level Value" },
+    { 'l',  "get_level",        ACTION(get_level),      ARG_IN1 | ARG_OUT2 | ARG_COALESCE, "Level", "Level Value" },
     { 'U',  "set_func",         ACTION(set_func),       ARG_IN, "Func", "Func Status" },
-    { 'u',  "get_func",         ACTION(get_func),       ARG_IN1 | ARG_OUT2, "Func", "Func Status" },
+    { 'u',  "get_func",         ACTION(get_func),       ARG_IN1 | ARG_OUT2 | ARG_COALESCE, "Func", "Func Status" },
     { 'P',  "set_parm",         ACTION(set_parm),       ARG_IN  | ARG_NOVFO, "Parm", "Parm Value" },
-    { 'p',  "get_parm",         ACTION(get_parm),       ARG_IN1 | ARG_OUT2 | ARG_NOVFO, "Parm", "Parm Value" },
+    { 'p',  "get_parm",         ACTION(get_parm),       ARG_IN1 | ARG_OUT2 | ARG_NOVFO | ARG_COALESCE, "Parm", "Parm Value" },
     { 'G',  "vfo_op",           ACTION(vfo_op),         ARG_IN, "Mem/VFO Op" },
     { 'g',  "scan",             ACTION(scan),           ARG_IN, "Scan Fct", "Scan Channel" },
     { 'A',  "set_trn",          ACTION(set_trn),        ARG_IN  | ARG_NOVFO, "Transceive" },
-    { 'a',  "get_trn",          ACTION(get_trn),        ARG_OUT | ARG_NOVFO, "Transceive" },
+    { 'a',  "get_trn",          ACTION(get_trn),        ARG_OUT | ARG_NOVFO | ARG_COALESCE, "Transceive" },
     { 'R',  "set_rptr_shift",   ACTION(set_rptr_shift), ARG_IN, "Rptr Shift" },
-    { 'r',  "get_rptr_shift",   ACTION(get_rptr_shift), ARG_OUT, "Rptr Shift" },
+    { 'r',  "get_rptr_shift",   ACTION(get_rptr_shift), ARG_OUT | ARG_COALESCE, "Rptr Shift" },
     { 'O',  "set_rptr_offs",    ACTION(set_rptr_offs),  ARG_IN, "Rptr Offset" },
-    { 'o',  "get_rptr_offs",    ACTION(get_rptr_offs),  ARG_OUT, "Rptr Offset" },
+    { 'o',  "get_rptr_offs",    ACTION(get_rptr_offs),  ARG_OUT | ARG_COALESCE, "Rptr Offset" },
     { 'C',  "set_ctcss_tone",   ACTION(set_ctcss_tone), ARG_IN, "CTCSS Tone" },
-    { 'c',  "get_ctcss_tone",   ACTION(get_ctcss_tone), ARG_OUT, "CTCSS Tone" },
+    { 'c',  "get_ctcss_tone",   ACTION(get_ctcss_tone), ARG_OUT | ARG_COALESCE, "CTCSS Tone" },
     { 'D',  "set_dcs_code",     ACTION(set_dcs_code),   ARG_IN, "DCS Code" },
-    { 'd',  "get_dcs_code",     ACTION(get_dcs_code),   ARG_OUT, "DCS Code" },
+    { 'd',  "get_dcs_code",     ACTION(get_dcs_code),   ARG_OUT | ARG_COALESCE, "DCS Code" },
     { 0x90, "set_ctcss_sql",    ACTION(set_ctcss_sql),  ARG_IN, "CTCSS Sql" },
-    { 0x91, "get_ctcss_sql",    ACTION(get_ctcss_sql),  ARG_OUT, "CTCSS Sql" },
+    { 0x91, "get_ctcss_sql",    ACTION(get_ctcss_sql),  ARG_OUT | ARG_COALESCE, "CTCSS Sql" },
     { 0x92, "set_dcs_sql",      ACTION(set_dcs_sql),    ARG_IN, "DCS Sql" },
-    { 0x93, "get_dcs_sql",      ACTION(get_dcs_sql),    ARG_OUT, "DCS Sql" },
+    { 0x93, "get_dcs_sql",      ACTION(get_dcs_sql),    ARG_OUT | ARG_COALESCE, "DCS Sql" },
     //
     //{ 'V',  "set_vfo",          ACTION(set_vfo),        ARG_IN  | ARG_NOVFO | ARG_OUT, "VFO" },
     { 'V',  "set_vfo",          ACTION(set_vfo),        ARG_IN  | ARG_NOVFO, "VFO" },
-    { 'v',  "get_vfo",          ACTION(get_vfo),        ARG_NOVFO | ARG_OUT, "VFO" },
+    { 'v',  "get_vfo",          ACTION(get_vfo),        ARG_NOVFO | ARG_OUT | ARG_COALESCE, "VFO" },
     { 'T',  "set_ptt",          ACTION(set_ptt),        ARG_IN, "PTT" },
-    { 't',  "get_ptt",          ACTION(get_ptt),        ARG_OUT, "PTT" },
+    { 't',  "get_ptt",          ACTION(get_ptt),        ARG_OUT | ARG_COALESCE, "PTT" },
     { 'E',  "set_mem",          ACTION(set_mem),        ARG_IN, "Memory#" },
-    { 'e',  "get_mem",          ACTION(get_mem),        ARG_OUT, "Memory#" },
+    { 'e',  "get_mem",          ACTION(get_mem),        ARG_OUT | ARG_COALESCE, "Memory#" },
     { 'H',  "set_channel",      ACTION(set_channel),    ARG_IN  | ARG_NOVFO, "Channel"},
     { 'h',  "get_channel",      ACTION(get_channel),    ARG_IN  | ARG_NOVFO, "Channel", "Read Only" },
     { 'B',  "set_bank",         ACTION(set_bank),       ARG_IN, "Bank" },
-    { '_',  "get_info",         ACTION(get_info),       ARG_OUT | ARG_NOVFO, "Info" },
+    { '_',  "get_info",         ACTION(get_info),       ARG_OUT | ARG_NOVFO | ARG_COALESCE, "Info" },
     { 'J',  "set_rit",          ACTION(set_rit),        ARG_IN, "RIT" },
-    { 'j',  "get_rit",          ACTION(get_rit),        ARG_OUT, "RIT" },
+    { 'j',  "get_rit",          ACTION(get_rit),        ARG_OUT | ARG_COALESCE, "RIT" },
     { 'Z',  "set_xit",          ACTION(set_xit),        ARG_IN, "XIT" },
-    { 'z',  "get_xit",          ACTION(get_xit),        ARG_OUT, "XIT" },
+    { 'z',  "get_xit",          ACTION(get_xit),        ARG_OUT | ARG_COALESCE, "XIT" },
     { 'Y',  "set_ant",          ACTION(set_ant),        ARG_IN, "Antenna", "Option" },
-    { 'y',  "get_ant",          ACTION(get_ant),        ARG_IN1 | ARG_OUT2 | ARG_NOVFO, "AntCurr", "Option", "AntTx", "AntRx" },
+    { 'y',  "get_ant",          ACTION(get_ant),        ARG_IN1 | ARG_OUT2 | ARG_NOVFO | ARG_COALESCE, "AntCurr", "Option", "AntTx", "AntRx" },
     { 0x87, "set_powerstat",    ACTION(set_powerstat),  ARG_IN  | ARG_NOVFO, "Power Status" },
-    { 0x88, "get_powerstat",    ACTION(get_powerstat),  ARG_OUT | ARG_NOVFO, "Power Status" },
+    { 0x88, "get_powerstat",    ACTION(get_powerstat),  ARG_OUT | ARG_NOVFO | ARG_COALESCE, "Power Status" },
     { 0x89, "send_dtmf",        ACTION(send_dtmf),      ARG_IN, "Digits" },
     { 0x8a, "recv_dtmf",        ACTION(recv_dtmf),      ARG_OUT, "Digits" },
     { '*',  "reset",            ACTION(reset),          ARG_IN, "Reset" },
@@ -317,7 +335,7 @@ static struct test_table test_list[] =
     { 0xbb, "stop_morse",       ACTION(stop_morse),     },
     { 0xbc, "wait_morse",       ACTION(wait_morse),     },
     { 0x94, "send_voice_mem",   ACTION(send_voice_mem), ARG_IN, "Voice Mem#" },
-    { 0x8b, "get_dcd",          ACTION(get_dcd),        ARG_OUT, "DCD" },
+    { 0x8b, "get_dcd",          ACTION(get_dcd),        ARG_OUT | ARG_COALESCE, "DCD" },
     { 0x8d, "set_twiddle",      ACTION(set_twiddle),    ARG_IN  | ARG_NOVFO, "Timeout (secs)" },
     { 0x8e, "get_twiddle",      ACTION(get_twiddle),    ARG_OUT | ARG_NOVFO, "Timeout (secs)" },
     { 0x97, "uplink",           ACTION(set_uplink),     ARG_IN | ARG_NOVFO, "1=Sub, 2=Main" },
@@ -332,28 +350,206 @@ static struct test_table test_list[] =
     { 0xf2, "set_vfo_opt",      ACTION(set_vfo_opt),    ARG_NOVFO | ARG_IN, "Status" }, /* turn vfo option on/off */
     { 0xf1, "halt",             ACTION(halt),           ARG_NOVFO },   /* rigctld only--halt the daemon */
     { 0x8c, "pause",            ACTION(pause),          ARG_IN, "Seconds" },
+    { 0x98, "get_coalesce",     ACTION(get_coalesce),   ARG_OUT | ARG_NOVFO, "Hits", "Misses" },
+    { 0x99, "get_snapshot",     ACTION(get_snapshot),   ARG_OUT | ARG_NOVFO | ARG_NOLOCK },
+    { 0x9a, "batch",            ACTION(batch),          ARG_IN1 | ARG_IN_LINE, "Commands" },
+    { 0x9b, "subscribe",        ACTION(subscribe),      ARG_IN1 | ARG_NOVFO | ARG_NOLOCK, "Events" },
+    { 0x9c, "binary",           ACTION(binary),         ARG_NOVFO | ARG_NOLOCK },
+    { 0x9d, "set_stats",        ACTION(set_stats),      ARG_IN | ARG_NOVFO | ARG_NOLOCK, "Enable" },
+    { 0x9e, "get_stats",        ACTION(get_stats),      ARG_OUT | ARG_NOVFO | ARG_NOLOCK },
     { 0x00, "", NULL },
 };
 
 
-static struct test_table *find_cmd_entry(int cmd)
+/*
+ * Command lookup tables, built once from test_list[] on first use.
+ *
+ * cmd_index[] is indexed directly by the single character command code.
+ * Long names go through a perfect hash (hash and displace): a first
+ * hash picks one of CMD_HASH_BUCKETS buckets, and each bucket has a
+ * displacement chosen so that the second hash of all its names land in
+ * distinct slots of cmd_slot[].  A lookup is then two hashes and a
+ * single string compare.  Entries store test_list index + 1, 0 is empty.
+ *
+ * Should no displacement up to CMD_DISPLACE_MAX fit a bucket, as could
+ * happen if test_list[] outgrew cmd_slot[], the long names are looked up
+ * by a linear scan instead.
+ */
+#define CMD_HASH_SLOTS   256    /* power of 2, > 2 * test_list entries */
+#define CMD_HASH_BUCKETS 64     /* power of 2 */
+#define CMD_DISPLACE_MAX 4096
+
+static unsigned short cmd_index[256];
+static unsigned short cmd_slot[CMD_HASH_SLOTS];
+static unsigned int cmd_displace[CMD_HASH_BUCKETS];
+static int cmd_slot_linear;     /* no perfect hash found */
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t cmd_table_once = PTHREAD_ONCE_INIT;
+#else
+static int cmd_table_done;
+#endif
+
+
+/* FNV-1a, seeded */
+static unsigned int cmd_hash(const char *name, unsigned int seed)
 {
-    int i;
+    unsigned int h = 2166136261u ^ (seed * 16777619u);
+    int n;
+
+    for (n = 0; n < MAXNAMSIZ && name[n] != '\0'; n++)
+    {
+        h ^= (unsigned char)name[n];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+static void cmd_table_build(void)
+{
+    int bucket_of[sizeof(test_list) / sizeof(test_list[0])];
+    int bucket_len[CMD_HASH_BUCKETS] = { 0 };
+    int i, b, len, max_len = 0;
 
     for (i = 0; test_list[i].cmd != 0x00; i++)
     {
-        if (test_list[i].cmd == cmd)
+        bucket_of[i] = -1;
+
+        /* first entry wins, as with the former linear scans */
+        if (!cmd_index[test_list[i].cmd])
         {
-            break;
+            cmd_index[test_list[i].cmd] = i + 1;
+        }
+
+        if (test_list[i].name[0] == '\0')
+        {
+            continue;
+        }
+
+        for (b = 0; b < i; b++)
+        {
+            if (bucket_of[b] >= 0
+                    && !strncmp(test_list[b].name, test_list[i].name, MAXNAMSIZ))
+            {
+                break;
+            }
+        }
+
+        if (b < i)
+        {
+            continue;
+        }
+
+        b = cmd_hash(test_list[i].name, 0) & (CMD_HASH_BUCKETS - 1);
+        bucket_of[i] = b;
+
+        if (++bucket_len[b] > max_len)
+        {
+            max_len = bucket_len[b];
+        }
+    }
+
+    /* place the fullest buckets first, they are the hardest to fit */
+    for (len = max_len; len > 0; len--)
+    {
+        for (b = 0; b < CMD_HASH_BUCKETS; b++)
+        {
+            unsigned int d;
+
+            if (bucket_len[b] != len)
+            {
+                continue;
+            }
+
+            for (d = 1; d <= CMD_DISPLACE_MAX; d++)
+            {
+                int j;
+
+                for (i = 0; test_list[i].cmd != 0x00; i++)
+                {
+                    unsigned int s;
+
+                    if (bucket_of[i] != b)
+                    {
+                        continue;
+                    }
+
+                    s = cmd_hash(test_list[i].name, d) & (CMD_HASH_SLOTS - 1);
+
+                    if (cmd_slot[s])
+                    {
+                        break;
+                    }
+
+                    cmd_slot[s] = i + 1;
+                }
+
+                if (test_list[i].cmd == 0x00)
+                {
+                    break;
+                }
+
+                /* collision, undo this bucket and try the next displacement */
+                for (j = 0; j < i; j++)
+                {
+                    if (bucket_of[j] == b)
+                    {
+                        cmd_slot[cmd_hash(test_list[j].name, d) & (CMD_HASH_SLOTS - 1)] = 0;
+                    }
+                }
+            }
+
+            if (d > CMD_DISPLACE_MAX)
+            {
+                rig_debug(RIG_DEBUG_WARN, "%s: no displacement fits bucket %d, "
+                          "long names will be scanned\n", __func__, b);
+                cmd_slot_linear = 1;
+                goto build_done;
+            }
+
+            cmd_displace[b] = d;
         }
     }
 
-    if (test_list[i].cmd == 0x00)
+build_done:
+#ifndef HAVE_PTHREAD
+    cmd_table_done = 1;
+#endif
+    return;
+}
+
+
+static void cmd_table_init(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_once(&cmd_table_once, cmd_table_build);
+#else
+
+    if (!cmd_table_done)
+    {
+        cmd_table_build();
+    }
+
+#endif
+}
+
+
+static struct test_table *find_cmd_entry(int cmd)
+{
+    int i;
+
+    cmd_table_init();
+
+    i = cmd_index[cmd & 0xff];
+
+    if (i == 0)
     {
         return NULL;
     }
 
-    return &test_list[i];
+    return &test_list[i - 1];
 }
 
 
@@ -464,18 +660,35 @@ static void rp_getline(const char *s)
 #endif
 
 /*
- * TODO: use Lex?
+ * Map a long command name to its command code, 0 when unknown
  */
 static char parse_arg(const char *arg)
 {
+    unsigned int b;
     int i;
 
-    for (i = 0; test_list[i].cmd != 0x00; i++)
+    cmd_table_init();
+
+    if (cmd_slot_linear)
     {
-        if (!strncmp(arg, test_list[i].name, MAXNAMSIZ))
+        for (i = 0; test_list[i].cmd != 0x00; i++)
         {
-            return test_list[i].cmd;
+            if (test_list[i].name[0] != '\0'
+                    && !strncmp(arg, test_list[i].name, MAXNAMSIZ))
+            {
+                return test_list[i].cmd;
+            }
         }
+
+        return 0;
+    }
+
+    b = cmd_hash(arg, 0) & (CMD_HASH_BUCKETS - 1);
+    i = cmd_slot[cmd_hash(arg, cmd_displace[b]) & (CMD_HASH_SLOTS - 1)];
+
+    if (i && !strncmp(arg, test_list[i - 1].name, MAXNAMSIZ))
+    {
+        return test_list[i - 1].cmd;
     }
 
     return 0;
@@ -620,1122 +833,2368 @@ static int next_word(char *buffer, int argc, char *argv[], int newline)
     })
 
 
-int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
-                 sync_cb_t sync_cb,
-                 int interactive, int prompt, int *vfo_opt, char send_cmd_term,
-                 int *ext_resp_ptr, char *resp_sep_ptr)
+/*
+ * Request coalescing
+ *
+ * When several rigctld clients issue the same read command (same cmd,
+ * VFO, argument and response format) while one is already in flight,
+ * the late comers do not go to the rig: they wait for the pending one
+ * and get a copy of its output.  Only entries not yet completed can be
+ * joined, and the result is published while the leader still holds the
+ * rig lock, so a client never sees a value older than its request.
+ */
+#if defined(HAVE_PTHREAD) && defined(HAVE_OPEN_MEMSTREAM)
+#define HAVE_COALESCE 1
+
+struct coalesce_entry
 {
-    int retcode;        /* generic return code from functions */
     unsigned char cmd;
-    struct test_table *cmd_entry = NULL;
+    vfo_t vfo;
+    char arg1[MAXARGSZ + 1];
+    int vfo_opt;
+    int ext_resp;
+    char resp_sep;
+    int done;
+    int retcode;
+    char *out;
+    size_t outlen;
+    int refs;
+    struct coalesce_entry *next;
+};
 
-    char command[MAXARGSZ + 1];
-    char arg1[MAXARGSZ + 1], *p1 = NULL;
-    char arg2[MAXARGSZ + 1], *p2 = NULL;
-    char arg3[MAXARGSZ + 1], *p3 = NULL;
-    vfo_t vfo = RIG_VFO_CURR;
+static int coalesce_enabled;
+static unsigned long coalesce_hits, coalesce_misses;
+static struct coalesce_entry *coalesce_list;
+static pthread_mutex_t coalesce_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t coalesce_cond = PTHREAD_COND_INITIALIZER;
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: called, interactive=%d\n", __func__,
-              interactive);
 
-    /* cmd, internal, rigctld */
-    if (!(interactive && prompt && have_rl))
-    {
+/*
+ * Join an identical in-flight read, or register a new one.
+ * *leader is set when the caller has to run the command itself.
+ */
+static struct coalesce_entry *coalesce_join(unsigned char cmd, vfo_t vfo,
+        const char *arg1, int vfo_opt, int ext_resp, char resp_sep, int *leader)
+{
+    struct coalesce_entry *ce;
 
-        if (interactive)
+    pthread_mutex_lock(&coalesce_lock);
+
+    for (ce = coalesce_list; ce; ce = ce->next)
+    {
+        if (ce->cmd == cmd && ce->vfo == vfo && ce->vfo_opt == vfo_opt
+                && ce->ext_resp == ext_resp && ce->resp_sep == resp_sep
+                && !strcmp(ce->arg1, arg1 ? arg1 : ""))
         {
-            static int last_was_ret = 1;
+            ce->refs++;
+            coalesce_hits++;
+            pthread_mutex_unlock(&coalesce_lock);
+            *leader = 0;
+            return ce;
+        }
+    }
 
-            if (prompt)
-            {
-                fprintf_flush(fout, "\nRig command: ");
-            }
+    ce = calloc(1, sizeof(struct coalesce_entry));
 
-            do
-            {
-                if ((retcode = scanfc(fin, "%c", &cmd)) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#1? retcode=%d\n", __func__,
-                              retcode);
-                    return -1;
-                }
+    if (ce)
+    {
+        ce->cmd = cmd;
+        ce->vfo = vfo;
+        snprintf(ce->arg1, sizeof(ce->arg1), "%s", arg1 ? arg1 : "");
+        ce->vfo_opt = vfo_opt;
+        ce->ext_resp = ext_resp;
+        ce->resp_sep = resp_sep;
+        ce->refs = 1;
+        ce->next = coalesce_list;
+        coalesce_list = ce;
+        coalesce_misses++;
+    }
 
-                if (cmd != 0xa)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: cmd=%c(%02x)\n", __func__,
-                              isprint(cmd) ? cmd : ' ', cmd);
-                }
+    pthread_mutex_unlock(&coalesce_lock);
+    *leader = 1;
 
-                /* Extended response protocol requested with leading '+' on command
-                 * string--rigctld only!
-                 */
-                if (cmd == '+' && !prompt)
-                {
-                    *ext_resp_ptr = 1;
+    return ce;
+}
 
-                    if (scanfc(fin, "%c", &cmd) < 1)
-                    {
-                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#2?\n", __func__);
-                        return -1;
-                    }
-                }
-                else if (cmd == '+' && prompt)
-                {
-                    return 0;
-                }
 
-                if (cmd != '\\'
-                        && cmd != '_'
-                        && cmd != '#'
-                        && cmd != '('
-                        && cmd != ')'
-                        && ispunct(cmd)
-                        && !prompt)
-                {
+static void coalesce_release(struct coalesce_entry *ce)
+{
+    if (--ce->refs == 0)
+    {
+        free(ce->out);
+        free(ce);
+    }
+}
 
-                    *ext_resp_ptr = 1;
-                    *resp_sep_ptr = cmd;
 
-                    if (scanfc(fin, "%c", &cmd) < 1)
-                    {
-                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#3?\n", __func__);
-                        return -1;
-                    }
-                }
-                else if (cmd != '\\'
-                         && cmd != '?'
-                         && cmd != '_'
-                         && cmd != '#'
-                         && cmd != '('
-                         && cmd != ')'
-                         && ispunct(cmd)
-                         && prompt)
-                {
+/*
+ * Leader side: publish the result and wake up the waiters
+ */
+static void coalesce_publish(struct coalesce_entry *ce, int retcode, char *out,
+                             size_t outlen)
+{
+    struct coalesce_entry **pce;
 
-                    return 0;
-                }
+    pthread_mutex_lock(&coalesce_lock);
 
-                /* command by name */
-                if (cmd == '\\')
-                {
-                    unsigned char cmd_name[MAXNAMSIZ], *pcmd = cmd_name;
-                    int c_len = MAXNAMSIZ;
+    for (pce = &coalesce_list; *pce; pce = &(*pce)->next)
+    {
+        if (*pce == ce)
+        {
+            *pce = ce->next;
+            break;
+        }
+    }
 
-                    if (scanfc(fin, "%c", pcmd) < 1)
-                    {
-                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#4?\n", __func__);
-                        return -1;
-                    }
+    ce->retcode = retcode;
+    ce->out = out;
+    ce->outlen = outlen;
+    ce->done = 1;
+    pthread_cond_broadcast(&coalesce_cond);
+    coalesce_release(ce);
 
-                    while (c_len-- && (isalnum(*pcmd) || *pcmd == '_'))
-                    {
-                        if (scanfc(fin, "%c", ++pcmd) < 1)
-                        {
-                            rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#5?\n", __func__);
-                            return -1;
-                        }
-                    }
+    pthread_mutex_unlock(&coalesce_lock);
+}
 
-                    *pcmd = '\0';
-                    cmd = parse_arg((char *)cmd_name);
-                    rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd=%s\n", __func__, cmd_name);
-                    break;
-                }
 
-                rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd==0x%02x\n", __func__, cmd);
+/*
+ * Waiter side: copy the leader's output to fout and return its status
+ */
+static int coalesce_wait(struct coalesce_entry *ce, FILE *fout)
+{
+    int retcode;
 
-                if (cmd == 0x0a || cmd == 0x0d)
-                {
-                    if (last_was_ret)
-                    {
-                        if (prompt)
-                        {
-                            fprintf(fout, "? for help, q to quit.\n");
-                            fprintf_flush(fout, "\nRig command: ");
-                        }
+    pthread_mutex_lock(&coalesce_lock);
 
-                        return 0;
-                    }
+    while (!ce->done)
+    {
+        pthread_cond_wait(&coalesce_cond, &coalesce_lock);
+    }
 
-                    last_was_ret = 1;
-                }
-            }
-            while (cmd == 0x0a || cmd == 0x0d);
+    if (ce->outlen)
+    {
+        fwrite(ce->out, 1, ce->outlen, fout);
+    }
 
-            last_was_ret = 0;
+    retcode = ce->retcode;
+    coalesce_release(ce);
 
-            /* comment line */
-            if (cmd == '#')
-            {
-                while (cmd != '\n' && cmd != '\r')
-                {
-                    if (scanfc(fin, "%c", &cmd) < 1)
-                    {
-                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#6?\n", __func__);
-                        return -1;
-                    }
-                }
+    pthread_mutex_unlock(&coalesce_lock);
 
-                return 0;
-            }
+    return retcode;
+}
+#endif
 
-            my_rig->state.vfo_opt = *vfo_opt;
-            rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
 
-            if (cmd == 'Q' || cmd == 'q')
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: quit returning NETRIGCTL_RET 0\n", __func__);
+static rigctl_subscribe_cb_t subscribe_cb;
 
-                if (interactive && !prompt) { fprintf(fout, "%s0\n", NETRIGCTL_RET); }
 
-                fflush(fout);
-                return 1;
-            }
+/*
+ * Set the function turning a connection into a notification stream
+ * (rigctld only), the subscribe command is not available without one.
+ */
+void rigctl_set_subscribe_cb(rigctl_subscribe_cb_t cb)
+{
+    subscribe_cb = cb;
+}
 
-            if (cmd == '?')
-            {
-                usage_rig(fout);
-                fflush(fout);
-                return 0;
-            }
-        }
-        else
-        {
-            /* parse rest of command line */
-            retcode = next_word(command, argc, argv, 1);
 
-            if (EOF == retcode)
-            {
-                return 1;
-            }
-            else if (retcode < 0)
-            {
-                return retcode;
-            }
-            else if ('\0' == command[1])
-            {
-                cmd = command[0];
-            }
-            else
-            {
-                cmd = parse_arg(command);
-            }
-        }
+#if defined(HAVE_SYS_SOCKET_H) && !defined(__MINGW32__)
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
 
-        cmd_entry = find_cmd_entry(cmd);
+/*
+ * Send a batch of notification lines to a subscriber without blocking.
+ * What its socket does not take is kept in out and goes first next time,
+ * so that no line is ever cut; while some is left, new batches are
+ * dropped whole.  A batch of len 0 only sends what was left.
+ *
+ * Returns 0 when the batch was sent or kept, 1 when it was dropped, and
+ * -1 when the subscriber is gone.
+ */
+int rigctl_notify_send(int sock, struct rigctl_notify_out *out,
+                       const char *batch, size_t len)
+{
+    ssize_t n;
 
-        if (!cmd_entry)
+    if (out->len > 0)
+    {
+        n = send(sock, out->pending, out->len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
         {
-            if (cmd != ' ')
-            {
-                fprintf(stderr, "Command '%c' not found!\n", cmd);
-            }
+            return -1;
+        }
 
-            return 0;
+        if (n > 0)
+        {
+            memmove(out->pending, out->pending + n, out->len - n);
+            out->len -= n;
         }
 
-        if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
+        if (out->len > 0)
         {
-            if (interactive)
-            {
-                if (prompt)
-                {
-                    fprintf_flush(fout, "VFO: ");
-                }
+            return len > 0;
+        }
+    }
 
-                if (scanfc(fin, "%s", arg1) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#7?\n", __func__);
-                    return -1;
-                }
+    if (len == 0)
+    {
+        return 0;
+    }
 
-                vfo = rig_parse_vfo(arg1);
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
+    if (len > sizeof(out->pending))
+    {
+        return 1;
+    }
 
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
+    n = send(sock, batch, len, MSG_DONTWAIT | MSG_NOSIGNAL);
 
-                vfo = rig_parse_vfo(arg1);
-            }
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            return -1;
         }
 
-        rig_debug(RIG_DEBUG_TRACE, "%s: debug1\n", __func__);
+        n = 0;
+    }
 
-        if ((cmd_entry->flags & ARG_IN_LINE)
-                && (cmd_entry->flags & ARG_IN1)
-                && cmd_entry->arg1)
-        {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug2\n", __func__);
+    memcpy(out->pending, batch + n, len - n);
+    out->len = len - n;
 
-            if (interactive)
-            {
-                char *nl;
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug2a\n", __func__);
+    return 0;
+}
+#endif
 
 
-                if (fgets(arg1, MAXARGSZ, fin) == NULL)
-                {
-                    return -1;
-                }
+/*
+ * Enable sharing of identical in-flight read commands (rigctld only)
+ */
+int rigctl_set_coalesce(int enable)
+{
+#ifdef HAVE_COALESCE
+    coalesce_enabled = enable;
+    return RIG_OK;
+#else
+    return enable ? -RIG_ENIMPL : RIG_OK;
+#endif
+}
 
-                if (arg1[0] == 0xa)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: debug2b\n", __func__);
 
-                    if (prompt)
-                    {
-                        fprintf_flush(fout, "%s: ", cmd_entry->arg1);
-                    }
+/* per command latency, lock wait included, while stats are enabled */
+static struct stats_hist cmd_stats[256];
 
-                    if (fgets(arg1, MAXARGSZ, fin) == NULL)
-                    {
-                        return -1;
-                    }
-                }
 
-                nl = strchr(arg1, 0xa);
+/*
+ * Print the library statistics followed by those of every command
+ * run since they were enabled, one item per line.
+ */
+void rigctl_stats_print(FILE *fout, char sep)
+{
+    int i;
 
-                if (nl)
-                {
-                    *nl = '\0';    /* chomp */
-                }
+    fprintf(fout, "enabled: %d%c", rig_stats_enabled(), sep);
 
-                if (cmd == 'b')
-                {
-                    p1 = arg1; /* CW must accept a space argument */
-                }
-                else   /* skip a space arg if first arg...but why? */
-                {
-                    p1 = arg1[0] == ' ' ? arg1 + 1 : arg1;
-                }
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
+    rig_stats_print(fout, sep);
 
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
+    for (i = 0; i < 256; i++)
+    {
+        struct test_table *cmd_entry;
+        char name[MAXNAMSIZ + 8];
 
-                p1 = arg1;
-            }
-        }
-        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+        if (cmd_stats[i].count == 0 || !(cmd_entry = find_cmd_entry(i)))
         {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug3\n", __func__);
+            continue;
+        }
 
-            if (interactive)
-            {
-                int c = fgetc(fin);
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug4 c=%02x\n", __func__, c);
+        snprintf(name, sizeof(name), "cmd %s", cmd_entry->name);
+        rig_stats_hist_print(fout, name, &cmd_stats[i], sep);
+    }
+}
 
-                if (prompt && c == 0x0a)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg1);
-                }
-                else
-                {
-                    ungetc(c, fin);
-                }
 
-                if (scanfc(fin, "%s", arg1) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#8?\n", __func__);
-                    return -1;
-                }
+/*
+ * Run a parsed command: locking, request coalescing, the extended
+ * response header and the return code line.  Shared by rigctl_parse()
+ * and rigctl_parse_input().
+ */
+static int rigctl_exec(RIG *my_rig, FILE *fin, FILE *fout, sync_cb_t sync_cb,
+                       int interactive, int prompt, int *vfo_opt,
+                       char send_cmd_term, int *ext_resp_ptr, char *resp_sep_ptr,
+                       unsigned char cmd, struct test_table *cmd_entry,
+                       vfo_t vfo, char *p1, char *p2, char *p3)
+{
+    int retcode;
+    FILE *fcmd = fout;
+    uint64_t start_us = rig_stats_enabled() ? rig_stats_now_us() : 0;
+#ifdef HAVE_COALESCE
+    struct coalesce_entry *ce = NULL;
+    int ce_leader = 0;
+    char *ce_out = NULL;
+    size_t ce_outlen = 0;
+#endif
 
-                p1 = arg1;
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
+#ifdef HAVE_COALESCE
 
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
+    if (coalesce_enabled && interactive && !prompt
+            && (cmd_entry->flags & ARG_COALESCE))
+    {
+        ce = coalesce_join(cmd, vfo, p1, *vfo_opt, *ext_resp_ptr, *resp_sep_ptr,
+                           &ce_leader);
 
-                p1 = arg1;
-            }
+        if (ce && ce_leader)
+        {
+            /* capture the output so waiters can get a copy */
+            fcmd = open_memstream(&ce_out, &ce_outlen);
         }
-
-        rig_debug(RIG_DEBUG_TRACE, "%s: debug5\n", __func__);
-
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN2)
-                && cmd_entry->arg2)
+        else if (ce)
         {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug6\n", __func__);
-
-            if (interactive)
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug7\n", __func__);
+            sync_cb = NULL; /* waiters do not touch the rig */
+        }
+    }
 
-#if 0 // was printing Reply: twice
+#endif
 
-                if (prompt)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: debug8\n", __func__);
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg2);
-                }
+    if (cmd_entry->flags & ARG_NOLOCK)
+    {
+        sync_cb = NULL;
+    }
 
-#endif
+    if (sync_cb) { sync_cb(1); }    /* lock if necessary */
+
+    if (!prompt)
+    {
+        rig_debug(RIG_DEBUG_TRACE,
+                  "rigctl(d): %c '%s' '%s' '%s' '%s'\n",
+                  cmd,
+                  rig_strvfo(vfo),
+                  p1 ? p1 : "",
+                  p2 ? p2 : "",
+                  p3 ? p3 : "");
+    }
+
+    /*
+     * Extended Response protocol: output received command name and arguments
+     * response.  Don't send command header on '\chk_vfo' command.
+     */
+    if (interactive && *ext_resp_ptr && !prompt && cmd != 0xf0)
+    {
+        char a1[MAXARGSZ + 2];
+        char a2[MAXARGSZ + 2];
+        char a3[MAXARGSZ + 2];
+        char vfo_str[MAXARGSZ + 2];
+
+        *vfo_opt == 0 ? vfo_str[0] = '\0' : snprintf(vfo_str,
+                                     sizeof(vfo_str),
+                                     " %s",
+                                     rig_strvfo(vfo));
+
+        p1 == NULL ? a1[0] = '\0' : snprintf(a1, sizeof(a1), " %s", p1);
+        p2 == NULL ? a2[0] = '\0' : snprintf(a2, sizeof(a2), " %s", p2);
+        p3 == NULL ? a3[0] = '\0' : snprintf(a3, sizeof(a3), " %s", p3);
+
+        fprintf(fout,
+                "%s:%s%s%s%s%c",
+                cmd_entry->name,
+                vfo_str,
+                a1,
+                a2,
+                a3,
+                *resp_sep_ptr);
+    }
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
+
+#ifdef HAVE_COALESCE
+
+    if (ce && !ce_leader)
+    {
+        retcode = coalesce_wait(ce, fout);
+    }
+    else if (ce && !fcmd)
+    {
+        retcode = -RIG_ENOMEM;
+        coalesce_publish(ce, retcode, NULL, 0);
+    }
+    else
+#endif
+        retcode = (*cmd_entry->rig_routine)(my_rig,
+                                            fcmd,
+                                            fin,
+                                            interactive,
+                                            prompt,
+                                            vfo_opt,
+                                            send_cmd_term,
+                                            *ext_resp_ptr,
+                                            *resp_sep_ptr,
+                                            cmd_entry,
+                                            vfo,
+                                            p1,
+                                            p2 ? p2 : "",
+                                            p3 ? p3 : "");
+
+#ifdef HAVE_COALESCE
+
+    if (ce && ce_leader && fcmd)
+    {
+        fclose(fcmd);
+        fwrite(ce_out, 1, ce_outlen, fout);
+        coalesce_publish(ce, retcode, ce_out, ce_outlen);
+    }
+
+#endif
+
+    if (start_us)
+    {
+        rig_stats_hist_add(&cmd_stats[cmd], rig_stats_now_us() - start_us);
+    }
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
+
+    if (retcode == RIG_EIO)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: RIG_EIO?\n", __func__);
+
+        if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+
+        return retcode;
+    }
+
+    if (retcode != RIG_OK)
+    {
+        /* only for rigctld */
+        if (interactive && !prompt)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: return#1 "NETRIGCTL_RET "%d\n", __func__,
+                      retcode);
+            fprintf(fout, NETRIGCTL_RET "%d\n", retcode);
+            *ext_resp_ptr = 0;
+            *resp_sep_ptr = '\n';
+        }
+        else
+        {
+            fprintf(fout,
+                    "%s: error = %s\n",
+                    cmd_entry->name,
+                    rigerror(retcode));
+        }
+    }
+    else
+    {
+        /* only for rigctld */
+        if (interactive && !prompt)
+        {
+            /* netrigctl RIG_OK */
+            if (!(cmd_entry->flags & ARG_OUT)
+                    && !*ext_resp_ptr && cmd != 0xf0)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: return#2 "NETRIGCTL_RET "0\n", __func__);
+                fprintf(fout, NETRIGCTL_RET "0\n");
+            }
+
+            /* Extended Response protocol */
+            else if (*ext_resp_ptr && cmd != 0xf0)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: return#3 "NETRIGCTL_RET "0\n", __func__);
+                fprintf(fout, NETRIGCTL_RET "0\n");
+                *ext_resp_ptr = 0;
+                *resp_sep_ptr = '\n';
+            }
+        }
+    }
+
+    fflush(fout);
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: retcode=%d\n", __func__, retcode);
+
+    if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+
+    if (retcode == -RIG_ENAVAIL)
+    {
+        return retcode;
+    }
+
+    return retcode != RIG_OK ? 2 : 0;
+}
+
+
+int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
+                 sync_cb_t sync_cb,
+                 int interactive, int prompt, int *vfo_opt, char send_cmd_term,
+                 int *ext_resp_ptr, char *resp_sep_ptr)
+{
+    int retcode;        /* generic return code from functions */
+    unsigned char cmd;
+    struct test_table *cmd_entry = NULL;
+
+    char command[MAXARGSZ + 1];
+    char arg1[MAXARGSZ + 1], *p1 = NULL;
+    char arg2[MAXARGSZ + 1], *p2 = NULL;
+    char arg3[MAXARGSZ + 1], *p3 = NULL;
+    vfo_t vfo = RIG_VFO_CURR;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: called, interactive=%d\n", __func__,
+              interactive);
+
+    /* cmd, internal, rigctld */
+    if (!(interactive && prompt && have_rl))
+    {
+
+        if (interactive)
+        {
+            static int last_was_ret = 1;
+
+            if (prompt)
+            {
+                fprintf_flush(fout, "\nRig command: ");
+            }
+
+            do
+            {
+                if ((retcode = scanfc(fin, "%c", &cmd)) < 1)
+                {
+                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#1? retcode=%d\n", __func__,
+                              retcode);
+                    return -1;
+                }
+
+                if (cmd != 0xa)
+                {
+                    rig_debug(RIG_DEBUG_TRACE, "%s: cmd=%c(%02x)\n", __func__,
+                              isprint(cmd) ? cmd : ' ', cmd);
+                }
+
+                /* Extended response protocol requested with leading '+' on command
+                 * string--rigctld only!
+                 */
+                if (cmd == '+' && !prompt)
+                {
+                    *ext_resp_ptr = 1;
+
+                    if (scanfc(fin, "%c", &cmd) < 1)
+                    {
+                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#2?\n", __func__);
+                        return -1;
+                    }
+                }
+                else if (cmd == '+' && prompt)
+                {
+                    return 0;
+                }
+
+                if (cmd != '\\'
+                        && cmd != '_'
+                        && cmd != '#'
+                        && cmd != '('
+                        && cmd != ')'
+                        && ispunct(cmd)
+                        && !prompt)
+                {
+
+                    *ext_resp_ptr = 1;
+                    *resp_sep_ptr = cmd;
+
+                    if (scanfc(fin, "%c", &cmd) < 1)
+                    {
+                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#3?\n", __func__);
+                        return -1;
+                    }
+                }
+                else if (cmd != '\\'
+                         && cmd != '?'
+                         && cmd != '_'
+                         && cmd != '#'
+                         && cmd != '('
+                         && cmd != ')'
+                         && ispunct(cmd)
+                         && prompt)
+                {
+
+                    return 0;
+                }
+
+                /* command by name */
+                if (cmd == '\\')
+                {
+                    unsigned char cmd_name[MAXNAMSIZ], *pcmd = cmd_name;
+                    int c_len = MAXNAMSIZ;
+
+                    if (scanfc(fin, "%c", pcmd) < 1)
+                    {
+                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#4?\n", __func__);
+                        return -1;
+                    }
+
+                    while (c_len-- && (isalnum(*pcmd) || *pcmd == '_'))
+                    {
+                        if (scanfc(fin, "%c", ++pcmd) < 1)
+                        {
+                            rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#5?\n", __func__);
+                            return -1;
+                        }
+                    }
+
+                    *pcmd = '\0';
+                    cmd = parse_arg((char *)cmd_name);
+                    rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd=%s\n", __func__, cmd_name);
+                    break;
+                }
+
+                rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd==0x%02x\n", __func__, cmd);
+
+                if (cmd == 0x0a || cmd == 0x0d)
+                {
+                    if (last_was_ret)
+                    {
+                        if (prompt)
+                        {
+                            fprintf(fout, "? for help, q to quit.\n");
+                            fprintf_flush(fout, "\nRig command: ");
+                        }
+
+                        return 0;
+                    }
+
+                    last_was_ret = 1;
+                }
+            }
+            while (cmd == 0x0a || cmd == 0x0d);
+
+            last_was_ret = 0;
+
+            /* comment line */
+            if (cmd == '#')
+            {
+                while (cmd != '\n' && cmd != '\r')
+                {
+                    if (scanfc(fin, "%c", &cmd) < 1)
+                    {
+                        rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#6?\n", __func__);
+                        return -1;
+                    }
+                }
+
+                return 0;
+            }
+
+            my_rig->state.vfo_opt = *vfo_opt;
+            rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
+
+            if (cmd == 'Q' || cmd == 'q')
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: quit returning NETRIGCTL_RET 0\n", __func__);
+
+                if (interactive && !prompt) { fprintf(fout, "%s0\n", NETRIGCTL_RET); }
+
+                fflush(fout);
+                return 1;
+            }
+
+            if (cmd == '?')
+            {
+                usage_rig(fout);
+                fflush(fout);
+                return 0;
+            }
+        }
+        else
+        {
+            /* parse rest of command line */
+            retcode = next_word(command, argc, argv, 1);
+
+            if (EOF == retcode)
+            {
+                return 1;
+            }
+            else if (retcode < 0)
+            {
+                return retcode;
+            }
+            else if ('\0' == command[1])
+            {
+                cmd = command[0];
+            }
+            else
+            {
+                cmd = parse_arg(command);
+            }
+        }
+
+        cmd_entry = find_cmd_entry(cmd);
+
+        if (!cmd_entry)
+        {
+            if (cmd != ' ')
+            {
+                fprintf(stderr, "Command '%c' not found!\n", cmd);
+            }
+
+            return 0;
+        }
+
+        if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
+        {
+            if (interactive)
+            {
+                if (prompt)
+                {
+                    fprintf_flush(fout, "VFO: ");
+                }
+
+                if (scanfc(fin, "%s", arg1) < 1)
+                {
+                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#7?\n", __func__);
+                    return -1;
+                }
+
+                vfo = rig_parse_vfo(arg1);
+            }
+            else
+            {
+                retcode = next_word(arg1, argc, argv, 0);
+
+                if (EOF == retcode)
+                {
+                    fprintf(stderr, "Invalid arg for command '%s'\n",
+                            cmd_entry->name);
+                }
+                else if (retcode < 0)
+                {
+                    return retcode;
+                }
+
+                vfo = rig_parse_vfo(arg1);
+            }
+        }
+
+        rig_debug(RIG_DEBUG_TRACE, "%s: debug1\n", __func__);
+
+        if ((cmd_entry->flags & ARG_IN_LINE)
+                && (cmd_entry->flags & ARG_IN1)
+                && cmd_entry->arg1)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: debug2\n", __func__);
+
+            if (interactive)
+            {
+                char *nl;
+                rig_debug(RIG_DEBUG_TRACE, "%s: debug2a\n", __func__);
+
+
+                if (fgets(arg1, MAXARGSZ, fin) == NULL)
+                {
+                    return -1;
+                }
+
+                if (arg1[0] == 0xa)
+                {
+                    rig_debug(RIG_DEBUG_TRACE, "%s: debug2b\n", __func__);
+
+                    if (prompt)
+                    {
+                        fprintf_flush(fout, "%s: ", cmd_entry->arg1);
+                    }
+
+                    if (fgets(arg1, MAXARGSZ, fin) == NULL)
+                    {
+                        return -1;
+                    }
+                }
+
+                nl = strchr(arg1, 0xa);
+
+                if (nl)
+                {
+                    *nl = '\0';    /* chomp */
+                }
+
+                if (cmd == 'b')
+                {
+                    p1 = arg1; /* CW must accept a space argument */
+                }
+                else   /* skip a space arg if first arg...but why? */
+                {
+                    p1 = arg1[0] == ' ' ? arg1 + 1 : arg1;
+                }
+            }
+            else
+            {
+                retcode = next_word(arg1, argc, argv, 0);
+
+                if (EOF == retcode)
+                {
+                    fprintf(stderr, "Invalid arg for command '%s'\n",
+                            cmd_entry->name);
+                    return 1;
+                }
+                else if (retcode < 0)
+                {
+                    return retcode;
+                }
+
+                p1 = arg1;
+            }
+        }
+        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: debug3\n", __func__);
+
+            if (interactive)
+            {
+                int c = fgetc(fin);
+                rig_debug(RIG_DEBUG_TRACE, "%s: debug4 c=%02x\n", __func__, c);
+
+                if (prompt && c == 0x0a)
+                {
+                    fprintf_flush(fout, "%s: ", cmd_entry->arg1);
+                }
+                else
+                {
+                    ungetc(c, fin);
+                }
+
+                if (scanfc(fin, "%s", arg1) < 1)
+                {
+                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#8?\n", __func__);
+                    return -1;
+                }
+
+                p1 = arg1;
+            }
+            else
+            {
+                retcode = next_word(arg1, argc, argv, 0);
+
+                if (EOF == retcode)
+                {
+                    fprintf(stderr, "Invalid arg for command '%s'\n",
+                            cmd_entry->name);
+                    return 1;
+                }
+                else if (retcode < 0)
+                {
+                    return retcode;
+                }
+
+                p1 = arg1;
+            }
+        }
+
+        rig_debug(RIG_DEBUG_TRACE, "%s: debug5\n", __func__);
+
+        if (p1
+                && p1[0] != '?'
+                && (cmd_entry->flags & ARG_IN2)
+                && cmd_entry->arg2)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: debug6\n", __func__);
+
+            if (interactive)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: debug7\n", __func__);
+
+#if 0 // was printing Reply: twice
+
+                if (prompt)
+                {
+                    rig_debug(RIG_DEBUG_TRACE, "%s: debug8\n", __func__);
+                    fprintf_flush(fout, "%s: ", cmd_entry->arg2);
+                }
+
+#endif
 
                 if (scanfc(fin, "%s", arg2) < 1)
                 {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#9?\n", __func__);
-                    return -1;
+                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#9?\n", __func__);
+                    return -1;
+                }
+
+                p2 = arg2;
+            }
+            else
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: debug9\n", __func__);
+                retcode = next_word(arg2, argc, argv, 0);
+
+                if (EOF == retcode)
+                {
+                    fprintf(stderr, "Invalid arg for command '%s'\n",
+                            cmd_entry->name);
+                    return 1;
+                }
+                else if (retcode < 0)
+                {
+                    return retcode;
+                }
+
+                p2 = arg2;
+            }
+        }
+
+        rig_debug(RIG_DEBUG_TRACE, "%s: debug10\n", __func__);
+
+        if (p1
+                && p1[0] != '?'
+                && (cmd_entry->flags & ARG_IN3)
+                && cmd_entry->arg3)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: debug11\n", __func__);
+
+            if (interactive)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: debug12\n", __func__);
+
+                if (prompt)
+                {
+                    rig_debug(RIG_DEBUG_TRACE, "%s: debug13\n", __func__);
+                    fprintf_flush(fout, "%s: ", cmd_entry->arg3);
+                }
+
+                if (scanfc(fin, "%s", arg3) < 1)
+                {
+                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#10?\n", __func__);
+                    return -1;
+                }
+
+                p3 = arg3;
+            }
+            else
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: debug14\n", __func__);
+                retcode = next_word(arg3, argc, argv, 0);
+
+                if (EOF == retcode)
+                {
+                    fprintf(stderr,
+                            "Invalid arg for command '%s'\n",
+                            cmd_entry->name);
+                    return 1;
+                }
+                else if (retcode < 0)
+                {
+                    return retcode;
+                }
+
+                p3 = arg3;
+            }
+        }
+    }
+
+#ifdef HAVE_LIBREADLINE
+
+    if (interactive && prompt && have_rl)
+    {
+        int j, x;
+
+#ifdef HAVE_READLINE_HISTORY
+        /* Minimum space for 32+1+32+1+128+1+128+1+128+1 = 453 chars, so
+         * allocate 512 chars cleared to zero for safety.
+         */
+        rp_hist_buf = (char *)calloc(512, sizeof(char));
+#endif
+
+        rp_getline("\nRig command: ");
+
+        /* EOF (Ctl-D) received on empty input line, bail out gracefully. */
+        if (!input_line)
+        {
+            fprintf_flush(fout, "\n");
+            return 1;
+        }
+
+        /* Q or q to quit */
+        if (!(strncasecmp(input_line, "q", 1)))
+        {
+            return 1;
+        }
+
+        /* '?' for help */
+        if (!(strncmp(input_line, "?", 1)))
+        {
+            usage_rig(fout);
+            fflush(fout);
+            return 0;
+        }
+
+        /* '#' for comment */
+        if (!(strncmp(input_line, "#", 1)))
+        {
+            return 0;
+        }
+
+        /* Blank line entered */
+        if (!(strcmp(input_line, "")))
+        {
+            fprintf(fout, "? for help, q to quit.\n");
+            fflush(fout);
+            return 0;
+        }
+
+        rig_debug(RIG_DEBUG_TRACE, "%s: input_line: %s\n", __func__, input_line);
+
+        /* Split input_line on any number of spaces to get the command token
+         * Tabs are intercepted by readline for completion and a newline
+         * causes readline to return the typed text.  If more than one
+         * argument is given, it will be parsed out later.
+         */
+        result = strtok(input_line, " ");
+
+        /* parsed_input stores pointers into input_line where the token strings
+         * start.
+         */
+        if (result)
+        {
+            parsed_input[0] = result;
+        }
+        else
+        {
+            /* Oops!  Invoke GDB!! */
+            fprintf_flush(fout, "\n");
+            return 1;
+        }
+
+        /* At this point parsed_input contains the typed text of the command
+         * with surrounding space characters removed.  If Readline History is
+         * available, copy the command string into a history buffer.
+         */
+
+        /* Single character command */
+        if ((strlen(parsed_input[0]) == 1) && (*parsed_input[0] != '\\'))
+        {
+            cmd = *parsed_input[0];
+
+#ifdef HAVE_READLINE_HISTORY
+
+            /* Store what is typed, not validated, for history. */
+            if (rp_hist_buf)
+            {
+                strncpy(rp_hist_buf, parsed_input[0], 1);
+            }
+
+#endif
+        }
+        /* Test the command token, parsed_input[0] */
+        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) > 1))
+        {
+            char cmd_name[MAXNAMSIZ];
+
+            /* if there is no terminating '\0' character in the source string,
+             * srncpy() doesn't add one even if the supplied length is less
+             * than the destination array.  Truncate the source string here.
+             */
+            if (strlen(parsed_input[0] + 1) >= MAXNAMSIZ)
+            {
+                *(parsed_input[0] + MAXNAMSIZ) = '\0';
+            }
+
+#ifdef HAVE_READLINE_HISTORY
+
+            if (rp_hist_buf)
+            {
+                strncpy(rp_hist_buf, parsed_input[0], MAXNAMSIZ);
+            }
+
+#endif
+            /* The starting position of the source string is the first
+             * character past the initial '\'.
+             */
+            snprintf(cmd_name, sizeof(cmd_name), "%s", parsed_input[0] + 1);
+
+            /* Sanity check as valid multiple character commands consist of
+             * alphanumeric characters and the underscore ('_') character.
+             */
+            for (j = 0; cmd_name[j] != '\0'; j++)
+            {
+                if (!(isalnum((int)cmd_name[j]) || cmd_name[j] == '_'))
+                {
+                    fprintf(stderr,
+                            "Valid multiple character command names contain alphanumeric characters plus '_'\n");
+                    return 0;
+                }
+            }
+
+            cmd = parse_arg(cmd_name);
+        }
+        /* Single '\' entered, prompt again */
+        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) == 1))
+        {
+            return 0;
+        }
+        /* Multiple characters but no leading '\' */
+        else
+        {
+            fprintf(stderr, "Precede multiple character command names with '\\'\n");
+            return 0;
+        }
+
+        cmd_entry = find_cmd_entry(cmd);
+
+        if (!cmd_entry)
+        {
+            if (cmd == '\0')
+            {
+                fprintf(stderr, "Command '%s' not found!\n", parsed_input[0]);
+            }
+            else
+            {
+                fprintf(stderr, "Command '%c' not found!\n", cmd);
+            }
+
+            return 0;
+        }
+
+        /* If vfo_opt is enabled (-o|--vfo) check if already given
+         * or prompt for it.
+         */
+        if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
+        {
+            /* Check if VFO was given with command. */
+            result = strtok(NULL, " ");
+
+            if (result)
+            {
+                x = 1;
+                parsed_input[x] = result;
+            }
+            /* Need to prompt if a VFO string was not given. */
+            else
+            {
+                x = 0;
+                rp_getline("VFO: ");
+
+                if (!input_line)
+                {
+                    fprintf_flush(fout, "\n");
+                    return 1;
+                }
+
+                /* Blank line entered */
+                if (!(strcmp(input_line, "")))
+                {
+                    fprintf(fout, "? for help, q to quit.\n");
+                    fflush(fout);
+                    return 0;
+                }
+
+                /* Get the first token of input, the rest, if any, will be
+                 * used later.
+                 */
+                result = strtok(input_line, " ");
+
+                if (result)
+                {
+                    parsed_input[x] = result;
+                }
+                else
+                {
+                    fprintf_flush(fout, "\n");
+                    return 1;
+                }
+            }
+
+            /* VFO name tokens are presently quite short.  Truncate excessively
+             * long strings.
+             */
+            if (strlen(parsed_input[x]) >= MAXNAMSIZ)
+            {
+                *(parsed_input[x] + (MAXNAMSIZ - 1)) = '\0';
+            }
+
+#ifdef HAVE_READLINE_HISTORY
+
+            if (rp_hist_buf)
+            {
+                strncat(rp_hist_buf, " ", 2);
+                strncat(rp_hist_buf, parsed_input[x], MAXNAMSIZ);
+            }
+
+#endif
+
+            /* Sanity check, VFO names are alpha only. */
+            for (j = 0; j < MAXNAMSIZ && parsed_input[x][j] != '\0'; j++)
+            {
+                if (!(isalpha((int)parsed_input[x][j])))
+                {
+                    parsed_input[x][j] = '\0';
+
+                    break;
+                }
+            }
+
+            vfo = rig_parse_vfo(parsed_input[x]);
+
+            if (vfo == RIG_VFO_NONE)
+            {
+                fprintf(stderr,
+                        "Warning:  VFO '%s' unrecognized, using 'currVFO' instead.\n",
+                        parsed_input[x]);
+                vfo = RIG_VFO_CURR;
+            }
+        }
+
+        /* \send_cmd, \send_morse */
+        if ((cmd_entry->flags & ARG_IN_LINE)
+                && (cmd_entry->flags & ARG_IN1)
+                && cmd_entry->arg1)
+        {
+            /* Check for a non-existent delimiter so as to not break up
+             * remaining line into separate tokens (spaces OK).
+             */
+            result = strtok(NULL, "\0");
+
+            if (*vfo_opt && result)
+            {
+                x = 2;
+                parsed_input[x] = result;
+            }
+            else if (result)
+            {
+                x = 1;
+                parsed_input[x] = result;
+            }
+            else
+            {
+                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
+                x = 0;
+
+                strcpy(pmptstr, cmd_entry->arg1);
+                strcat(pmptstr, ": ");
+
+                rp_getline(pmptstr);
+
+                /* Blank line entered */
+                if (input_line && !(strcmp(input_line, "")))
+                {
+                    fprintf(fout, "? for help, q to quit.\n");
+                    fflush(fout);
+                    return 0;
+                }
+
+                if (input_line)
+                {
+                    parsed_input[x] = input_line;
+                }
+                else
+                {
+                    fprintf_flush(fout, "\n");
+                    return 1;
+                }
+            }
+
+            /* The arg1 array size is MAXARGSZ + 1 so truncate it to fit if larger. */
+            if (strlen(parsed_input[x]) > MAXARGSZ)
+            {
+                parsed_input[x][MAXARGSZ] = '\0';
+            }
+
+#ifdef HAVE_READLINE_HISTORY
+
+            if (rp_hist_buf)
+            {
+                strncat(rp_hist_buf, " ", 2);
+                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
+            }
+
+#endif
+            strcpy(arg1, parsed_input[x]);
+            p1 = arg1;
+        }
+
+        /* Normal argument parsing. */
+        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+        {
+            result = strtok(NULL, " ");
+
+            if (*vfo_opt && result)
+            {
+                x = 2;
+                parsed_input[x] = result;
+            }
+            else if (result)
+            {
+                x = 1;
+                parsed_input[x] = result;
+            }
+            else
+            {
+                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
+                x = 0;
+
+                strcpy(pmptstr, cmd_entry->arg1);
+                strcat(pmptstr, ": ");
+
+                rp_getline(pmptstr);
+
+                if (!(strcmp(input_line, "")))
+                {
+                    fprintf(fout, "? for help, q to quit.\n");
+                    fflush(fout);
+                    return 0;
                 }
 
-                p2 = arg2;
+                result = strtok(input_line, " ");
+
+                if (result)
+                {
+                    parsed_input[x] = result;
+                }
+                else
+                {
+                    fprintf_flush(fout, "\n");
+                    return 1;
+                }
+            }
+
+            if (strlen(parsed_input[x]) > MAXARGSZ)
+            {
+                parsed_input[x][MAXARGSZ] = '\0';
+            }
+
+#ifdef HAVE_READLINE_HISTORY
+
+            if (rp_hist_buf)
+            {
+                strncat(rp_hist_buf, " ", 2);
+                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
+            }
+
+#endif
+            strcpy(arg1, parsed_input[x]);
+            p1 = arg1;
+        }
+
+        if (p1
+                && p1[0] != '?'
+                && (cmd_entry->flags & ARG_IN2)
+                && cmd_entry->arg2)
+        {
+
+            result = strtok(NULL, " ");
+
+            if (*vfo_opt && result)
+            {
+                x = 3;
+                parsed_input[x] = result;
+            }
+            else if (result)
+            {
+                x = 2;
+                parsed_input[x] = result;
             }
             else
             {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug9\n", __func__);
-                retcode = next_word(arg2, argc, argv, 0);
+                char pmptstr[(strlen(cmd_entry->arg2) + 3)];
+                x = 0;
 
-                if (EOF == retcode)
+                strcpy(pmptstr, cmd_entry->arg2);
+                strcat(pmptstr, ": ");
+
+                rp_getline(pmptstr);
+
+                if (!(strcmp(input_line, "")))
                 {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
+                    fprintf(fout, "? for help, q to quit.\n");
+                    fflush(fout);
+                    return 0;
+                }
+
+                result = strtok(input_line, " ");
+
+                if (result)
+                {
+                    parsed_input[x] = result;
+                }
+                else
+                {
+                    fprintf_flush(fout, "\n");
                     return 1;
                 }
-                else if (retcode < 0)
+            }
+
+            if (strlen(parsed_input[x]) > MAXARGSZ)
+            {
+                parsed_input[x][MAXARGSZ] = '\0';
+            }
+
+#ifdef HAVE_READLINE_HISTORY
+
+            if (rp_hist_buf)
+            {
+                strncat(rp_hist_buf, " ", 2);
+                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
+            }
+
+#endif
+            strcpy(arg2, parsed_input[x]);
+            p2 = arg2;
+        }
+
+        if (p1
+                && p1[0] != '?'
+                && (cmd_entry->flags & ARG_IN3)
+                && cmd_entry->arg3)
+        {
+
+            result = strtok(NULL, " ");
+
+            if (*vfo_opt && result)
+            {
+                x = 4;
+                parsed_input[x] = result;
+            }
+            else if (result)
+            {
+                x = 3;
+                parsed_input[x] = result;
+            }
+            else
+            {
+                char pmptstr[(strlen(cmd_entry->arg3) + 3)];
+                x = 0;
+
+                strcpy(pmptstr, cmd_entry->arg3);
+                strcat(pmptstr, ": ");
+
+                rp_getline(pmptstr);
+
+                if (!(strcmp(input_line, "")))
                 {
-                    return retcode;
+                    fprintf(fout, "? for help, q to quit.\n");
+                    fflush(fout);
+                    return 0;
+                }
+
+                result = strtok(input_line, " ");
+
+                if (result)
+                {
+                    parsed_input[x] = result;
+                }
+                else
+                {
+                    fprintf_flush(fout, "\n");
+                    return 1;
                 }
+            }
+
+            if (strlen(parsed_input[x]) > MAXARGSZ)
+            {
+                parsed_input[x][MAXARGSZ] = '\0';
+            }
+
+#ifdef HAVE_READLINE_HISTORY
+
+            if (rp_hist_buf)
+            {
+                strncat(rp_hist_buf, " ", 2);
+                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
+            }
+
+#endif
+            strcpy(arg3, parsed_input[x]);
+            p3 = arg3;
+        }
+
+#ifdef HAVE_READLINE_HISTORY
+
+        if (rp_hist_buf)
+        {
+            add_history(rp_hist_buf);
+            free(rp_hist_buf);
+            rp_hist_buf = (char *)NULL;
+        }
+
+#endif
+    }
+
+#endif // HAVE_LIBREADLINE
+
+    return rigctl_exec(my_rig, fin, fout, sync_cb, interactive, prompt, vfo_opt,
+                       send_cmd_term, ext_resp_ptr, resp_sep_ptr, cmd, cmd_entry,
+                       vfo, p1, p2, p3);
+}
+
+
+/*
+ * Zero-copy command tokenizer for rigctld
+ *
+ * rigctl_parse_input() takes commands straight from the bytes received
+ * on a connection instead of a stdio stream.  A first pass walks the
+ * input without touching it and records where the VFO and argument
+ * words are.  If the input ends before the command does, nothing is
+ * consumed and RIGCTL_PARSE_MORE is returned, so the caller can wait
+ * for more bytes and try again.  Once the command is complete, its
+ * words are NUL terminated in place and handed to the command routine
+ * from the buffer itself.
+ */
+struct rigctl_span
+{
+    size_t off;
+    size_t len;
+};
+
+
+static int tok_getc(const struct rigctl_input *in, size_t *pos)
+{
+    if (*pos >= in->tail)
+    {
+        return EOF;
+    }
+
+    return (unsigned char)in->buf[(*pos)++];
+}
+
+
+/*
+ * Like scanf("%s"): skip white space, then take everything up to the
+ * next white space, which is consumed.  -1 when the word is not
+ * complete yet.
+ */
+static int tok_word(const struct rigctl_input *in, size_t *pos,
+                    struct rigctl_span *span)
+{
+    size_t p = *pos;
+
+    while (p < in->tail && isspace((unsigned char)in->buf[p]))
+    {
+        p++;
+    }
+
+    span->off = p;
+
+    while (p < in->tail && !isspace((unsigned char)in->buf[p]))
+    {
+        p++;
+    }
+
+    if (p >= in->tail)
+    {
+        return -1;
+    }
+
+    span->len = p - span->off;
+    *pos = p + 1;
+
+    return 0;
+}
+
+
+/*
+ * Like fgets() and a chomp: the rest of the line, newline consumed.
+ * -1 when the line is not complete yet.
+ */
+static int tok_line(const struct rigctl_input *in, size_t *pos,
+                    struct rigctl_span *span)
+{
+    const char *nl = memchr(in->buf + *pos, '\n', in->tail - *pos);
 
-                p2 = arg2;
-            }
-        }
+    if (!nl)
+    {
+        return -1;
+    }
 
-        rig_debug(RIG_DEBUG_TRACE, "%s: debug10\n", __func__);
+    span->off = *pos;
+    span->len = nl - (in->buf + *pos);
+    *pos = span->off + span->len + 1;
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN3)
-                && cmd_entry->arg3)
-        {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug11\n", __func__);
+    return 0;
+}
 
-            if (interactive)
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug12\n", __func__);
 
-                if (prompt)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: debug13\n", __func__);
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg3);
-                }
+/* NUL terminate a span over its delimiter, there is always one */
+static char *tok_str(struct rigctl_input *in, const struct rigctl_span *span)
+{
+    size_t len = span->len > MAXARGSZ ? MAXARGSZ : span->len;
 
-                if (scanfc(fin, "%s", arg3) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#10?\n", __func__);
-                    return -1;
-                }
+    in->buf[span->off + len] = '\0';
 
-                p3 = arg3;
-            }
-            else
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug14\n", __func__);
-                retcode = next_word(arg3, argc, argv, 0);
+    return in->buf + span->off;
+}
 
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
 
-                p3 = arg3;
-            }
-        }
+/*
+ * Make room at the end of the input buffer for received bytes.
+ * Returns where to put them, the caller adds the count to in->tail.
+ */
+char *rigctl_input_space(struct rigctl_input *in, size_t *room)
+{
+    if (in->head > 0)
+    {
+        memmove(in->buf, in->buf + in->head, in->tail - in->head);
+        in->tail -= in->head;
+        in->head = 0;
     }
 
-#ifdef HAVE_LIBREADLINE
+    *room = sizeof(in->buf) - in->tail;
 
-    if (interactive && prompt && have_rl)
+    return in->buf + in->tail;
+}
+
+
+/*
+ * Binary framed protocol for rigctld
+ *
+ * Negotiated with the "binary" command, after which the connection
+ * carries frames instead of text lines, all fields little endian:
+ *
+ *  request:  u16 length  u8 cmd  u8 flags  u32 id  u32 vfo     values...
+ *  response: u16 length  u8 cmd  u8 flags  u32 id  i32 status  values...
+ *
+ * length counts the whole frame, header included.  cmd is the command
+ * code of test_list[], id is echoed back so a client can match replies
+ * to requests, vfo is the target VFO in VFO mode (0 is the current VFO)
+ * and flags are reserved.  Values are typed: 'i' and an i64, 'd' and an
+ * IEEE 754 f64, or 's', a u16 length and the string bytes.
+ *
+ * The request values are the arguments of the command, numbers being
+ * accepted wherever the text protocol takes a number.  The commands
+ * polled the most reply with typed values straight from the rig API,
+ * the other ones run their text routine and reply one 's' value per
+ * output line, so both protocols share the same command semantics.
+ */
+#define FRAME_HDR_LEN 12
+#define FRAME_MAX_LEN 0xffff
+
+struct frame_out
+{
+    unsigned char *buf;
+    size_t len;
+    size_t size;
+    int overflow;
+    unsigned char stackbuf[512];
+};
+
+
+static unsigned long frame_get_le(const unsigned char *p, int n)
+{
+    unsigned long v = 0;
+
+    while (n--)
     {
-        int j, x;
+        v = (v << 8) | p[n];
+    }
 
-#ifdef HAVE_READLINE_HISTORY
-        /* Minimum space for 32+1+32+1+128+1+128+1+128+1 = 453 chars, so
-         * allocate 512 chars cleared to zero for safety.
-         */
-        rp_hist_buf = (char *)calloc(512, sizeof(char));
-#endif
+    return v;
+}
 
-        rp_getline("\nRig command: ");
 
-        /* EOF (Ctl-D) received on empty input line, bail out gracefully. */
-        if (!input_line)
-        {
-            fprintf_flush(fout, "\n");
-            return 1;
-        }
+static void frame_put(struct frame_out *out, const void *data, size_t len)
+{
+    if (out->len + len > out->size)
+    {
+        size_t size = out->size * 2 > out->len + len ? out->size * 2 : out->len + len;
+        unsigned char *buf;
 
-        /* Q or q to quit */
-        if (!(strncasecmp(input_line, "q", 1)))
+        if (size > FRAME_MAX_LEN)
         {
-            return 1;
+            out->overflow = 1;
+            return;
         }
 
-        /* '?' for help */
-        if (!(strncmp(input_line, "?", 1)))
-        {
-            usage_rig(fout);
-            fflush(fout);
-            return 0;
-        }
+        buf = out->buf == out->stackbuf ? malloc(size) : realloc(out->buf, size);
 
-        /* '#' for comment */
-        if (!(strncmp(input_line, "#", 1)))
+        if (!buf)
         {
-            return 0;
+            out->overflow = 1;
+            return;
         }
 
-        /* Blank line entered */
-        if (!(strcmp(input_line, "")))
+        if (out->buf == out->stackbuf)
         {
-            fprintf(fout, "? for help, q to quit.\n");
-            fflush(fout);
-            return 0;
+            memcpy(buf, out->stackbuf, out->len);
         }
 
-        rig_debug(RIG_DEBUG_TRACE, "%s: input_line: %s\n", __func__, input_line);
+        out->buf = buf;
+        out->size = size;
+    }
 
-        /* Split input_line on any number of spaces to get the command token
-         * Tabs are intercepted by readline for completion and a newline
-         * causes readline to return the typed text.  If more than one
-         * argument is given, it will be parsed out later.
-         */
-        result = strtok(input_line, " ");
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
 
-        /* parsed_input stores pointers into input_line where the token strings
-         * start.
-         */
-        if (result)
-        {
-            parsed_input[0] = result;
-        }
-        else
-        {
-            /* Oops!  Invoke GDB!! */
-            fprintf_flush(fout, "\n");
-            return 1;
-        }
 
-        /* At this point parsed_input contains the typed text of the command
-         * with surrounding space characters removed.  If Readline History is
-         * available, copy the command string into a history buffer.
-         */
+static void frame_put_le(struct frame_out *out, uint64_t v, int n)
+{
+    unsigned char b[8];
+    int i;
 
-        /* Single character command */
-        if ((strlen(parsed_input[0]) == 1) && (*parsed_input[0] != '\\'))
-        {
-            cmd = *parsed_input[0];
+    for (i = 0; i < n; i++, v >>= 8)
+    {
+        b[i] = v & 0xff;
+    }
 
-#ifdef HAVE_READLINE_HISTORY
+    frame_put(out, b, n);
+}
 
-            /* Store what is typed, not validated, for history. */
-            if (rp_hist_buf)
-            {
-                strncpy(rp_hist_buf, parsed_input[0], 1);
-            }
 
-#endif
-        }
-        /* Test the command token, parsed_input[0] */
-        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) > 1))
-        {
-            char cmd_name[MAXNAMSIZ];
+static void frame_put_int(struct frame_out *out, int64_t v)
+{
+    frame_put(out, "i", 1);
+    frame_put_le(out, (uint64_t)v, 8);
+}
 
-            /* if there is no terminating '\0' character in the source string,
-             * srncpy() doesn't add one even if the supplied length is less
-             * than the destination array.  Truncate the source string here.
-             */
-            if (strlen(parsed_input[0] + 1) >= MAXNAMSIZ)
-            {
-                *(parsed_input[0] + MAXNAMSIZ) = '\0';
-            }
 
-#ifdef HAVE_READLINE_HISTORY
+static void frame_put_double(struct frame_out *out, double d)
+{
+    uint64_t v;
 
-            if (rp_hist_buf)
-            {
-                strncpy(rp_hist_buf, parsed_input[0], MAXNAMSIZ);
-            }
+    memcpy(&v, &d, sizeof(v));
+    frame_put(out, "d", 1);
+    frame_put_le(out, v, 8);
+}
 
-#endif
-            /* The starting position of the source string is the first
-             * character past the initial '\'.
-             */
-            snprintf(cmd_name, sizeof(cmd_name), "%s", parsed_input[0] + 1);
 
-            /* Sanity check as valid multiple character commands consist of
-             * alphanumeric characters and the underscore ('_') character.
-             */
-            for (j = 0; cmd_name[j] != '\0'; j++)
-            {
-                if (!(isalnum((int)cmd_name[j]) || cmd_name[j] == '_'))
-                {
-                    fprintf(stderr,
-                            "Valid multiple character command names contain alphanumeric characters plus '_'\n");
-                    return 0;
-                }
-            }
+static void frame_put_str(struct frame_out *out, const char *s, size_t len)
+{
+    frame_put(out, "s", 1);
+    frame_put_le(out, len, 2);
+    frame_put(out, s, len);
+}
 
-            cmd = parse_arg(cmd_name);
-        }
-        /* Single '\' entered, prompt again */
-        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) == 1))
+
+/*
+ * Decode the next request value into its text protocol form.
+ * Returns the bytes used, 0 when the value is malformed.
+ */
+static size_t frame_get_arg(const unsigned char *p, size_t avail, char *arg)
+{
+    uint64_t v;
+    double d;
+    size_t len;
+
+    if (avail < 1)
+    {
+        return 0;
+    }
+
+    switch (p[0])
+    {
+    case 'i':
+        if (avail < 9)
         {
             return 0;
         }
-        /* Multiple characters but no leading '\' */
-        else
+
+        v = frame_get_le(p + 1, 4) | ((uint64_t)frame_get_le(p + 5, 4) << 32);
+        snprintf(arg, MAXARGSZ + 1, "%"PRIll, (int64_t)v);
+        return 9;
+
+    case 'd':
+        if (avail < 9)
         {
-            fprintf(stderr, "Precede multiple character command names with '\\'\n");
             return 0;
         }
 
-        cmd_entry = find_cmd_entry(cmd);
+        v = frame_get_le(p + 1, 4) | ((uint64_t)frame_get_le(p + 5, 4) << 32);
+        memcpy(&d, &v, sizeof(d));
+        snprintf(arg, MAXARGSZ + 1, "%.17g", d);
+        return 9;
 
-        if (!cmd_entry)
+    case 's':
+        if (avail < 3 || avail < 3 + (len = frame_get_le(p + 1, 2)))
         {
-            if (cmd == '\0')
-            {
-                fprintf(stderr, "Command '%s' not found!\n", parsed_input[0]);
-            }
-            else
-            {
-                fprintf(stderr, "Command '%c' not found!\n", cmd);
-            }
-
             return 0;
         }
 
-        /* If vfo_opt is enabled (-o|--vfo) check if already given
-         * or prompt for it.
-         */
-        if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
-        {
-            /* Check if VFO was given with command. */
-            result = strtok(NULL, " ");
+        memcpy(arg, p + 3, len > MAXARGSZ ? MAXARGSZ : len);
+        arg[len > MAXARGSZ ? MAXARGSZ : len] = '\0';
+        return 3 + len;
+    }
 
-            if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            /* Need to prompt if a VFO string was not given. */
-            else
-            {
-                x = 0;
-                rp_getline("VFO: ");
+    return 0;
+}
+
+
+/*
+ * Typed replies of the most polled commands.
+ * Returns -RIG_ENIMPL to fall back on the text routine.
+ */
+static int frame_exec_native(RIG *rig, unsigned char cmd, vfo_t vfo,
+                             const char *arg1, struct frame_out *out)
+{
+    int status;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+    split_t split;
+    vfo_t tx_vfo;
+    shortfreq_t offs;
+    setting_t level;
+    value_t val;
+    const char *s;
 
-                if (!input_line)
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
+    switch (cmd)
+    {
+    case 'f':
+        status = rig_get_freq(rig, vfo, &freq);
 
-                /* Blank line entered */
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
+        if (status == RIG_OK) { frame_put_double(out, freq); }
 
-                /* Get the first token of input, the rest, if any, will be
-                 * used later.
-                 */
-                result = strtok(input_line, " ");
+        return status;
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
+    case 'm':
+        status = rig_get_mode(rig, vfo, &mode, &width);
 
-            /* VFO name tokens are presently quite short.  Truncate excessively
-             * long strings.
-             */
-            if (strlen(parsed_input[x]) >= MAXNAMSIZ)
-            {
-                *(parsed_input[x] + (MAXNAMSIZ - 1)) = '\0';
-            }
+        if (status == RIG_OK)
+        {
+            s = rig_strrmode(mode);
+            frame_put_str(out, s, strlen(s));
+            frame_put_int(out, width);
+        }
 
-#ifdef HAVE_READLINE_HISTORY
+        return status;
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXNAMSIZ);
-            }
+    case 'v':
+        status = rig_get_vfo(rig, &vfo);
 
-#endif
+        if (status == RIG_OK)
+        {
+            s = rig_strvfo(vfo);
+            frame_put_str(out, s, strlen(s));
+        }
 
-            /* Sanity check, VFO names are alpha only. */
-            for (j = 0; j < MAXNAMSIZ && parsed_input[x][j] != '\0'; j++)
-            {
-                if (!(isalpha((int)parsed_input[x][j])))
-                {
-                    parsed_input[x][j] = '\0';
+        return status;
 
-                    break;
-                }
-            }
+    case 't':
+        status = rig_get_ptt(rig, vfo, &ptt);
 
-            vfo = rig_parse_vfo(parsed_input[x]);
+        if (status == RIG_OK) { frame_put_int(out, ptt); }
 
-            if (vfo == RIG_VFO_NONE)
-            {
-                fprintf(stderr,
-                        "Warning:  VFO '%s' unrecognized, using 'currVFO' instead.\n",
-                        parsed_input[x]);
-                vfo = RIG_VFO_CURR;
-            }
-        }
+        return status;
 
-        /* \send_cmd, \send_morse */
-        if ((cmd_entry->flags & ARG_IN_LINE)
-                && (cmd_entry->flags & ARG_IN1)
-                && cmd_entry->arg1)
-        {
-            /* Check for a non-existent delimiter so as to not break up
-             * remaining line into separate tokens (spaces OK).
-             */
-            result = strtok(NULL, "\0");
+    case 's':
+        status = rig_get_split_vfo(rig, vfo, &split, &tx_vfo);
 
-            if (*vfo_opt && result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
-                x = 0;
+        if (status == RIG_OK)
+        {
+            s = rig_strvfo(tx_vfo);
+            frame_put_int(out, split);
+            frame_put_str(out, s, strlen(s));
+        }
 
-                strcpy(pmptstr, cmd_entry->arg1);
-                strcat(pmptstr, ": ");
+        return status;
 
-                rp_getline(pmptstr);
+    case 'j':
+    case 'z':
+        status = cmd == 'j' ? rig_get_rit(rig, vfo, &offs) : rig_get_xit(rig, vfo, &offs);
 
-                /* Blank line entered */
-                if (input_line && !(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
+        if (status == RIG_OK) { frame_put_int(out, offs); }
 
-                if (input_line)
-                {
-                    parsed_input[x] = input_line;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
+        return status;
 
-            /* The arg1 array size is MAXARGSZ + 1 so truncate it to fit if larger. */
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
+    case 'l':
+        level = rig_parse_level(arg1);
 
-#ifdef HAVE_READLINE_HISTORY
+        /* "?" and extension levels keep the text routine */
+        if (!rig_has_get_level(rig, level))
+        {
+            break;
+        }
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+        status = rig_get_level(rig, vfo, level, &val);
 
-#endif
-            strcpy(arg1, parsed_input[x]);
-            p1 = arg1;
+        if (status == RIG_OK && RIG_LEVEL_IS_FLOAT(level))
+        {
+            frame_put_double(out, val.f);
         }
-
-        /* Normal argument parsing. */
-        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+        else if (status == RIG_OK)
         {
-            result = strtok(NULL, " ");
+            frame_put_int(out, val.i);
+        }
 
-            if (*vfo_opt && result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
-                x = 0;
+        return status;
+    }
 
-                strcpy(pmptstr, cmd_entry->arg1);
-                strcat(pmptstr, ": ");
+    return -RIG_ENIMPL;
+}
 
-                rp_getline(pmptstr);
 
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
+/*
+ * Run the text routine of a command, one 's' value per output line
+ */
+static int frame_exec_text(RIG *rig, struct test_table *cmd_entry,
+                           int *vfo_opt, vfo_t vfo, const char *arg1,
+                           const char *arg2, const char *arg3,
+                           struct frame_out *out)
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+    char *text = NULL;
+    size_t textlen = 0;
+    FILE *fout = open_memstream(&text, &textlen);
+    const char *p, *nl;
+    int status;
 
-                result = strtok(input_line, " ");
+    if (!fout)
+    {
+        return -RIG_ENOMEM;
+    }
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
+    status = (*cmd_entry->rig_routine)(rig, fout, NULL, 1, 0, vfo_opt, '\r', 0,
+                                       '\n', cmd_entry, vfo, arg1, arg2, arg3);
+    fclose(fout);
 
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
+    for (p = text; p && p < text + textlen; p = nl + 1)
+    {
+        nl = memchr(p, '\n', text + textlen - p);
 
-#ifdef HAVE_READLINE_HISTORY
+        if (!nl)
+        {
+            nl = text + textlen;
+        }
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+        frame_put_str(out, p, nl - p);
+    }
 
+    free(text);
+
+    return status;
+#else
+    return -RIG_ENAVAIL;
 #endif
-            strcpy(arg1, parsed_input[x]);
-            p1 = arg1;
-        }
+}
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN2)
-                && cmd_entry->arg2)
+
+/*
+ * Parse and run the next request frame of the input buffer
+ *
+ * A request must fit in the input buffer, RIGCTL_FRAME_MAX bytes.  A
+ * longer one is answered with -RIG_EINVAL as soon as its header is in,
+ * then its bytes are dropped as they arrive and the connection goes on
+ * with the next frame.
+ */
+static int rigctl_parse_frame(RIG *my_rig, struct rigctl_input *in,
+                              FILE *fout, sync_cb_t sync_cb, int *vfo_opt)
+{
+    const unsigned char *p;
+    size_t avail;
+    size_t len, off;
+    struct test_table *cmd_entry;
+    struct frame_out out;
+    char args[3][MAXARGSZ + 1];
+    int nargs = 0;
+    unsigned char cmd;
+    vfo_t vfo;
+    int status;
+
+    if (in->skip)
+    {
+        size_t n = in->tail - in->head < in->skip ? in->tail - in->head : in->skip;
+
+        in->head += n;
+        in->skip -= n;
+
+        if (in->head == in->tail)
         {
+            in->head = in->tail = 0;
+            return RIGCTL_PARSE_MORE;
+        }
+    }
 
-            result = strtok(NULL, " ");
+    p = (const unsigned char *)in->buf + in->head;
+    avail = in->tail - in->head;
 
-            if (*vfo_opt && result)
-            {
-                x = 3;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg2) + 3)];
-                x = 0;
+    if (avail < 2)
+    {
+        return RIGCTL_PARSE_MORE;
+    }
 
-                strcpy(pmptstr, cmd_entry->arg2);
-                strcat(pmptstr, ": ");
+    len = frame_get_le(p, 2);
 
-                rp_getline(pmptstr);
+    if (len < FRAME_HDR_LEN)
+    {
+        /* no way to find the next frame */
+        rig_debug(RIG_DEBUG_ERR, "%s: bad frame length %d\n", __func__, (int)len);
+        in->head = in->tail = 0;
+        return -RIG_EPROTO;
+    }
 
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
+    if (avail < (len > RIGCTL_FRAME_MAX ? FRAME_HDR_LEN : len))
+    {
+        return RIGCTL_PARSE_MORE;
+    }
+
+    cmd = p[2];
+    vfo = *vfo_opt && frame_get_le(p + 8, 4) ? frame_get_le(p + 8, 4) : RIG_VFO_CURR;
+
+    out.buf = out.stackbuf;
+    out.size = sizeof(out.stackbuf);
+    out.len = FRAME_HDR_LEN;
+    out.overflow = 0;
+
+    if (len > RIGCTL_FRAME_MAX)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: frame of %d bytes, the limit is %d\n",
+                  __func__, (int)len, RIGCTL_FRAME_MAX);
+        status = -RIG_EINVAL;
+        goto reply;
+    }
+
+    for (off = FRAME_HDR_LEN; off < len && nargs < 3; nargs++)
+    {
+        size_t n = frame_get_arg(p + off, len - off, args[nargs]);
+
+        if (n == 0)
+        {
+            break;
+        }
 
-                result = strtok(input_line, " ");
+        off += n;
+    }
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
+    cmd_entry = find_cmd_entry(cmd);
 
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
+    if (off != len)
+    {
+        status = -RIG_EPROTO;
+    }
+    else if (!cmd_entry || cmd_entry->rig_routine == ACTION(subscribe))
+    {
+        /* subscribe streams text, it has no place here */
+        status = -RIG_ENAVAIL;
+    }
+    else if (cmd_entry->rig_routine == ACTION(binary))
+    {
+        status = RIG_OK;
+    }
+    else
+    {
+        uint64_t start_us = rig_stats_enabled() ? rig_stats_now_us() : 0;
 
-#ifdef HAVE_READLINE_HISTORY
+        my_rig->state.vfo_opt = *vfo_opt;
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+        if (sync_cb && !(cmd_entry->flags & ARG_NOLOCK)) { sync_cb(1); }
 
-#endif
-            strcpy(arg2, parsed_input[x]);
-            p2 = arg2;
-        }
+        status = frame_exec_native(my_rig, cmd, vfo, nargs > 0 ? args[0] : "",
+                                   &out);
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN3)
-                && cmd_entry->arg3)
+        if (status == -RIG_ENIMPL && out.len == FRAME_HDR_LEN)
         {
+            status = frame_exec_text(my_rig, cmd_entry, vfo_opt, vfo,
+                                     nargs > 0 ? args[0] : NULL,
+                                     nargs > 1 ? args[1] : "",
+                                     nargs > 2 ? args[2] : "", &out);
+        }
 
-            result = strtok(NULL, " ");
+        if (sync_cb && !(cmd_entry->flags & ARG_NOLOCK)) { sync_cb(0); }
 
-            if (*vfo_opt && result)
-            {
-                x = 4;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 3;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg3) + 3)];
-                x = 0;
+        if (start_us)
+        {
+            rig_stats_hist_add(&cmd_stats[cmd], rig_stats_now_us() - start_us);
+        }
+    }
 
-                strcpy(pmptstr, cmd_entry->arg3);
-                strcat(pmptstr, ": ");
+    if (out.overflow)
+    {
+        out.len = FRAME_HDR_LEN;
+        status = -RIG_ETRUNC;
+    }
 
-                rp_getline(pmptstr);
+reply:
+    /* header, the length and status now known */
+    out.buf[0] = out.len & 0xff;
+    out.buf[1] = out.len >> 8;
+    out.buf[2] = cmd;
+    out.buf[3] = 0;
+    memcpy(out.buf + 4, p + 4, 4);
+    out.buf[8] = (uint32_t)status & 0xff;
+    out.buf[9] = ((uint32_t)status >> 8) & 0xff;
+    out.buf[10] = ((uint32_t)status >> 16) & 0xff;
+    out.buf[11] = ((uint32_t)status >> 24) & 0xff;
 
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
+    if (len > avail)
+    {
+        in->skip = len - avail;
+        in->head = in->tail;
+    }
+    else
+    {
+        in->head += len;
+    }
 
-                result = strtok(input_line, " ");
+    if (in->head == in->tail)
+    {
+        in->head = in->tail = 0;
+    }
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
+    fwrite(out.buf, 1, out.len, fout);
+    fflush(fout);
 
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
+    if (out.buf != out.stackbuf)
+    {
+        free(out.buf);
+    }
 
-#ifdef HAVE_READLINE_HISTORY
+    return status == RIG_OK ? 0 : 2;
+}
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
 
-#endif
-            strcpy(arg3, parsed_input[x]);
-            p3 = arg3;
-        }
+/*
+ * Parse and run the next command in the input buffer of a rigctld
+ * connection.  Returns RIGCTL_PARSE_MORE when the buffer does not
+ * hold a complete command, otherwise as rigctl_parse() does.
+ */
+int rigctl_parse_input(RIG *my_rig, struct rigctl_input *in, FILE *fout,
+                       sync_cb_t sync_cb, int *vfo_opt, char send_cmd_term,
+                       int *ext_resp_ptr, char *resp_sep_ptr)
+{
+    size_t pos = in->head;
+    int ext_resp = *ext_resp_ptr;
+    char resp_sep = *resp_sep_ptr;
+    struct test_table *cmd_entry;
+    struct rigctl_span vfo_span, args[3];
+    int have = 0;          /* bit mask of the args[] present */
+    vfo_t vfo = RIG_VFO_CURR;
+    char *p[3] = { NULL, NULL, NULL };
+    FILE *fin = NULL;
+    int retcode;
+    int c, i;
 
-#ifdef HAVE_READLINE_HISTORY
+    if (in->binary)
+    {
+        return rigctl_parse_frame(my_rig, in, fout, sync_cb, vfo_opt);
+    }
 
-        if (rp_hist_buf)
+    /* blank lines */
+    do
+    {
+        c = tok_getc(in, &pos);
+
+        if (c == EOF)
         {
-            add_history(rp_hist_buf);
-            free(rp_hist_buf);
-            rp_hist_buf = (char *)NULL;
+            in->head = in->tail = 0;
+            return RIGCTL_PARSE_MORE;
         }
-
-#endif
     }
+    while (c == '\n' || c == '\r' || c == ' ');
 
-#endif // HAVE_LIBREADLINE
+    in->head = pos - 1;
 
-    if (sync_cb) { sync_cb(1); }    /* lock if necessary */
+    /* Extended response protocol requested with leading '+' */
+    if (c == '+')
+    {
+        ext_resp = 1;
+        c = tok_getc(in, &pos);
+    }
 
-    if (!prompt)
+    if (c != EOF
+            && c != '\\'
+            && c != '_'
+            && c != '#'
+            && c != '('
+            && c != ')'
+            && ispunct(c))
     {
-        rig_debug(RIG_DEBUG_TRACE,
-                  "rigctl(d): %c '%s' '%s' '%s' '%s'\n",
-                  cmd,
-                  rig_strvfo(vfo),
-                  p1 ? p1 : "",
-                  p2 ? p2 : "",
-                  p3 ? p3 : "");
+        ext_resp = 1;
+        resp_sep = c;
+        c = tok_getc(in, &pos);
     }
 
-    /*
-     * Extended Response protocol: output received command name and arguments
-     * response.  Don't send command header on '\chk_vfo' command.
-     */
-    if (interactive && *ext_resp_ptr && !prompt && cmd != 0xf0)
+    if (c == '\\')
     {
-        char a1[MAXARGSZ + 2];
-        char a2[MAXARGSZ + 2];
-        char a3[MAXARGSZ + 2];
-        char vfo_str[MAXARGSZ + 2];
+        char cmd_name[MAXNAMSIZ + 1];
+        int n = 0;
 
-        *vfo_opt == 0 ? vfo_str[0] = '\0' : snprintf(vfo_str,
-                                     sizeof(vfo_str),
-                                     " %s",
-                                     rig_strvfo(vfo));
+        while ((c = tok_getc(in, &pos)) != EOF
+                && n < MAXNAMSIZ
+                && (isalnum(c) || c == '_'))
+        {
+            cmd_name[n++] = c;
+        }
 
-        p1 == NULL ? a1[0] = '\0' : snprintf(a1, sizeof(a1), " %s", p1);
-        p2 == NULL ? a2[0] = '\0' : snprintf(a2, sizeof(a2), " %s", p2);
-        p3 == NULL ? a3[0] = '\0' : snprintf(a3, sizeof(a3), " %s", p3);
+        if (c == EOF)
+        {
+            goto more;
+        }
 
-        fprintf(fout,
-                "%s:%s%s%s%s%c",
-                cmd_entry->name,
-                vfo_str,
-                a1,
-                a2,
-                a3,
-                *resp_sep_ptr);
+        cmd_name[n] = '\0';
+        c = (unsigned char)parse_arg(cmd_name);
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd=%s\n", __func__, cmd_name);
     }
+    else if (c == '#')
+    {
+        /* comment line */
+        while ((c = tok_getc(in, &pos)) != '\n' && c != '\r')
+        {
+            if (c == EOF)
+            {
+                goto more;
+            }
+        }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
-    retcode = (*cmd_entry->rig_routine)(my_rig,
-                                        fout,
-                                        fin,
-                                        interactive,
-                                        prompt,
-                                        vfo_opt,
-                                        send_cmd_term,
-                                        *ext_resp_ptr,
-                                        *resp_sep_ptr,
-                                        cmd_entry,
-                                        vfo,
-                                        p1,
-                                        p2 ? p2 : "",
-                                        p3 ? p3 : "");
+        in->head = pos;
+        return 0;
+    }
+    else if (c == EOF)
+    {
+        goto more;
+    }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
+    my_rig->state.vfo_opt = *vfo_opt;
 
-    if (retcode == RIG_EIO)
+    if (c == 'Q' || c == 'q')
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: RIG_EIO?\n", __func__);
+        in->head = pos;
+        fprintf(fout, "%s0\n", NETRIGCTL_RET);
+        fflush(fout);
+        return 1;
+    }
 
-        if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+    if (c == '?')
+    {
+        in->head = pos;
+        usage_rig(fout);
+        fflush(fout);
+        return 0;
+    }
 
-        return retcode;
+    cmd_entry = find_cmd_entry(c);
+
+    if (!cmd_entry)
+    {
+        in->head = pos;
+        fprintf(stderr, "Command '%c' not found!\n", c);
+        return 0;
     }
 
-    if (retcode != RIG_OK)
+    if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt
+            && tok_word(in, &pos, &vfo_span) < 0)
     {
-        /* only for rigctld */
-        if (interactive && !prompt)
+        goto more;
+    }
+
+    if ((cmd_entry->flags & ARG_IN_LINE)
+            && (cmd_entry->flags & ARG_IN1)
+            && cmd_entry->arg1)
+    {
+        if (tok_line(in, &pos, &args[0]) < 0
+                || (args[0].len == 0 && tok_line(in, &pos, &args[0]) < 0))
         {
-            rig_debug(RIG_DEBUG_TRACE, "%s: return#1 "NETRIGCTL_RET "%d\n", __func__,
-                      retcode);
-            fprintf(fout, NETRIGCTL_RET "%d\n", retcode);
-            *ext_resp_ptr = 0;
-            *resp_sep_ptr = '\n';
+            goto more;
         }
-        else
+
+        /* CW must accept a space argument */
+        if (c != 'b' && args[0].len > 0 && in->buf[args[0].off] == ' ')
         {
-            fprintf(fout,
-                    "%s: error = %s\n",
-                    cmd_entry->name,
-                    rigerror(retcode));
+            args[0].off++;
+            args[0].len--;
         }
+
+        have = 1;
     }
-    else
+    else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
     {
-        /* only for rigctld */
-        if (interactive && !prompt)
+        if (tok_word(in, &pos, &args[0]) < 0)
         {
-            /* netrigctl RIG_OK */
-            if (!(cmd_entry->flags & ARG_OUT)
-                    && !*ext_resp_ptr && cmd != 0xf0)
+            goto more;
+        }
+
+        have = 1;
+    }
+
+    if (have == 1 && (args[0].len == 0 || in->buf[args[0].off] != '?'))
+    {
+        if ((cmd_entry->flags & ARG_IN2) && cmd_entry->arg2)
+        {
+            if (tok_word(in, &pos, &args[1]) < 0)
             {
-                rig_debug(RIG_DEBUG_TRACE, "%s: return#2 "NETRIGCTL_RET "0\n", __func__);
-                fprintf(fout, NETRIGCTL_RET "0\n");
+                goto more;
             }
 
-            /* Extended Response protocol */
-            else if (*ext_resp_ptr && cmd != 0xf0)
+            have |= 2;
+        }
+
+        if ((cmd_entry->flags & ARG_IN3) && cmd_entry->arg3)
+        {
+            if (tok_word(in, &pos, &args[2]) < 0)
             {
-                rig_debug(RIG_DEBUG_TRACE, "%s: return#3 "NETRIGCTL_RET "0\n", __func__);
-                fprintf(fout, NETRIGCTL_RET "0\n");
-                *ext_resp_ptr = 0;
-                *resp_sep_ptr = '\n';
+                goto more;
             }
+
+            have |= 4;
         }
     }
 
-    fflush(fout);
+    /* complete, from here on the words are used in place */
+    in->head = pos;
+    *ext_resp_ptr = ext_resp;
+    *resp_sep_ptr = resp_sep;
+
+    if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
+    {
+        vfo = rig_parse_vfo(tok_str(in, &vfo_span));
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        if (have & (1 << i))
+        {
+            p[i] = tok_str(in, &args[i]);
+        }
+    }
+
+    if (cmd_entry->rig_routine == ACTION(binary))
+    {
+        /* frames from now on */
+        in->binary = 1;
+        fprintf(fout, "%s0\n", NETRIGCTL_RET);
+        fflush(fout);
+        return 0;
+    }
+
+    if (cmd_entry->rig_routine == ACTION(set_channel))
+    {
+        /* the channel fields follow, let set_channel read them */
+#ifdef HAVE_FMEMOPEN
+        fin = fmemopen(in->buf + in->head, in->tail - in->head, "rb");
+#else
+        fin = tmpfile();
+
+        if (fin)
+        {
+            fwrite(in->buf + in->head, 1, in->tail - in->head, fin);
+            rewind(fin);
+        }
+
+#endif
+    }
+
+    retcode = rigctl_exec(my_rig, fin, fout, sync_cb, 1, 0, vfo_opt,
+                          send_cmd_term, ext_resp_ptr, resp_sep_ptr, c,
+                          cmd_entry, vfo, p[0], p[1], p[2]);
+
+    if (fin)
+    {
+        long used = ftell(fin);
+
+        if (used > 0)
+        {
+            in->head += used;
+        }
+
+        fclose(fin);
+    }
+
+    if (in->head == in->tail)
+    {
+        in->head = in->tail = 0;
+    }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: retcode=%d\n", __func__, retcode);
+    return retcode;
 
-    if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+more:
 
-    if (retcode == -RIG_ENAVAIL)
+    if (in->head == 0 && in->tail == sizeof(in->buf))
     {
-        return retcode;
+        rig_debug(RIG_DEBUG_ERR, "%s: command does not fit in %d bytes\n",
+                  __func__, (int)sizeof(in->buf));
+        in->head = in->tail = 0;
+        return -RIG_EPROTO;
     }
 
-    return retcode != RIG_OK ? 2 : 0;
+    return RIGCTL_PARSE_MORE;
 }
 
 
@@ -3388,6 +4847,12 @@ declare_proto_rig(set_channel)
         return -RIG_ECONF;
     }
 
+    /* no stream to read the channel fields from */
+    if (!fin)
+    {
+        return -RIG_ENAVAIL;
+    }
+
     if (mem_caps->bank_num)
     {
         if ((interactive && prompt) || (interactive && !prompt && ext_resp))
@@ -4580,6 +6045,340 @@ declare_proto_rig(halt)
 }
 
 
+/* '0x98' */
+declare_proto_rig(get_coalesce)
+{
+    unsigned long hits = 0, misses = 0;
+
+#ifdef HAVE_COALESCE
+    pthread_mutex_lock(&coalesce_lock);
+    hits = coalesce_hits;
+    misses = coalesce_misses;
+    pthread_mutex_unlock(&coalesce_lock);
+#endif
+
+    if ((interactive && prompt) || (interactive && !prompt && ext_resp))
+    {
+        fprintf(fout, "%s: ", cmd->arg1);
+    }
+
+    fprintf(fout, "%lu%c", hits, resp_sep);
+
+    if ((interactive && prompt) || (interactive && !prompt && ext_resp))
+    {
+        fprintf(fout, "%s: ", cmd->arg2);
+    }
+
+    fprintf(fout, "%lu%c", misses, resp_sep);
+
+    return RIG_OK;
+}
+
+
+/* '0x99' -- lock free copy of the cached rig state */
+declare_proto_rig(get_snapshot)
+{
+    struct rig_state_snapshot snap;
+    int retval;
+    int ext = (interactive && prompt) || (interactive && !prompt && ext_resp);
+
+    retval = rig_get_state_snapshot(rig, &snap);
+
+    if (retval != RIG_OK)
+    {
+        return retval;
+    }
+
+    if (ext) { fprintf(fout, "Version: "); }
+
+    fprintf(fout, "%lu%c", snap.version, resp_sep);
+
+    if (ext) { fprintf(fout, "VFO: "); }
+
+    fprintf(fout, "%s%c", rig_strvfo(snap.vfo), resp_sep);
+
+    if (ext) { fprintf(fout, "Frequency: "); }
+
+    fprintf(fout, "%"PRIll"%c", (int64_t)snap.freq, resp_sep);
+
+    if (ext) { fprintf(fout, "Mode: "); }
+
+    fprintf(fout, "%s%c", rig_strrmode(snap.mode), resp_sep);
+
+    if (ext) { fprintf(fout, "Passband: "); }
+
+    fprintf(fout, "%ld%c", snap.width, resp_sep);
+
+    if (ext) { fprintf(fout, "PTT: "); }
+
+    fprintf(fout, "%d%c", snap.ptt, resp_sep);
+
+    if (ext) { fprintf(fout, "Split: "); }
+
+    fprintf(fout, "%d%c", snap.split, resp_sep);
+
+    if (ext) { fprintf(fout, "TX VFO: "); }
+
+    fprintf(fout, "%s%c", rig_strvfo(snap.split_vfo), resp_sep);
+
+    if (ext) { fprintf(fout, "Satmode: "); }
+
+    fprintf(fout, "%d%c", snap.satmode, resp_sep);
+
+    return RIG_OK;
+}
+
+
+/* split the next blank separated word off *line, NULL at end of line */
+static char *batch_next_word(char **line)
+{
+    char *word = *line;
+
+    while (*word == ' ' || *word == '\t') { word++; }
+
+    if (*word == '\0')
+    {
+        return NULL;
+    }
+
+    *line = word;
+
+    while (**line && **line != ' ' && **line != '\t') { (*line)++; }
+
+    if (**line)
+    {
+        *(*line)++ = '\0';
+    }
+
+    return word;
+}
+
+
+/*
+ * '0x9a' -- execute several commands as one rig_batch_exec(), e.g.
+ * "f m t s l RFPOWER" or "F 14074000 M USB 0 f".
+ * Supported: f F m M v V t T s S l L, with the same arguments as alone.
+ * Outputs each get result, "RPRT x" in place of an operation that failed.
+ */
+declare_proto_rig(batch)
+{
+    struct rig_batch b;
+    char line[MAXARGSZ + 1];
+    char *p = line;
+    char *word;
+    int ext = (interactive && prompt) || (interactive && !prompt && ext_resp);
+    int i;
+
+    rig_batch_init(&b);
+    strncpy(line, arg1, MAXARGSZ);
+    line[MAXARGSZ] = '\0';
+
+    while ((word = batch_next_word(&p)) != NULL)
+    {
+        struct rig_batch_op *bop;
+        char *a1 = NULL, *a2 = NULL;
+        int op;
+
+        if (strlen(word) != 1)
+        {
+            return -RIG_EINVAL;
+        }
+
+        switch (word[0])
+        {
+        case 'f': op = RIG_BATCH_GET_FREQ; break;
+
+        case 'F': op = RIG_BATCH_SET_FREQ; break;
+
+        case 'm': op = RIG_BATCH_GET_MODE; break;
+
+        case 'M': op = RIG_BATCH_SET_MODE; break;
+
+        case 'v': op = RIG_BATCH_GET_VFO; break;
+
+        case 'V': op = RIG_BATCH_SET_VFO; break;
+
+        case 't': op = RIG_BATCH_GET_PTT; break;
+
+        case 'T': op = RIG_BATCH_SET_PTT; break;
+
+        case 's': op = RIG_BATCH_GET_SPLIT_VFO; break;
+
+        case 'S': op = RIG_BATCH_SET_SPLIT_VFO; break;
+
+        case 'l': op = RIG_BATCH_GET_LEVEL; break;
+
+        case 'L': op = RIG_BATCH_SET_LEVEL; break;
+
+        default:
+            return -RIG_EINVAL;
+        }
+
+        bop = rig_batch_add(&b, op, vfo);
+
+        if (!bop)
+        {
+            return -RIG_EINVAL;     /* too many commands */
+        }
+
+        /* the number of arguments is the one of the command alone */
+        if (op != RIG_BATCH_GET_FREQ && op != RIG_BATCH_GET_MODE
+                && op != RIG_BATCH_GET_VFO && op != RIG_BATCH_GET_PTT
+                && op != RIG_BATCH_GET_SPLIT_VFO)
+        {
+            a1 = batch_next_word(&p);
+
+            if (!a1)
+            {
+                return -RIG_EINVAL;
+            }
+        }
+
+        if (op == RIG_BATCH_SET_MODE || op == RIG_BATCH_SET_SPLIT_VFO
+                || op == RIG_BATCH_SET_LEVEL)
+        {
+            a2 = batch_next_word(&p);
+
+            if (!a2)
+            {
+                return -RIG_EINVAL;
+            }
+        }
+
+        switch (op)
+        {
+        case RIG_BATCH_SET_FREQ:
+            CHKSCN1ARG(sscanf(a1, "%"SCNfreq, &bop->freq));
+            break;
+
+        case RIG_BATCH_SET_MODE:
+            bop->mode = rig_parse_mode(a1);
+            CHKSCN1ARG(sscanf(a2, "%ld", &bop->width));
+            break;
+
+        case RIG_BATCH_SET_VFO:
+            bop->vfo = rig_parse_vfo(a1);
+            break;
+
+        case RIG_BATCH_SET_PTT:
+            CHKSCN1ARG(sscanf(a1, "%d", (int *)&bop->ptt));
+            break;
+
+        case RIG_BATCH_SET_SPLIT_VFO:
+            CHKSCN1ARG(sscanf(a1, "%d", (int *)&bop->split));
+            bop->tx_vfo = rig_parse_vfo(a2);
+            break;
+
+        case RIG_BATCH_GET_LEVEL:
+        case RIG_BATCH_SET_LEVEL:
+            bop->level = rig_parse_level(a1);
+
+            if (bop->level == RIG_LEVEL_NONE)
+            {
+                return -RIG_EINVAL;
+            }
+
+            if (op == RIG_BATCH_GET_LEVEL)
+            {
+                break;
+            }
+
+            if (RIG_LEVEL_IS_FLOAT(bop->level))
+            {
+                CHKSCN1ARG(sscanf(a2, "%f", &bop->val.f));
+            }
+            else
+            {
+                CHKSCN1ARG(sscanf(a2, "%d", &bop->val.i));
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (b.count == 0)
+    {
+        return -RIG_EINVAL;
+    }
+
+    rig_batch_exec(rig, &b);
+
+    for (i = 0; i < b.count; i++)
+    {
+        struct rig_batch_op *bop = &b.ops[i];
+
+        if (bop->retcode != RIG_OK)
+        {
+            fprintf(fout, NETRIGCTL_RET "%d\n", bop->retcode);
+            continue;
+        }
+
+        switch (bop->op)
+        {
+        case RIG_BATCH_GET_FREQ:
+            if (ext) { fprintf(fout, "Frequency: "); }
+
+            fprintf(fout, "%"PRIll"%c", (int64_t)bop->freq, resp_sep);
+            break;
+
+        case RIG_BATCH_GET_MODE:
+            if (ext) { fprintf(fout, "Mode: "); }
+
+            fprintf(fout, "%s%c", rig_strrmode(bop->mode), resp_sep);
+
+            if (ext) { fprintf(fout, "Passband: "); }
+
+            fprintf(fout, "%ld%c", bop->width, resp_sep);
+            break;
+
+        case RIG_BATCH_GET_VFO:
+            if (ext) { fprintf(fout, "VFO: "); }
+
+            fprintf(fout, "%s%c", rig_strvfo(bop->tx_vfo), resp_sep);
+            break;
+
+        case RIG_BATCH_GET_PTT:
+            if (ext) { fprintf(fout, "PTT: "); }
+
+            fprintf(fout, "%d%c", bop->ptt, resp_sep);
+            break;
+
+        case RIG_BATCH_GET_SPLIT_VFO:
+            if (ext) { fprintf(fout, "Split: "); }
+
+            fprintf(fout, "%d%c", bop->split, resp_sep);
+
+            if (ext) { fprintf(fout, "TX VFO: "); }
+
+            fprintf(fout, "%s%c", rig_strvfo(bop->tx_vfo), resp_sep);
+            break;
+
+        case RIG_BATCH_GET_LEVEL:
+            if (ext) { fprintf(fout, "%s: ", rig_strlevel(bop->level)); }
+
+            if (RIG_LEVEL_IS_FLOAT(bop->level))
+            {
+                fprintf(fout, "%f%c", bop->val.f, resp_sep);
+            }
+            else
+            {
+                fprintf(fout, "%d%c", bop->val.i, resp_sep);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return RIG_OK;
+}
+
+
 /* '0x8c'--pause processing */
 declare_proto_rig(pause)
 {
@@ -4658,3 +6457,102 @@ declare_proto_rig(get_cache)
 
     return RIG_OK;
 }
+
+
+/*
+ * '0x9b' -- turn the connection into a change notification stream,
+ * e.g. "freq,ptt" or "all".  Events: freq mode ptt vfo all
+ */
+declare_proto_rig(subscribe)
+{
+    static const struct
+    {
+        const char *name;
+        unsigned int event;
+    } names[] =
+    {
+        { "freq", RIGCTL_EVENT_FREQ },
+        { "mode", RIGCTL_EVENT_MODE },
+        { "ptt",  RIGCTL_EVENT_PTT },
+        { "vfo",  RIGCTL_EVENT_VFO },
+        { "all",  RIGCTL_EVENT_ALL },
+    };
+    unsigned int events = 0;
+    const char *p = arg1;
+
+    if (!subscribe_cb)
+    {
+        return -RIG_ENIMPL;
+    }
+
+    while (*p)
+    {
+        size_t len = strcspn(p, ",");
+        int i;
+
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            if (strlen(names[i].name) == len && strncmp(p, names[i].name, len) == 0)
+            {
+                break;
+            }
+        }
+
+        if (i == sizeof(names) / sizeof(names[0]))
+        {
+            return -RIG_EINVAL;
+        }
+
+        events |= names[i].event;
+        p += len;
+
+        if (*p == ',') { p++; }
+    }
+
+    if (!events)
+    {
+        return -RIG_EINVAL;
+    }
+
+    return subscribe_cb(fout, events);
+}
+
+
+/*
+ * '0x9c' -- switch a rigctld connection to the binary framed protocol.
+ * Only rigctl_parse_input() can do that, see rigctl_parse_frame().
+ */
+declare_proto_rig(binary)
+{
+    return -RIG_ENAVAIL;
+}
+
+
+/*
+ * '0x9d' -- 1 clears the statistics and starts collecting, 0 stops.
+ */
+declare_proto_rig(set_stats)
+{
+    int enable;
+
+    CHKSCN1ARG(sscanf(arg1, "%d", &enable));
+
+    if (enable)
+    {
+        rig_stats_reset();
+        memset(cmd_stats, 0, sizeof(cmd_stats));
+    }
+
+    rig_stats_enable(enable);
+
+    return RIG_OK;
+}
+
+
+/* '0x9e' */
+declare_proto_rig(get_stats)
+{
+    rigctl_stats_print(fout, resp_sep);
+
+    return RIG_OK;
+}
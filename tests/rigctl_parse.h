@@ -49,5 +49,58 @@ typedef void (*sync_cb_t)(int);
 int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc, sync_cb_t sync_cb,
                  int interactive, int prompt, int * vfo_mode, char send_cmd_term,
                  int * ext_resp_ptr, char * resp_sep_ptr);
+int rigctl_set_coalesce(int enable);
+
+/*
+ * Input buffer of a rigctld connection, see rigctl_parse_input().
+ * The bytes between head and tail are received but not parsed yet.
+ */
+#define RIGCTL_INPUT_SIZE 4096
+
+struct rigctl_input
+{
+    size_t head;
+    size_t tail;
+    int binary;         /* binary framed protocol negotiated */
+    size_t skip;        /* bytes of an oversized frame still to drop */
+    char buf[RIGCTL_INPUT_SIZE];
+};
+
+/* largest request frame of the binary protocol, see rigctl_parse_frame() */
+#define RIGCTL_FRAME_MAX RIGCTL_INPUT_SIZE
+
+/* rigctl_parse_input() return code when the input ends mid-command */
+#define RIGCTL_PARSE_MORE 3
+
+char *rigctl_input_space(struct rigctl_input *in, size_t *room);
+int rigctl_parse_input(RIG *my_rig, struct rigctl_input *in, FILE *fout,
+                       sync_cb_t sync_cb, int *vfo_mode, char send_cmd_term,
+                       int *ext_resp_ptr, char *resp_sep_ptr);
+
+/* change notification events, see the subscribe command */
+#define RIGCTL_EVENT_FREQ   (1 << 0)
+#define RIGCTL_EVENT_MODE   (1 << 1)
+#define RIGCTL_EVENT_PTT    (1 << 2)
+#define RIGCTL_EVENT_VFO    (1 << 3)
+#define RIGCTL_EVENT_ALL    (RIGCTL_EVENT_FREQ | RIGCTL_EVENT_MODE \
+                             | RIGCTL_EVENT_PTT | RIGCTL_EVENT_VFO)
+
+typedef int (*rigctl_subscribe_cb_t)(FILE *fout, unsigned int events);
+void rigctl_set_subscribe_cb(rigctl_subscribe_cb_t cb);
+
+/* longest batch of notification lines sent at once */
+#define RIGCTL_NOTIFY_BATCH_MAX 512
+
+/* the end of a batch a subscriber socket did not take yet */
+struct rigctl_notify_out
+{
+    char pending[RIGCTL_NOTIFY_BATCH_MAX];
+    size_t len;
+};
+
+int rigctl_notify_send(int sock, struct rigctl_notify_out *out,
+                       const char *batch, size_t len);
+
+void rigctl_stats_print(FILE *fout, char sep);
 
 #endif  /* RIGCTL_PARSE_H */
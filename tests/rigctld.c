@@ -70,12 +70,25 @@
 #  include <pthread.h>
 #endif
 
+#if defined(HAVE_PTHREAD) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#  define RIGCTLD_EVENT_LOOP 1
+#  include <fcntl.h>
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#endif
+
+#if defined(HAVE_PTHREAD) && !defined(__MINGW32__)
+#  define RIGCTLD_NOTIFY 1
+#  include <fcntl.h>
+#endif
+
 #include <hamlib/rig.h>
 #include <hamlibdatetime.h>
 #include "misc.h"
 #include "iofunc.h"
 #include "serial.h"
 #include "sprintflst.h"
+#include "stats.h"
 
 #include "rigctl_parse.h"
 
@@ -86,7 +99,7 @@
  * NB: do NOT use -W since it's reserved by POSIX.
  * TODO: add an option to read from a file
  */
-#define SHORT_OPTIONS "m:r:p:d:P:D:s:c:T:t:C:W:x:z:lLuovhVZ"
+#define SHORT_OPTIONS "m:r:p:d:P:D:s:c:T:t:C:W:x:z:S:lLuovhVZAeR"
 static struct option long_options[] =
 {
     {"model",           1, 0, 'm'},
@@ -110,6 +123,10 @@ static struct option long_options[] =
     {"twiddle_timeout", 1, 0, 'W'},
     {"uplink",          1, 0, 'x'},
     {"debug-time-stamps", 0, 0, 'Z'},
+    {"debug-async",     0, 0, 'A'},
+    {"event-loop",      0, 0, 'e'},
+    {"coalesce",        0, 0, 'R'},
+    {"stats",           1, 0, 'S'},
     {0, 0, 0, 0}
 };
 
@@ -126,6 +143,21 @@ struct handle_data
 
 void *handle_socket(void *arg);
 void usage(void);
+static void accept_loop(int sock_listen, int vfo_mode);
+
+#ifdef HAVE_PTHREAD
+static void *stats_dumper(void *arg);
+#endif
+
+#ifdef RIGCTLD_EVENT_LOOP
+static void event_loop_run(int sock_listen, int vfo_mode);
+#endif
+
+#ifdef RIGCTLD_NOTIFY
+static void notify_init(void);
+static int notify_activate(int sock);
+static void notify_unsubscribe(int sock);
+#endif
 
 
 #ifdef HAVE_PTHREAD
@@ -250,8 +282,8 @@ int main(int argc, char *argv[])
     int reuseaddr = 1;
     int twiddle = 0;
     int uplink = 0;
-    char host[NI_MAXHOST];
-    char serv[NI_MAXSERV];
+    int event_loop = 0;
+    int stats_interval = -1;
 #if HAVE_SIGACTION
     struct sigaction act;
 #endif
@@ -260,7 +292,6 @@ int main(int argc, char *argv[])
     pthread_t thread;
     pthread_attr_t attr;
 #endif
-    struct handle_data *arg;
     int vfo_mode = 0; /* vfo_mode=0 means target VFO is current VFO */
 
     while (1)
@@ -541,6 +572,36 @@ int main(int argc, char *argv[])
             rig_set_debug_time_stamp(1);
             break;
 
+        case 'A':
+            if (rig_set_debug_async(1) != RIG_OK)
+            {
+                fprintf(stderr, "Asynchronous debug output not supported on this system\n");
+            }
+
+            break;
+
+        case 'e':
+            event_loop = 1;
+            break;
+
+        case 'R':
+            if (rigctl_set_coalesce(1) != RIG_OK)
+            {
+                fprintf(stderr, "Request coalescing not supported on this system\n");
+            }
+
+            break;
+
+        case 'S':
+            if (!optarg)
+            {
+                usage();    /* wrong arg count */
+                exit(1);
+            }
+
+            stats_interval = atoi(optarg);
+            break;
+
         default:
             usage();    /* unknown option? */
             exit(1);
@@ -859,9 +920,94 @@ int main(int argc, char *argv[])
 #endif
 #endif
 
-    /*
-     * main loop accepting connections
-     */
+#ifdef RIGCTLD_NOTIFY
+    notify_init();
+#endif
+
+    if (stats_interval >= 0)
+    {
+        rig_stats_enable(1);
+    }
+
+#ifdef HAVE_PTHREAD
+
+    if (stats_interval > 0)
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        retcode = pthread_create(&thread, &attr, stats_dumper,
+                                 (void *)(long)stats_interval);
+
+        if (retcode != 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "pthread_create: %s\n", strerror(retcode));
+        }
+
+        pthread_attr_destroy(&attr);
+    }
+
+#endif
+
+#ifdef RIGCTLD_EVENT_LOOP
+
+    if (event_loop)
+    {
+        event_loop_run(sock_listen, vfo_mode);
+    }
+    else
+    {
+        accept_loop(sock_listen, vfo_mode);
+    }
+
+#else
+
+    if (event_loop)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: event loop not supported, "
+                  "using one thread per client\n", __func__);
+    }
+
+    accept_loop(sock_listen, vfo_mode);
+#endif
+
+#ifdef HAVE_PTHREAD
+    /* allow threads to finish current action */
+    sync_callback(1);
+
+    if (client_count)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%u outstanding client(s)\n", client_count);
+    }
+
+    rig_close(my_rig);
+    sync_callback(0);
+#else
+    rig_close(my_rig); /* close port */
+#endif
+    rig_cleanup(my_rig); /* if you care about memory */
+
+#ifdef __MINGW32__
+    WSACleanup();
+#endif
+
+    return 0;
+}
+
+
+/*
+ * main loop accepting connections, one thread per client
+ */
+static void accept_loop(int sock_listen, int vfo_mode)
+{
+    int retcode;
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
+#ifdef HAVE_PTHREAD
+    pthread_t thread;
+    pthread_attr_t attr;
+#endif
+    struct handle_data *arg;
+
     do
     {
         fd_set set;
@@ -945,29 +1091,28 @@ int main(int argc, char *argv[])
         }
     }
     while (retcode == 0 && !ctrl_c);
+}
+
 
 #ifdef HAVE_PTHREAD
-    /* allow threads to finish current action */
-    sync_callback(1);
+/*
+ * Dump the statistics to stderr every arg seconds
+ */
+static void *stats_dumper(void *arg)
+{
+    unsigned int interval = (long)arg;
 
-    if (client_count)
+    for (;;)
     {
-        rig_debug(RIG_DEBUG_WARN, "%u outstanding client(s)\n", client_count);
-    }
-
-    rig_close(my_rig);
-    sync_callback(0);
-#else
-    rig_close(my_rig); /* close port */
-#endif
-    rig_cleanup(my_rig); /* if you care about memory */
+        sleep(interval);
 
-#ifdef __MINGW32__
-    WSACleanup();
-#endif
+        rigctl_stats_print(stderr, '\n');
+        fflush(stderr);
+    }
 
-    return 0;
+    return NULL;
 }
+#endif
 
 
 /*
@@ -976,7 +1121,7 @@ int main(int argc, char *argv[])
 void *handle_socket(void *arg)
 {
     struct handle_data *handle_data_arg = (struct handle_data *)arg;
-    FILE *fsockin = NULL;
+    struct rigctl_input sockin;
     FILE *fsockout = NULL;
     int retcode = RIG_OK;
     char host[NI_MAXHOST];
@@ -985,6 +1130,10 @@ void *handle_socket(void *arg)
     int ext_resp = 0;
     char resp_sep = '\n';
 
+    sockin.head = sockin.tail = 0;
+    sockin.binary = 0;
+    sockin.skip = 0;
+
 #ifdef __MINGW32__
     int sock_osfhandle = _open_osfhandle(handle_data_arg->sock, _O_RDONLY);
 
@@ -994,19 +1143,6 @@ void *handle_socket(void *arg)
         goto handle_exit;
     }
 
-    fsockin = _fdopen(sock_osfhandle,  "rb");
-#else
-    fsockin = fdopen(handle_data_arg->sock, "rb");
-#endif
-
-    if (!fsockin)
-    {
-        rig_debug(RIG_DEBUG_ERR, "fdopen(0x%d) in: %s\n", handle_data_arg->sock,
-                  strerror(errno));
-        goto handle_exit;
-    }
-
-#ifdef __MINGW32__
     fsockout = _fdopen(sock_osfhandle, "wb");
 #else
     fsockout = fdopen(handle_data_arg->sock, "wb");
@@ -1015,7 +1151,6 @@ void *handle_socket(void *arg)
     if (!fsockout)
     {
         rig_debug(RIG_DEBUG_ERR, "fdopen out: %s\n", strerror(errno));
-        fclose(fsockin);
 
         goto handle_exit;
     }
@@ -1057,22 +1192,51 @@ void *handle_socket(void *arg)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: vfo_mode=%d\n", __func__,
                   handle_data_arg->vfo_mode);
-        retcode = rigctl_parse(handle_data_arg->rig, fsockin, fsockout, NULL, 0,
-                               sync_callback,
-                               1, 0, &handle_data_arg->vfo_mode, send_cmd_term, &ext_resp, &resp_sep);
+        retcode = rigctl_parse_input(handle_data_arg->rig, &sockin, fsockout,
+                                     sync_callback, &handle_data_arg->vfo_mode,
+                                     send_cmd_term, &ext_resp, &resp_sep);
+
+        if (retcode == RIGCTL_PARSE_MORE)
+        {
+            size_t room;
+            char *p = rigctl_input_space(&sockin, &room);
+            int n = recv(handle_data_arg->sock, p, room, 0);
+
+            if (n <= 0)
+            {
+                if (n < 0)
+                {
+                    rig_debug(RIG_DEBUG_ERR, "%s: recv: %s\n", __func__, strerror(errno));
+                }
+
+                break;
+            }
+
+            sockin.tail += n;
+            continue;
+        }
 
         if (retcode != 0) { rig_debug(RIG_DEBUG_ERR, "%s: rigctl_parse retcode=%d\n", __func__, retcode); }
 
-        if (retcode == -1)
+#ifdef RIGCTLD_NOTIFY
+
+        if (retcode == 0 && notify_activate(handle_data_arg->sock))
         {
-            //sleep(1); // probably don't need this delay
-            continue;
+            char drain[256];
+
+            /* only notifications from now on, until the client goes */
+            while (recv(handle_data_arg->sock, drain, sizeof(drain), 0) > 0) {}
+
+            notify_unsubscribe(handle_data_arg->sock);
+            break;
         }
 
-        if (ferror(fsockin) || ferror(fsockout))
+#endif
+
+        if (ferror(fsockout))
         {
-            rig_debug(RIG_DEBUG_ERR, "%s: socket error in=%d, out=%d\n", __func__,
-                      ferror(fsockin), ferror(fsockout));
+            rig_debug(RIG_DEBUG_ERR, "%s: socket error out=%d\n", __func__,
+                      ferror(fsockout));
 
             retcode = rig_close(my_rig);
             rig_debug(RIG_DEBUG_ERR, "%s: rig_close retcode=%d\n", __func__, retcode);
@@ -1080,8 +1244,8 @@ void *handle_socket(void *arg)
             rig_debug(RIG_DEBUG_ERR, "%s: rig_open retcode=%d\n", __func__, retcode);
         }
     }
-
-    while (retcode == 0 || retcode == 2 || retcode == -RIG_ENAVAIL);
+    while (retcode == 0 || retcode == 2 || retcode == -RIG_ENAVAIL
+           || retcode == RIGCTL_PARSE_MORE);
 
 #ifdef HAVE_PTHREAD
 #if 0
@@ -1138,11 +1302,14 @@ handle_exit:
 #ifdef __MINGW32__
     retcode = closesocket(handle_data_arg->sock);
 
-    if (retcode != 0) { rig_debug(RIG_DEBUG_ERR, "%s: fclose(fsockin) %s\n", __func__, strerror(retcode)); }
+    if (retcode != 0) { rig_debug(RIG_DEBUG_ERR, "%s: closesocket %s\n", __func__, strerror(retcode)); }
 
 #endif
-    fclose(fsockin);
-    fclose(fsockout);
+
+    if (fsockout)
+    {
+        fclose(fsockout);
+    }
 
 // for everybody else we close the handle after fclose
 #ifndef __MINGW32__
@@ -1161,6 +1328,1279 @@ handle_exit:
 }
 
 
+#ifdef RIGCTLD_NOTIFY
+
+/*
+ * Change notification
+ *
+ * A client sending "subscribe" turns its connection into a stream of
+ * "Label: value" lines, sent as the rig state changes.  One poller
+ * thread reads the rig for all the subscribers, so watching clients
+ * cost one poll whatever their number.  When the rig is in transceive
+ * mode, the values decoded by the backend through the event callbacks
+ * feed the stream and the poller leaves the rig alone.
+ *
+ * Each value follows a "Version:" line, the snapshot version of the
+ * cache when the value was read, see rig_get_state_snapshot().
+ */
+
+#define NOTIFY_INTERVAL_MS 200
+#define NOTIFY_LINE_LEN 96
+#define NOTIFY_MAX_EVENTS 5
+
+struct notify_event
+{
+    unsigned int kind;          /* RIGCTL_EVENT_xxx */
+    char line[NOTIFY_LINE_LEN];
+};
+
+struct notify_sub
+{
+    int sock;
+    unsigned int events;
+    int active;                 /* reply to subscribe sent */
+    struct rigctl_notify_out out;
+    struct notify_sub *next;
+};
+
+static struct
+{
+    pthread_mutex_t lock;
+    struct notify_sub *subs;    /* thread per client subscribers */
+    int count;                  /* all subscribers, event loop ones too */
+    int resync;                 /* send the whole state on next round */
+    int started;
+    int wake[2];                /* pipe waking the poller up */
+
+    /* from the event callbacks, which may run in a signal handler */
+    volatile freq_t trn_freq;
+    volatile rmode_t trn_mode;
+    volatile pbwidth_t trn_width;
+    volatile ptt_t trn_ptt;
+    volatile vfo_t trn_vfo;
+    unsigned int trn_pending;
+} notify =
+{
+    PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, { -1, -1 }
+};
+
+#ifdef RIGCTLD_EVENT_LOOP
+static void evl_post_events(const struct notify_event *ev, int n);
+#endif
+
+
+static void notify_wakeup(void)
+{
+    char c = 0;
+
+    /* async-signal-safe, a full pipe already means a wake up is due */
+    if (write(notify.wake[1], &c, 1) < 0) {}
+}
+
+
+static void notify_trn_pending(unsigned int kind)
+{
+    __atomic_or_fetch(&notify.trn_pending, kind, __ATOMIC_RELEASE);
+    notify_wakeup();
+}
+
+
+/* transceive callbacks, keep to async-signal-safe calls */
+static int notify_freq_event(RIG *rig, vfo_t vfo, freq_t freq, rig_ptr_t arg)
+{
+    if (vfo != RIG_VFO_CURR && vfo != rig->state.current_vfo)
+    {
+        return RIG_OK;
+    }
+
+    notify.trn_freq = freq;
+    notify_trn_pending(RIGCTL_EVENT_FREQ);
+
+    return RIG_OK;
+}
+
+
+static int notify_mode_event(RIG *rig, vfo_t vfo, rmode_t mode,
+                             pbwidth_t width, rig_ptr_t arg)
+{
+    if (vfo != RIG_VFO_CURR && vfo != rig->state.current_vfo)
+    {
+        return RIG_OK;
+    }
+
+    notify.trn_mode = mode;
+    notify.trn_width = width;
+    notify_trn_pending(RIGCTL_EVENT_MODE);
+
+    return RIG_OK;
+}
+
+
+static int notify_ptt_event(RIG *rig, vfo_t vfo, ptt_t ptt, rig_ptr_t arg)
+{
+    notify.trn_ptt = ptt;
+    notify_trn_pending(RIGCTL_EVENT_PTT);
+
+    return RIG_OK;
+}
+
+
+static int notify_vfo_event(RIG *rig, vfo_t vfo, rig_ptr_t arg)
+{
+    notify.trn_vfo = vfo;
+    notify_trn_pending(RIGCTL_EVENT_VFO);
+
+    return RIG_OK;
+}
+
+
+/*
+ * Send the events a thread per client subscriber asked for.  A client
+ * not reading fast enough loses whole batches of events, never part of
+ * a line, see rigctl_notify_send().  A client gone is shut down, its
+ * thread then unsubscribes it.
+ */
+static void notify_deliver(const struct notify_event *ev, int n)
+{
+    struct notify_sub *sub;
+
+    pthread_mutex_lock(&notify.lock);
+
+    for (sub = notify.subs; sub; sub = sub->next)
+    {
+        /* NOTIFY_MAX_EVENTS lines of NOTIFY_LINE_LEN at most */
+        char buf[RIGCTL_NOTIFY_BATCH_MAX];
+        size_t len = 0;
+        int i;
+
+        if (!sub->active)
+        {
+            continue;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (ev[i].kind & sub->events)
+            {
+                len += snprintf(buf + len, sizeof(buf) - len, "%s", ev[i].line);
+            }
+        }
+
+        switch (rigctl_notify_send(sub->sock, &sub->out, buf, len))
+        {
+        case 1:
+            rig_debug(RIG_DEBUG_WARN, "%s: events lost, fd=%d\n", __func__, sub->sock);
+            break;
+
+        case -1:
+            rig_debug(RIG_DEBUG_WARN, "%s: subscriber gone, fd=%d\n", __func__,
+                      sub->sock);
+            sub->active = 0;
+            shutdown(sub->sock, SHUT_RDWR);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&notify.lock);
+
+#ifdef RIGCTLD_EVENT_LOOP
+    evl_post_events(ev, n);
+#endif
+}
+
+
+/* the rig state as last sent to the subscribers */
+struct notify_state
+{
+    vfo_t vfo;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+    unsigned int known;         /* RIGCTL_EVENT_xxx read so far */
+};
+
+
+/*
+ * Read the rig, returns the RIGCTL_EVENT_xxx which changed
+ */
+static unsigned int notify_read_rig(struct notify_state *st)
+{
+    unsigned int changed = 0;
+    vfo_t v;
+    freq_t f;
+    rmode_t m;
+    pbwidth_t w;
+    ptt_t p;
+
+    sync_callback(1);
+
+    if (my_rig->caps->get_vfo && rig_get_vfo(my_rig, &v) == RIG_OK)
+    {
+        changed |= (v != st->vfo) ? RIGCTL_EVENT_VFO : 0;
+        st->vfo = v;
+        st->known |= RIGCTL_EVENT_VFO;
+    }
+
+    if (rig_get_freq(my_rig, RIG_VFO_CURR, &f) == RIG_OK)
+    {
+        changed |= (f != st->freq) ? RIGCTL_EVENT_FREQ : 0;
+        st->freq = f;
+        st->known |= RIGCTL_EVENT_FREQ;
+    }
+
+    if (rig_get_mode(my_rig, RIG_VFO_CURR, &m, &w) == RIG_OK)
+    {
+        changed |= (m != st->mode || w != st->width) ? RIGCTL_EVENT_MODE : 0;
+        st->mode = m;
+        st->width = w;
+        st->known |= RIGCTL_EVENT_MODE;
+    }
+
+    if (rig_get_ptt(my_rig, RIG_VFO_CURR, &p) == RIG_OK)
+    {
+        changed |= (p != st->ptt) ? RIGCTL_EVENT_PTT : 0;
+        st->ptt = p;
+        st->known |= RIGCTL_EVENT_PTT;
+    }
+
+    sync_callback(0);
+
+    return changed;
+}
+
+
+static void *notify_poller(void *arg)
+{
+    struct notify_state st;
+
+    memset(&st, 0, sizeof(st));
+    st.vfo = RIG_VFO_NONE;
+    st.mode = RIG_MODE_NONE;
+    st.ptt = RIG_PTT_OFF;
+
+    for (;;)
+    {
+        struct notify_event ev[NOTIFY_MAX_EVENTS];
+        struct rig_state_snapshot snap;
+        unsigned long version = 0;
+        unsigned int changed = 0;
+        unsigned int trn;
+        int count, resync;
+        int n = 0;
+        fd_set set;
+        struct timeval tv;
+        char drain[16];
+
+        pthread_mutex_lock(&notify.lock);
+        count = notify.count;
+        pthread_mutex_unlock(&notify.lock);
+
+        /* sleep until the next round, a callback or a new subscriber */
+        FD_ZERO(&set);
+        FD_SET(notify.wake[0], &set);
+        tv.tv_sec = 0;
+        tv.tv_usec = NOTIFY_INTERVAL_MS * 1000;
+
+        if (select(notify.wake[0] + 1, &set, NULL, NULL, count ? &tv : NULL) > 0
+                && read(notify.wake[0], drain, sizeof(drain)) < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: read: %s\n", __func__, strerror(errno));
+        }
+
+        pthread_mutex_lock(&notify.lock);
+        count = notify.count;
+        resync = notify.resync;
+        notify.resync = 0;
+        pthread_mutex_unlock(&notify.lock);
+
+        if (!count)
+        {
+            st.known = 0;
+            continue;
+        }
+
+        /* taken before reading, the values sent are at least that recent,
+         * which lets a client drop the pushes older than its own sets */
+        if (rig_get_state_snapshot(my_rig, &snap) == RIG_OK)
+        {
+            version = snap.version;
+        }
+
+        trn = __atomic_exchange_n(&notify.trn_pending, 0, __ATOMIC_ACQUIRE);
+
+        if (my_rig->state.transceive == RIG_TRN_OFF)
+        {
+            changed = notify_read_rig(&st);
+        }
+        else
+        {
+            /* a new subscriber gets the whole state, read once if the rig
+             * has not sent it yet */
+            if (resync && st.known != RIGCTL_EVENT_ALL)
+            {
+                changed = notify_read_rig(&st);
+            }
+
+            if (trn & RIGCTL_EVENT_VFO) { st.vfo = notify.trn_vfo; }
+
+            if (trn & RIGCTL_EVENT_FREQ) { st.freq = notify.trn_freq; }
+
+            if (trn & RIGCTL_EVENT_MODE)
+            {
+                st.mode = notify.trn_mode;
+                st.width = notify.trn_width;
+            }
+
+            if (trn & RIGCTL_EVENT_PTT) { st.ptt = notify.trn_ptt; }
+
+            changed |= trn;
+            st.known |= trn;
+        }
+
+        if (resync)
+        {
+            changed = st.known;
+        }
+
+        if (changed & RIGCTL_EVENT_VFO)
+        {
+            ev[n].kind = RIGCTL_EVENT_VFO;
+            snprintf(ev[n++].line, NOTIFY_LINE_LEN, "Version: %lu\nVFO: %s\n",
+                     version, rig_strvfo(st.vfo));
+        }
+
+        if (changed & RIGCTL_EVENT_FREQ)
+        {
+            ev[n].kind = RIGCTL_EVENT_FREQ;
+            snprintf(ev[n++].line, NOTIFY_LINE_LEN, "Version: %lu\nFrequency: %"PRIll"\n",
+                     version, (int64_t)st.freq);
+        }
+
+        if (changed & RIGCTL_EVENT_MODE)
+        {
+            ev[n].kind = RIGCTL_EVENT_MODE;
+            snprintf(ev[n++].line, NOTIFY_LINE_LEN,
+                     "Version: %lu\nMode: %s\nPassband: %ld\n",
+                     version, rig_strrmode(st.mode), st.width);
+        }
+
+        if (changed & RIGCTL_EVENT_PTT)
+        {
+            ev[n].kind = RIGCTL_EVENT_PTT;
+            snprintf(ev[n++].line, NOTIFY_LINE_LEN, "Version: %lu\nPTT: %d\n",
+                     version, st.ptt);
+        }
+
+        if (n)
+        {
+            notify_deliver(ev, n);
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Account for a new subscriber, starting the poller on first use
+ */
+static int notify_count_add(int delta)
+{
+    int retcode = 0;
+
+    pthread_mutex_lock(&notify.lock);
+    notify.count += delta;
+
+    if (delta > 0 && !notify.started)
+    {
+        pthread_t thread;
+        pthread_attr_t attr;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        retcode = pthread_create(&thread, &attr, notify_poller, NULL);
+        notify.started = (retcode == 0);
+    }
+
+    pthread_mutex_unlock(&notify.lock);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "pthread_create: %s\n", strerror(retcode));
+        return -RIG_EINTERNAL;
+    }
+
+    return RIG_OK;
+}
+
+
+#ifdef RIGCTLD_EVENT_LOOP
+static struct evl_client *evl_current;
+static void evl_subscribe(struct evl_client *c, unsigned int events);
+#endif
+
+/*
+ * rigctl_parse() callback of the subscribe command.  The subscriber is
+ * only served once the reply to the command is out, see notify_activate().
+ */
+static int notify_subscribe(FILE *fout, unsigned int events)
+{
+    struct notify_sub *sub;
+    int sock;
+
+#ifdef RIGCTLD_EVENT_LOOP
+
+    if (evl_current)
+    {
+        evl_subscribe(evl_current, events);
+        return RIG_OK;
+    }
+
+#endif
+
+    sock = fileno(fout);
+
+    if (sock < 0)
+    {
+        return -RIG_EINVAL;
+    }
+
+    pthread_mutex_lock(&notify.lock);
+
+    for (sub = notify.subs; sub && sub->sock != sock; sub = sub->next) {}
+
+    if (sub)
+    {
+        sub->events = events;
+        pthread_mutex_unlock(&notify.lock);
+        return RIG_OK;
+    }
+
+    sub = calloc(1, sizeof(struct notify_sub));
+
+    if (!sub)
+    {
+        pthread_mutex_unlock(&notify.lock);
+        return -RIG_ENOMEM;
+    }
+
+    sub->sock = sock;
+    sub->events = events;
+    sub->next = notify.subs;
+    notify.subs = sub;
+    pthread_mutex_unlock(&notify.lock);
+
+    return notify_count_add(1);
+}
+
+
+/* have the poller send the whole state to a new subscriber */
+static void notify_resync(void)
+{
+    pthread_mutex_lock(&notify.lock);
+    notify.resync = 1;
+    pthread_mutex_unlock(&notify.lock);
+
+    notify_wakeup();
+}
+
+
+/*
+ * Start sending events to a thread per client subscriber.
+ * Returns 1 when the client subscribed.
+ */
+static int notify_activate(int sock)
+{
+    struct notify_sub *sub;
+
+    pthread_mutex_lock(&notify.lock);
+
+    for (sub = notify.subs; sub && sub->sock != sock; sub = sub->next) {}
+
+    if (sub)
+    {
+        sub->active = 1;
+    }
+
+    pthread_mutex_unlock(&notify.lock);
+
+    if (sub)
+    {
+        notify_resync();
+    }
+
+    return sub != NULL;
+}
+
+
+static void notify_unsubscribe(int sock)
+{
+    struct notify_sub **psub;
+
+    pthread_mutex_lock(&notify.lock);
+
+    for (psub = &notify.subs; *psub; psub = &(*psub)->next)
+    {
+        if ((*psub)->sock == sock)
+        {
+            struct notify_sub *sub = *psub;
+
+            *psub = sub->next;
+            free(sub);
+            notify.count--;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&notify.lock);
+}
+
+
+static void notify_init(void)
+{
+    if (pipe(notify.wake) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pipe: %s\n", __func__, strerror(errno));
+        return;
+    }
+
+    fcntl(notify.wake[0], F_SETFL, fcntl(notify.wake[0], F_GETFL) | O_NONBLOCK);
+    fcntl(notify.wake[1], F_SETFL, fcntl(notify.wake[1], F_GETFL) | O_NONBLOCK);
+
+    rig_set_freq_callback(my_rig, notify_freq_event, NULL);
+    rig_set_mode_callback(my_rig, notify_mode_event, NULL);
+    rig_set_ptt_callback(my_rig, notify_ptt_event, NULL);
+    rig_set_vfo_callback(my_rig, notify_vfo_event, NULL);
+
+    rigctl_set_subscribe_cb(notify_subscribe);
+}
+
+#endif /* RIGCTLD_NOTIFY */
+
+
+#ifdef RIGCTLD_EVENT_LOOP
+
+/*
+ * Event loop mode
+ *
+ * One epoll reactor owns the listening socket and all the client
+ * sockets.  A client with new input is queued to a single rig worker
+ * thread, which runs the complete commands of its input buffer through
+ * rigctl_parse_input() and hands the reply back through an eventfd.
+ * The reactor does not touch the input buffer while the worker has it.
+ * Each client has at most one request in flight, so replies keep the
+ * order of the commands.
+ */
+
+#define EVL_MAX_EVENTS 64
+
+struct evl_client
+{
+    int sock;
+    struct rigctl_input in;     /* worker owned while busy */
+    int fresh;                  /* input received since the last request */
+    char *outbuf;               /* reply bytes not sent yet */
+    size_t outlen;
+    size_t outoff;
+    char *resp;                 /* reply built by the worker */
+    size_t resplen;
+    int busy;                   /* a request is queued or running */
+    int closing;                /* close as soon as the worker is done */
+    int quit;                   /* client asked to quit */
+    int vfo_mode;
+    int ext_resp;
+    char resp_sep;
+    struct evl_client *next;    /* worker queue or done list */
+#ifdef RIGCTLD_NOTIFY
+    unsigned int events;        /* subscribed change notifications */
+    int subscribed;             /* on the subscriber list */
+    struct evl_client *sub_next;
+#endif
+};
+
+#define EVL_MAX_PENDING 32
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct evl_client *queue_head, *queue_tail;
+    struct evl_client *done;
+    int efd;                    /* signals the reactor that replies are ready */
+    int stop;
+#ifdef RIGCTLD_NOTIFY
+    struct notify_event pending[EVL_MAX_PENDING];   /* events to send out */
+    int npending;
+#endif
+} evl =
+{
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, NULL, -1, 0
+};
+
+#ifdef RIGCTLD_NOTIFY
+static struct evl_client *evl_subs;     /* reactor owned */
+#endif
+
+
+/*
+ * Run the complete commands in the input of a client through
+ * rigctl_parse_input(), collecting the reply in memory.
+ */
+static void evl_run_request(struct evl_client *c)
+{
+    FILE *fout;
+
+    c->resp = NULL;
+    c->resplen = 0;
+
+#ifdef HAVE_OPEN_MEMSTREAM
+    fout = open_memstream(&c->resp, &c->resplen);
+#else
+    /* read back into c->resp below */
+    fout = tmpfile();
+#endif
+
+    if (!fout)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: memory stream: %s\n", __func__,
+                  strerror(errno));
+        c->quit = 1;
+        return;
+    }
+
+    for (;;)
+    {
+        int retcode = rigctl_parse_input(my_rig, &c->in, fout, sync_callback,
+                                         &c->vfo_mode, '\r', &c->ext_resp,
+                                         &c->resp_sep);
+
+        if (retcode == RIGCTL_PARSE_MORE)
+        {
+            break;
+        }
+
+        if (retcode != 0 && retcode != 2 && retcode != -RIG_ENAVAIL)
+        {
+            c->quit = 1;
+            break;
+        }
+    }
+
+#ifndef HAVE_OPEN_MEMSTREAM
+    c->resplen = ftell(fout);
+    c->resp = malloc(c->resplen + 1);
+    rewind(fout);
+
+    if (!c->resp || fread(c->resp, 1, c->resplen, fout) != c->resplen)
+    {
+        c->resplen = 0;
+        c->quit = 1;
+    }
+
+#endif
+    fclose(fout);
+}
+
+
+static void *evl_worker(void *arg)
+{
+    pthread_mutex_lock(&evl.lock);
+
+    while (!evl.stop)
+    {
+        struct evl_client *c = evl.queue_head;
+        uint64_t one = 1;
+
+        if (!c)
+        {
+            pthread_cond_wait(&evl.cond, &evl.lock);
+            continue;
+        }
+
+        evl.queue_head = c->next;
+
+        if (!evl.queue_head)
+        {
+            evl.queue_tail = NULL;
+        }
+
+        pthread_mutex_unlock(&evl.lock);
+
+#ifdef RIGCTLD_NOTIFY
+        evl_current = c;
+#endif
+        evl_run_request(c);
+#ifdef RIGCTLD_NOTIFY
+        evl_current = NULL;
+#endif
+
+        pthread_mutex_lock(&evl.lock);
+        c->next = evl.done;
+        evl.done = c;
+
+        if (write(evl.efd, &one, sizeof(one)) < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: eventfd write: %s\n", __func__,
+                      strerror(errno));
+        }
+    }
+
+    pthread_mutex_unlock(&evl.lock);
+
+    return NULL;
+}
+
+
+static void evl_free_client(int epfd, struct evl_client *c)
+{
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: connection closed, fd=%d\n", __func__,
+              c->sock);
+
+#ifdef RIGCTLD_NOTIFY
+
+    if (c->events)
+    {
+        struct evl_client **pc;
+
+        for (pc = &evl_subs; *pc && *pc != c; pc = &(*pc)->sub_next) {}
+
+        if (*pc) { *pc = c->sub_next; }
+
+        notify_count_add(-1);
+    }
+
+#endif
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->sock, NULL);
+    close(c->sock);
+    free(c->outbuf);
+    free(c);
+}
+
+
+/*
+ * Poll for input only while there is room for it,
+ * and for output only while some is pending
+ */
+static void evl_update_events(int epfd, struct evl_client *c)
+{
+    struct epoll_event ev;
+
+    ev.events = (!c->busy && c->in.tail - c->in.head < sizeof(c->in.buf) ? EPOLLIN : 0)
+                | (c->outlen ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->sock, &ev);
+}
+
+
+/*
+ * Send as much pending output as the socket takes.
+ * Returns -1 when the client is gone.
+ */
+static int evl_flush_output(struct evl_client *c)
+{
+    while (c->outoff < c->outlen)
+    {
+        ssize_t n = send(c->sock, c->outbuf + c->outoff, c->outlen - c->outoff,
+                         MSG_NOSIGNAL);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+
+            return -1;
+        }
+
+        c->outoff += n;
+    }
+
+    if (c->outoff == c->outlen)
+    {
+        c->outoff = c->outlen = 0;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Hand a client with new input to the worker
+ */
+static void evl_dispatch(struct evl_client *c)
+{
+    if (c->busy || c->closing || c->quit || !c->fresh)
+    {
+        return;
+    }
+
+    c->fresh = 0;
+
+#ifdef RIGCTLD_NOTIFY
+
+    if (c->events)
+    {
+        /* the connection only carries notifications now */
+        c->in.head = c->in.tail = 0;
+        return;
+    }
+
+#endif
+
+    c->busy = 1;
+
+    pthread_mutex_lock(&evl.lock);
+    c->next = NULL;
+
+    if (evl.queue_tail)
+    {
+        evl.queue_tail->next = c;
+    }
+    else
+    {
+        evl.queue_head = c;
+    }
+
+    evl.queue_tail = c;
+    pthread_cond_signal(&evl.cond);
+    pthread_mutex_unlock(&evl.lock);
+}
+
+
+/*
+ * Queue bytes to send to the client.
+ * Returns -1 when out of memory.
+ */
+static int evl_queue_output(struct evl_client *c, const char *data, size_t len)
+{
+    char *outbuf;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    outbuf = realloc(c->outbuf, c->outlen + len);
+
+    if (!outbuf)
+    {
+        return -1;
+    }
+
+    memcpy(outbuf + c->outlen, data, len);
+    c->outbuf = outbuf;
+    c->outlen += len;
+
+    return 0;
+}
+
+
+#ifdef RIGCTLD_NOTIFY
+
+/*
+ * Called by the worker from the subscribe command,
+ * the reactor puts the client on its list with the reply.
+ */
+static void evl_subscribe(struct evl_client *c, unsigned int events)
+{
+    if (!c->events)
+    {
+        notify_count_add(1);
+    }
+
+    c->events = events;
+}
+
+
+/*
+ * Called by the poller, hands the events over to the reactor
+ */
+static void evl_post_events(const struct notify_event *ev, int n)
+{
+    uint64_t one = 1;
+    int i;
+
+    if (evl.efd < 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&evl.lock);
+
+    for (i = 0; i < n && evl.npending < EVL_MAX_PENDING; i++)
+    {
+        evl.pending[evl.npending++] = ev[i];
+    }
+
+    if (i < n)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: %d events lost\n", __func__, n - i);
+    }
+
+    if (write(evl.efd, &one, sizeof(one)) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: eventfd write: %s\n", __func__,
+                  strerror(errno));
+    }
+
+    pthread_mutex_unlock(&evl.lock);
+}
+
+
+/*
+ * Queue the pending events to the subscribers
+ */
+static void evl_send_events(int epfd, const struct notify_event *ev, int n)
+{
+    struct evl_client *c, *next;
+
+    for (c = evl_subs; c; c = next)
+    {
+        int i;
+        int err = 0;
+
+        next = c->sub_next;
+
+        if (c->closing)
+        {
+            continue;
+        }
+
+        for (i = 0; i < n && !err; i++)
+        {
+            if (ev[i].kind & c->events)
+            {
+                err = evl_queue_output(c, ev[i].line, strlen(ev[i].line));
+            }
+        }
+
+        if (err || evl_flush_output(c) < 0)
+        {
+            evl_free_client(epfd, c);
+            continue;
+        }
+
+        evl_update_events(epfd, c);
+    }
+}
+
+#endif
+
+
+/*
+ * Collect the replies finished by the worker
+ */
+static void evl_collect(int epfd)
+{
+    struct evl_client *c, *next;
+    uint64_t count;
+#ifdef RIGCTLD_NOTIFY
+    struct notify_event pending[EVL_MAX_PENDING];
+    int npending;
+#endif
+
+    if (read(evl.efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: eventfd read: %s\n", __func__, strerror(errno));
+    }
+
+    pthread_mutex_lock(&evl.lock);
+    c = evl.done;
+    evl.done = NULL;
+#ifdef RIGCTLD_NOTIFY
+    npending = evl.npending;
+    memcpy(pending, evl.pending, npending * sizeof(struct notify_event));
+    evl.npending = 0;
+#endif
+    pthread_mutex_unlock(&evl.lock);
+
+    for (; c; c = next)
+    {
+        int err;
+
+        next = c->next;
+        c->busy = 0;
+
+        if (c->closing)
+        {
+            free(c->resp);
+            evl_free_client(epfd, c);
+            continue;
+        }
+
+        err = evl_queue_output(c, c->resp, c->resplen);
+
+        free(c->resp);
+        c->resp = NULL;
+
+        if (err || evl_flush_output(c) < 0 || (c->quit && c->outlen == 0))
+        {
+            evl_free_client(epfd, c);
+            continue;
+        }
+
+#ifdef RIGCTLD_NOTIFY
+
+        if (c->events && !c->subscribed)
+        {
+            /* the reply to subscribe is out, start the stream */
+            c->subscribed = 1;
+            c->sub_next = evl_subs;
+            evl_subs = c;
+            notify_resync();
+        }
+
+#endif
+        evl_dispatch(c);
+        evl_update_events(epfd, c);
+    }
+
+#ifdef RIGCTLD_NOTIFY
+
+    if (npending)
+    {
+        evl_send_events(epfd, pending, npending);
+    }
+
+#endif
+}
+
+
+static void evl_accept(int epfd, int sock_listen, int vfo_mode)
+{
+    struct sockaddr_storage cli_addr;
+    socklen_t clilen = sizeof(cli_addr);
+    struct epoll_event ev;
+    struct evl_client *c;
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
+    int sock;
+    int retcode;
+
+    sock = accept(sock_listen, (struct sockaddr *)&cli_addr, &clilen);
+
+    if (sock < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "accept");
+        return;
+    }
+
+    if ((retcode = getnameinfo((struct sockaddr const *)&cli_addr, clilen,
+                               host, sizeof(host), serv, sizeof(serv),
+                               NI_NOFQDN)) < 0)
+    {
+        rig_debug(RIG_DEBUG_WARN, "Peer lookup error: %s", gai_strerror(retcode));
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "Connection opened from %s:%s\n", host, serv);
+
+    c = calloc(1, sizeof(struct evl_client));
+
+    if (!c)
+    {
+        rig_debug(RIG_DEBUG_ERR, "calloc: %s\n", strerror(errno));
+        close(sock);
+        return;
+    }
+
+    c->sock = sock;
+    c->vfo_mode = vfo_mode;
+    c->resp_sep = '\n';
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: epoll_ctl: %s\n", __func__, strerror(errno));
+        close(sock);
+        free(c);
+    }
+}
+
+
+/*
+ * Read what the client sent and queue the complete lines.
+ * Returns -1 when the client is gone.
+ */
+static int evl_read_input(struct evl_client *c)
+{
+    for (;;)
+    {
+        size_t room;
+        char *p = rigctl_input_space(&c->in, &room);
+        ssize_t n;
+
+        if (room == 0)
+        {
+            /* let the worker drain the buffer first */
+            return 0;
+        }
+
+        n = recv(c->sock, p, room, 0);
+
+        if (n == 0)
+        {
+            return -1;
+        }
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        c->in.tail += n;
+        c->fresh = 1;
+    }
+}
+
+
+static void event_loop_run(int sock_listen, int vfo_mode)
+{
+    struct epoll_event ev, events[EVL_MAX_EVENTS];
+    pthread_t worker;
+    int epfd;
+    int retcode;
+
+    epfd = epoll_create1(0);
+    evl.efd = eventfd(0, EFD_NONBLOCK);
+
+    if (epfd < 0 || evl.efd < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: epoll/eventfd: %s\n", __func__, strerror(errno));
+        exit(1);
+    }
+
+    /* the listening socket and the eventfd are told apart by data.ptr */
+    ev.events = EPOLLIN;
+    ev.data.ptr = &sock_listen;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sock_listen, &ev);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &evl.efd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, evl.efd, &ev);
+
+    retcode = pthread_create(&worker, NULL, evl_worker, NULL);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "pthread_create: %s\n", strerror(retcode));
+        exit(1);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: serving clients from the event loop\n",
+              __func__);
+
+    while (!ctrl_c)
+    {
+        int i;
+        int collect = 0;
+        int nfds = epoll_wait(epfd, events, EVL_MAX_EVENTS, 5000);
+
+        if (nfds < 0)
+        {
+            if (errno != EINTR)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: epoll_wait: %s\n", __func__, strerror(errno));
+            }
+
+            continue;
+        }
+
+        for (i = 0; i < nfds; i++)
+        {
+            struct evl_client *c = events[i].data.ptr;
+            int gone = 0;
+
+            if (events[i].data.ptr == &sock_listen)
+            {
+                evl_accept(epfd, sock_listen, vfo_mode);
+                continue;
+            }
+
+            if (events[i].data.ptr == &evl.efd)
+            {
+                /* done last, it may free clients still in events[] */
+                collect = 1;
+                continue;
+            }
+
+            if ((events[i].events & EPOLLOUT) && evl_flush_output(c) < 0)
+            {
+                gone = 1;
+            }
+
+            if (!gone && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+            {
+                if (c->busy)
+                {
+                    /* the input buffer belongs to the worker for now */
+                    gone = !!(events[i].events & (EPOLLHUP | EPOLLERR));
+                }
+                else if (evl_read_input(c) < 0)
+                {
+                    gone = 1;
+                }
+            }
+
+            if (c->quit && c->outlen == 0 && !c->busy)
+            {
+                gone = 1;
+            }
+
+            if (gone)
+            {
+                if (c->busy)
+                {
+                    /* drop the client once the worker is done with it */
+                    c->closing = 1;
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, c->sock, NULL);
+                }
+                else
+                {
+                    evl_free_client(epfd, c);
+                }
+
+                continue;
+            }
+
+            evl_dispatch(c);
+            evl_update_events(epfd, c);
+        }
+
+        if (collect)
+        {
+            evl_collect(epfd);
+        }
+    }
+
+    pthread_mutex_lock(&evl.lock);
+    evl.stop = 1;
+    pthread_cond_signal(&evl.cond);
+    pthread_mutex_unlock(&evl.lock);
+    pthread_join(worker, NULL);
+
+    close(evl.efd);
+    close(epfd);
+}
+
+#endif /* RIGCTLD_EVENT_LOOP */
+
+
 void usage(void)
 {
     printf("Usage: rigctld [OPTION]...\n"
@@ -1187,6 +2627,10 @@ void usage(void)
         "  -W, --twiddle_timeout         timeout after detecting vfo manual change\n"
         "  -x, --uplink                  set uplink get_freq ignore, 1=Sub, 2=Main\n"
         "  -Z, --debug-time-stamps       enable time stamps for debug messages\n"
+        "  -A, --debug-async             write debug messages from a separate thread\n"
+        "  -e, --event-loop              serve all clients from one event loop\n"
+        "  -R, --coalesce                share identical in-flight read commands\n"
+        "  -S, --stats=SECS              collect latency statistics, dump every SECS\n"
         "  -h, --help                    display this help and exit\n"
         "  -V, --version                 output version information and exit\n\n",
         portno);
@@ -0,0 +1,556 @@
+/*
+ * rigtrace.c - (C) The Hamlib Group 2020
+ *
+ * This program pretty prints the binary wire traces written by Hamlib
+ * when the trace_file configuration parameter is set.
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <getopt.h>
+
+#include <hamlib/rig.h>
+#include "trace.h"
+
+
+/*
+ * Prototypes
+ */
+static void usage();
+static void version();
+
+/*
+ * Reminder: when adding long options,
+ *  keep up to date SHORT_OPTIONS, usage()'s output and man page. thanks.
+ * NB: do NOT use -W since it's reserved by POSIX.
+ */
+#define SHORT_OPTIONS "p:rhV"
+static struct option long_options[] =
+{
+    {"protocol",        1, 0, 'p'},
+    {"raw",             0, 0, 'r'},
+    {"help",            0, 0, 'h'},
+    {"version",         0, 0, 'V'},
+    {0, 0, 0, 0}
+};
+
+enum protocol
+{
+    PROTO_AUTO,
+    PROTO_HEX,
+    PROTO_CIV,
+    PROTO_KENWOOD,
+    PROTO_NEWCAT
+};
+
+/* longest frame reassembled from the records of one direction */
+#define FRAME_MAX 1024
+
+struct stream
+{
+    unsigned char buf[FRAME_MAX];
+    size_t len;
+};
+
+static enum protocol protocol = PROTO_AUTO;
+static int ascii_mfg;       /* Yaesu when 2, any other ASCII protocol when 1 */
+static unsigned char last_tx[FRAME_MAX];
+static size_t last_tx_len;
+
+
+static uint64_t get_le(const unsigned char *p, int len)
+{
+    uint64_t val = 0;
+
+    while (len-- > 0)
+    {
+        val = (val << 8) | p[len];
+    }
+
+    return val;
+}
+
+
+static const char *civ_cmd_name(unsigned char cmd)
+{
+    switch (cmd)
+    {
+    case 0x00: return "transceive freq";
+    case 0x01: return "transceive mode";
+    case 0x03: return "read freq";
+    case 0x04: return "read mode";
+    case 0x05: return "set freq";
+    case 0x06: return "set mode";
+    case 0x07: return "vfo";
+    case 0x08: return "memory";
+    case 0x0f: return "split";
+    case 0x11: return "attenuator";
+    case 0x14: return "level";
+    case 0x15: return "meter";
+    case 0x16: return "function";
+    case 0x19: return "read id";
+    case 0x1a: return "extended";
+    case 0x1c: return "ptt/tuner";
+    case 0x25: return "vfo freq";
+    case 0x26: return "vfo mode";
+    case 0xfa: return "NG";
+    case 0xfb: return "OK";
+    default:   return "";
+    }
+}
+
+
+/* little endian BCD frequency as sent by Icom rigs */
+static unsigned long long civ_freq(const unsigned char *p, int len)
+{
+    unsigned long long f = 0;
+
+    while (len-- > 0)
+    {
+        f = f * 100 + (p[len] >> 4) * 10 + (p[len] & 0x0f);
+    }
+
+    return f;
+}
+
+
+/*
+ * One CI-V frame, FE FE to FD included
+ */
+static void print_civ(int dir, const unsigned char *f, size_t len)
+{
+    const unsigned char *data = f + 5;
+    size_t dlen = len - 6;
+    size_t i;
+
+    if (len < 6)
+    {
+        printf("%23s CI-V short frame\n", "");
+        return;
+    }
+
+    if (dir == TRACE_RX && len == last_tx_len && memcmp(f, last_tx, len) == 0)
+    {
+        printf("%23s CI-V echo\n", "");
+        return;
+    }
+
+    printf("%23s CI-V %02X->%02X %02X %s", "", f[3], f[2], f[4],
+           civ_cmd_name(f[4]));
+
+    if ((f[4] == 0x00 || f[4] == 0x03 || f[4] == 0x05) && dlen >= 4 && dlen <= 5)
+    {
+        printf(" %llu Hz\n", civ_freq(data, dlen));
+        return;
+    }
+
+    if (dlen > 0)
+    {
+        printf(" data");
+
+        for (i = 0; i < dlen; i++)
+        {
+            printf(" %02X", data[i]);
+        }
+    }
+
+    printf("\n");
+}
+
+
+/*
+ * One Kenwood or NewCAT command, up to ';' included
+ */
+static void print_cat(const unsigned char *f, size_t len)
+{
+    const char *name = protocol == PROTO_NEWCAT ? "NewCAT" : "Kenwood";
+    size_t plen = len - 1;
+    size_t i;
+
+    if (plen == 1 && f[0] == '?')
+    {
+        printf("%23s %s error: command rejected\n", "", name);
+        return;
+    }
+
+    if (protocol == PROTO_KENWOOD && plen == 1 && f[0] == 'E')
+    {
+        printf("%23s %s error: communication error\n", "", name);
+        return;
+    }
+
+    if (protocol == PROTO_KENWOOD && plen == 1 && f[0] == 'O')
+    {
+        printf("%23s %s error: processing not complete\n", "", name);
+        return;
+    }
+
+    printf("%23s %s %.2s", "", name, (const char *)f);
+
+    /* VFO frequencies, 11 digits on Kenwood, 9 on NewCAT */
+    if (plen >= 11 && f[0] == 'F' && (f[1] == 'A' || f[1] == 'B'))
+    {
+        printf(" %llu Hz\n", strtoull((const char *)f + 2, NULL, 10));
+        return;
+    }
+
+    if (plen > 2)
+    {
+        printf(" ");
+
+        for (i = 2; i < plen; i++)
+        {
+            putchar(isprint(f[i]) ? f[i] : '.');
+        }
+    }
+
+    printf("\n");
+}
+
+
+/* pick the protocol from the first bytes sent to the rig */
+static void detect(const unsigned char *data, size_t len)
+{
+    size_t i;
+
+    if (len >= 2 && data[0] == 0xfe && data[1] == 0xfe)
+    {
+        protocol = PROTO_CIV;
+        return;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        if (!isprint(data[i]) && data[i] != '\r' && data[i] != '\n')
+        {
+            protocol = PROTO_HEX;
+            return;
+        }
+    }
+
+    if (memchr(data, ';', len))
+    {
+        protocol = ascii_mfg == 2 ? PROTO_NEWCAT : PROTO_KENWOOD;
+        return;
+    }
+
+    protocol = PROTO_HEX;
+}
+
+
+/*
+ * Append a record to the stream of its direction and decode every
+ * frame it completes
+ */
+static void decode(int dir, struct stream *s, const unsigned char *data,
+                   size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        int end;
+
+        if (s->len == FRAME_MAX)
+        {
+            printf("%23s frame too long, dropped\n", "");
+            s->len = 0;
+        }
+
+        if (protocol == PROTO_CIV && s->len == 0 && data[i] != 0xfe)
+        {
+            continue;   /* noise between frames */
+        }
+
+        s->buf[s->len++] = data[i];
+
+        end = protocol == PROTO_CIV ? data[i] == 0xfd : data[i] == ';';
+
+        if (!end)
+        {
+            continue;
+        }
+
+        if (protocol == PROTO_CIV)
+        {
+            print_civ(dir, s->buf, s->len);
+
+            if (dir == TRACE_TX)
+            {
+                memcpy(last_tx, s->buf, s->len);
+                last_tx_len = s->len;
+            }
+        }
+        else
+        {
+            print_cat(s->buf, s->len);
+        }
+
+        s->len = 0;
+    }
+}
+
+
+static void print_bytes(int dir, const unsigned char *data, size_t len)
+{
+    size_t i;
+
+    if (protocol == PROTO_KENWOOD || protocol == PROTO_NEWCAT)
+    {
+        for (i = 0; i < len; i++)
+        {
+            if (isprint(data[i]))
+            {
+                putchar(data[i]);
+            }
+            else
+            {
+                printf("\\x%02x", data[i]);
+            }
+        }
+    }
+    else
+    {
+        for (i = 0; i < len; i++)
+        {
+            printf(i ? " %02X" : "%02X", data[i]);
+        }
+    }
+
+    printf("\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    unsigned char hdr[TRACE_HEADER_LEN];
+    unsigned char rec[TRACE_RECORD_LEN];
+    unsigned char *data;
+    struct stream tx, rx;
+    const struct rig_caps *caps;
+    rig_model_t model;
+    uint64_t start_wall, start_mono;
+    time_t t;
+    char date[32];
+    int raw = 0;
+
+    while (1)
+    {
+        int c;
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, SHORT_OPTIONS, long_options, &option_index);
+
+        if (c == -1)
+        {
+            break;
+        }
+
+        switch (c)
+        {
+        case 'h':
+            usage();
+            exit(0);
+
+        case 'V':
+            version();
+            exit(0);
+
+        case 'p':
+            if (!optarg)
+            {
+                usage();    /* wrong arg count */
+                exit(1);
+            }
+
+            if (!strcmp(optarg, "civ"))
+            {
+                protocol = PROTO_CIV;
+            }
+            else if (!strcmp(optarg, "kenwood"))
+            {
+                protocol = PROTO_KENWOOD;
+            }
+            else if (!strcmp(optarg, "newcat"))
+            {
+                protocol = PROTO_NEWCAT;
+            }
+            else if (!strcmp(optarg, "hex"))
+            {
+                protocol = PROTO_HEX;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown protocol '%s'\n", optarg);
+                exit(1);
+            }
+
+            break;
+
+        case 'r':
+            raw = 1;
+            break;
+
+        default:
+            usage();    /* unknown option? */
+            exit(1);
+        }
+    }
+
+    if (optind + 1 != argc)
+    {
+        usage();
+        exit(1);
+    }
+
+    fp = fopen(argv[optind], "rb");
+
+    if (!fp)
+    {
+        perror(argv[optind]);
+        exit(2);
+    }
+
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+            || memcmp(hdr, TRACE_MAGIC, 8) != 0)
+    {
+        fprintf(stderr, "%s: not a Hamlib trace file\n", argv[optind]);
+        exit(2);
+    }
+
+    model = get_le(hdr + 8, 4);
+    start_wall = get_le(hdr + 16, 8);
+    start_mono = get_le(hdr + 24, 8);
+
+    rig_set_debug(RIG_DEBUG_NONE);
+    rig_load_all_backends();
+    caps = rig_get_caps(model);
+
+    if (caps)
+    {
+        ascii_mfg = strcmp(caps->mfg_name, "Yaesu") == 0 ? 2 : 1;
+    }
+
+    t = start_wall / 1000000;
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&t));
+
+    printf("Trace of %s %s (model %u), started %s.%06u\n",
+           caps ? caps->mfg_name : "unknown",
+           caps ? caps->model_name : "rig",
+           (unsigned)model, date, (unsigned)(start_wall % 1000000));
+
+    data = malloc(0x10000);
+    tx.len = rx.len = 0;
+
+    if (!data)
+    {
+        exit(2);
+    }
+
+    while (fread(rec, 1, sizeof(rec), fp) == sizeof(rec))
+    {
+        double when = (int64_t)(get_le(rec, 8) - start_mono) / 1e6;
+        int type = rec[8];
+        size_t len = get_le(rec + 10, 2);
+
+        if (fread(data, 1, len, fp) != len)
+        {
+            printf("%12.6f truncated record\n", when);
+            break;
+        }
+
+        switch (type)
+        {
+        case TRACE_TX:
+        case TRACE_RX:
+            if (protocol == PROTO_AUTO && type == TRACE_TX)
+            {
+                detect(data, len);
+            }
+
+            printf("%12.6f %s %5u  ", when, type == TRACE_TX ? "TX" : "RX",
+                   (unsigned)len);
+            print_bytes(type, data, len);
+
+            if (!raw && protocol != PROTO_AUTO && protocol != PROTO_HEX)
+            {
+                decode(type, type == TRACE_TX ? &tx : &rx, data, len);
+            }
+
+            break;
+
+        case TRACE_TIMEOUT:
+            printf("%12.6f timeout\n", when);
+            break;
+
+        case TRACE_FLUSH:
+            printf("%12.6f flush\n", when);
+            rx.len = 0;
+            break;
+
+        case TRACE_LOST:
+            printf("%12.6f %u records lost\n", when,
+                   len == 4 ? (unsigned)get_le(data, 4) : 0);
+            break;
+
+        default:
+            printf("%12.6f unknown record type 0x%02x, %u bytes\n", when, type,
+                   (unsigned)len);
+        }
+    }
+
+    free(data);
+    fclose(fp);
+
+    return 0;
+}
+
+
+void version()
+{
+    printf("rigtrace, %s\n\n", hamlib_version);
+    printf("%s\n", hamlib_copyright);
+}
+
+
+void usage()
+{
+    printf("Usage: rigtrace [OPTION]... FILE\n"
+           "Print a Hamlib wire trace file.\n\n");
+
+
+    printf(
+        "  -p, --protocol=PROTO          decode as civ, kenwood, newcat or hex\n"
+        "  -r, --raw                     only print the bytes, no decoding\n"
+        "  -h, --help                    display this help and exit\n"
+        "  -V, --version                 output version information and exit\n\n"
+    );
+
+    printf("\nReport bugs to <hamlib-developer@lists.sourceforge.net>.\n");
+
+}
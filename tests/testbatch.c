@@ -0,0 +1,177 @@
+/*
+ * Check of rig_batch_exec(): a batch of sets and gets against the dummy
+ * rig, then a run of gets against a TS-590S replayed from a trace file.
+ *
+ * The trace only knows the "FA;MD;IF;" of kenwood_batch_prefetch() as a
+ * single command, so the run of gets only succeeds when it went out in
+ * one write and the replies were served from the prefetch.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <hamlib/rig.h>
+#include "tracefile.h"
+#include "testutil.h"
+
+static const struct trace_exchange session[] =
+{
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID021;"), 0 },
+    { TRACE_BYTES("PS;"), TRACE_BYTES("PS1;"), 0 },
+    { TRACE_BYTES("FV;"), TRACE_BYTES("FV1.04;"), 0 },
+    { TRACE_BYTES("AI;"), TRACE_BYTES("AI0;"), 0 },
+    { TRACE_BYTES("IF;"), TRACE_BYTES("IF00014074000    +0000000000020000000;"), 0 },
+    {
+        TRACE_BYTES("FA;MD;IF;"),
+        TRACE_BYTES("FA00014074000;MD2;IF00014074000    +0000000000020000000;"), 0
+    },
+    { TRACE_BYTES("DA;"), TRACE_BYTES("DA0;"), 0 },
+    { TRACE_BYTES("AI0;"), TRACE_NONE, 0 },
+    { NULL }
+};
+
+
+static void test_dummy(void)
+{
+    RIG *rig;
+    struct rig_batch batch;
+    struct rig_batch_op *op;
+
+    rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!rig || rig_open(rig) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open the dummy rig\n");
+        failures++;
+        return;
+    }
+
+    rig_batch_init(&batch);
+
+    op = rig_batch_add(&batch, RIG_BATCH_SET_FREQ, RIG_VFO_CURR);
+    op->freq = 7074000;
+    op = rig_batch_add(&batch, RIG_BATCH_SET_MODE, RIG_VFO_CURR);
+    op->mode = RIG_MODE_USB;
+    op->width = RIG_PASSBAND_NOCHANGE;
+    op = rig_batch_add(&batch, RIG_BATCH_SET_PTT, RIG_VFO_CURR);
+    op->ptt = RIG_PTT_ON;
+    rig_batch_add(&batch, RIG_BATCH_GET_FREQ, RIG_VFO_CURR);
+    rig_batch_add(&batch, RIG_BATCH_GET_MODE, RIG_VFO_CURR);
+    rig_batch_add(&batch, RIG_BATCH_GET_PTT, RIG_VFO_CURR);
+
+    CHECK(batch.count == 6);
+    CHECK(rig_batch_exec(rig, &batch) == RIG_OK);
+    CHECK(batch.ops[3].retcode == RIG_OK && batch.ops[3].freq == 7074000);
+    CHECK(batch.ops[4].retcode == RIG_OK && batch.ops[4].mode == RIG_MODE_USB);
+    CHECK(batch.ops[5].retcode == RIG_OK && batch.ops[5].ptt == RIG_PTT_ON);
+
+    /* an error does not stop the batch, the first one is returned */
+    rig_batch_init(&batch);
+    rig_batch_add(&batch, RIG_BATCH_GET_FREQ, RIG_VFO_CURR);
+    op = rig_batch_add(&batch, RIG_BATCH_SET_LEVEL, RIG_VFO_CURR);
+    op->level = RIG_LEVEL_STRENGTH;     /* read only */
+    op = rig_batch_add(&batch, RIG_BATCH_SET_PTT, RIG_VFO_CURR);
+    op->ptt = RIG_PTT_OFF;
+
+    CHECK(rig_batch_exec(rig, &batch) == batch.ops[1].retcode);
+    CHECK(batch.ops[0].retcode == RIG_OK && batch.ops[0].freq == 7074000);
+    CHECK(batch.ops[1].retcode != RIG_OK);
+    CHECK(batch.ops[2].retcode == RIG_OK);
+
+    /* a full batch takes no more */
+    rig_batch_init(&batch);
+
+    while (rig_batch_add(&batch, RIG_BATCH_GET_FREQ, RIG_VFO_CURR)) {}
+
+    CHECK(batch.count == RIG_BATCH_MAX);
+
+    rig_close(rig);
+    rig_cleanup(rig);
+}
+
+
+/* returns 77 when the platform has no replay port */
+static int test_prefetch(const char *path)
+{
+    RIG *rig;
+    struct rig_batch batch;
+    int retcode;
+
+    rig = rig_init(RIG_MODEL_TS590S);
+
+    if (!rig)
+    {
+        failures++;
+        return 1;
+    }
+
+    rig_set_conf(rig, rig_token_lookup(rig, "replay_file"), path);
+    /* the gets would otherwise be answered from the IF cache */
+    rig_set_conf(rig, rig_token_lookup(rig, "cache_timeout"), "0");
+
+    retcode = rig_open(rig);
+
+    if (retcode != RIG_OK)
+    {
+        fprintf(stderr, "rig_open: %s\n", rigerror(retcode));
+        rig_cleanup(rig);
+
+        if (retcode == -RIG_ENIMPL)
+        {
+            return 77;
+        }
+
+        failures++;
+        return 1;
+    }
+
+    rig_batch_init(&batch);
+    rig_batch_add(&batch, RIG_BATCH_GET_FREQ, RIG_VFO_A);
+    rig_batch_add(&batch, RIG_BATCH_GET_MODE, RIG_VFO_CURR);
+    rig_batch_add(&batch, RIG_BATCH_GET_PTT, RIG_VFO_CURR);
+
+    CHECK(rig_batch_exec(rig, &batch) == RIG_OK);
+    CHECK(batch.ops[0].freq == 14074000);
+    CHECK(batch.ops[1].mode == RIG_MODE_USB);
+    CHECK(batch.ops[2].ptt == RIG_PTT_OFF);
+
+    rig_close(rig);
+    rig_cleanup(rig);
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    char path[64];
+    int ret;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    test_dummy();
+
+    snprintf(path, sizeof(path), "testbatch-%d.trc", (int)getpid());
+
+    if (trace_write_session(path, RIG_MODEL_TS590S, session) != 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    ret = test_prefetch(path);
+    unlink(path);
+
+    printf("testbatch: %d failure(s)\n", failures);
+
+    if (ret == 77 && !failures)
+    {
+        return 77;
+    }
+
+    return failures ? 1 : 0;
+}
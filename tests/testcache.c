@@ -0,0 +1,284 @@
+/*
+ * Check of the settings cache against the dummy rig: the settings kinds
+ * are off by default, serve what was read once turned on, are dropped by
+ * the matching rig_set_*() calls, and never keep a meter level.
+ *
+ * The rig is changed behind the frontend through the backend calls, as
+ * from the front panel, to tell a cached answer from a fresh one.
+ *
+ * Then rig_get_state_snapshot() must follow the cache, a new version at
+ * each update, and not move on a failed set.
+ *
+ * Last, the IF answer the kenwood backend keeps: a RIT set through RC and
+ * RU must drop its RIT field, so that the RIT read back is the new one.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <hamlib/rig.h>
+#include "cache.h"
+#include "tracefile.h"
+#include "testutil.h"
+
+
+static float get_af(RIG *rig)
+{
+    value_t val;
+
+    val.f = -1;
+    rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, &val);
+
+    return val.f;
+}
+
+
+static void panel_af(RIG *rig, float f)
+{
+    value_t val;
+
+    val.f = f;
+    rig->caps->set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, val);
+}
+
+
+static int get_nb(RIG *rig)
+{
+    int status = -1;
+
+    rig_get_func(rig, RIG_VFO_CURR, RIG_FUNC_NB, &status);
+
+    return status;
+}
+
+
+static int failing_set_mode(RIG *rig, vfo_t vfo, rmode_t mode,
+                            pbwidth_t width)
+{
+    return -RIG_ERJCTED;
+}
+
+
+static unsigned long check_snapshot(RIG *rig, unsigned long prev)
+{
+    struct rig_state_snapshot snap;
+    const struct rig_cache *cache = &rig->state.cache;
+
+    CHECK(rig_get_state_snapshot(rig, &snap) == RIG_OK);
+    CHECK(snap.version > prev);
+    CHECK(snap.vfo == cache->vfo);
+    CHECK(snap.freq == cache->freq);
+    CHECK(snap.vfo_freq == cache->vfo_freq);
+    CHECK(snap.mode == cache->mode);
+    CHECK(snap.ptt == cache->ptt);
+    CHECK(snap.split == cache->split);
+    CHECK(snap.split_vfo == cache->split_vfo);
+
+    return snap.version;
+}
+
+
+static void test_snapshot(RIG *rig)
+{
+    struct rig_state_snapshot snap;
+    static struct rig_caps caps;
+    struct rig_caps *saved = rig->caps;
+    unsigned long version = 0;
+
+    rig_set_freq(rig, RIG_VFO_CURR, 14074000);
+    version = check_snapshot(rig, version);
+    CHECK(rig_get_state_snapshot(rig, &snap) == RIG_OK && snap.freq == 14074000);
+
+    rig_set_mode(rig, RIG_VFO_CURR, RIG_MODE_USB, RIG_PASSBAND_NORMAL);
+    version = check_snapshot(rig, version);
+
+    rig_set_ptt(rig, RIG_VFO_CURR, RIG_PTT_ON);
+    version = check_snapshot(rig, version);
+    rig_set_ptt(rig, RIG_VFO_CURR, RIG_PTT_OFF);
+    version = check_snapshot(rig, version);
+
+    rig_set_split_vfo(rig, RIG_VFO_A, RIG_SPLIT_ON, RIG_VFO_B);
+    version = check_snapshot(rig, version);
+
+    /* a set the rig refuses publishes nothing */
+    caps = *saved;
+    caps.set_mode = failing_set_mode;
+    rig->caps = &caps;
+    CHECK(rig_set_mode(rig, RIG_VFO_CURR, RIG_MODE_CW, RIG_PASSBAND_NORMAL)
+          == -RIG_ERJCTED);
+    rig->caps = saved;
+
+    CHECK(rig_get_state_snapshot(rig, &snap) == RIG_OK);
+    CHECK(snap.version == version);
+    CHECK(snap.mode == RIG_MODE_USB);
+}
+
+
+/* a TS-450S, which clears RIT with RC and moves it 10 Hz at a time */
+static const struct trace_exchange ts450s_session[] =
+{
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID010;"), 0 },
+    { TRACE_BYTES("PS;"), TRACE_BYTES("PS1;"), 0 },
+    { TRACE_BYTES("AI0;"), TRACE_NONE, 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID010;"), 0 },
+    { TRACE_BYTES("IF;"), TRACE_BYTES("IF00014074000    +0000000000020000000;"), 0 },
+    { TRACE_BYTES("TO;"), TRACE_BYTES("TO0;"), 0 },
+    { TRACE_BYTES("RC;"), TRACE_NONE, 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID010;"), 0 },
+    { TRACE_BYTES("RU;"), TRACE_NONE, 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID010;"), 0 },
+    { TRACE_BYTES("RU;"), TRACE_NONE, 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID010;"), 0 },
+    { TRACE_BYTES("RU;"), TRACE_NONE, 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID010;"), 0 },
+    { TRACE_BYTES("IF;"), TRACE_BYTES("IF00014074000    +0003000000020000000;"), 0 },
+    { NULL }
+};
+
+
+static void test_kenwood_if(void)
+{
+    RIG *rig;
+    char path[64];
+    shortfreq_t rit = -1;
+    int retcode;
+
+    snprintf(path, sizeof(path), "testcache-%d.trc", (int)getpid());
+
+    if (trace_write_session(path, RIG_MODEL_TS450S, ts450s_session) != 0)
+    {
+        perror(path);
+        failures++;
+        return;
+    }
+
+    rig = rig_init(RIG_MODEL_TS450S);
+    rig_set_conf(rig, rig_token_lookup(rig, "replay_file"), path);
+    /* the IF answer stays fresh unless a command changes it */
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, 60000);
+
+    retcode = rig_open(rig);
+
+    if (retcode == RIG_OK)
+    {
+        CHECK(rig_get_rit(rig, RIG_VFO_CURR, &rit) == RIG_OK && rit == 0);
+        CHECK(rig_set_rit(rig, RIG_VFO_CURR, 30) == RIG_OK);
+        CHECK(rig_get_rit(rig, RIG_VFO_CURR, &rit) == RIG_OK && rit == 30);
+        rig_close(rig);
+    }
+    else if (retcode != -RIG_ENIMPL)    /* no replay on this platform */
+    {
+        fprintf(stderr, "rig_open: %s\n", rigerror(retcode));
+        failures++;
+    }
+
+    rig_cleanup(rig);
+    unlink(path);
+}
+
+
+static shortfreq_t get_rit(RIG *rig)
+{
+    shortfreq_t rit = -1;
+
+    rig_get_rit(rig, RIG_VFO_CURR, &rit);
+
+    return rit;
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *rig;
+    value_t val;
+    int kind;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!rig || rig_open(rig) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open the dummy rig\n");
+        return 1;
+    }
+
+    /* off by default, a panel change shows at once */
+    for (kind = HAMLIB_CACHE_LEVEL; kind < HAMLIB_CACHE_MAX; kind++)
+    {
+        CHECK(rig_get_cache_timeout_ms(rig, kind) == 0);
+    }
+
+    CHECK(rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_FREQ) == 500);
+
+    val.f = 0.5f;
+    rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, val);
+    CHECK(get_af(rig) == 0.5f);
+    panel_af(rig, 0.25f);
+    CHECK(get_af(rig) == 0.25f);
+
+    /* HAMLIB_CACHE_ALL leaves the settings kinds alone */
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, 1000);
+    CHECK(rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_LEVEL) == 0);
+
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_LEVEL, 10000);
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_FUNC, 10000);
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_RIT, 10000);
+
+    /* levels: served from the cache until set */
+    CHECK(get_af(rig) == 0.25f);
+    panel_af(rig, 0.5f);
+    CHECK(get_af(rig) == 0.25f);
+    val.f = 0.75f;
+    rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, val);
+    CHECK(get_af(rig) == 0.75f);
+
+    /* a meter is never cached */
+    rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_STRENGTH, &val);
+    CHECK(!rig_cache_find(rig, HAMLIB_CACHE_LEVEL, RIG_VFO_CURR,
+                          RIG_LEVEL_STRENGTH));
+    CHECK(!rig_cache_find(rig, HAMLIB_CACHE_LEVEL, RIG_VFO_A,
+                          RIG_LEVEL_STRENGTH));
+
+    /* funcs */
+    rig_set_func(rig, RIG_VFO_CURR, RIG_FUNC_NB, 1);
+    CHECK(get_nb(rig) == 1);
+    rig->caps->set_func(rig, RIG_VFO_CURR, RIG_FUNC_NB, 0);
+    CHECK(get_nb(rig) == 1);
+    rig_set_func(rig, RIG_VFO_CURR, RIG_FUNC_NB, 0);
+    CHECK(get_nb(rig) == 0);
+
+    /* RIT */
+    rig_set_rit(rig, RIG_VFO_CURR, 100);
+    CHECK(get_rit(rig) == 100);
+    rig->caps->set_rit(rig, RIG_VFO_CURR, 200);
+    CHECK(get_rit(rig) == 100);
+    rig_set_rit(rig, RIG_VFO_CURR, 300);
+    CHECK(get_rit(rig) == 300);
+
+    /* a frequency change may change any setting */
+    panel_af(rig, 0.125f);
+    CHECK(get_af(rig) == 0.75f);
+    rig_set_freq(rig, RIG_VFO_CURR, 7074000);
+    CHECK(get_af(rig) == 0.125f);
+
+    /* and a timeout of 0 turns the kind off again */
+    panel_af(rig, 0.5f);
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_LEVEL, 0);
+    CHECK(get_af(rig) == 0.5f);
+
+    test_snapshot(rig);
+
+    rig_close(rig);
+    rig_cleanup(rig);
+
+    test_kenwood_if();
+
+    printf("testcache: %d failure(s)\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,350 @@
+/*
+ * Check of the Icom backend against simicom, an IC-7300 on a pty.
+ *
+ * In transceive mode get_freq is answered from what the rig pushed: with
+ * the dial turning, the frequency read follows it and nothing is sent.
+ * A VFO switch drops what was learned, and a rig not heard for
+ * ICOM_TRN_LIVE_MS is asked again.
+ *
+ * The backend is called directly, so the frontend cache cannot answer,
+ * and the bytes written are counted by the port statistics.
+ *
+ * Then two rigs at different CI-V addresses share the line of one
+ * simicom: each must get its own answers, from two threads at once, and
+ * the second one must keep working once the first, which owns the port,
+ * is closed.
+ *
+ * Usage: testicom SIMICOM
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+#include "stats.h"
+#include "icom.h"
+#include "testutil.h"
+
+static const char *simicom;
+
+
+/*
+ * Start simicom with the options of argv, returns its pid and its pty in
+ * pty, or -1
+ */
+static pid_t start_sim(char *const argv[], char *pty, size_t size)
+{
+    int fd[2];
+    pid_t pid;
+    FILE *fin;
+
+    if (pipe(fd) < 0)
+    {
+        return -1;
+    }
+
+    pid = fork();
+
+    if (pid == 0)
+    {
+        dup2(fd[1], STDOUT_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        execv(simicom, argv);
+        _exit(127);
+    }
+
+    close(fd[1]);
+    fin = fdopen(fd[0], "r");
+
+    if (pid < 0 || !fin || !fgets(pty, size, fin))
+    {
+        if (pid > 0)
+        {
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+        }
+
+        if (fin)
+        {
+            fclose(fin);
+        }
+        else
+        {
+            close(fd[0]);
+        }
+
+        return -1;
+    }
+
+    fclose(fin);
+    pty[strcspn(pty, "\n")] = '\0';
+
+    return pid;
+}
+
+
+static void stop_sim(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+
+/* an IC-7300 at the CI-V address civaddr, in hex, or its default one */
+static RIG *open_rig(const char *pty, const char *civaddr, int trn)
+{
+    RIG *rig;
+
+    rig = rig_init(RIG_MODEL_IC7300);
+
+    if (!rig)
+    {
+        return NULL;
+    }
+
+    rig_set_conf(rig, rig_token_lookup(rig, "rig_pathname"), pty);
+
+    if (civaddr)
+    {
+        rig_set_conf(rig, rig_token_lookup(rig, "civaddr"), civaddr);
+    }
+
+    if (rig_open(rig) != RIG_OK)
+    {
+        rig_cleanup(rig);
+        return NULL;
+    }
+
+    if (trn != RIG_TRN_OFF && rig_set_trn(rig, trn) != RIG_OK)
+    {
+        rig_close(rig);
+        rig_cleanup(rig);
+        return NULL;
+    }
+
+    return rig;
+}
+
+
+static void close_rig(RIG *rig)
+{
+    rig_close(rig);
+    rig_cleanup(rig);
+}
+
+
+/* get_freq of the backend, counting the bytes it sent in *sent */
+static freq_t get_freq(RIG *rig, uint64_t *sent)
+{
+    freq_t freq = 0;
+    uint64_t tx = rig_stats_get_count(STATS_TX_BYTES);
+
+    CHECK(rig->caps->get_freq(rig, RIG_VFO_CURR, &freq) == RIG_OK);
+    *sent = rig_stats_get_count(STATS_TX_BYTES) - tx;
+
+    return freq;
+}
+
+
+/* the dial turns 10 Hz every 100 ms, the rig tells each step */
+static void test_dial(RIG *rig)
+{
+    freq_t f0, f1;
+    uint64_t sent;
+
+    f0 = get_freq(rig, &sent);
+    usleep(350 * 1000);
+    f1 = get_freq(rig, &sent);
+
+    CHECK(f1 > f0);
+    CHECK(sent == 0);
+}
+
+
+static void test_vfo_and_silence(RIG *rig)
+{
+    uint64_t sent;
+
+    /* the answer to the first read is learned too */
+    CHECK(get_freq(rig, &sent) == 14074000);
+    CHECK(get_freq(rig, &sent) == 14074000 && sent == 0);
+
+    /*
+     * VFO B has its own frequency, the rig does not tell.  rig_set_vfo()
+     * would read it back at once, hence the backend call.
+     */
+    CHECK(rig->caps->set_vfo(rig, RIG_VFO_B) == RIG_OK);
+    CHECK(get_freq(rig, &sent) == 7074000 && sent > 0);
+    CHECK(get_freq(rig, &sent) == 7074000 && sent == 0);
+
+    /* a silent rig may have been switched off */
+    usleep((ICOM_TRN_LIVE_MS + 200) * 1000);
+    CHECK(get_freq(rig, &sent) == 7074000 && sent > 0);
+}
+
+
+/* reads of one rig of the bus from its own thread */
+#define BUS_READS 100
+
+struct bus_reader
+{
+    RIG *rig;
+    freq_t freq;        /* what it must read */
+    int errors;
+};
+
+
+static void *bus_read(void *arg)
+{
+    struct bus_reader *r = arg;
+    freq_t freq;
+    int i;
+
+    for (i = 0; i < BUS_READS; i++)
+    {
+        if (r->rig->caps->get_freq(r->rig, RIG_VFO_CURR, &freq) != RIG_OK
+                || freq != r->freq)
+        {
+            r->errors++;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void test_bus(RIG *rig94, RIG *rig96)
+{
+    struct bus_reader r[2] = { { rig94, 14074000 }, { rig96, 7074000 } };
+    freq_t freq;
+    uint64_t sent;
+
+    CHECK(rig94->caps->set_freq(rig94, RIG_VFO_CURR, 14074000) == RIG_OK);
+    CHECK(rig96->caps->set_freq(rig96, RIG_VFO_CURR, 7074000) == RIG_OK);
+    CHECK(get_freq(rig94, &sent) == 14074000);
+    CHECK(get_freq(rig96, &sent) == 7074000);
+
+#ifdef HAVE_PTHREAD
+    {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, bus_read, &r[1]) == 0)
+        {
+            bus_read(&r[0]);
+            pthread_join(thread, NULL);
+        }
+    }
+#else
+    bus_read(&r[0]);
+    bus_read(&r[1]);
+#endif
+
+    CHECK(r[0].errors == 0);
+    CHECK(r[1].errors == 0);
+
+    /* the second rig takes the port over */
+    close_rig(rig94);
+    CHECK(rig96->caps->get_freq(rig96, RIG_VFO_CURR, &freq) == RIG_OK
+          && freq == 7074000);
+}
+
+
+int main(int argc, char *argv[])
+{
+    char *const dial_argv[] = { "simicom", "-t", "100", NULL };
+    char *const quiet_argv[] = { "simicom", NULL };
+    char *const bus_argv[] = { "simicom", "-a", "94", "-a", "96", NULL };
+    RIG *rig96;
+    char pty[256];
+    pid_t pid;
+    RIG *rig;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s SIMICOM\n", argv[0]);
+        return 1;
+    }
+
+    simicom = argv[1];
+    rig_set_debug(RIG_DEBUG_NONE);
+    rig_stats_enable(1);
+
+    pid = start_sim(dial_argv, pty, sizeof(pty));
+
+    if (pid < 0)
+    {
+        fprintf(stderr, "cannot start %s\n", simicom);
+        return 77;
+    }
+
+    rig = open_rig(pty, NULL, RIG_TRN_RIG);
+    CHECK(rig != NULL);
+
+    if (rig)
+    {
+        test_dial(rig);
+        close_rig(rig);
+    }
+
+    stop_sim(pid);
+
+    pid = start_sim(quiet_argv, pty, sizeof(pty));
+    CHECK(pid > 0);
+
+    if (pid > 0)
+    {
+        rig = open_rig(pty, NULL, RIG_TRN_RIG);
+        CHECK(rig != NULL);
+
+        if (rig)
+        {
+            test_vfo_and_silence(rig);
+            close_rig(rig);
+        }
+
+        stop_sim(pid);
+    }
+
+    pid = start_sim(bus_argv, pty, sizeof(pty));
+    CHECK(pid > 0);
+
+    if (pid > 0)
+    {
+        rig = open_rig(pty, "0x94", RIG_TRN_OFF);
+        rig96 = open_rig(pty, "0x96", RIG_TRN_OFF);
+        CHECK(rig != NULL && rig96 != NULL);
+
+        if (rig && rig96)
+        {
+            test_bus(rig, rig96);
+        }
+        else if (rig)
+        {
+            close_rig(rig);
+        }
+
+        if (rig96)
+        {
+            close_rig(rig96);
+        }
+
+        stop_sim(pid);
+    }
+
+    printf("testicom: %d failure(s)\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,482 @@
+/*
+ * Check of the rigctld command tokenizer, rigctl_parse_input(), against
+ * the dummy rig: long names after a backslash, the '+' and punctuation
+ * prefixes of the extended response protocol, comment lines, the line
+ * argument of send_morse with its spaces, and input that arrives in
+ * pieces, which must wait for the rest of the command and consume
+ * nothing meanwhile.
+ *
+ * Then the same through the binary framed protocol: frames round trip
+ * whole or byte by byte, and a frame over RIGCTL_FRAME_MAX is refused
+ * without losing the connection.
+ *
+ * Last, events to a subscriber that does not read: once its socket is
+ * full whole batches are dropped, and what it reads later holds no cut
+ * line.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(HAVE_SYS_SOCKET_H) && !defined(__MINGW32__)
+#  include <sys/socket.h>
+#  define NOTIFY_SOCKETS 1
+#endif
+
+#include <hamlib/rig.h>
+#include "rigctl_parse.h"
+#include "testutil.h"
+
+static RIG *my_rig;
+static FILE *fout;
+static struct rigctl_input in;
+static int vfo_mode;
+static int ext_resp;
+static char resp_sep = '\n';
+
+
+/* append received bytes to the connection buffer */
+static void feed_bytes(const void *data, size_t len)
+{
+    size_t room;
+    char *p = rigctl_input_space(&in, &room);
+
+    if (len > room)
+    {
+        len = room;
+    }
+
+    memcpy(p, data, len);
+    in.tail += len;
+}
+
+
+static void feed(const char *s)
+{
+    feed_bytes(s, strlen(s));
+}
+
+
+/*
+ * Run the commands of the buffer until it needs more input, returns the
+ * last return code and the output in buf, *plen bytes of it.
+ */
+static int run_bytes(char *buf, size_t size, size_t *plen)
+{
+    int retcode;
+    size_t len;
+
+    rewind(fout);
+
+    do
+    {
+        retcode = rigctl_parse_input(my_rig, &in, fout, NULL, &vfo_mode, '\r',
+                                     &ext_resp, &resp_sep);
+    }
+    while (retcode != RIGCTL_PARSE_MORE && retcode != 1 && retcode >= 0);
+
+    fflush(fout);
+    len = ftell(fout);
+    rewind(fout);
+
+    if (len >= size)
+    {
+        len = size - 1;
+    }
+
+    *plen = fread(buf, 1, len, fout);
+    buf[*plen] = '\0';
+
+    return retcode;
+}
+
+
+static int run(char *buf, size_t size)
+{
+    size_t len;
+
+    return run_bytes(buf, size, &len);
+}
+
+
+static int sends(const char *input, const char *expect)
+{
+    char buf[512];
+
+    feed(input);
+    run(buf, sizeof(buf));
+
+    if (strcmp(buf, expect) != 0)
+    {
+        fprintf(stderr, "input \"%s\":\n  got \"%s\"\n  expected \"%s\"\n", input,
+                buf, expect);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/* little endian */
+static unsigned char *put_le(unsigned char *p, uint64_t v, int n)
+{
+    while (n--)
+    {
+        *p++ = v & 0xff;
+        v >>= 8;
+    }
+
+    return p;
+}
+
+
+static unsigned long get_le(const unsigned char *p, int n)
+{
+    unsigned long v = 0;
+
+    while (n--)
+    {
+        v = (v << 8) | p[n];
+    }
+
+    return v;
+}
+
+
+/* a request frame with no value, or one double */
+static size_t make_frame(unsigned char *frame, unsigned char cmd,
+                         unsigned long id, const double *d)
+{
+    unsigned char *p = frame + 12;
+    size_t len;
+
+    if (d)
+    {
+        uint64_t v;
+
+        memcpy(&v, d, sizeof(v));
+        *p++ = 'd';
+        p = put_le(p, v, 8);
+    }
+
+    len = p - frame;
+    put_le(frame, len, 2);
+    frame[2] = cmd;
+    frame[3] = 0;
+    put_le(frame + 4, id, 4);
+    put_le(frame + 8, 0, 4);
+
+    return len;
+}
+
+
+/*
+ * Check the reply header, returns the values that follow
+ */
+static const unsigned char *check_reply(const unsigned char *reply,
+                                        size_t len, unsigned char cmd,
+                                        unsigned long id, int status)
+{
+    if (len < 12 || get_le(reply, 2) != len)
+    {
+        fprintf(stderr, "reply of %d bytes, length field %d\n", (int)len,
+                len < 2 ? -1 : (int)get_le(reply, 2));
+        failures++;
+        return NULL;
+    }
+
+    CHECK(reply[2] == cmd);
+    CHECK(get_le(reply + 4, 4) == id);
+    CHECK((int)get_le(reply + 8, 4) == status);
+
+    return reply + 12;
+}
+
+
+static void test_frames(void)
+{
+    unsigned char frame[32];
+    unsigned char big[RIGCTL_FRAME_MAX + 100];
+    char buf[512];
+    const unsigned char *v;
+    double d = 7074000;
+    size_t len, flen;
+    uint64_t bits;
+    int i;
+
+    CHECK(sends("\\binary\n", "RPRT 0\n"));
+    CHECK(in.binary);
+
+    /* set then get, the value comes back typed and the id echoed */
+    flen = make_frame(frame, 'F', 1, &d);
+    feed_bytes(frame, flen);
+    CHECK(run_bytes(buf, sizeof(buf), &len) == RIGCTL_PARSE_MORE);
+    check_reply((unsigned char *)buf, len, 'F', 1, RIG_OK);
+
+    flen = make_frame(frame, 'f', 0x12345678, NULL);
+    feed_bytes(frame, flen);
+    run_bytes(buf, sizeof(buf), &len);
+    v = check_reply((unsigned char *)buf, len, 'f', 0x12345678, RIG_OK);
+
+    if (v)
+    {
+        CHECK(len == 12 + 9 && v[0] == 'd');
+        bits = get_le(v + 1, 4) | ((uint64_t)get_le(v + 5, 4) << 32);
+        memcpy(&d, &bits, sizeof(d));
+        CHECK(d == 7074000);
+    }
+
+    /* a frame in pieces, one byte at a time */
+    flen = make_frame(frame, 'f', 2, NULL);
+
+    for (i = 0; i < flen - 1; i++)
+    {
+        feed_bytes(frame + i, 1);
+        CHECK(run_bytes(buf, sizeof(buf), &len) == RIGCTL_PARSE_MORE && len == 0);
+    }
+
+    feed_bytes(frame + i, 1);
+    run_bytes(buf, sizeof(buf), &len);
+    check_reply((unsigned char *)buf, len, 'f', 2, RIG_OK);
+
+    /*
+     * An oversized frame is refused once its header is in, the rest of
+     * it is dropped in whatever pieces it comes, and the next frame runs.
+     */
+    memset(big, 'x', sizeof(big));
+    put_le(big, sizeof(big), 2);
+    big[2] = 'F';
+    big[3] = 0;
+    put_le(big + 4, 3, 4);
+    put_le(big + 8, 0, 4);
+
+    feed_bytes(big, 6);
+    CHECK(run_bytes(buf, sizeof(buf), &len) == RIGCTL_PARSE_MORE && len == 0);
+    feed_bytes(big + 6, 1000);
+    CHECK(run_bytes(buf, sizeof(buf), &len) == RIGCTL_PARSE_MORE);
+    check_reply((unsigned char *)buf, len, 'F', 3, -RIG_EINVAL);
+
+    for (i = 1006; i < sizeof(big); i += len)
+    {
+        len = sizeof(big) - i < 1500 ? sizeof(big) - i : 1500;
+        feed_bytes(big + i, len);
+        CHECK(run_bytes(buf, sizeof(buf), &flen) == RIGCTL_PARSE_MORE && flen == 0);
+    }
+
+    flen = make_frame(frame, 'f', 4, NULL);
+    feed_bytes(frame, flen);
+    run_bytes(buf, sizeof(buf), &len);
+    check_reply((unsigned char *)buf, len, 'f', 4, RIG_OK);
+
+    /* a length shorter than the header cannot be skipped */
+    memset(frame, 0, sizeof(frame));
+    frame[0] = 4;
+    feed_bytes(frame, 4);
+    CHECK(run(buf, sizeof(buf)) == -RIG_EPROTO);
+}
+
+
+#ifdef NOTIFY_SOCKETS
+/* all a subscriber can read now, appended to buf */
+static size_t drain(int sock, char *buf, size_t size, size_t len)
+{
+    ssize_t n;
+
+    while (len < size
+            && (n = recv(sock, buf + len, size - len, MSG_DONTWAIT)) > 0)
+    {
+        len += n;
+    }
+
+    return len;
+}
+
+
+/*
+ * Each batch is a Version line and its Frequency line, the reader must
+ * see them in pairs with versions going up
+ */
+static void check_batches(const char *buf, size_t len, long *last)
+{
+    const char *p = buf, *end = buf + len;
+    long version, freq;
+    int n;
+
+    while (p < end)
+    {
+        n = 0;
+
+        if (sscanf(p, "Version: %ld\nFrequency: %ld\n%n", &version, &freq, &n) != 2
+                || n == 0 || p + n > end)
+        {
+            fprintf(stderr, "cut batch: %.40s\n", p);
+            failures++;
+            return;
+        }
+
+        CHECK(freq == 14074000 + version);
+        CHECK(version > *last);
+        *last = version;
+        p += n;
+    }
+}
+
+
+static void test_notify(void)
+{
+    static char buf[1 << 20];
+    struct rigctl_notify_out out;
+    char batch[RIGCTL_NOTIFY_BATCH_MAX];
+    int kept = 0, dropped = 0;
+    int size = 4096;
+    size_t len, blen;
+    long last = -1;
+    int sv[2];
+    int ret;
+    long k;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    {
+        CHECK(0);
+        return;
+    }
+
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    memset(&out, 0, sizeof(out));
+
+    /* the subscriber reads nothing */
+    for (k = 0; k < 10000; k++)
+    {
+        blen = snprintf(batch, sizeof(batch), "Version: %ld\nFrequency: %ld\n",
+                        k, 14074000 + k);
+        ret = rigctl_notify_send(sv[0], &out, batch, blen);
+        CHECK(ret == 0 || ret == 1);
+
+        if (ret == 0 && out.len > 0)
+        {
+            kept++;
+        }
+        else if (ret == 1)
+        {
+            dropped++;
+        }
+    }
+
+    CHECK(kept > 0);
+    CHECK(dropped > 0);
+
+    /* then catches up, the kept end of a batch comes once there is room */
+    len = 0;
+
+    do
+    {
+        len = drain(sv[1], buf, sizeof(buf), len);
+        CHECK(rigctl_notify_send(sv[0], &out, NULL, 0) == 0);
+    }
+    while (out.len > 0 && len < sizeof(buf));
+
+    len = drain(sv[1], buf, sizeof(buf), len);
+    CHECK(len > 0 && len < sizeof(buf));
+    check_batches(buf, len, &last);
+
+    /* and gets the next batch whole */
+    blen = snprintf(batch, sizeof(batch), "Version: %ld\nFrequency: %ld\n",
+                    k, 14074000 + k);
+    CHECK(rigctl_notify_send(sv[0], &out, batch, blen) == 0 && out.len == 0);
+    len = drain(sv[1], buf, sizeof(buf), 0);
+    CHECK(len == blen);
+    check_batches(buf, len, &last);
+    CHECK(last == k);
+
+    /* a subscriber gone is told apart from a slow one */
+    close(sv[1]);
+    CHECK(rigctl_notify_send(sv[0], &out, batch, blen) == -1);
+    close(sv[0]);
+}
+#endif
+
+
+int main(int argc, char *argv[])
+{
+    char buf[512];
+    freq_t freq;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    fout = tmpfile();
+    my_rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!fout || !my_rig || rig_open(my_rig) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open the dummy rig\n");
+        return 1;
+    }
+
+    /* short and long names, several commands per read, blank lines */
+    CHECK(sends("F 14074000\nf\n", "RPRT 0\n14074000\n"));
+    CHECK(sends("\r\n\n\\set_freq 7074000\r\n\\get_freq\n",
+                "RPRT 0\n7074000\n"));
+    CHECK(in.head == 0 && in.tail == 0);
+
+    /* a command in pieces waits for the rest */
+    feed("F 35");
+    CHECK(run(buf, sizeof(buf)) == RIGCTL_PARSE_MORE);
+    CHECK(in.tail - in.head == 4);
+    feed("73000");
+    CHECK(run(buf, sizeof(buf)) == RIGCTL_PARSE_MORE);
+    feed("\n");
+    run(buf, sizeof(buf));
+    CHECK(rig_get_freq(my_rig, RIG_VFO_CURR, &freq) == RIG_OK
+          && freq == 3573000);
+
+    /* a long name cut after the backslash, and within the name */
+    CHECK(sends("\\", ""));
+    CHECK(sends("get_fr", ""));
+    CHECK(sends("eq\n", "3573000\n"));
+
+    /* the '+' prefix and a punctuation separator */
+    CHECK(sends("+\\get_freq\n",
+                "get_freq:\nFrequency: 3573000\nRPRT 0\n"));
+    CHECK(sends(";f\n", "get_freq:;Frequency: 3573000;RPRT 0\n"));
+    CHECK(sends("|\\get_freq\n", "get_freq:|Frequency: 3573000|RPRT 0\n"));
+    ext_resp = 0;
+    resp_sep = '\n';
+
+    /* a comment is skipped up to its end of line, even in pieces */
+    CHECK(sends("# F 7000000 \\get_freq", ""));
+    CHECK(sends("\nf\n", "3573000\n"));
+
+    /* the morse line keeps its inner spaces, and waits for its newline */
+    CHECK(sends("b CQ CQ DE", ""));
+    CHECK(sends(" N0CALL\n", "RPRT 0\n"));
+    CHECK(in.head == in.tail);
+
+    /* an unknown long name is consumed without a reply */
+    CHECK(sends("\\no_such_command\nf\n", "3573000\n"));
+
+    /* q ends the session */
+    feed("q\n");
+    CHECK(run(buf, sizeof(buf)) == 1);
+
+    test_frames();
+#ifdef NOTIFY_SOCKETS
+    test_notify();
+#endif
+
+    rig_close(my_rig);
+    rig_cleanup(my_rig);
+    fclose(fout);
+
+    printf("testparse: %d failure(s)\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Check of the replay port: sessions of a TS-590S, an IC-7300 and an
+ * FTDX-101D are written as trace files, then replayed to their backends,
+ * at once, and for the TS-590S also at the recorded pace.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <hamlib/rig.h>
+#include "stats.h"
+#include "tracefile.h"
+
+static const struct trace_exchange ts590s_session[] =
+{
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID021;"), 0 },
+    { TRACE_BYTES("PS;"), TRACE_BYTES("PS1;"), 0 },
+    { TRACE_BYTES("FV;"), TRACE_BYTES("FV1.04;"), 0 },
+    { TRACE_BYTES("AI;"), TRACE_BYTES("AI0;"), 0 },
+    { TRACE_BYTES("IF;"), TRACE_BYTES("IF00014074000    +0000000000020000000;"), 0 },
+    { TRACE_BYTES("FA;"), TRACE_BYTES("FA00014074000;"), 200 },
+    { TRACE_BYTES("AI0;"), TRACE_NONE, 0 },
+    { NULL }
+};
+
+/* CI-V: the rig echoes the command on the bus ahead of its reply */
+static const struct trace_exchange ic7300_session[] =
+{
+    {
+        TRACE_BYTES("\xfe\xfe\x94\xe0\x03\xfd"),
+        TRACE_BYTES("\xfe\xfe\x94\xe0\x03\xfd"
+                    "\xfe\xfe\xe0\x94\x03\x00\x40\x07\x14\x00\xfd"), 0
+    },
+    { NULL }
+};
+
+static const struct trace_exchange ftdx101d_session[] =
+{
+    { TRACE_BYTES("AI;"), TRACE_BYTES("AI0;"), 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID0681;"), 0 },
+    { TRACE_BYTES("VS;"), TRACE_BYTES("VS0;"), 0 },
+    { TRACE_BYTES("IF;"), TRACE_BYTES("IF001014074000+000000200000;"), 0 },
+    { TRACE_BYTES("FA;"), TRACE_BYTES("FA014074000;"), 0 },
+    { TRACE_BYTES("AI0;"), TRACE_NONE, 0 },
+    { TRACE_BYTES("ID;"), TRACE_BYTES("ID0681;"), 0 },
+    { NULL }
+};
+
+static const struct
+{
+    rig_model_t model;
+    const struct trace_exchange *session;
+    int paced;          /* also replay at the recorded pace */
+} sessions[] =
+{
+    { RIG_MODEL_TS590S, ts590s_session, 1 },
+    { RIG_MODEL_IC7300, ic7300_session, 0 },
+    { RIG_MODEL_FTDX101D, ftdx101d_session, 0 },
+};
+
+
+static int replay(rig_model_t model, const char *path, int timing)
+{
+    RIG *rig;
+    freq_t freq = 0;
+    uint64_t start;
+    int elapsed_ms;
+    int retcode;
+
+    rig = rig_init(model);
+
+    if (!rig)
+    {
+        return 1;
+    }
+
+    rig_set_conf(rig, rig_token_lookup(rig, "replay_file"), path);
+    rig_set_conf(rig, rig_token_lookup(rig, "replay_timing"),
+                 timing ? "1" : "0");
+    /* the FA of the trace would otherwise be answered from the IF cache */
+    rig_set_conf(rig, rig_token_lookup(rig, "cache_timeout"), "0");
+
+    retcode = rig_open(rig);
+
+    if (retcode != RIG_OK)
+    {
+        fprintf(stderr, "%s rig_open: %s\n", rig->caps->model_name,
+                rigerror(retcode));
+        rig_cleanup(rig);
+        /* no replay on this platform, tell automake to skip the test */
+        return retcode == -RIG_ENIMPL ? 77 : 1;
+    }
+
+    start = rig_stats_now_us();
+    retcode = rig_get_freq(rig, RIG_VFO_CURR, &freq);
+    elapsed_ms = (rig_stats_now_us() - start) / 1000;
+
+    printf("replay %s timing=%d: freq=%.0f in %d ms\n", rig->caps->model_name,
+           timing, freq, elapsed_ms);
+
+    rig_close(rig);
+    rig_cleanup(rig);
+
+    if (retcode != RIG_OK || freq != 14074000)
+    {
+        fprintf(stderr, "rig_get_freq: %s\n", rigerror(retcode));
+        return 1;
+    }
+
+    /* a fast replay must not wait, a paced one must */
+    if (timing ? elapsed_ms < 200 : elapsed_ms >= 200)
+    {
+        fprintf(stderr, "unexpected replay time\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    char path[64];
+    int ret = 0;
+    int i;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    snprintf(path, sizeof(path), "testreplay-%d.trc", (int)getpid());
+
+    for (i = 0; ret == 0 && i < sizeof(sessions) / sizeof(sessions[0]); i++)
+    {
+        if (trace_write_session(path, sessions[i].model, sessions[i].session) != 0)
+        {
+            perror(path);
+            return 1;
+        }
+
+        ret = replay(sessions[i].model, path, 0);
+
+        if (ret == 0 && sessions[i].paced)
+        {
+            ret = replay(sessions[i].model, path, 1);
+        }
+
+        unlink(path);
+    }
+
+    return ret;
+}
@@ -45,6 +45,8 @@ int main(int argc, char *argv[])
     if (argc < 2)
     {
         hamlib_port_t myport;
+
+        memset(&myport, 0, sizeof(myport));
         /* may be overridden by backend probe */
         myport.type.rig = RIG_PORT_SERIAL;
         myport.parm.serial.rate = 9600;
@@ -73,6 +75,12 @@ int main(int argc, char *argv[])
 
     strncpy(my_rig->state.rigport.pathname, SERIAL_PORT, FILPATHLEN - 1);
 
+    /* replay a trace file instead of talking to the rig */
+    if (argc > 2)
+    {
+        rig_set_conf(my_rig, rig_token_lookup(my_rig, "replay_file"), argv[2]);
+    }
+
     retcode = rig_open(my_rig);
 
     if (retcode != RIG_OK)
@@ -0,0 +1,39 @@
+/*
+ * Helpers shared by the check programs, see testutil.h
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include "testutil.h"
+
+int failures;
+
+
+/*
+ * Numbers of read and write syscalls issued so far by this process,
+ * -1 when /proc/self/io is not available.
+ */
+void proc_syscalls(long *syscr, long *syscw)
+{
+    char line[128];
+    FILE *fp = fopen("/proc/self/io", "r");
+
+    *syscr = *syscw = -1;
+
+    if (!fp)
+    {
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        sscanf(line, "syscr: %ld", syscr);
+        sscanf(line, "syscw: %ld", syscw);
+    }
+
+    fclose(fp);
+}
@@ -0,0 +1,21 @@
+/*
+ * Helpers shared by the check programs
+ */
+
+#ifndef _TESTUTIL_H
+#define _TESTUTIL_H 1
+
+#include <stdio.h>
+
+/* failed checks so far */
+extern int failures;
+
+/* count and report a failed condition, the test goes on */
+#define CHECK(cond) \
+    do { if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; } } while (0)
+
+/* read and write syscalls of this process so far, from /proc/self/io */
+void proc_syscalls(long *syscr, long *syscw);
+
+#endif /* _TESTUTIL_H */
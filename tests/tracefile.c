@@ -0,0 +1,79 @@
+/*
+ * Writing of trace files for the replay port tests, see src/trace.h
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "trace.h"
+#include "tracefile.h"
+
+
+static void put_le(unsigned char *p, uint64_t val, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        p[i] = val >> (8 * i);
+    }
+}
+
+
+static void put_record(FILE *fp, uint64_t us, int type, const char *data,
+                       size_t len)
+{
+    unsigned char hdr[TRACE_RECORD_LEN];
+
+    put_le(hdr, us, 8);
+    hdr[8] = type;
+    hdr[9] = 0;
+    put_le(hdr + 10, len, 2);
+    fwrite(hdr, 1, sizeof(hdr), fp);
+    fwrite(data, 1, len, fp);
+}
+
+
+/*
+ * Write the session, ended by an exchange with a NULL command, as the
+ * trace of the given rig model.  Returns 0, or -1 with errno set.
+ */
+int trace_write_session(const char *path, rig_model_t model,
+                        const struct trace_exchange *session)
+{
+    unsigned char hdr[TRACE_HEADER_LEN];
+    uint64_t us = 1000;
+    FILE *fp;
+    int i;
+
+    fp = fopen(path, "wb");
+
+    if (!fp)
+    {
+        return -1;
+    }
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, TRACE_MAGIC, 8);
+    put_le(hdr + 8, model, 4);
+    put_le(hdr + 24, us, 8);
+    fwrite(hdr, 1, sizeof(hdr), fp);
+
+    for (i = 0; session[i].tx; i++)
+    {
+        us += 1000;
+        put_record(fp, us, TRACE_TX, session[i].tx, session[i].tx_len);
+
+        if (session[i].rx)
+        {
+            us += 1000 * session[i].ms + 100;
+            put_record(fp, us, TRACE_RX, session[i].rx, session[i].rx_len);
+        }
+    }
+
+    return fclose(fp) == 0 ? 0 : -1;
+}
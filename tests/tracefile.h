@@ -0,0 +1,32 @@
+/*
+ * Writing of trace files for the replay port tests, see src/trace.h
+ */
+
+#ifndef _TRACEFILE_H
+#define _TRACEFILE_H 1
+
+#include <hamlib/rig.h>
+
+/*
+ * One exchange of a recorded session: command, reply or NULL, and delay
+ * of the reply in ms.  The lengths allow binary frames, see TRACE_BYTES.
+ */
+struct trace_exchange
+{
+    const char *tx;
+    size_t tx_len;
+    const char *rx;
+    size_t rx_len;
+    int ms;
+};
+
+/* a string literal and its length, NULs included */
+#define TRACE_BYTES(s)  s, sizeof(s) - 1
+
+/* a command without reply */
+#define TRACE_NONE      NULL, 0
+
+extern int trace_write_session(const char *path, rig_model_t model,
+                               const struct trace_exchange *session);
+
+#endif /* _TRACEFILE_H */